@@ -3,50 +3,900 @@
    ================================================================
    這個程式可以讓我：
      1. 把單字分資料夾儲存
-     2. 用單字卡方式學習
-     3. 做測驗並記錄錯誤次數
+     2. 用單字卡方式學習（照字母順序，可以只看 a-c 這種範圍，也能列出單字一覽）
+     3. 做測驗並記錄錯誤次數（打英文，或是四選一的選擇題）
      4. 查看錯題本 / 針對錯題再練習
      5. 查詢 / 刪除單字
 
    單字資料存在程式同目錄下的 english_word.txt，
    每一行格式是：資料夾名稱 [Tab] 英文 [Tab] 中文 [Tab] 錯誤次數
    例如：ch1    apple    蘋果    3
+
+   編譯：gcc En_word.c -o En_word -pthread
+   （-pthread 是給大量匯入、背景寫入和伺服器模式用的執行緒；
+     Windows 不需要 -pthread，但一定要加 -lws2_32：伺服器模式每次都會編進去，
+     用 Visual C++ 的話下面的 #pragma 會自動連結，MinGW 的 gcc 要自己加）
+   Windows（MinGW）：gcc En_word.c -o En_word.exe -lws2_32
+   要和 Python 版共用 vocabulary.db 的話：
+         gcc -DUSE_SQLITE En_word.c -o En_word -pthread -lsqlite3
+   然後用 ./En_word --db vocabulary.db 開啟（單字改存在資料庫裡，不用 english_word.txt）
+   要給 Python 直接呼叫（english_word_lib.py）的話，編成共用函式庫：
+         gcc -O2 -shared -fPIC -fvisibility=hidden -DEN_WORD_LIBRARY -DUSE_SQLITE En_word.c -o libenword.so -pthread -lsqlite3
    ================================================================ */
 
 
 /* ========== 引入標頭檔 ==========
    就像使用工具箱前要先把工具帶來，
    這些 #include 讓我可以使用 C 語言內建的各種函數。
-   少了這些，編譯器會說「我不知道 printf 是什麼」。 */
+   少了這些，編譯器會說「我不知道 printf 是什麼」。
+
+   _POSIX_C_SOURCE 要寫在所有 #include 之前：
+   → 它告訴系統的標頭檔「我要用 POSIX 的函數（fileno、fsync...）」，
+     就算用 -std=c99 這種嚴格模式編譯也看得到它們。 */
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
 #include <stdio.h>   // printf（印出文字）、scanf（讀輸入）、fopen/fclose/fgets/fprintf（讀寫檔案）
-#include <stdlib.h>  // atoi（把字串 "3" 變成整數 3）
+#include <stdlib.h>  // atoi（把字串 "3" 變成整數 3）、malloc/realloc/free（動態配置記憶體）
+#include <stdarg.h>  // va_list（讓 journalWrite 可以像 printf 一樣接受任意個參數）
 #include <string.h>  // strcpy（複製字串）、strcmp（比較字串）、strstr（在字串裡找子字串）
-                     // strtok（切割字串）、strcspn（找特定字元的位置）、strlen（字串長度）
+                     // strtok（切割字串）、strcspn / memchr（找特定字元的位置）、strlen（字串長度）
 #include <time.h>    // time()，用來讓每次執行時隨機順序不同
+#include <stdint.h>  // uint32_t / int32_t（固定大小的整數型別，讓 Word 的大小在每台電腦都一樣）
+#include <sys/stat.h> // stat（查檔案大小和修改時間，判斷快照檔是不是最新的）
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <winsock2.h> // socket（伺服器模式的網路連線；一定要寫在 windows.h 前面）
+#include <windows.h> // CreateThread（Windows 版的執行緒）
+#include <io.h>      // _commit（Windows 版的 fsync）
+#else
+#include <pthread.h> // pthread_create（同時用好幾個 CPU 核心解析大檔案）、pthread_cond（叫醒寫入執行緒）
+#include <sched.h>   // sched_yield（佇列滿了的時候先讓寫入執行緒跑一下）
+#include <unistd.h>  // fsync（確保資料真的寫到磁碟上）
+#include <fcntl.h>   // open（用檔案描述子開檔，給 mmap 用）
+#include <sys/mman.h> // mmap（把檔案直接對應到記憶體，不用一行一行讀）
+#include <sys/socket.h> // socket / accept（伺服器模式：好幾個學生同時連進來）
+#include <netinet/in.h> // sockaddr_in（IPv4 位址）
+#include <arpa/inet.h>  // htons / htonl（把數字轉成網路用的 byte 順序）
+#include <signal.h>     // signal(SIGPIPE)（學生突然斷線時，不要讓整個伺服器跟著結束）
+#endif
+#ifdef _MSC_VER
+#pragma comment(lib, "ws2_32.lib") // Visual C++：自動連結 Winsock
+#endif
+#ifdef USE_SQLITE
+#include <sqlite3.h> // SQLite（--db：和 Python 版共用同一個 vocabulary.db）
+#endif
+#if defined(__SSE2__)
+#include <emmintrin.h> // SSE2：一次處理 16 個 byte（英文大小寫轉換用）
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>  // NEON：ARM 上一次處理 16 個 byte 的指令
+#endif
 
 
 /* ========== 常數定義 ==========
    用 #define 給數字取一個有意義的名字。
    好處：之後要改上限，只需要改這裡一處，不用在程式碼裡到處找數字。
    慣例：常數名稱全部大寫，方便一眼看出這是常數不是變數。 */
-#define WORD_MAX   1000  // 最多存幾個單字（陣列大小固定，不能超過）
-#define EN_LEN       50  // 英文單字欄位最長幾個字元（最後一格存 '\0' 結尾）
-#define CN_LEN      100  // 中文意思欄位最長幾個字元（UTF-8 中文一個字佔 3 bytes）
-#define FOLDER_MAX   50  // 最多幾個資料夾
+#define EN_LEN       50  // 英文輸入暫存區的大小（最後一格存 '\0' 結尾）
+#define CN_LEN      100  // 中文輸入暫存區的大小（UTF-8 中文一個字佔 3 bytes）
 #define LINE_BUF    300  // 讀取一整行文字時的暫存空間大小
+#define READ_STEP   512  // readLine 一次最多交給 fgets 幾個 byte（一行比這長就分好幾次讀）
+
+#define WORD_FILE      "english_word.txt"      // 單字主檔
+#define WORD_FILE_TMP  "english_word.txt.tmp"  // 重寫主檔時先寫到這裡，寫完再改名
+#define JOURNAL_FILE   "english_word.journal"  // 寫入日誌：記錄主檔之後的每一筆變更
+#define SNAP_FILE      "english_word.snap"     // 二進位快照：啟動時直接對應到記憶體使用
+#define SNAP_FILE_TMP  "english_word.snap.tmp"
+#define PROGRESS_FILE  "english_word.progress" // 伺服器模式每個使用者的學習進度（和單字庫分開存）
+#define PROGRESS_FILE_TMP "english_word.progress.tmp"
+#define EVENT_FILE     "english_word.events"   // 每一題的作答紀錄（二進位，只會往後加）
+#define EVENT_FILE_TMP "english_word.events.tmp"
+#define EVENT_FILE_OLD "english_word.events.old" // 看不懂的舊紀錄改名成這個，不直接蓋掉
+#define LIST_PAGE           20  // 清單（錯題本、查詢結果）一頁顯示幾行
+#define OUT_FLUSH_AT        65536 // 畫面輸出攢到這麼多 byte 才真的寫出去一次
+#define REVIEW_SESSION      20  // 一次複習測驗最多幾題
+#define WEIGHTED_QUIZ       20  // 加權抽題一次抽幾題
+#define ERROR_WEIGHT         3  // 每答錯一次，被抽到的權重多幾（沒錯過的字權重是 1）
+#define TYPO_LIMIT           2  // 預設最多容忍幾個打錯的字母（--typo 可以改，0 = 關閉）
+#define TYPO_CHARS_PER_EDIT  4  // 每幾個字母才容忍一個錯（4~7 個字母容忍 1 個，8 個以上容忍 2 個）
+#define SUGGEST_LIMIT        2  // 「你是不是要找」最多差幾個字母
+#define DISTRACT_CHOICES     3  // 選擇題除了正確答案，再放幾個干擾選項
+#define DISTRACT_KEEP        4  // 每個單字事先挑幾個干擾選項（多留一個，刪掉一個字也還夠用）
+#define DISTRACT_WINDOW      6  // 在字母順序索引裡前後各看幾個鄰居當候選
+#define DISTRACT_CANDIDATES (3 * 2 * DISTRACT_WINDOW) // 最多幾個候選（三份索引的鄰居）
+#define DISTRACT_FAR         6  // 編輯距離算到幾就不再算（再遠都一樣不像）
+#define DISTRACT_GLOSS       3  // 比中文意思時看前幾個中文字
+#define DISTRACT_UNSET     (-2) // distractors 裡「這個字還沒挑過」的記號
+
+#define ANSWER_WRONG  0  // askQuestion 的回傳值：答錯
+#define ANSWER_RIGHT  1  //                       答對
+#define ANSWER_NEAR   2  //                       差一點（打錯字，不算分也不算錯）
+#define SM2_EASE_INIT      250  // 新單字的難易係數（×100，也就是 2.5）
+#define SM2_EASE_MIN       130  // 難易係數最低降到 1.3
+#define SM2_INTERVAL_MAX 36500  // 複習間隔最長 100 年（其實就是「已經記住了」）
+#define RELEARN_MINUTES     10  // 答錯之後幾分鐘再考一次
+#define IMPORT_MAX_THREADS  64  // 大量匯入最多開幾個執行緒
+#define IMPORT_MIN_CHUNK (256 * 1024) // 每個執行緒至少分到多少 bytes（檔案小就不值得開執行緒）
+#define JOURNAL_BATCH       32  // 日誌攢幾筆才真正寫到磁碟一次（fsync）
+#define JOURNAL_COMPACT_AT 4096 // 日誌超過幾筆就重寫主檔、清空日誌
+#define PERSIST_RING      4096  // 背景寫入佇列最多放幾筆還沒寫的紀錄（一定要是 2 的次方）
+#define SERVER_MAX_SESSIONS 64  // 伺服器模式最多同時幾個連線
+#define SERVER_MAX_RESULTS  50  // FIND / SEARCH / ERRORS 一次最多回傳幾筆
+#define SERVER_LINE_MAX  65536  // 伺服器模式一行指令最多幾個 byte（超過整行丟掉、回 ERR）
+#define USER_NAME_LEN       32  // 使用者名稱最長幾個 byte（含結尾的 '\0'）
+#define CACHE_LINE          64  // 一條 cache line 的大小（兩個核心寫同一條就會互相拖慢）
+#define METRIC_LOAD    0  // 效能統計的操作種類：載入單字庫
+#define METRIC_SAVE    1  //                     儲存主檔（包含背景寫入執行緒的壓縮）
+#define METRIC_SEARCH  2  //                     查詢
+#define METRIC_ANSWER  3  //                     對答案
+#define METRIC_OPS     4  // 總共幾種
+#define METRIC_BUCKETS 36 // 延遲分布幾格：第 b 格是 2^b ~ 2^(b+1) 奈秒（最後一格大約一分鐘以上）
+#define METRIC_MAX_INDEXES 16 // 效能統計最多列幾個索引的大小
+#define PROGRESS_SAVE_EVERY 20  // 伺服器模式每個人答錯幾題就存一次進度檔（離線時也會存）
+#define CHANGE_KEEP       4096  // 變更紀錄留最近幾筆（更舊的游標就要重新下載全部）
+#define STATS_BUCKETS        8  // 錯誤次數分布分幾格：0 次、1 次、2~3、4~7……最後一格是 64 次以上
+#define STATS_RECENT        10  // 統計資訊列出最近幾次測驗的正確率
+#define CARD_PREFETCH        8  // 單字卡先排好幾張（包含正在看的那一張）
+#define SQL_SAVE_WORD     0  // SQLite 後端預先編譯好的 SQL：新增或更新一個單字（UPSERT）
+#define SQL_SAVE_REVIEW   1  //                           新增或更新一個單字的複習排程（UPSERT）
+#define SQL_DELETE_WORD   2  //                           刪除一個單字
+#define SQL_DELETE_REVIEW 3  //                           刪除一個單字的複習排程
+#define SQL_LOAD          4  //                           啟動時讀出所有單字
+#define SQL_BEGIN         5  //                           開始一個交易
+#define SQL_COMMIT        6  //                           結束交易（真正寫入）
+#define SQL_STMTS         7  // 總共幾句
+
+#define FNV_OFFSET  14695981039346656037ULL  // FNV-1a 雜湊的起始值
+#define FNV_PRIME   1099511628211ULL         // FNV-1a 雜湊的乘數
+
+#define STORE_INIT_CAP   256   // 單字庫第一次配置時先準備幾格（之後不夠再加倍）
+#define HASH_INIT_CAP     64   // 雜湊表第一次配置的格數（一定要是 2 的次方）
+#define ARENA_INIT_CAP  8192   // 字串池第一次配置的 byte 數（之後不夠再加倍）
+#define DICT_BLOCK        16   // 壓縮字典每幾個單字一塊（塊裡做前綴壓縮，每一塊的開頭可以直接跳過去）
+#define DICT_KEY_MAX     256   // 壓縮字典裡英文 key 最長幾個 byte（含 '\0'）
+#define BUMP_BLOCK     65536   // 測驗的記憶體池不夠用時，每次再多要一塊多大（byte）
+#define SESSION_ANSWER_AVG 16  // 一題的答案平均幾 byte（sessionBegin 先替答案留這麼多位置）
 
 
 /* ========== 結構定義 ==========
    struct（結構）可以把相關的資料綁在一起，
    就像一張單字卡上面同時有英文、中文、資料夾、錯誤次數。
-   typedef 讓我之後可以直接寫 Word，不用每次都寫 struct Word。 */
+   typedef 讓我之後可以直接寫 Word，不用每次都寫 struct Word。
+
+   為什麼 Word 裡面不直接放 char english[50] 這種陣列？
+   → 舊版每個 Word 有 english[50] + chinese[100] + folder[50]，
+     一個單字就佔 204 bytes，但大部分單字只有幾個字母，其餘空間都是浪費。
+   → 現在把所有字串「緊密地」排在同一塊記憶體（字串池 StrArena）裡，
+     Word 只記錄「字串從字串池的第幾個 byte 開始」（位移 offset）。
+   → 資料夾名稱只存一個小小的編號（folders 登錄表的索引），不用每個單字都存一份。
+   → 這樣一個 Word 只有 36 bytes（將近一半是複習排程），掃描 10 萬個單字時幾乎都能留在 CPU 快取裡。 */
+
+/* Review：一個單字的複習排程（SM-2 間隔重複法）
+   -------------------------------------------------------
+   SM-2 的想法：每答對一次，下次複習的間隔就拉長（1 天 → 6 天 → 6×2.5 天...），
+   答錯就從頭來過；越常答錯的字「難易係數」越低，間隔拉長得越慢。
+   這樣每次測驗都先考「快要忘記」的字，已經很熟的字就不用一直考。
+
+   時間都用「從 1970 年起算的分鐘數」，uint32_t 用到西元 10000 年都夠。*/
+typedef struct {
+    uint32_t due;         // 下次該複習的時間（分鐘）；0 = 還沒學過的新單字
+    uint32_t lastReview;  // 上次複習的時間（分鐘）
+    uint16_t interval;    // 目前的複習間隔（天）
+    uint16_t ease;        // 難易係數 ×100（SM-2 的 EF，新單字是 SM2_EASE_INIT）
+    uint16_t reps;        // 連續答對幾次
+    uint16_t lapses;      // 學會之後又答錯幾次
+} Review;
+
 typedef struct {
-    char english[EN_LEN];  // 英文單字，例如 "apple"
-    char chinese[CN_LEN];  // 中文意思，例如 "蘋果"
-    char folder[EN_LEN];   // 屬於哪個資料夾，例如 "ch1"
-    int  errorCount;       // 答錯了幾次（測驗時答錯就 +1）
+    uint32_t enOff;       // 英文單字在字串池的位移，例如指向 "apple"
+    uint32_t cnOff;       // 中文意思在字串池的位移，例如指向 "蘋果"
+    uint32_t folderId;    // 屬於哪個資料夾（folders 登錄表的索引），例如 0 代表 "ch1"
+    int32_t  errorCount;  // 答錯了幾次（測驗時答錯就 +1）
+    uint32_t keyOff;      // 正規化之後的英文、中文（比對用，見 normalizeText）；和 enOff 一樣代表不用另外存
+    Review   review;      // 複習排程
 } Word;
 
+/* StrArena：字串池
+   -------------------------------------------------------
+   一大塊連續的 char 記憶體，每個字串接在上一個字串的 '\0' 後面：
+     "apple\0蘋果\0banana\0香蕉\0..."
+   空間不夠時用 realloc 加倍，因為 Word 存的是「位移」不是指標，
+   所以就算 realloc 把整塊搬到別的地址，位移還是正確的。
+
+   borrowed（借來的）是什麼？
+   → 從快照檔（english_word.snap）啟動時，data 直接指向對應到記憶體的檔案內容，
+     不是 malloc 來的，所以不能 realloc / free，第一次要長大時要先複製一份出來。
+   → WordStore、HashIndex、GramIndex 裡的 borrowed 也是同樣的意思。 */
+typedef struct {
+    char   *data;      // 字串池本體
+    size_t  used;      // 已經用了幾個 byte
+    size_t  capacity;  // 目前總共配置了幾個 byte
+    size_t  garbage;   // 被刪除單字留下、已經沒人使用的 byte 數
+    int     borrowed;  // 1 = data 指向快照檔，不是自己 malloc 的
+} StrArena;
+
+/* WordStore：會自動長大的單字庫
+   -------------------------------------------------------
+   words[] 不夠用時就把容量加倍（1 → 2 → 4 → ...），
+   平均下來每次新增只要 O(1)，也不再有 1000 個單字的上限。 */
+typedef struct {
+    Word     *words;     // 單字陣列（動態配置）
+    int       count;     // 目前存了幾個單字（陣列用了幾格）
+    int       capacity;  // 目前陣列總共有幾格
+    StrArena  strings;   // 所有英文、中文字串都放在這裡
+    int       borrowed;  // 1 = words 指向快照檔，不是自己 malloc 的
+} WordStore;
+
+/* HashSlot / HashIndex：開放定址（open addressing）的雜湊表
+   -------------------------------------------------------
+   用途：用「英文」或「資料夾 + 英文」直接跳到對應的單字，不用從頭掃到尾。
+
+   原理：
+   → 先把鍵（例如 "apple"）算成一個數字 hash，hash & mask 就是它該放的格子。
+   → 那格已經有人了，就往下一格找（線性探測），直到找到空格。
+   → 查詢時也從同一格開始往下找，遇到空格就代表「沒有這個鍵」。
+   → 每格同時存 hash 和單字索引，比對時先比 hash，
+     hash 一樣才去比字串，大部分不相干的格子一下就跳過了。
+
+   特殊的 value：
+     HASH_EMPTY → 這格從來沒用過（查詢到這裡就可以停了）
+     HASH_TOMB  → 這格的東西被刪掉了（「墓碑」，查詢要繼續往下找） */
+#define HASH_EMPTY  (-1)
+#define HASH_TOMB   (-2)
+
+typedef struct {
+    uint32_t hash;   // 鍵的雜湊值
+    int32_t  value;  // 存放的東西（單字索引或資料夾編號），或 HASH_EMPTY / HASH_TOMB
+} HashSlot;
+
+typedef struct {
+    HashSlot *slots;  // 雜湊表本體（格數一定是 2 的次方）
+    uint32_t  mask;   // 格數 - 1，用 hash & mask 取代 hash % 格數，比較快
+    int       used;   // 用過的格數（包含墓碑），決定什麼時候要擴充
+    int       live;   // 真正有東西的格數
+    int       borrowed; // 1 = slots 指向快照檔，不是自己 malloc 的
+} HashIndex;
+
+/* GramIndex：片段（n-gram）倒排索引，讓 search() 不用每次都 strstr 整個單字庫
+   -------------------------------------------------------
+   想法：先把每個單字拆成很多小「片段」，記下「哪些單字含有這個片段」。
+     英文 "cat" → 2 個字的片段 ^c ca at，3 個字的片段 ^ca cat（^ 代表字串開頭）
+     中文 "小貓" → 1 個字的片段 小 貓，2 個字的片段 ^小 小貓
+   查詢 "cat" 時，只要拿出「含有 cat 這個片段」的單字清單（Posting），
+   再用 strstr 確認一下就好，不用把 20 萬個單字都看過一遍。
+
+   為什麼英文用 2~3 個字、中文用 1~2 個字？
+   → 英文字母只有 26 個，單一字母幾乎每個單字都有，當索引沒有意義；
+     3 個字母的組合就很有鑑別度了。
+   → 中文字有好幾千個，一個字就很有鑑別度，而且大家常常只查一個字（例如「貓」）。
+
+   片段編成一個 64 位元整數：最高位元是欄位（英文 / 中文），
+   剩下 63 位元剛好放 3 個 21 位元的 Unicode 字元（沒用到的位置是 0）。
+
+   為什麼清單不是各自 malloc 一塊，而是全部放在同一個 pool 裡？
+   → Posting 只記錄「從 pool 的第幾格開始」（位移），不存指標，
+     整個索引就可以原封不動寫進快照檔，下次啟動直接對應到記憶體使用。
+   → 某個清單滿了，就在 pool 最後面開一塊兩倍大的新空間搬過去，
+     舊的那塊變成垃圾，垃圾超過一半時整理一次（gramCompact）。 */
+#define GRAM_EN     0ULL        // 英文欄位的片段
+#define GRAM_CN     1ULL        // 中文欄位的片段
+#define GRAM_START  0x110000u   // 「字串開頭」的虛擬字元（比所有 Unicode 字元都大，不會撞到真的字）
+
+typedef struct {
+    uint64_t key;       // 片段本身（編碼後的整數）
+    uint32_t off;       // 這個清單在 pool 裡從第幾格開始
+    int32_t  count;     // 清單裡有幾個單字
+    int32_t  capacity;  // 這塊空間總共有幾格
+    int32_t  reserved;  // 補齊成 24 bytes，讓快照檔的格式固定
+} Posting;
+
+/* GramKeys：拆片段時放片段的暫存區（不夠會自動加倍）
+   查詢用的是自己的暫存區，不和索引共用，好幾個執行緒才能同時查詢（見「伺服器模式」）。*/
+typedef struct {
+    uint64_t *keys;
+    int       cap;
+} GramKeys;
+
+typedef struct {
+    Posting   *lists;       // 所有片段的單字清單
+    int        count;       // 目前有幾種片段
+    int        capacity;    // lists 總共有幾格
+    int32_t   *pool;        // 所有清單的單字索引都放在這裡
+    uint32_t   poolUsed;    // pool 用了幾格
+    uint32_t   poolCap;     // pool 總共有幾格
+    uint32_t   poolGarbage; // pool 裡有幾格是搬家後留下的垃圾
+    HashIndex  lookup;      // 片段 → lists 的索引
+    GramKeys   scratch;     // 新增、刪除單字時拆片段用的暫存區（重複使用，不用每次 malloc）
+    int        borrowed;    // 1 = lists 和 pool 指向快照檔，不是自己 malloc 的
+} GramIndex;
+
+/* IdList：一串單字索引（搜尋結果之類的），容量不夠會自動加倍*/
+typedef struct {
+    int *ids;
+    int  count;
+    int  capacity;
+} IdList;
+
+/* SortedIndex：照字母順序排好的單字索引（陣列裡放的是 library 的索引）
+   -------------------------------------------------------
+   kind 決定怎麼排：
+     SORT_ALPHA  → 照英文排；一樣的英文再照資料夾、中文排。
+     SORT_FOLDER → 先照資料夾分開，資料夾裡再照英文、中文排（一個資料夾的字是連續的一段）。
+     SORT_GLOSS  → 先照資料夾分開，資料夾裡再照中文、英文排（中文開頭一樣的字排在一起）。*/
+#define SORT_ALPHA  0
+#define SORT_FOLDER 1
+#define SORT_GLOSS  2
+
+typedef struct {
+    IdList list;
+    int    kind;
+    int    ready;    // 0 = 還沒建，第一次用到時才整個排序
+} SortedIndex;
+
+/* SortCursor：記住排好的順序裡「看到哪個字」（用字本身記，不用位置，新增、刪除單字也不會跑掉）*/
+typedef struct {
+    int   valid;
+    int   folderId;
+    char *en;    // 正規化之後的英文（malloc 來的，中文緊接在後面，同一塊記憶體）
+    char *cn;    // 正規化之後的中文
+} SortCursor;
+
+/* DistractorIndex：每個單字事先挑好的選擇題干擾選項
+   -------------------------------------------------------
+   第 i 個單字的選項在 ids[i × DISTRACT_KEEP] 開始的 DISTRACT_KEEP 格，
+   tags 記著當初挑的是哪個字（資料夾 + 英文的雜湊）：那一格後來換成別的字的話就對不上，不會拿錯。*/
+typedef struct {
+    int32_t  *ids;      // DISTRACT_UNSET = 這個字還沒挑過；-1 = 空格
+    uint32_t *tags;
+    int       capacity; // 放得下幾個單字
+    int       ready;    // 0 = 還沒出過選擇題，什麼都不用維護
+} DistractorIndex;
+
+/* SortedView：排好的索引裡的一段（單字一覽傳給 pageList 用）*/
+typedef struct {
+    const SortedIndex *order;
+    int                first;  // 這一段從第幾個開始
+} SortedView;
+
+/* Card：預先排好的一張單字卡（內容是複製出來的，翻的時候不用再查單字庫）*/
+typedef struct {
+    int         pos;     // 這是第幾張（從 0 算）
+    int         idx;     // 哪一個單字（記住看到哪裡用）
+    int         errors;  // 答錯過幾次
+    const char *en;      // 下面三個都指向 text 裡面
+    const char *cn;
+    const char *folder;
+    char       *text;    // 英文、中文、資料夾接在一起（各自有 '\0'），這一格一直重複用，不夠才加大
+    size_t      cap;
+} Card;
+
+/* CardDeck：一次單字卡學習（詳細說明見「單字卡學習」那一段）*/
+typedef struct {
+    int  *order;                // 要看的單字，照順序（開始時一次決定好）
+    int   count;                // 總共幾張
+    int   next;                 // 下一張是第幾張（cardNext 給出去的是第 next - 1 張）
+    int   filled;               // 已經排好到第幾張（不含）
+    Card  ring[CARD_PREFETCH];  // 第 pos 張放在 ring[pos % CARD_PREFETCH]
+} CardDeck;
+
+/* Folder：一個資料夾
+   -------------------------------------------------------
+   members 記錄這個資料夾有哪些單字（由小到大排好），
+   統計數量、出題時只要看這一串，不用把整個單字庫掃一遍。*/
+typedef struct {
+    uint32_t nameOff;   // 資料夾名稱在 FolderRegistry.names 的位移
+    IdList   members;   // 這個資料夾裡的單字索引（由小到大）
+} Folder;
+
+/* FolderRegistry：資料夾登錄表
+   -------------------------------------------------------
+   舊版是 char folderList[50][50]，最多只能有 50 個資料夾，
+   現在和單字庫一樣用「動態陣列 + 字串池」，資料夾要幾個都可以。
+   每個資料夾名稱只存一次，之後都用編號（items 的索引）代表它。
+
+   membersReady：從快照檔啟動時，為了不拖慢啟動，members 先不建，
+   第一次真的用到時才掃一遍單字庫建起來（之後就一直隨著新增、刪除更新）。*/
+typedef struct {
+    Folder   *items;
+    int       count;
+    int       capacity;
+    StrArena  names;         // 所有資料夾名稱
+    HashIndex index;         // 資料夾名稱 → 資料夾編號
+    int       membersReady;  // 1 = 每個資料夾的 members 都是最新的
+} FolderRegistry;
+
+/* IndexHeap：單字的優先順序佇列（索引堆積 indexed heap）
+   -------------------------------------------------------
+   heap 裡放的是單字的索引，排成一棵二元 heap：
+   每個位置都「比它底下的兩個子節點更該排前面」，所以 heap[0] 永遠是第一名。
+   kind 決定「誰排前面」和「哪些單字要放進來」：
+     HEAP_ERRORS → 有答錯過的單字，錯最多的在前（錯題本）
+     HEAP_DUE    → 學過的單字，最早到期的在前（複習佇列）
+     HEAP_NEW    → 還沒學過的新單字，先加進來的在前
+
+   pos[i] 記錄單字 i 在 heap 的哪個位置（-1 = 不在 heap 裡），
+   答題之後就能直接找到它、往上或往下調整，O(log n) 就更新完，不用整個重新排序。
+
+   ready：啟動時先不建（讀檔時一直調整 heap 沒有意義），
+   第一次真的要用時才一次建好（O(n)），之後就隨著答題即時更新。*/
+#define HEAP_ERRORS 0
+#define HEAP_DUE    1
+#define HEAP_NEW    2
+
+typedef struct {
+    int32_t *heap;      // heap[k] = 單字索引
+    int32_t *pos;       // pos[i]  = 單字 i 在 heap 的位置
+    int      count;     // heap 裡有幾個單字
+    int      capacity;  // heap 和 pos 的大小
+    int      ready;     // 1 = heap 是最新的
+    int      kind;      // HEAP_ERRORS / HEAP_DUE / HEAP_NEW
+} IndexHeap;
+
+/* HeapFilter：heapTop 用來篩選單字的函數
+   回傳值：1 = 要這個，0 = 跳過，-1 = 後面的都不用看了（例如已經不是到期的）*/
+typedef int (*HeapFilter)(int idx, const void *ctx);
+
+/* ListRender：pageList 用來排出清單第 first 行開始的 count 行*/
+typedef void (*ListRender)(int first, int count, void *ctx);
+
+/* Rng：亂數產生器（xoshiro256**）的狀態
+   -------------------------------------------------------
+   為什麼不用 rand()？
+   → 很多系統的 rand() 只有 15 bits（RAND_MAX = 32767），單字一多，後面的字根本抽不到。
+   → rand() % n 還會偏向比較小的數字（除不盡多出來的那一段會多出現一次）。
+   xoshiro256** 只用到乘法、位移和互斥或，比 rand() 快，品質也好得多。*/
+typedef struct {
+    uint64_t s[4];
+} Rng;
+
+/* WeightTree：加權抽題用的 Fenwick tree（樹狀陣列）
+   -------------------------------------------------------
+   每個單字有一個權重（錯越多次越重），抽題時要「依照權重的比例」隨機挑。
+   sum[i] 存的是一小段單字的權重總和（哪一段由 i 的最低位元決定），
+   所以「改一個權重」和「找出累計權重排第 r 的單字」都只要 O(log n)，
+   抽 20 題不用把整個單字庫掃一遍。
+
+   為什麼不用 alias table？
+   → alias table 每次抽是 O(1)，但權重一改就要整張重建（O(n)），
+     這裡每答錯一題權重就會變，抽過的字也要暫時拿掉才不會重複，Fenwick tree 這兩件事都是 O(log n)。
+
+   ready 和 IndexHeap 一樣：第一次抽題時才建，之後隨著新增、刪除、答錯即時更新。*/
+typedef struct {
+    uint64_t *sum;      // sum[1..count]（Fenwick tree 習慣從 1 開始編號，sum[0] 不用）
+    int       count;    // 有幾個位置
+    int       capacity; // sum 陣列的大小
+    int       ready;    // 1 = sum 是最新的
+} WeightTree;
+
+/* EditPattern：算編輯距離用的「題目字串」預先處理結果（Myers 位元平行演算法）
+   -------------------------------------------------------
+   peq[c] 的第 i 個 bit = 1 代表「字串的第 i 個字元是 c」。
+   有了這張表，另一個字串每讀一個字元，只要幾個 64-bit 的位元運算
+   就能一次算完動態規劃表的一整欄，不用一格一格填。
+   同一個字串要跟很多字比（BK-tree 查詢）時，這張表只要建一次。
+
+   字串超過 64 個 byte 放不進一個 uint64_t，就退回一般的動態規劃。*/
+typedef struct {
+    uint64_t    peq[256];
+    const char *str;
+    int         len;
+} EditPattern;
+
+/* BkNode / BkTree：找「最接近的單字」用的 BK-tree
+   -------------------------------------------------------
+   每個節點是一個英文單字，子節點依照「和父節點的編輯距離」分開掛。
+   因為編輯距離滿足三角不等式，要找距離 query 不超過 r 的字時，
+   跟某個節點距離是 d 的話，只要往「邊上距離在 d-r ~ d+r 之間」的子節點找，
+   其他整棵子樹都可以跳過。
+
+   同一個英文在好幾個資料夾只存一個節點，refs 記錄單字庫裡有幾個單字是這個英文；
+   刪到 0 就當作已刪除（節點還要留著當路標），刪掉的太多就整棵重建。
+   字串自己存一份（names），不受單字庫搬移、壓縮影響。
+   ready 和其他索引一樣：第一次用到才建。*/
+typedef struct {
+    uint32_t nameOff;      // 英文在 names 的位移
+    int32_t  len;          // 英文的長度
+    int32_t  dist;         // 和父節點的編輯距離
+    int32_t  maxChild;     // 子節點的邊上最大的距離（查詢時用來提早放棄）
+    int32_t  refs;         // 單字庫裡有幾個單字是這個英文（0 = 已刪除）
+    int32_t  firstChild;   // 第一個子節點（-1 = 沒有）
+    int32_t  nextSibling;  // 同一個父節點的下一個子節點（-1 = 沒有）
+} BkNode;
+
+typedef struct {
+    BkNode  *nodes;
+    int      count;
+    int      capacity;
+    int      dead;         // refs 是 0 的節點有幾個
+    StrArena names;
+    int      ready;        // 1 = 樹是最新的
+} BkTree;
+
+/* SnapHeader：快照檔（english_word.snap）的檔頭
+   -------------------------------------------------------
+   快照檔就是把記憶體裡的單字庫和所有索引「原封不動」寫進檔案：
+     [檔頭] [words] [字串池] [資料夾] [三個雜湊表] [片段清單] [片段 pool] [片段雜湊表] [資料夾名稱]
+   下次啟動時用 mmap 把整個檔案對應到記憶體，
+   library.words 之類的指標直接指向檔案內容，不用 fgets、strtok、strcpy、atoi，
+   所以不管有幾個單字，啟動時間都差不多。
+
+   sizeWord 這些欄位記錄寫檔時各個結構的大小，
+   換了編譯器或電腦導致結構大小不同時，就知道這份快照不能用，改讀文字檔。 */
+#define SNAP_MAGIC     "ENWSNAP"    // 檔案開頭的識別字
+#define SNAP_VERSION   4            // 格式版本，格式改了就加 1
+#define SNAP_ENDIAN    0x01020304u  // 用來認出「byte 順序不同的電腦」寫的檔案
+
+#define SEC_WORDS          0  // 各區段的編號
+#define SEC_STRINGS        1
+#define SEC_FOLDERS        2  // 每個資料夾名稱的位移（uint32_t）
+#define SEC_IDX_EN         3
+#define SEC_IDX_FOLDER_EN  4
+#define SEC_IDX_FOLDER     5
+#define SEC_GRAM_LISTS     6
+#define SEC_GRAM_POOL      7
+#define SEC_GRAM_LOOKUP    8
+#define SEC_FOLDER_NAMES   9
+#define SNAP_SECTIONS     10
+
+typedef struct {
+    uint64_t off;   // 區段從檔案的第幾個 byte 開始（一定是 8 的倍數）
+    uint64_t size;  // 區段有幾個 byte
+} SnapSection;
+
+typedef struct {
+    uint32_t mask;     // HashIndex.mask
+    int32_t  used;     // HashIndex.used
+    int32_t  live;     // HashIndex.live
+    int32_t  reserved;
+} SnapHash;
+
+typedef struct {
+    char        magic[8];       // "ENWSNAP"
+    uint32_t    version;        // SNAP_VERSION
+    uint32_t    endian;         // SNAP_ENDIAN
+    uint32_t    sizeWord;       // sizeof(Word)
+    uint32_t    sizeSlot;       // sizeof(HashSlot)
+    uint32_t    sizePosting;    // sizeof(Posting)
+    uint32_t    reserved0;
+    uint64_t    tsvHash;        // 對應的 english_word.txt 指紋（日誌靠它核對）
+    uint64_t    tsvSize;        // 對應的 english_word.txt 大小
+    int64_t     tsvMtime;       // 對應的 english_word.txt 修改時間
+    int32_t     wordCount;
+    int32_t     folderCount;
+    uint64_t    stringsUsed;
+    uint64_t    stringsGarbage;
+    uint64_t    folderNamesUsed;
+    int32_t     gramCount;
+    uint32_t    poolUsed;
+    uint32_t    poolGarbage;
+    uint32_t    reserved;
+    SnapHash    hashes[4];      // englishIndex, folderEnglishIndex, folders.index, textIndex.lookup
+    SnapSection sec[SNAP_SECTIONS];
+} SnapHeader;
+
+/* MappedFile：一個對應到記憶體的檔案（不支援 mmap 的系統就整個讀進記憶體）*/
+typedef struct {
+    char   *data;
+    size_t  size;
+} MappedFile;
+
+/* DictHeader：壓縮字典（english_word.dict）的檔頭
+   -------------------------------------------------------
+   給記憶體很少的機器用的唯讀參考字典，格式的說明在「壓縮字典」那一節：
+     [檔頭] [資料夾名稱位移] [資料夾名稱] [中文位移] [中文] [每一塊的位移] [前綴壓縮的英文塊]
+   區段和快照檔一樣都從 8 的倍數開始（SnapSection），byte 順序也用 SNAP_ENDIAN 確認。*/
+#define DICT_MAGIC     "ENWDICT"    // 檔案開頭的識別字
+#define DICT_VERSION   1            // 格式版本，格式改了就加 1
+
+#define DSEC_FOLDER_OFFS   0  // 各區段的編號：每個資料夾名稱的位移（uint32_t）
+#define DSEC_FOLDER_NAMES  1  //               資料夾名稱（'\0' 分隔）
+#define DSEC_GLOSS_OFFS    2  //               每種中文解釋的位移（uint32_t）
+#define DSEC_GLOSSES       3  //               中文解釋（'\0' 分隔，一樣的只存一次）
+#define DSEC_BLOCK_OFFS    4  //               每一塊從 DSEC_BLOCKS 的第幾個 byte 開始（uint32_t）
+#define DSEC_BLOCKS        5  //               前綴壓縮的單字
+#define DICT_SECTIONS      6
+
+typedef struct {
+    char        magic[8];     // "ENWDICT"
+    uint32_t    version;      // DICT_VERSION
+    uint32_t    endian;       // SNAP_ENDIAN
+    int32_t     wordCount;
+    int32_t     folderCount;
+    int32_t     glossCount;   // 幾種不一樣的中文解釋
+    int32_t     blockCount;   // 幾塊（每塊 DICT_BLOCK 個單字，最後一塊可能比較少）
+    SnapSection sec[DICT_SECTIONS];
+} DictHeader;
+
+/* CompactDict：對應到記憶體的壓縮字典（指標都指向檔案內容）*/
+typedef struct {
+    MappedFile        map;
+    const DictHeader *h;
+    const uint32_t   *folderOffs;
+    const char       *folderNames;
+    const uint32_t   *glossOffs;
+    const char       *glosses;
+    const uint32_t   *blockOffs;
+    const uint8_t    *blocks;
+} CompactDict;
+
+/* DictCursor：在壓縮字典裡照順序往下讀（dictSeek 跳到某個位置，dictNext 解出下一個）*/
+typedef struct {
+    const CompactDict *d;
+    int            ordinal;            // 下一個要解的是第幾個單字
+    const uint8_t *p;                  // 解到 blocks 的哪裡
+    char           key[DICT_KEY_MAX];  // 目前這個單字的英文 key（前綴壓縮要靠上一個字還原）
+    int            keyLen;
+    const char    *english;            // 顯示用的英文（和 key 一樣時就指向 key）
+    const char    *folder;
+    const char    *chinese;
+    int            errorCount;
+} DictCursor;
+
+/* EventHeader / EventBlock：作答紀錄（english_word.events）的檔頭和每一塊的開頭
+   -------------------------------------------------------
+   格式的說明在「作答紀錄」那一節：
+     [檔頭] [一次測驗一塊] [一次測驗一塊] ...
+   每一塊都從 8 的倍數開始，塊裡的資料是「一欄一欄」放的（EventCols），
+   分析的時候只讀用得到的那幾欄。byte 順序一樣用 SNAP_ENDIAN 確認。*/
+#define EVENT_MAGIC    "ENWEVT"     // 檔案開頭的識別字
+#define EVENT_VERSION  1            // 格式版本，格式改了就加 1
+#define EVENT_TAG      0x4b425645u  // 每一塊開頭的記號（寫進檔案就是 "EVBK" 四個字）
+#define EVENT_ROW      19           // 每一題在各欄加起來佔幾個 byte（不含打的答案本身）
+#define EVENT_CURVE     6           // 難度曲線分幾段：第 1 次、第 2 次、3~4、5~8、9~16、17 次以後
+#define EVENT_MIN_SHARD 65536       // 每個分析執行緒至少分到幾筆作答（太少就不值得開執行緒）
+#define EVENT_HARDEST  10           // 分析完列出最難的幾個單字
+#define EVENT_MIN_TRIES 3           // 考過幾次以上才列進「最難的單字」
+
+typedef struct {
+    char     magic[8];  // "ENWEVT"
+    uint32_t version;   // EVENT_VERSION
+    uint32_t endian;    // SNAP_ENDIAN
+} EventHeader;
+
+typedef struct {
+    uint32_t tag;       // EVENT_TAG
+    uint32_t bytes;     // 這一塊總共幾個 byte（包含這個開頭，和最後補到 8 的倍數的 0）
+    uint32_t count;     // 這次測驗有幾題
+    uint32_t mode;      // 0 = 打英文，1 = 選擇題
+} EventBlock;
+
+/* EventCols：一塊作答紀錄裡的各欄（都指向檔案內容）*/
+typedef struct {
+    const uint64_t *word;     // 哪個單字（eventWordKey：資料夾 + 英文的雜湊，刪除別的字也不會變）
+    const uint32_t *at;       // 交出答案的時間（Unix 秒）
+    const uint32_t *latency;  // 想了幾毫秒
+    const uint16_t *len;      // 打的答案有幾個 byte
+    const uint8_t  *result;   // ANSWER_*
+    const char     *answers;  // 打的答案，一題接一題（沒有 '\0'）
+} EventCols;
+
+/* WordTrend：分析作答紀錄時，一個單字累計的結果*/
+typedef struct {
+    uint32_t    attempts;              // 考了幾次
+    uint32_t    right, near;           // 答對、差一點幾次（其餘是答錯）
+    uint32_t    lastAt;                // 最後一次作答的時間
+    uint64_t    latencyMs;             // 想的時間加起來
+    uint32_t    tried[EVENT_CURVE];    // tried[b]：落在曲線第 b 段的作答次數
+    uint32_t    passed[EVENT_CURVE];   // 其中答對的
+    const char *lastWrong;             // 最後一次答錯時打的字（指向檔案內容）
+    uint32_t    lastWrongLen;
+} WordTrend;
+
+/* EventShard：分析作答紀錄時，一個執行緒的工作（只處理 key 分到自己的那些單字）*/
+typedef struct {
+    const char      *data;        // 整個作答紀錄檔
+    const size_t    *blocks;      // 每一塊從第幾個 byte 開始
+    int              blockCount;
+    const uint64_t  *keys;        // keys[idx]：第 idx 個單字的 key
+    const HashIndex *lookup;      // key → 單字索引
+    int32_t         *slot;        // slot[idx]：第 idx 個單字在自己 trends 的第幾格（-1 = 還沒出現）
+    int              shard;       // 自己是第幾個
+    int              shards;      // 總共幾個
+    WordTrend       *trends;
+    int              count;
+    int              capacity;
+    long             events;      // 分到自己的作答筆數
+    long             orphans;     // 其中單字已經不在單字庫裡的
+    int              failed;      // 1 = 記憶體不足
+} EventShard;
+
+/* TextView：指向別人的字串的一段（不複製、不需要 '\0' 結尾）
+   -------------------------------------------------------
+   大量匯入時，每個欄位都直接指向對應到記憶體的檔案內容，
+   只記錄「從哪裡開始、有幾個 bytes」，解析的時候完全不用複製字串。*/
+typedef struct {
+    char   *p;
+    size_t  len;
+} TextView;
+
+/* LineFields：一行拆開之後的欄位（資料夾、英文、中文、錯誤次數、複習排程）
+   複習排程的六欄依序是 due、lastReview、interval、ease、reps、lapses，
+   還沒複習過的單字存檔時不會寫這幾欄（舊格式的檔案也沒有），len 都是 0。*/
+#define REVIEW_FIELDS 6
+
+typedef struct {
+    TextView folder;
+    TextView en;
+    TextView cn;
+    TextView err;                    // 舊格式沒有這欄，len 是 0
+    TextView review[REVIEW_FIELDS];
+} LineFields;
+
+/* ImportChunk：大量匯入時分給一個執行緒的那一塊檔案
+   一定從某一行的開頭開始、在某一行的 '\n' 之後結束，不會把一行切成兩半。*/
+typedef struct {
+    char       *begin;
+    char       *end;
+    LineFields *lines;     // 解析出來的每一行（按照檔案順序）
+    int         count;
+    int         capacity;
+    int         invalid;   // 有幾行不是合法的 UTF-8（沒有解析，直接略過）
+    int         failed;    // 1 = 記憶體不足，這一塊沒有解析完
+} ImportChunk;
+
+/* Journal：寫入日誌的狀態（詳細說明見「寫入日誌」那一段）
+   背景寫入執行緒開著的時候，fp 只有寫入執行緒會碰；records、pending 只有主執行緒會碰。*/
+typedef struct {
+    FILE *fp;       // 以追加模式開著的日誌檔
+    int   records;  // 日誌裡目前有幾筆紀錄（太多就壓縮進主檔）
+    int   pending;  // 有幾筆還沒 fsync 到磁碟（背景寫入時：還沒交代寫入執行緒寫入）
+} Journal;
+
+/* TextBuf：會自動長大的文字緩衝區
+   先在記憶體裡把整份檔案排好，再一次寫出去（壓縮主檔用）。
+   中途記憶體不足時 failed 會變成 1，之後的 textAppend 都不做事，最後檢查一次就好。*/
+typedef struct {
+    char   *data;
+    size_t  len;
+    size_t  cap;
+    int     failed;
+} TextBuf;
+
+/* ProgressEntry：學習進度表裡的一格：某個單字錯了幾次*/
+typedef struct {
+    uint32_t word;   // 單字索引
+    int32_t  count;  // 錯誤次數
+} ProgressEntry;
+
+/* UserProgress：一個使用者的學習進度（詳細說明見「學習進度表」那一段）*/
+typedef struct {
+    char           name[USER_NAME_LEN];
+    ProgressEntry *entries;    // 稀疏存法：碰過的單字，照單字索引排好
+    int            entryCap;
+    int32_t       *dense;      // 密集存法：dense[idx]（不是 NULL 就代表用密集存法）
+    int            denseCap;
+    int            count;      // 碰過幾個單字
+    ProgressEntry *saved;      // 最近一次 progressSnapshot 的複本（寫進度檔用）
+    int            savedCount;
+    int            online;     // 1 = 有連線正在用這個名字（在 progress.lock 裡面讀寫）
+    int            unsaved;    // 上次存檔之後又改了幾次（只有自己的連線會讀寫）
+} UserProgress;
+
+/* LatencyHist：一種操作的延遲分布（詳細說明見「效能統計」那一段）*/
+typedef struct {
+    uint64_t buckets[METRIC_BUCKETS]; // buckets[b]：花了 2^b ~ 2^(b+1) 奈秒的次數
+    uint64_t count;                   // 總共做了幾次
+    uint64_t totalNs;                 // 全部加起來花了幾奈秒（算平均用）
+} LatencyHist;
+
+/* Metrics：這次執行的效能統計*/
+typedef struct {
+    LatencyHist latency[METRIC_OPS];  // 照 METRIC_* 排
+    uint64_t    bytesWritten;         // 寫進檔案的 byte 數（主檔、日誌、快照、進度檔）
+    uint64_t    saves;                // 主檔重寫了幾次
+    uint64_t    fsyncs;               // fsync 了幾次
+    uint64_t    journalRecords;       // 寫了幾筆日誌
+} Metrics;
+
+/* FolderStat：一群單字（整個單字庫或一個資料夾）的統計*/
+typedef struct {
+    int     words;       // 幾個單字
+    int     errorWords;  // 其中答錯過的（errorCount > 0）
+    int64_t errors;      // 錯誤次數加起來
+} FolderStat;
+
+/* LibraryStats：隨時維護好的統計（詳細說明見「統計資訊」那一段）*/
+typedef struct {
+    FolderStat  total;                     // 整個單字庫
+    FolderStat *perFolder;                 // perFolder[f]：第 f 個資料夾
+    int         folderCap;
+    int         histogram[STATS_BUCKETS];  // histogram[b]：錯誤次數落在第 b 格的單字數（見 statsBucket）
+    int         ready;                     // 0 = 還沒算過（或記憶體不足放棄了），要用時再整個掃一次
+    // 下面是這次執行做過的測驗，測驗結束就加進來，和 ready 無關
+    int         sessions;                  // 做了幾次測驗
+    long        asked, right, near;        // 全部加起來幾題、答對幾題、差一點幾題
+    uint16_t    recent[STATS_RECENT];      // 最近幾次的正確率（萬分之幾），第 sessions % STATS_RECENT 格最舊
+} LibraryStats;
+
+/* BumpBlock / BumpArena：一次測驗專用的記憶體池
+   -------------------------------------------------------
+   為什麼不直接 malloc？
+   → 一次測驗要好幾種陣列（題目、每題的結果、答案、花的時間），
+     一個一個 malloc、一個一個 free，很容易漏掉，也會把 heap 切得很碎。
+   → 記憶體池只會「往後拿」（bump）：要一塊就把 used 往後推，不能單獨還；
+     測驗結束時整串一次放掉（bumpFree），不用記得誰 free 了沒。
+   → 一塊用完就再接一塊新的（用 next 串起來），已經拿到的指標都不會搬家。*/
+typedef struct BumpBlock {
+    struct BumpBlock *next;  // 上一塊（比較早配置的）
+    size_t            used;  // data 已經用掉幾 byte
+    size_t            cap;   // data 有幾 byte
+    char              data[];
+} BumpBlock;
+
+typedef struct {
+    BumpBlock *head;  // 目前在用的那一塊（最新的）
+} BumpArena;
+
+/* TestSession：一次測驗的所有資料（全部放在 mem 裡，大小依照這次的題數配置）*/
+typedef struct {
+    BumpArena    mem;
+    int         *questions;  // 題目（單字索引），照出題順序
+    int          total;      // 實際有幾題
+    int          capacity;   // questions 最多放幾題
+    uint8_t     *results;    // results[i]：第 i 題的結果（ANSWER_*）
+    const char **answers;    // answers[i]：第 i 題打的答案（正規化過）
+    uint32_t    *elapsedMs;  // elapsedMs[i]：第 i 題想了幾毫秒
+    uint32_t    *answeredAt; // answeredAt[i]：第 i 題交出答案的時間（Unix 秒，寫作答紀錄用）
+    int          choices;    // 1 = 選擇題（askChoice），0 = 打英文（askQuestion）
+} TestSession;
+
+/* Storage：一種儲存後端（文字檔或 SQLite）要提供的函數*/
+typedef struct {
+    const char *name;
+    int  (*open)(void);                       // 把單字庫讀進 library；回傳值：1 = 成功
+    void (*added)(int idx);                   // 剛新增了第 idx 個單字
+    void (*removing)(int idx);                // 要刪除第 idx 個單字了（要在 libraryRemove 之前呼叫）
+    void (*errorChanged)(int idx, int delta); // 第 idx 個單字的錯誤次數剛加了 delta
+    void (*reviewChanged)(int idx);           // 第 idx 個單字的複習排程剛改過
+    void (*commit)(int force);                // 寫入磁碟（force 的意思和 journalCommit 一樣）
+    void (*close)(int compact);               // 不會再有變更了：全部寫完、放掉資源
+} Storage;
+
+#ifdef USE_SQLITE
+/* SqliteStore：SQLite 後端的狀態*/
+typedef struct {
+    const char   *path;
+    sqlite3      *db;
+    sqlite3_stmt *stmt[SQL_STMTS]; // 開資料庫時就編譯好的 SQL，照 SQL_* 排
+    int64_t      *rowIds;          // rowIds[idx]：第 idx 個單字在 words 資料表的 id
+    int           rowCap;
+    int           inTxn;           // 1 = 已經 BEGIN，還沒 COMMIT
+    int           pending;         // 這個交易裡有幾筆變更
+} SqliteStore;
+#endif
+
+/* ChangeFeed：最近的變更，每一筆依序編號（詳細說明見「變更紀錄」那一段）*/
+typedef struct {
+    char     **lines;  // 第 n 號變更放在 lines[n % CHANGE_KEEP]（malloc 來的一行文字）
+    uint64_t   epoch;  // 這次執行的代號（重開程式就換一個）
+    uint64_t   seq;    // 最後一筆變更的號碼（0 = 還沒有變更）
+    uint64_t   oldest; // 還留著的最早一筆的號碼（更早的已經被蓋掉了）
+} ChangeFeed;
+
+/* PersistItem：背景寫入佇列裡的一筆工作*/
+typedef struct {
+    int       kind;  // PERSIST_RECORD / PERSIST_COMPACT / PERSIST_STOP
+    char     *text;  // 要寫的內容（malloc 來的，寫完由寫入執行緒 free）
+    size_t    len;
+    uint64_t  hash;  // PERSIST_COMPACT：新主檔的指紋
+} PersistItem;
+
+/* EnWord：嵌入模式的單字庫代號（enwOpen 傳回來，其他 enw* 函數都要傳進去）
+   詳細說明見「嵌入用的函式庫介面」那一段。*/
+#if defined(_WIN32) && defined(EN_WORD_LIBRARY)
+#define ENW_API __declspec(dllexport) // 編成 DLL 時，enw* 這幾個函數要匯出給別的程式用（其他的不會匯出）
+#elif defined(__GNUC__) && defined(EN_WORD_LIBRARY)
+#define ENW_API __attribute__((visibility("default"))) // 配合 -fvisibility=hidden：.so 只匯出 enw* 這幾個
+#else
+#define ENW_API                       // 編成一般的程式時不用匯出
+#endif
+
+typedef struct EnWord {
+    TextBuf  out;     // enwWord / enwSearch / enwQuiz 回傳的文字（下一次呼叫就會被蓋掉）
+    char    *dbPath;  // SQLite 後端會一直用到檔名，所以自己留一份（NULL = 文字檔）
+} EnWord;
+
 
 /* ========== 全域變數 ==========
    寫在所有函數外面的變數，整個程式都可以直接使用，
@@ -55,11 +905,31 @@ typedef struct {
    什麼時候用全域變數？
    → 當很多函數都需要存取同一份資料時（這裡的單字庫就是好例子）。
    → 不建議把所有變數都設為全域，會讓程式很難追蹤誰改了什麼。 */
-Word library[WORD_MAX];              // 單字庫：一個可以裝 1000 個 Word 的陣列
-int  wordCount = 0;                  // 目前存了幾個單字（陣列用了幾格）
-
-char folderList[FOLDER_MAX][EN_LEN]; // 資料夾名稱清單，避免重複顯示
-int  folderCount = 0;                // 目前有幾個不同的資料夾
+WordStore library = {0};             // 單字庫：容量會隨單字數量自動長大
+Journal   journal = {0};             // 寫入日誌
+
+HashIndex englishIndex       = {0};  // 英文 → 單字索引（同一個英文可能在好幾個資料夾）
+HashIndex folderEnglishIndex = {0};  // （資料夾, 英文）→ 單字索引
+GramIndex textIndex          = {0};  // 英文、中文的片段索引（給 search() 用）
+
+MappedFile snapMap = {0};            // 啟動時對應到記憶體的快照檔（程式結束前都要留著）
+
+FolderRegistry folders = {0};        // 資料夾登錄表：名稱、編號、每個資料夾有哪些單字
+IndexHeap errorRank = { NULL, NULL, 0, 0, 0, HEAP_ERRORS }; // 錯題排行：錯誤次數由多到少
+IndexHeap dueQueue  = { NULL, NULL, 0, 0, 0, HEAP_DUE };    // 複習佇列：最早到期的在前
+IndexHeap newQueue  = { NULL, NULL, 0, 0, 0, HEAP_NEW };    // 還沒學過的新單字
+WeightTree errorWeights = {0};       // 加權抽題：第 i 個位置就是第 i 個單字的權重
+Rng rng = {{0}};                     // 亂數產生器（main 一開始用時間當種子）
+BkTree headwords = {0};              // 所有英文單字的 BK-tree（打錯字時找最接近的字）
+SortedIndex alphaOrder       = { {0}, SORT_ALPHA, 0 };  // 全部單字照字母排好
+SortedIndex folderAlphaOrder = { {0}, SORT_FOLDER, 0 }; // 每個資料夾裡照字母排好
+SortedIndex folderGlossOrder = { {0}, SORT_GLOSS, 0 };  // 每個資料夾裡照中文排好（找意思相近的字）
+DistractorIndex distractors  = {0};                     // 每個單字事先挑好的選擇題干擾選項
+int typoLimit = TYPO_LIMIT;          // 測驗時最多容忍幾個打錯的字母
+Metrics metrics = {0};               // 效能統計（每種操作花多久、寫了多少資料）
+ChangeFeed changes = {0};            // 變更紀錄（給其他前端只拿新的變更）
+LibraryStats stats = {0};            // 統計資訊（新增、刪除、答錯時順便更新，不用每次重算）
+EnWord *enwOpened = NULL;            // 目前開著的嵌入模式代號（單字庫只有一份，所以同時只能有一個）
 
 
 /* ========== 函數前置宣告 ==========
@@ -70,33 +940,216 @@ int  folderCount = 0;                // 目前有幾個不同的資料夾
 
 // --- 工具函數（小工具，其他函數會用到）---
 void toLowerEN(char *str);
+size_t foldAscii(char *s, size_t len);
+void normalizeText(char *dst, const char *src);
+int  utf8Valid(const char *s, size_t len);
+void trimText(char *s);
 void inputLine(char *str, int max);
-void inputLineEN(char *str, int max);
+long inputText(char **buf, size_t *cap);
 void clearInputBuffer(void);
 
+// --- 單字庫（字串池 + 動態陣列）---
+uint32_t    arenaAdd(StrArena *a, const char *str);
+int         storeAdd(WordStore *s, int folderId, const char *en, const char *cn, int errorCount);
+int         storeReserve(WordStore *s, int words, size_t bytes);
+void        storeRemove(WordStore *s, int idx);
+void        storeCompact(WordStore *s);
+void        storeFree(WordStore *s);
+void       *growBuffer(void *old, size_t oldBytes, size_t newBytes, int *borrowed);
+const char *wordEnglish(int idx);
+const char *wordChinese(int idx);
+const char *wordFolder(int idx);
+const char *wordKeyEn(int idx);
+const char *wordKeyCn(int idx);
+
+// --- 雜湊索引 ---
+void     hashInsert(HashIndex *h, uint32_t hash, int value);
+int      hashNext(const HashIndex *h, uint32_t hash, uint32_t *pos);
+void     hashReplace(HashIndex *h, uint32_t hash, int oldValue, int newValue);
+void     hashFree(HashIndex *h);
+uint32_t keyHash(const char *str);
+uint32_t folderKeyHash(uint32_t folderId, const char *en);
+int      findEnglish(const char *en);
+int      findInFolder(int folderId, const char *en, const char *cn);
+
+// --- 搜尋索引 ---
+int  idListPush(IdList *list, int id);
+void gramIndexAdd(GramIndex *g, int idx, const char *en, const char *cn);
+void gramIndexRemove(GramIndex *g, int idx, const char *en, const char *cn);
+void gramIndexMove(GramIndex *g, int from, int to, const char *en, const char *cn);
+int  gramSearch(GramIndex *g, const WordStore *s, const char *key, int prefix, IdList *out);
+void gramIndexFree(GramIndex *g);
+
+// --- 資料夾登錄表 ---
+int           folderFind(const char *name);
+int           folderIntern(const char *name);
+const char   *folderName(int id);
+const IdList *folderMembers(int id);
+void          folderFree(void);
+
+// --- 優先順序佇列（錯題排行、複習佇列）---
+void heapUpdate(IndexHeap *h, int idx);
+int  heapCount(IndexHeap *h);
+int  heapTop(IndexHeap *h, int offset, int k, int out[], HeapFilter filter, const void *ctx);
+int  heapCollect(IndexHeap *h, int out[]);
+void heapFree(IndexHeap *h);
+
+// --- 複習排程 ---
+uint32_t nowMinutes(void);
+void     reviewSchedule(Review *r, int correct, uint32_t now);
+int      reviewIsDefault(const Review *r);
+int      buildReviewSession(int folderId, int out[], int max, int *dueCount);
+
+// --- 亂數與加權抽題 ---
+void     rngInit(Rng *r, uint64_t seed);
+uint64_t rngStep(Rng *r);
+uint64_t rngRange(Rng *r, uint64_t n);
+void     rngSeed(uint64_t seed);
+uint64_t rngNext(void);
+uint64_t rngBelow(uint64_t n);
+int      drawWeighted(int folderId, int k, int out[]);
+void     weightFree(WeightTree *t);
+
+// --- 模糊比對 ---
+void        editPrepare(EditPattern *p, const char *str);
+int         editDistanceTo(const EditPattern *p, const char *b, int lb, int limit, int transpose);
+int         isNearMiss(const char *answer, const char *correct);
+const char *bkNearest(const char *word, int limit, int *distOut);
+void        bkFree(BkTree *t);
+
+// --- 字母順序索引 ---
+int  sortedBuild(SortedIndex *s);
+void sortedAdd(SortedIndex *s, int idx);
+void sortedForget(SortedIndex *s, int idx, int last);
+int  sortedRange(int folderId, const char *from, const char *to, const SortedIndex **out, int *first);
+void sortedCursorSave(SortCursor *c, int idx);
+int  sortedCursorNext(const SortedIndex *s, const SortCursor *c);
+void sortedFree(SortedIndex *s);
+
+// --- 選擇題的干擾選項 ---
+int  distractorPick(int q, int out[]);
+void distractorAdd(int idx);
+void distractorForget(int idx, int last);
+void distractorFree(void);
+
+// --- 新增 / 刪除單字（同時更新所有索引）---
+int      libraryAdd(int folderId, const char *en, const char *cn, int errorCount);
+void     libraryRemove(int idx);
+void     libraryAddError(int idx, int delta);
+void     librarySetReview(int idx, const Review *r);
+void     libraryReview(int idx, int correct);
+
 // --- 檔案讀寫 ---
-int  isFull(void);
-void updateFolderList(const char *name);
-void parseLine(char *line);
+int  splitFields(char *p, char *end, LineFields *f);
+int  parseLine(char *line);
+long readLine(FILE *fp, char **buf, size_t *cap);
+uint64_t fnvHash(uint64_t h, const char *buf, size_t len);
+void syncFile(FILE *fp);
+void textAppend(TextBuf *b, const char *s, size_t n);
+int  tsvRender(TextBuf *out);
+int  replaceFile(const char *path, const char *tmp, const char *data, size_t len);
+int  tsvWrite(const char *data, size_t len);
 int  saveToFile(void);
 void loadFile(void);
 
+// --- 二進位快照 ---
+int  snapshotSave(const char *path, uint64_t tsvHash, uint64_t tsvSize, int64_t tsvMtime);
+int  snapshotLoad(const char *path, int checkTsv, uint64_t *tsvHash);
+void snapshotRelease(void);
+void libraryFree(void);
+
+// --- 壓縮字典 ---
+int  dictSave(const char *path);
+int  dictOpen(const char *path, CompactDict *d);
+void dictClose(CompactDict *d);
+int  dictNext(DictCursor *c);
+void dictSeek(DictCursor *c, const CompactDict *d, int ordinal);
+int  dictLowerBound(const CompactDict *d, const char *key);
+int  dictLookup(const char *path);
+int  dictImport(const char *path);
+
+// --- 大量匯入 ---
+int  cpuCount(void);
+int  bulkImport(const char *path, int skipDuplicates, uint64_t *hash, int *added);
+
+// --- 寫入日誌 ---
+void journalReset(uint64_t baseHash);
+void journalReplay(uint64_t baseHash);
+void journalAppendAdd(int idx);
+void journalAppendDelete(int idx);
+void journalAppendError(int idx, int delta);
+void journalAppendReview(int idx);
+void journalCommit(int force);
+
+// --- 背景寫入 ---
+int  persistStart(void);
+void persistStop(void);
+int  persistRunning(void);
+void persistAppend(char *text, size_t len);
+void persistCompact(void);
+void persistFlush(void);
+
+// --- 儲存後端 ---
+int  storageUseDatabase(const char *path);
+int  storageIsText(void);
+int  storageOpen(void);
+void storageAdded(int idx);
+void storageRemoving(int idx);
+void storageError(int idx, int delta);
+void storageReview(int idx);
+void storageCommit(int force);
+void storageClose(int compact);
+
+// --- 變更紀錄 ---
+void changeStart(void);
+void changeRecord(char op, int idx);
+int  changesSince(const char *cursor, TextBuf *out, int *reset);
+void changesFree(void);
+
+// --- 效能統計 ---
+uint64_t metricNow(void);
+void     metricRecord(int op, uint64_t started);
+void     metricCount(uint64_t *counter, uint64_t n);
+void     metricsShow(void);
+void     metricsExport(TextBuf *out);
+
 // --- 洗牌 ---
 void shuffle(int arr[], int n);
 
+// --- 畫面輸出 ---
+void outFlush(void);
+void outPrintf(const char *fmt, ...);
+void pageList(int total, ListRender render, void *ctx);
+
 // --- 資料夾選擇 ---
 int  chooseFolder(void);
 
 // --- 單字卡 ---
-void showSingleCard(int idx);
-void showAllCards(void);
-void showFolderCards(int folderIdx);
+int         cardOpen(CardDeck *d, const int *ids, int count, int start);
+int         cardPending(const CardDeck *d);
+int         cardPrefetch(CardDeck *d);
+const Card *cardNext(CardDeck *d);
+void        cardClose(CardDeck *d);
+void        rangeKeys(char *range, char *from, char *to);
+int  showSingleCard(CardDeck *deck, const Card *c);
+void showCards(const SortedIndex *order, int first, int count, int start);
+void showWordList(const SortedIndex *order, int first, int count);
 void showCard(void);
 
+// --- 測驗的記憶體池 ---
+void *bumpAlloc(BumpArena *a, size_t bytes);
+char *bumpStrdup(BumpArena *a, const char *s);
+void  bumpFree(BumpArena *a);
+int   sessionBegin(TestSession *s, int capacity);
+void  sessionEnd(TestSession *s);
+
 // --- 測驗 ---
-int  collectIndices(const char *folder, int result[]);
-int  askQuestion(int wordIdx, int qNum, int total, int *score);
-void runTest(int indices[], int total);
+int  collectIndices(int folderId, int result[]);
+int  isSynonymAnswer(const char *answer, int wordIdx);
+int  gradeAnswer(const char *answer, int wordIdx);
+int  askQuestion(int wordIdx, int qNum, int total, int *score, char **answer, size_t *cap);
+int  askChoice(int wordIdx, int qNum, int total, int *score, char **answer, size_t *cap);
+void runTest(TestSession *s);
 void takeTest(void);
 void takeErrorTest(void);
 
@@ -107,6 +1160,47 @@ void deleteWord(void);
 void AddWord(void);
 void showStats(void);
 
+// --- 統計資訊 ---
+int  statsBuild(void);
+void statsAdd(int idx);
+void statsForget(int idx);
+void statsError(int idx, int before);
+void statsSession(int right, int near, int total);
+void statsFree(void);
+
+// --- 作答紀錄 ---
+uint64_t eventWordKey(int idx);
+void     eventLogSession(const TestSession *s);
+int      eventAnalyze(const char *outPath);
+
+// --- 批次批改 ---
+int  gradeBatch(const char *inPath, const char *outPath);
+
+// --- 學習進度表 ---
+UserProgress *progressFind(const char *name, int create);
+int           progressGet(const UserProgress *u, int idx);
+int           progressAdd(UserProgress *u, int idx, int delta, int words);
+int           progressCollect(const UserProgress *u, ProgressEntry **out);
+int           progressSnapshot(UserProgress *u);
+int           progressRender(TextBuf *out);
+void          progressLoad(void);
+void          progressFree(void);
+
+// --- 伺服器模式 ---
+int  serverRun(int port);
+
+// --- 嵌入用的函式庫介面 ---
+ENW_API EnWord     *enwOpen(const char *dbPath);
+ENW_API void        enwClose(EnWord *h);
+ENW_API int         enwCount(EnWord *h);
+ENW_API const char *enwWord(EnWord *h, int idx);
+ENW_API int         enwAdd(EnWord *h, const char *folder, const char *en, const char *cn);
+ENW_API int         enwDelete(EnWord *h, int idx);
+ENW_API const char *enwSearch(EnWord *h, const char *keyword, int limit);
+ENW_API const char *enwQuiz(EnWord *h, const char *folder, int mode, int count);
+ENW_API int         enwGrade(EnWord *h, int idx, const char *answer);
+ENW_API int         enwSave(EnWord *h);
+
 // --- 主選單 ---
 int  mainMenu(void);
 
@@ -123,17 +1217,12 @@ int  mainMenu(void);
    → 我只想改英文的 A-Z，所以自己寫判斷式比較安全。
 
    原理：ASCII 編碼中，'A' = 65，'a' = 97，差距剛好是 32，
-   所以把大寫加 32 就能得到對應的小寫。
+   所以把大寫加 32 就能得到對應的小寫。實際的轉換在 foldAscii，一次處理 16 或 8 個 byte。
 
    參數：
      str → 要修改的字串（直接改原本的，不會另外建一個新的）*/
 void toLowerEN(char *str) {
-    for (int i = 0; str[i] != '\0'; i++) {
-        // str[i] != '\0' 是判斷「還沒到字串結尾」的寫法
-        if (str[i] >= 'A' && str[i] <= 'Z') {
-            str[i] += 32; // 'A'→'a', 'B'→'b', ... , 'Z'→'z'
-        }
-    }
+    foldAscii(str, strlen(str));
 }
 
 /* inputLine：讀取使用者輸入的一整行文字
@@ -143,22 +1232,58 @@ void toLowerEN(char *str) {
    → fgets 會讀整行，但會把使用者按的 Enter（'\n'）也存進去，
      所以要用 strcspn 找到 '\n' 的位置，把它換成 '\0'（字串結尾）。
 
+   一行比 max 還長的話，放不下的部分直接丟掉（clearInputBuffer），
+   不然它會留在緩衝區裡，被下一個問題當成使用者的回答。
+   輸入的長度沒有上限的地方（單字、答案、查詢）改用 inputText。
+
    參數：
      str → 存放輸入內容的陣列
      max → 陣列大小（fgets 會確保不超出這個長度，防止 overflow）*/
 void inputLine(char *str, int max) {
-    fgets(str, max, stdin);
-    str[strcspn(str, "\n")] = '\0'; // strcspn 找到第一個 '\n' 的位置，換成結尾
+    if (!fgets(str, max, stdin)) {
+        str[0] = '\0'; // 輸入結束了，當作什麼都沒打
+        return;
+    }
+    size_t len = strcspn(str, "\n"); // strcspn 找到第一個 '\n' 的位置
+    if (str[len] != '\n') clearInputBuffer(); // 沒讀到換行 = 這一行太長，剩下的丟掉
+    str[len] = '\0';
 }
 
-/* inputLineEN：讀取一行輸入，並把英文自動轉成小寫
+/* inputText：讀取使用者輸入的一整行，不管有多長
    -------------------------------------------------------
-   適合用在需要英文輸入的地方（資料夾名稱、單字輸入），
-   這樣使用者打 APPLE 或 apple 都會被當成一樣。
-   中文字元的 byte 值不在 A-Z 範圍，所以 toLowerEN 不會誤改它。*/
-void inputLineEN(char *str, int max) {
-    inputLine(str, max);  // 先讀一行
-    toLowerEN(str);       // 再把英文大寫轉小寫
+   inputLine 要呼叫者準備固定大小的陣列，一段很長的中文解釋（一個字 3 bytes）很快就塞不下；
+   inputText 和讀檔一樣用 readLine，暫存區不夠就自動加大，讀完把結尾的 '\r'、'\n' 拿掉。
+
+   參數：
+     buf, cap → 和 readLine 一樣（第一次可以傳指向 NULL 的指標，用完要 free）
+
+   回傳值：這一行的長度（不含換行）；輸入結束或記憶體不足時回傳 -1
+           （這時 *buf 不是 NULL 的話會是空字串）*/
+long inputText(char **buf, size_t *cap) {
+    long len = readLine(stdin, buf, cap);
+    if (len < 0) {
+        if (*buf) (*buf)[0] = '\0';
+        return -1;
+    }
+    while (len > 0 && ((*buf)[len - 1] == '\n' || (*buf)[len - 1] == '\r')) (*buf)[--len] = '\0';
+    return len;
+}
+
+/* trimText：把 s 前後的空白拿掉，中間連續的空白（包括 Tab）縮成一個空格
+   答案、查詢的關鍵字用：打「 look   up 」和「look up」要算一樣。*/
+void trimText(char *s) {
+    size_t out = 0;
+    int space = 0;
+    for (const char *p = s; *p; p++) {
+        if (*p == ' ' || *p == '\t') {
+            space = (out > 0);
+            continue;
+        }
+        if (space) s[out++] = ' ';
+        space = 0;
+        s[out++] = *p;
+    }
+    s[out] = '\0';
 }
 
 /* clearInputBuffer：清空鍵盤輸入緩衝區
@@ -179,730 +1304,8243 @@ void clearInputBuffer(void) {
 
 
 /* ================================================================
-   檔案讀寫
-   ================================================================ */
+   字串正規化（比對用的 key）
+   ================================================================
 
-/* isFull：確認單字庫是否已經滿了
+   使用者輸入的答案、查詢的關鍵字，和單字庫裡的字可能「看起來不一樣，意思一樣」：
+     大小寫         APPLE ／ apple
+     全形英數字     ａｐｐｌｅ ／ apple（中文輸入法常常不小心切到全形）
+     繁簡體         蘋果 ／ 苹果
+   normalizeText 把這些都轉成同一種寫法（小寫、半形、簡體），叫做這個字串的 key。
+   單字庫的 key 在新增單字時就算好存起來（Word 的 keyOff），
+   查詢和對答案時只要把使用者輸入的那一個字串轉一次，不用每次把整個單字庫再轉一遍。
+
+   為什麼是轉成簡體而不是繁體？
+   → 繁轉簡是「多對一」（發、髮 → 发；乾、幹 → 干），兩邊都轉成簡體一定對得上；
+     反過來簡轉繁要猜是哪一個字，猜錯就找不到了。key 只用來比對，不會顯示出來。*/
+
+/* hanFold：繁體 → 簡體的對照表（依照繁體字的 Unicode 編號排好，給二分搜尋用）
+   只收常用、而且一定是同一個字的對照，不是完整的繁簡轉換。*/
+static const uint16_t hanFold[][2] = {
+    { 0x4E7E, 0x5E72 }, { 0x4F86, 0x6765 }, { 0x4FC2, 0x7CFB }, { 0x500B, 0x4E2A }, // 乾干 來来 係系 個个
+    { 0x5011, 0x4EEC }, { 0x5099, 0x5907 }, { 0x50B3, 0x4F20 }, { 0x50B7, 0x4F24 }, // 們们 備备 傳传 傷伤
+    { 0x50F9, 0x4EF7 }, { 0x5118, 0x5C3D }, { 0x512A, 0x4F18 }, { 0x5169, 0x4E24 }, // 價价 儘尽 優优 兩两
+    { 0x52D5, 0x52A8 }, { 0x52DD, 0x80DC }, { 0x532F, 0x6C47 }, { 0x554F, 0x95EE }, // 動动 勝胜 匯汇 問问
+    { 0x5617, 0x5C1D }, { 0x56B4, 0x4E25 }, { 0x570B, 0x56FD }, { 0x5712, 0x56ED }, // 嘗尝 嚴严 國国 園园
+    { 0x5716, 0x56FE }, { 0x5718, 0x56E2 }, { 0x57F7, 0x6267 }, { 0x5805, 0x575A }, // 圖图 團团 執执 堅坚
+    { 0x5831, 0x62A5 }, { 0x5834, 0x573A }, { 0x584A, 0x5757 }, { 0x5857, 0x6D82 }, // 報报 場场 塊块 塗涂
+    { 0x58DE, 0x574F }, { 0x58FA, 0x58F6 }, { 0x5922, 0x68A6 }, { 0x596A, 0x593A }, // 壞坏 壺壶 夢梦 奪夺
+    { 0x596E, 0x594B }, { 0x5ABD, 0x5988 }, { 0x5B6B, 0x5B59 }, { 0x5B78, 0x5B66 }, // 奮奋 媽妈 孫孙 學学
+    { 0x5BE6, 0x5B9E }, { 0x5BE7, 0x5B81 }, { 0x5BEB, 0x5199 }, { 0x5BF6, 0x5B9D }, // 實实 寧宁 寫写 寶宝
+    { 0x5C0D, 0x5BF9 }, { 0x5C0E, 0x5BFC }, { 0x5C64, 0x5C42 }, { 0x5CF6, 0x5C9B }, // 對对 導导 層层 島岛
+    { 0x5E2B, 0x5E08 }, { 0x5E36, 0x5E26 }, { 0x5E6B, 0x5E2E }, { 0x5E79, 0x5E72 }, // 師师 帶带 幫帮 幹干
+    { 0x5E7E, 0x51E0 }, { 0x5EAB, 0x5E93 }, { 0x5EE2, 0x5E9F }, { 0x5EE3, 0x5E7F }, // 幾几 庫库 廢废 廣广
+    { 0x5F35, 0x5F20 }, { 0x5F37, 0x5F3A }, { 0x5F48, 0x5F39 }, { 0x5F59, 0x6C47 }, // 張张 強强 彈弹 彙汇
+    { 0x5F8C, 0x540E }, { 0x5FA9, 0x590D }, { 0x5FB5, 0x5F81 }, { 0x5FB9, 0x5F7B }, // 後后 復复 徵征 徹彻
+    { 0x60E1, 0x6076 }, { 0x60F1, 0x607C }, { 0x611B, 0x7231 }, { 0x614B, 0x6001 }, // 惡恶 惱恼 愛爱 態态
+    { 0x6163, 0x60EF }, { 0x616E, 0x8651 }, { 0x6176, 0x5E86 }, { 0x6182, 0x5FE7 }, // 慣惯 慮虑 慶庆 憂忧
+    { 0x61B6, 0x5FC6 }, { 0x61C9, 0x5E94 }, { 0x61F6, 0x61D2 }, { 0x61F7, 0x6000 }, // 憶忆 應应 懶懒 懷怀
+    { 0x61F8, 0x60AC }, { 0x61FC, 0x60E7 }, { 0x6230, 0x6218 }, { 0x6232, 0x620F }, // 懸悬 懼惧 戰战 戲戏
+    { 0x6383, 0x626B }, { 0x639B, 0x6302 }, { 0x63DA, 0x626C }, { 0x63DB, 0x6362 }, // 掃扫 掛挂 揚扬 換换
+    { 0x63EE, 0x6325 }, { 0x640D, 0x635F }, { 0x6416, 0x6447 }, { 0x6436, 0x62A2 }, // 揮挥 損损 搖摇 搶抢
+    { 0x64C1, 0x62E5 }, { 0x64D4, 0x62C5 }, { 0x64DA, 0x636E }, { 0x64E0, 0x6324 }, // 擁拥 擔担 據据 擠挤
+    { 0x64F4, 0x6269 }, { 0x64FA, 0x6446 }, { 0x64FE, 0x6270 }, { 0x651D, 0x6444 }, // 擴扩 擺摆 擾扰 攝摄
+    { 0x6557, 0x8D25 }, { 0x6575, 0x654C }, { 0x6578, 0x6570 }, { 0x65B7, 0x65AD }, // 敗败 敵敌 數数 斷断
+    { 0x6642, 0x65F6 }, { 0x665D, 0x663C }, { 0x66A2, 0x7545 }, { 0x66AB, 0x6682 }, // 時时 晝昼 暢畅 暫暂
+    { 0x66C6, 0x5386 }, { 0x66C9, 0x6653 }, { 0x66F8, 0x4E66 }, { 0x6703, 0x4F1A }, // 曆历 曉晓 書书 會会
+    { 0x6771, 0x4E1C }, { 0x689D, 0x6761 }, { 0x68C4, 0x5F03 }, { 0x694A, 0x6768 }, // 東东 條条 棄弃 楊杨
+    { 0x696D, 0x4E1A }, { 0x6975, 0x6781 }, { 0x69AE, 0x8363 }, { 0x69CB, 0x6784 }, // 業业 極极 榮荣 構构
+    { 0x69CD, 0x67AA }, { 0x6A02, 0x4E50 }, { 0x6A13, 0x697C }, { 0x6A19, 0x6807 }, // 槍枪 樂乐 樓楼 標标
+    { 0x6A23, 0x6837 }, { 0x6A39, 0x6811 }, { 0x6A4B, 0x6865 }, { 0x6A5F, 0x673A }, // 樣样 樹树 橋桥 機机
+    { 0x6AA2, 0x68C0 }, { 0x6B0A, 0x6743 }, { 0x6B50, 0x6B27 }, { 0x6B61, 0x6B22 }, // 檢检 權权 歐欧 歡欢
+    { 0x6B72, 0x5C81 }, { 0x6B77, 0x5386 }, { 0x6B78, 0x5F52 }, { 0x6B98, 0x6B8B }, // 歲岁 歷历 歸归 殘残
+    { 0x6BBA, 0x6740 }, { 0x6BC0, 0x6BC1 }, { 0x6C23, 0x6C14 }, { 0x6C92, 0x6CA1 }, // 殺杀 毀毁 氣气 沒没
+    { 0x6DDA, 0x6CEA }, { 0x6DFA, 0x6D45 }, { 0x6E2C, 0x6D4B }, { 0x6E6F, 0x6C64 }, // 淚泪 淺浅 測测 湯汤
+    { 0x6E96, 0x51C6 }, { 0x6E9D, 0x6C9F }, { 0x6EAB, 0x6E29 }, { 0x6EC5, 0x706D }, // 準准 溝沟 溫温 滅灭
+    { 0x6EFE, 0x6EDA }, { 0x6EFF, 0x6EE1 }, { 0x6F22, 0x6C49 }, { 0x6F32, 0x6DA8 }, // 滾滚 滿满 漢汉 漲涨
+    { 0x6F54, 0x6D01 }, { 0x6F64, 0x6DA6 }, { 0x6FA4, 0x6CFD }, { 0x6FC3, 0x6D53 }, // 潔洁 潤润 澤泽 濃浓
+    { 0x6FD5, 0x6E7F }, { 0x6FDF, 0x6D4E }, { 0x70BA, 0x4E3A }, { 0x7121, 0x65E0 }, // 濕湿 濟济 為为 無无
+    { 0x7159, 0x70DF }, { 0x7169, 0x70E6 }, { 0x71B1, 0x70ED }, { 0x71C8, 0x706F }, // 煙烟 煩烦 熱热 燈灯
+    { 0x71D2, 0x70E7 }, { 0x71DF, 0x8425 }, { 0x7210, 0x7089 }, { 0x721B, 0x70C2 }, // 燒烧 營营 爐炉 爛烂
+    { 0x723A, 0x7237 }, { 0x723E, 0x5C14 }, { 0x727D, 0x7275 }, { 0x72C0, 0x72B6 }, // 爺爷 爾尔 牽牵 狀状
+    { 0x72F9, 0x72ED }, { 0x7336, 0x72B9 }, { 0x7345, 0x72EE }, { 0x7368, 0x72EC }, // 狹狭 猶犹 獅狮 獨独
+    { 0x7372, 0x83B7 }, { 0x7375, 0x730E }, { 0x737B, 0x732E }, { 0x73FE, 0x73B0 }, // 獲获 獵猎 獻献 現现
+    { 0x74B0, 0x73AF }, { 0x7562, 0x6BD5 }, { 0x756B, 0x753B }, { 0x7570, 0x5F02 }, // 環环 畢毕 畫画 異异
+    { 0x7576, 0x5F53 }, { 0x760B, 0x75AF }, { 0x7642, 0x7597 }, { 0x767C, 0x53D1 }, // 當当 瘋疯 療疗 發发
+    { 0x76E1, 0x5C3D }, { 0x76E3, 0x76D1 }, { 0x76E4, 0x76D8 }, { 0x773E, 0x4F17 }, // 盡尽 監监 盤盘 眾众
+    { 0x775C, 0x7741 }, { 0x78BA, 0x786E }, { 0x78BC, 0x7801 }, { 0x790E, 0x7840 }, // 睜睁 確确 碼码 礎础
+    { 0x7926, 0x77FF }, { 0x798D, 0x7978 }, { 0x79AE, 0x793C }, { 0x7A05, 0x7A0E }, // 礦矿 禍祸 禮礼 稅税
+    { 0x7A2E, 0x79CD }, { 0x7A31, 0x79F0 }, { 0x7A40, 0x8C37 }, { 0x7A4D, 0x79EF }, // 種种 稱称 穀谷 積积
+    { 0x7A69, 0x7A33 }, { 0x7A6B, 0x83B7 }, { 0x7AAE, 0x7A77 }, { 0x7ACA, 0x7A83 }, // 穩稳 穫获 窮穷 竊窃
+    { 0x7AF6, 0x7ADE }, { 0x7B46, 0x7B14 }, { 0x7BC0, 0x8282 }, { 0x7BC4, 0x8303 }, // 競竞 筆笔 節节 範范
+    { 0x7C21, 0x7B80 }, { 0x7C3D, 0x7B7E }, { 0x7C60, 0x7B3C }, { 0x7CE7, 0x7CAE }, // 簡简 簽签 籠笼 糧粮
+    { 0x7CF0, 0x56E2 }, { 0x7D00, 0x7EAA }, { 0x7D04, 0x7EA6 }, { 0x7D05, 0x7EA2 }, // 糰团 紀纪 約约 紅红
+    { 0x7D0D, 0x7EB3 }, { 0x7D14, 0x7EAF }, { 0x7D19, 0x7EB8 }, { 0x7D1A, 0x7EA7 }, // 納纳 純纯 紙纸 級级
+    { 0x7D30, 0x7EC6 }, { 0x7D39, 0x7ECD }, { 0x7D42, 0x7EC8 }, { 0x7D44, 0x7EC4 }, // 細细 紹绍 終终 組组
+    { 0x7D50, 0x7ED3 }, { 0x7D55, 0x7EDD }, { 0x7D66, 0x7ED9 }, { 0x7D71, 0x7EDF }, // 結结 絕绝 給给 統统
+    { 0x7D93, 0x7ECF }, { 0x7D9C, 0x7EFC }, { 0x7DA0, 0x7EFF }, { 0x7DAD, 0x7EF4 }, // 經经 綜综 綠绿 維维
+    { 0x7DB1, 0x7EB2 }, { 0x7DB2, 0x7F51 }, { 0x7DCA, 0x7D27 }, { 0x7DDA, 0x7EBF }, // 綱纲 網网 緊紧 線线
+    { 0x7DE8, 0x7F16 }, { 0x7DE9, 0x7F13 }, { 0x7DF4, 0x7EC3 }, { 0x7E2E, 0x7F29 }, // 編编 緩缓 練练 縮缩
+    { 0x7E31, 0x7EB5 }, { 0x7E3D, 0x603B }, { 0x7E3E, 0x7EE9 }, { 0x7E54, 0x7EC7 }, // 縱纵 總总 績绩 織织
+    { 0x7E5E, 0x7ED5 }, { 0x7E6A, 0x7ED8 }, { 0x7E6B, 0x7CFB }, { 0x7E8C, 0x7EED }, // 繞绕 繪绘 繫系 續续
+    { 0x7F70, 0x7F5A }, { 0x7F85, 0x7F57 }, { 0x7FA9, 0x4E49 }, { 0x7FD2, 0x4E60 }, // 罰罚 羅罗 義义 習习
+    { 0x805E, 0x95FB }, { 0x806F, 0x8054 }, { 0x8072, 0x58F0 }, { 0x8077, 0x804C }, // 聞闻 聯联 聲声 職职
+    { 0x807D, 0x542C }, { 0x8085, 0x8083 }, { 0x8139, 0x80C0 }, { 0x8166, 0x8111 }, // 聽听 肅肃 脹胀 腦脑
+    { 0x816B, 0x80BF }, { 0x8173, 0x811A }, { 0x8178, 0x80A0 }, { 0x819A, 0x80A4 }, // 腫肿 腳脚 腸肠 膚肤
+    { 0x81A0, 0x80F6 }, { 0x81BD, 0x80C6 }, { 0x81C9, 0x8138 }, { 0x81DF, 0x810F }, // 膠胶 膽胆 臉脸 臟脏
+    { 0x81E8, 0x4E34 }, { 0x81FA, 0x53F0 }, { 0x8207, 0x4E0E }, { 0x8209, 0x4E3E }, // 臨临 臺台 與与 舉举
+    { 0x820A, 0x65E7 }, { 0x8266, 0x8230 }, { 0x8271, 0x8270 }, { 0x83EF, 0x534E }, // 舊旧 艦舰 艱艰 華华
+    { 0x840A, 0x83B1 }, { 0x842C, 0x4E07 }, { 0x84CB, 0x76D6 }, { 0x85CD, 0x84DD }, // 萊莱 萬万 蓋盖 藍蓝
+    { 0x85DD, 0x827A }, { 0x85E5, 0x836F }, { 0x860B, 0x82F9 }, { 0x863F, 0x841D }, // 藝艺 藥药 蘋苹 蘿萝
+    { 0x8655, 0x5904 }, { 0x8766, 0x867E }, { 0x87FB, 0x8681 }, { 0x883B, 0x86EE }, // 處处 蝦虾 蟻蚁 蠻蛮
+    { 0x8853, 0x672F }, { 0x885D, 0x51B2 }, { 0x88CF, 0x91CC }, { 0x88DC, 0x8865 }, // 術术 衝冲 裏里 補补
+    { 0x88DD, 0x88C5 }, { 0x88E1, 0x91CC }, { 0x88FD, 0x5236 }, { 0x8907, 0x590D }, // 裝装 裡里 製制 複复
+    { 0x896A, 0x889C }, { 0x896F, 0x886C }, { 0x8972, 0x88AD }, { 0x898B, 0x89C1 }, // 襪袜 襯衬 襲袭 見见
+    { 0x898F, 0x89C4 }, { 0x8996, 0x89C6 }, { 0x89AA, 0x4EB2 }, { 0x89BA, 0x89C9 }, // 規规 視视 親亲 覺觉
+    { 0x89BD, 0x89C8 }, { 0x89C0, 0x89C2 }, { 0x8A02, 0x8BA2 }, { 0x8A08, 0x8BA1 }, // 覽览 觀观 訂订 計计
+    { 0x8A0E, 0x8BA8 }, { 0x8A13, 0x8BAD }, { 0x8A18, 0x8BB0 }, { 0x8A2A, 0x8BBF }, // 討讨 訓训 記记 訪访
+    { 0x8A2D, 0x8BBE }, { 0x8A31, 0x8BB8 }, { 0x8A34, 0x8BC9 }, { 0x8A55, 0x8BC4 }, // 設设 許许 訴诉 評评
+    { 0x8A5E, 0x8BCD }, { 0x8A62, 0x8BE2 }, { 0x8A66, 0x8BD5 }, { 0x8A69, 0x8BD7 }, // 詞词 詢询 試试 詩诗
+    { 0x8A71, 0x8BDD }, { 0x8A72, 0x8BE5 }, { 0x8A73, 0x8BE6 }, { 0x8A8D, 0x8BA4 }, // 話话 該该 詳详 認认
+    { 0x8A98, 0x8BF1 }, { 0x8A9E, 0x8BED }, { 0x8AA0, 0x8BDA }, { 0x8AA4, 0x8BEF }, // 誘诱 語语 誠诚 誤误
+    { 0x8AAA, 0x8BF4 }, { 0x8AB0, 0x8C01 }, { 0x8AB2, 0x8BFE }, { 0x8ABF, 0x8C03 }, // 說说 誰谁 課课 調调
+    { 0x8AC7, 0x8C08 }, { 0x8ACB, 0x8BF7 }, { 0x8AD2, 0x8C05 }, { 0x8AD6, 0x8BBA }, // 談谈 請请 諒谅 論论
+    { 0x8AE7, 0x8C10 }, { 0x8AF7, 0x8BBD }, { 0x8AF8, 0x8BF8 }, { 0x8B00, 0x8C0B }, // 諧谐 諷讽 諸诸 謀谋
+    { 0x8B02, 0x8C13 }, { 0x8B0E, 0x8C1C }, { 0x8B1B, 0x8BB2 }, { 0x8B1D, 0x8C22 }, // 謂谓 謎谜 講讲 謝谢
+    { 0x8B49, 0x8BC1 }, { 0x8B58, 0x8BC6 }, { 0x8B6F, 0x8BD1 }, { 0x8B70, 0x8BAE }, // 證证 識识 譯译 議议
+    { 0x8B77, 0x62A4 }, { 0x8B80, 0x8BFB }, { 0x8B93, 0x8BA9 }, { 0x8C50, 0x4E30 }, // 護护 讀读 讓让 豐丰
+    { 0x8C6C, 0x732A }, { 0x8C93, 0x732B }, { 0x8C9D, 0x8D1D }, { 0x8CA0, 0x8D1F }, // 豬猪 貓猫 貝贝 負负
+    { 0x8CA1, 0x8D22 }, { 0x8CA2, 0x8D21 }, { 0x8CA7, 0x8D2B }, { 0x8CA8, 0x8D27 }, // 財财 貢贡 貧贫 貨货
+    { 0x8CAB, 0x8D2F }, { 0x8CAC, 0x8D23 }, { 0x8CB4, 0x8D35 }, { 0x8CB7, 0x4E70 }, // 貫贯 責责 貴贵 買买
+    { 0x8CB8, 0x8D37 }, { 0x8CBB, 0x8D39 }, { 0x8CBC, 0x8D34 }, { 0x8CBF, 0x8D38 }, // 貸贷 費费 貼贴 貿贸
+    { 0x8CC7, 0x8D44 }, { 0x8CDE, 0x8D4F }, { 0x8CE0, 0x8D54 }, { 0x8CE3, 0x5356 }, // 資资 賞赏 賠赔 賣卖
+    { 0x8CEA, 0x8D28 }, { 0x8CFC, 0x8D2D }, { 0x8CFD, 0x8D5B }, { 0x8D08, 0x8D60 }, // 質质 購购 賽赛 贈赠
+    { 0x8D0A, 0x8D5E }, { 0x8D0F, 0x8D62 }, { 0x8D95, 0x8D76 }, { 0x8DA8, 0x8D8B }, // 贊赞 贏赢 趕赶 趨趋
+    { 0x8E10, 0x8DF5 }, { 0x8E64, 0x8E2A }, { 0x8E8D, 0x8DC3 }, { 0x8ECA, 0x8F66 }, // 踐践 蹤踪 躍跃 車车
+    { 0x8ECC, 0x8F68 }, { 0x8EDF, 0x8F6F }, { 0x8F03, 0x8F83 }, { 0x8F09, 0x8F7D }, // 軌轨 軟软 較较 載载
+    { 0x8F14, 0x8F85 }, { 0x8F15, 0x8F7B }, { 0x8F1B, 0x8F86 }, { 0x8F29, 0x8F88 }, // 輔辅 輕轻 輛辆 輩辈
+    { 0x8F2A, 0x8F6E }, { 0x8F2F, 0x8F91 }, { 0x8F38, 0x8F93 }, { 0x8F49, 0x8F6C }, // 輪轮 輯辑 輸输 轉转
+    { 0x8F5F, 0x8F70 }, { 0x8FAD, 0x8F9E }, { 0x8FAF, 0x8FA9 }, { 0x9019, 0x8FD9 }, // 轟轰 辭辞 辯辩 這这
+    { 0x9023, 0x8FDE }, { 0x9032, 0x8FDB }, { 0x904B, 0x8FD0 }, { 0x904E, 0x8FC7 }, // 連连 進进 運运 過过
+    { 0x9054, 0x8FBE }, { 0x9055, 0x8FDD }, { 0x9059, 0x9065 }, { 0x905E, 0x9012 }, // 達达 違违 遙遥 遞递
+    { 0x9060, 0x8FDC }, { 0x9069, 0x9002 }, { 0x9072, 0x8FDF }, { 0x9077, 0x8FC1 }, // 遠远 適适 遲迟 遷迁
+    { 0x9078, 0x9009 }, { 0x907A, 0x9057 }, { 0x9081, 0x8FC8 }, { 0x9084, 0x8FD8 }, // 選选 遺遗 邁迈 還还
+    { 0x908A, 0x8FB9 }, { 0x908F, 0x903B }, { 0x90F5, 0x90AE }, { 0x9109, 0x4E61 }, // 邊边 邏逻 郵邮 鄉乡
+    { 0x9127, 0x9093 }, { 0x9130, 0x90BB }, { 0x919C, 0x4E11 }, { 0x91AB, 0x533B }, // 鄧邓 鄰邻 醜丑 醫医
+    { 0x91AC, 0x9171 }, { 0x91CB, 0x91CA }, { 0x91E3, 0x9493 }, { 0x9234, 0x94C3 }, // 醬酱 釋释 釣钓 鈴铃
+    { 0x925B, 0x94C5 }, { 0x9280, 0x94F6 }, { 0x9285, 0x94DC }, { 0x92B7, 0x9500 }, // 鉛铅 銀银 銅铜 銷销
+    { 0x92D2, 0x950B }, { 0x92EA, 0x94FA }, { 0x92FC, 0x94A2 }, { 0x9304, 0x5F55 }, // 鋒锋 鋪铺 鋼钢 錄录
+    { 0x9322, 0x94B1 }, { 0x932F, 0x9519 }, { 0x9336, 0x8868 }, { 0x934B, 0x9505 }, // 錢钱 錯错 錶表 鍋锅
+    { 0x935B, 0x953B }, { 0x9375, 0x952E }, { 0x937E, 0x949F }, { 0x9396, 0x9501 }, // 鍛锻 鍵键 鍾钟 鎖锁
+    { 0x93C8, 0x94FE }, { 0x93E1, 0x955C }, { 0x9418, 0x949F }, { 0x9435, 0x94C1 }, // 鏈链 鏡镜 鐘钟 鐵铁
+    { 0x9470, 0x94A5 }, { 0x947D, 0x94BB }, { 0x9577, 0x957F }, { 0x9580, 0x95E8 }, // 鑰钥 鑽钻 長长 門门
+    { 0x9583, 0x95EA }, { 0x9589, 0x95ED }, { 0x958B, 0x5F00 }, { 0x9593, 0x95F4 }, // 閃闪 閉闭 開开 間间
+    { 0x95A5, 0x9600 }, { 0x95B1, 0x9605 }, { 0x95D6, 0x95EF }, { 0x95DC, 0x5173 }, // 閥阀 閱阅 闖闯 關关
+    { 0x9663, 0x9635 }, { 0x9670, 0x9634 }, { 0x9673, 0x9648 }, { 0x9678, 0x9646 }, // 陣阵 陰阴 陳陈 陸陆
+    { 0x967D, 0x9633 }, { 0x968A, 0x961F }, { 0x968E, 0x9636 }, { 0x969B, 0x9645 }, // 陽阳 隊队 階阶 際际
+    { 0x96A8, 0x968F }, { 0x96AA, 0x9669 }, { 0x96B1, 0x9690 }, { 0x96BB, 0x53EA }, // 隨随 險险 隱隐 隻只
+    { 0x96D6, 0x867D }, { 0x96DC, 0x6742 }, { 0x96DE, 0x9E21 }, { 0x96E2, 0x79BB }, // 雖虽 雜杂 雞鸡 離离
+    { 0x96E3, 0x96BE }, { 0x96F2, 0x4E91 }, { 0x96FB, 0x7535 }, { 0x9727, 0x96FE }, // 難难 雲云 電电 霧雾
+    { 0x9748, 0x7075 }, { 0x97D3, 0x97E9 }, { 0x9801, 0x9875 }, { 0x9802, 0x9876 }, // 靈灵 韓韩 頁页 頂顶
+    { 0x9805, 0x9879 }, { 0x9806, 0x987A }, { 0x9808, 0x987B }, { 0x9810, 0x9884 }, // 項项 順顺 須须 預预
+    { 0x9813, 0x987F }, { 0x9818, 0x9886 }, { 0x982D, 0x5934 }, { 0x983B, 0x9891 }, // 頓顿 領领 頭头 頻频
+    { 0x9846, 0x9897 }, { 0x984C, 0x9898 }, { 0x984D, 0x989D }, { 0x984F, 0x989C }, // 顆颗 題题 額额 顏颜
+    { 0x9858, 0x613F }, { 0x985E, 0x7C7B }, { 0x9867, 0x987E }, { 0x986F, 0x663E }, // 願愿 類类 顧顾 顯显
+    { 0x98A8, 0x98CE }, { 0x98B1, 0x53F0 }, { 0x98C4, 0x98D8 }, { 0x98DB, 0x98DE }, // 風风 颱台 飄飘 飛飞
+    { 0x98E2, 0x9965 }, { 0x98EF, 0x996D }, { 0x98F2, 0x996E }, { 0x98FD, 0x9971 }, // 飢饥 飯饭 飲饮 飽饱
+    { 0x98FE, 0x9970 }, { 0x9903, 0x997A }, { 0x9905, 0x997C }, { 0x9913, 0x997F }, // 飾饰 餃饺 餅饼 餓饿
+    { 0x9918, 0x4F59 }, { 0x9928, 0x9986 }, { 0x9951, 0x9965 }, { 0x99AC, 0x9A6C }, // 餘余 館馆 饑饥 馬马
+    { 0x99D5, 0x9A7E }, { 0x9A0E, 0x9A91 }, { 0x9A19, 0x9A97 }, { 0x9A57, 0x9A8C }, // 駕驾 騎骑 騙骗 驗验
+    { 0x9A5A, 0x60CA }, { 0x9AD2, 0x810F }, { 0x9AD4, 0x4F53 }, { 0x9AEE, 0x53D1 }, // 驚惊 髒脏 體体 髮发
+    { 0x9B06, 0x677E }, { 0x9B1A, 0x987B }, { 0x9B25, 0x6597 }, { 0x9B27, 0x95F9 }, // 鬆松 鬚须 鬥斗 鬧闹
+    { 0x9B31, 0x90C1 }, { 0x9B5A, 0x9C7C }, { 0x9BAE, 0x9C9C }, { 0x9CE5, 0x9E1F }, // 鬱郁 魚鱼 鮮鲜 鳥鸟
+    { 0x9CF4, 0x9E23 }, { 0x9D28, 0x9E2D }, { 0x9D3B, 0x9E3F }, { 0x9E7D, 0x76D0 }, // 鳴鸣 鴨鸭 鴻鸿 鹽盐
+    { 0x9E97, 0x4E3D }, { 0x9EA5, 0x9EA6 }, { 0x9EB5, 0x9762 }, { 0x9EBC, 0x4E48 }, // 麗丽 麥麦 麵面 麼么
+    { 0x9EC3, 0x9EC4 }, { 0x9EDE, 0x70B9 }, { 0x9F52, 0x9F7F }, { 0x9F61, 0x9F84 }, // 黃黄 點点 齒齿 齡龄
+    { 0x9F8D, 0x9F99 }, { 0x9F9C, 0x9F9F }, // 龍龙 龜龟
+};
+
+/* foldAsciiScalar：一次 8 個 byte 的英文大寫轉小寫（沒有 SIMD 指令可以用時）
    -------------------------------------------------------
-   為什麼需要這個？
-   → library[] 陣列大小固定（WORD_MAX 個），如果繼續寫入就會超出陣列邊界，
-     這叫做「buffer overflow」，會讓程式當掉或行為異常，非常危險。
-   → 每次要新增單字前都要先呼叫這個函數確認還有沒有空間。
-
-   回傳值：1 = 已滿，請勿繼續新增；0 = 還有空間*/
-int isFull(void) {
-    if (wordCount >= WORD_MAX) {
-        printf("[Error] 單字庫已滿（上限 %d 個），請先刪除一些單字。\n", WORD_MAX);
-        return 1;
+   把 8 個 byte 當成一個 uint64_t，每個 byte 各自判斷是不是 'A'~'Z'：
+   → 先把最高位元拿掉（x & 0x7f），每個 byte 加上一個常數，
+     「大於等於 'A'」和「大於 'Z'」的 byte 最高位元就會變成 1，而且不會進位到隔壁的 byte。
+   → 兩個結果互斥或，只有 'A'~'Z' 的最高位元是 1；再排除原本就是中文（最高位元是 1）的 byte。
+   → 把那個位元往右移 2 格剛好是 0x20，互斥或上去就是小寫。
+
+   回傳值：第一個不是 ASCII 的 byte 的位置（全部都是 ASCII 就回傳 len）*/
+static size_t foldAsciiScalar(char *s, size_t i, size_t len) {
+    const uint64_t ones = 0x0101010101010101ULL;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t x;
+        memcpy(&x, s + i, 8); // 用 memcpy 讀，不用擔心沒有對齊
+        if (x & (ones * 0x80)) break; // 有中文，剩下的交給下面一個一個處理
+        uint64_t low   = x & (ones * 0x7f);
+        uint64_t geA   = low + ones * (0x80 - 'A');
+        uint64_t gtZ   = low + ones * (0x7f - 'Z');
+        uint64_t upper = (geA ^ gtZ) & ~x & (ones * 0x80);
+        x ^= upper >> 2;
+        memcpy(s + i, &x, 8);
     }
-    return 0;
+    size_t firstHigh = len;
+    for (; i < len; i++) {
+        unsigned char c = (unsigned char)s[i];
+        if (c >= 0x80 && firstHigh == len) firstHigh = i;
+        if (c >= 'A' && c <= 'Z') s[i] = (char)(c + 32);
+    }
+    return firstHigh;
 }
 
-/* updateFolderList：把資料夾名稱加入 folderList（如果還沒有的話）
+/* foldAscii：把 s 的前 len 個 byte 裡的 'A'~'Z' 全部換成小寫
    -------------------------------------------------------
-   每次新增單字時都會呼叫，目的是讓 folderList 保持無重複的清單，
-   這樣顯示選單時才不會出現同樣的資料夾兩次。*/
-void updateFolderList(const char *name) {
-    // 先掃描一遍，看看這個名稱是否已經存在
-    for (int i = 0; i < folderCount; i++) {
-        if (strcmp(folderList[i], name) == 0) {
-            return; // 已經有了，不用再加，直接離開函數
-        }
+   有 SSE2（x86）或 NEON（ARM）就一次比 16 個 byte：
+   一個指令同時比較 16 個 byte 是不是在 'A'~'Z' 之間，得到一個「是大寫就全是 1」的遮罩，
+   遮罩 & 0x20 再加回去就轉好了，不用一個 byte 一個 byte 判斷、跳躍。
+   中文的 byte 都 >= 0x80，當成有號數是負的，一定不會落在 'A'~'Z' 之間，不會被改到。
+
+   回傳值：第一個不是 ASCII 的 byte 的位置（全部都是 ASCII 就回傳 len），
+           normalizeText 用它決定要不要再做 UTF-8 的轉換*/
+size_t foldAscii(char *s, size_t len) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i aMinus1 = _mm_set1_epi8('A' - 1);
+    const __m128i zPlus1  = _mm_set1_epi8('Z' + 1);
+    const __m128i bit20   = _mm_set1_epi8(0x20);
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+        if (_mm_movemask_epi8(v)) break; // 有 byte 的最高位元是 1（中文）
+        __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(v, aMinus1), _mm_cmplt_epi8(v, zPlus1));
+        _mm_storeu_si128((__m128i *)(s + i), _mm_add_epi8(v, _mm_and_si128(upper, bit20)));
     }
-    // 沒有的話，加到清單最後面（同時要確認還有空間）
-    if (folderCount < FOLDER_MAX) {
-        strcpy(folderList[folderCount], name);
-        folderCount++;
+#elif defined(__ARM_NEON)
+    const uint8x16_t a   = vdupq_n_u8('A');
+    const uint8x16_t z   = vdupq_n_u8('Z');
+    const uint8x16_t b20 = vdupq_n_u8(0x20);
+    for (; i + 16 <= len; i += 16) {
+        uint8x16_t v = vld1q_u8((const uint8_t *)(s + i));
+        if (vmaxvq_u8(v) >= 0x80) break;
+        uint8x16_t upper = vandq_u8(vcgeq_u8(v, a), vcleq_u8(v, z));
+        vst1q_u8((uint8_t *)(s + i), vaddq_u8(v, vandq_u8(upper, b20)));
     }
+#endif
+    return foldAsciiScalar(s, i, len);
 }
 
-/* parseLine：解析一行文字，把單字資料存進 library[]
+/* hanLookup：在 hanFold 裡找繁體字 cp 對應的簡體字；沒有的話原封不動回傳*/
+static uint32_t hanLookup(uint32_t cp) {
+    int lo = 0, hi = (int)(sizeof(hanFold) / sizeof(hanFold[0]));
+    if (cp < hanFold[0][0] || cp > hanFold[hi - 1][0]) return cp;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (hanFold[mid][0] < cp) lo = mid + 1;
+        else                      hi = mid;
+    }
+    return (lo < (int)(sizeof(hanFold) / sizeof(hanFold[0])) && hanFold[lo][0] == cp) ? hanFold[lo][1] : cp;
+}
+
+/* normalizeText：把 src 轉成比對用的 key，寫進 dst
    -------------------------------------------------------
-   檔案裡每行的格式是：
-     資料夾 [Tab] 英文 [Tab] 中文 [Tab] 錯誤次數 [換行]
+   1. 英文大寫 → 小寫（foldAscii）
+   2. 全形英數字、符號（U+FF01 ~ U+FF5E）→ 半形，全形空白（U+3000）→ 空白
+   3. 常用的繁體字 → 簡體字（hanFold）
+
+   轉完的長度一定不會比原本長（全形 3 bytes 變 1 byte，繁簡都是 3 bytes），
+   所以 dst 只要跟 src 一樣大就夠，dst 和 src 也可以是同一個陣列。
+   不是合法 UTF-8 的 byte 原封不動照抄。*/
+void normalizeText(char *dst, const char *src) {
+    size_t len = strlen(src);
+    if (dst != src) memmove(dst, src, len + 1);
+
+    // 大部分英文單字只有 ASCII，這一步做完就結束了
+    size_t i = foldAscii(dst, len);
+    if (i == len) return;
+
+    const unsigned char *in = (const unsigned char *)dst;
+    size_t out = i;
+    while (i < len) {
+        unsigned char c = in[i];
+        if (c < 0x80) {
+            dst[out++] = (char)((c >= 'A' && c <= 'Z') ? c + 32 : c);
+            i++;
+            continue;
+        }
+        // 這裡會轉換的字都是 3 bytes 的 UTF-8：1110xxxx 10xxxxxx 10xxxxxx
+        if ((c & 0xF0) == 0xE0 && i + 2 < len &&
+            (in[i + 1] & 0xC0) == 0x80 && (in[i + 2] & 0xC0) == 0x80) {
+            uint32_t cp = ((uint32_t)(c & 0x0F) << 12) | ((uint32_t)(in[i + 1] & 0x3F) << 6) |
+                          (uint32_t)(in[i + 2] & 0x3F);
+            uint32_t to = cp;
+            if (cp >= 0xFF01 && cp <= 0xFF5E) to = cp - 0xFEE0; // 全形 → 半形
+            else if (cp == 0x3000)            to = ' ';
+            else if (cp >= 0x4E00)            to = hanLookup(cp);
+
+            if (to < 0x80) {
+                dst[out++] = (char)((to >= 'A' && to <= 'Z') ? to + 32 : to);
+            } else {
+                dst[out++] = (char)(0xE0 | (to >> 12));
+                dst[out++] = (char)(0x80 | ((to >> 6) & 0x3F));
+                dst[out++] = (char)(0x80 | (to & 0x3F));
+            }
+            i += 3;
+            continue;
+        }
+        dst[out++] = (char)c; // 其他的字（2 bytes、4 bytes、壞掉的 byte）原封不動
+        i++;
+    }
+    dst[out] = '\0';
+}
 
-   strtok() 的工作原理：
-   → 第一次呼叫：傳入字串和分隔符 "\t"，它會找到第一個 Tab，
-     把那個位置換成 '\0'，然後回傳字串開頭的指標。
-   → 之後呼叫：傳入 NULL，代表「繼續處理剛才那個字串」，
-     從上次結束的地方繼續往後找下一個 Tab。
-   → 注意！strtok 會破壞原始字串（把分隔符換成 '\0'），
-     所以呼叫之後就不能再使用原本的 line 了。
+/* normalizeKey：把 src 轉成 key，短的放在呼叫者給的 buf，太長的才 malloc
+   回傳值：key（不等於 buf 的話，用完要 free）；記憶體不足回傳 NULL*/
+static char *normalizeKey(const char *src, char *buf, size_t cap) {
+    size_t len = strlen(src);
+    char *key = (len < cap) ? buf : malloc(len + 1);
+    if (key) normalizeText(key, src);
+    return key;
+}
 
-   參數：
-     line → 一行文字（會被 strtok 修改，呼叫後不能再用）*/
-void parseLine(char *line) {
-    if (isFull()) return; // 滿了就不繼續
+/* utf8Valid：s 的前 len 個 byte 是不是合法的 UTF-8
+   -------------------------------------------------------
+   合法的 UTF-8（RFC 3629）：
+     00~7F                    → 1 byte（ASCII）
+     C2~DF + 1 個 80~BF       → 2 bytes（C0、C1 開頭是「用太多 byte 寫小字元」，不合法）
+     E0~EF + 2 個 80~BF       → 3 bytes（E0 後面至少 A0；ED 後面最多 9F，那是 UTF-16 的代理區）
+     F0~F4 + 3 個 80~BF       → 4 bytes（F0 後面至少 90；F4 後面最多 8F，不能超過 U+10FFFF）
+   用 Big5 存的檔案、被切掉一半的中文字都過不了這一關。
+
+   單字表大部分是英文，所以和 foldAscii 一樣先一次看 16 個 byte（SSE2 / NEON），
+   沒有的話一次看 8 個（uint64_t），全部都是 ASCII 就直接跳過；
+   遇到中文才一個字一個字檢查，檢查完又回到一次看一大塊。
+
+   回傳值：1 = 合法，0 = 不合法*/
+int utf8Valid(const char *s, size_t len) {
+    const unsigned char *p = (const unsigned char *)s;
+    size_t i = 0;
+    while (i < len) {
+#if defined(__SSE2__)
+        while (i + 16 <= len && !_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)(p + i)))) i += 16;
+#elif defined(__ARM_NEON)
+        while (i + 16 <= len && vmaxvq_u8(vld1q_u8(p + i)) < 0x80) i += 16;
+#endif
+        for (; i + 8 <= len; i += 8) {
+            uint64_t x;
+            memcpy(&x, p + i, 8);
+            if (x & 0x8080808080808080ULL) break;
+        }
+        if (i >= len) break;
+
+        unsigned char c = p[i];
+        if (c < 0x80) { i++; continue; }
+        int n;                           // 後面還要幾個 80~BF
+        unsigned char lo = 0x80, hi = 0xBF; // 第二個 byte 的範圍
+        if      (c >= 0xC2 && c <= 0xDF) n = 1;
+        else if (c >= 0xE0 && c <= 0xEF) { n = 2; if (c == 0xE0) lo = 0xA0; if (c == 0xED) hi = 0x9F; }
+        else if (c >= 0xF0 && c <= 0xF4) { n = 3; if (c == 0xF0) lo = 0x90; if (c == 0xF4) hi = 0x8F; }
+        else return 0;
+        if (len - i <= (size_t)n || p[i + 1] < lo || p[i + 1] > hi) return 0;
+        for (int k = 2; k <= n; k++) {
+            if ((p[i + k] & 0xC0) != 0x80) return 0;
+        }
+        i += (size_t)n + 1;
+    }
+    return 1;
+}
 
-    char *folder = strtok(line, "\t");           // 取第一段（資料夾名稱）
-    char *en     = strtok(NULL, "\t");           // 取第二段（英文單字）
-    char *ch     = strtok(NULL, "\t\r\n");       // 取第三段（中文意思，順便去掉 \r \n）
-    char *errStr = strtok(NULL, "\t\r\n");       // 取第四段（錯誤次數，可能沒有）
 
-    // 三個必要欄位缺一個就跳過這行（格式不對）
-    if (!folder || !en || !ch) return;
+/* ================================================================
+   單字庫（字串池 + 動態陣列）
+   ================================================================ */
 
-    // 把資料寫進 library 的下一格
-    strcpy(library[wordCount].folder,  folder);
-    strcpy(library[wordCount].english, en);
-    strcpy(library[wordCount].chinese, ch);
-    // errStr 可能是 NULL（舊格式沒有這欄），用三元運算子設預設值
-    library[wordCount].errorCount = errStr ? atoi(errStr) : 0;
+/* growBuffer：把一塊記憶體換成更大的一塊（realloc 的加強版）
+   -------------------------------------------------------
+   一般情況就是 realloc；但如果舊的那塊是「借來的」（指向快照檔），
+   就不能 realloc，要另外 malloc 一塊新的，把舊內容複製過去。
 
-    updateFolderList(folder); // 更新資料夾清單
-    wordCount++;              // 最後才遞增，確保前面的寫入都成功了
+   參數：
+     old      → 舊的記憶體（可以是 NULL）
+     oldBytes → 舊的記憶體裡有幾個 byte 要保留
+     newBytes → 新的大小
+     borrowed → 舊的記憶體是不是借來的；成功後一定會變成 0
+
+   回傳值：新的記憶體；失敗時回傳 NULL（舊的記憶體不受影響）*/
+void *growBuffer(void *old, size_t oldBytes, size_t newBytes, int *borrowed) {
+    if (!*borrowed) return realloc(old, newBytes);
+    void *p = malloc(newBytes);
+    if (!p) return NULL;
+    if (oldBytes > 0) memcpy(p, old, oldBytes);
+    *borrowed = 0;
+    return p;
 }
 
-/* saveToFile：把整個 library[] 寫入 english_word.txt
+/* arenaAdd：把一個字串（含結尾的 '\0'）複製到字串池的最後面
    -------------------------------------------------------
-   每次新增或刪除單字、測驗結束後都會呼叫，
-   確保關掉程式後資料還在。
-
-   "w" 模式代表「寫入」：
-   → 如果檔案已存在，會先清空再重寫（所以是整個重寫，不是追加）。
-   → 如果檔案不存在，會自動建立一個新的。
-
-   回傳值：1 = 儲存成功，0 = 開檔失敗*/
-int saveToFile(void) {
-    FILE *fp = fopen("english_word.txt", "w");
-    if (!fp) {
-        // 開檔失敗通常是因為沒有寫入權限
-        printf("[Error] 無法儲存！請確認程式所在的資料夾有寫入權限。\n");
-        return 0;
+   空間不夠時容量加倍。為什麼是「加倍」而不是「每次多 100 個 byte」？
+   → 每次只多一點點的話，大量匯入時會一直 realloc、一直搬資料，變成 O(n²)。
+   → 加倍的話，搬資料的總次數平均分攤到每次新增只有 O(1)。
+
+   回傳值：字串在字串池中的位移；記憶體不足時回傳 UINT32_MAX*/
+uint32_t arenaAdd(StrArena *a, const char *str) {
+    size_t len = strlen(str) + 1; // +1 是結尾的 '\0'
+
+    if (a->used + len > UINT32_MAX) return UINT32_MAX; // 位移用 32 位元存，不能超過 4GB
+
+    if (a->used + len > a->capacity) {
+        size_t newCap = a->capacity ? a->capacity : ARENA_INIT_CAP;
+        while (newCap < a->used + len) newCap *= 2;
+        char *p = growBuffer(a->data, a->used, newCap, &a->borrowed);
+        if (!p) return UINT32_MAX; // 失敗時原本的資料還在，不會遺失
+        a->data     = p;
+        a->capacity = newCap;
     }
-    for (int i = 0; i < wordCount; i++) {
-        // fprintf 跟 printf 一樣，但輸出目標是檔案（fp）而不是螢幕
-        fprintf(fp, "%s\t%s\t%s\t%d\n",
-                library[i].folder,
-                library[i].english,
-                library[i].chinese,
-                library[i].errorCount);
-    }
-    fclose(fp); // 一定要記得關檔案！不然資料可能沒有真正寫進去
-    return 1;
+
+    uint32_t off = (uint32_t)a->used;
+    memcpy(a->data + off, str, len);
+    a->used += len;
+    return off;
 }
 
-/* loadFile：程式啟動時，從 english_word.txt 讀取所有單字
+/* storeAdd：在單字庫最後面新增一個單字
    -------------------------------------------------------
-   "r" 模式代表「唯讀」：
-   → 如果檔案不存在，fopen 會回傳 NULL（不會建立新檔）。
-   → 第一次使用這個程式時，english_word.txt 還不存在，是正常的。*/
-void loadFile(void) {
-    FILE *fp = fopen("english_word.txt", "r");
-    if (!fp) {
-        printf("[Notice] 還沒有單字資料，請先用「1. 新增單字」開始。\n");
-        return;
+   參數：
+     s          → 要新增到哪個單字庫
+     folderId   → 資料夾編號（folderIntern 的回傳值）
+     en / cn    → 英文、中文（會複製進字串池，呼叫後原字串可以丟掉）
+     errorCount → 錯誤次數
+
+   英文、中文的 key（normalizeText）也在這裡算好：
+   兩個都已經是 key 的話（絕大部分的單字），keyOff 就直接等於 enOff，不多佔空間；
+   否則把兩個 key 接著存進字串池。不管哪一種，中文的 key 都緊接在英文的 key 後面。
+
+   回傳值：新單字的索引；記憶體不足時回傳 -1*/
+int storeAdd(WordStore *s, int folderId, const char *en, const char *cn, int errorCount) {
+    if (s->count == s->capacity) {
+        int newCap = s->capacity ? s->capacity * 2 : STORE_INIT_CAP;
+        Word *p = growBuffer(s->words, (size_t)s->count * sizeof(Word),
+                             (size_t)newCap * sizeof(Word), &s->borrowed);
+        if (!p) {
+            printf("[Error] 記憶體不足，無法再新增單字。\n");
+            return -1;
+        }
+        s->words    = p;
+        s->capacity = newCap;
     }
 
-    char line[LINE_BUF];
-    // fgets 每次讀一行（包含 '\n'），讀到檔案結尾時回傳 NULL，迴圈結束
-    while (fgets(line, sizeof(line), fp)) {
-        parseLine(line); // 解析這一行並存入 library[]
+    char enBuf[LINE_BUF], cnBuf[LINE_BUF];
+    char *enKey = normalizeKey(en, enBuf, sizeof(enBuf));
+    char *cnKey = normalizeKey(cn, cnBuf, sizeof(cnBuf));
+    uint32_t enOff = UINT32_MAX, cnOff = UINT32_MAX, keyOff = UINT32_MAX;
+    if (enKey && cnKey) {
+        enOff  = arenaAdd(&s->strings, en);
+        cnOff  = arenaAdd(&s->strings, cn);
+        keyOff = enOff;
+        if (strcmp(enKey, en) != 0 || strcmp(cnKey, cn) != 0) {
+            keyOff = arenaAdd(&s->strings, enKey);
+            if (arenaAdd(&s->strings, cnKey) == UINT32_MAX) keyOff = UINT32_MAX;
+        }
+    }
+    if (enKey != enBuf) free(enKey);
+    if (cnKey != cnBuf) free(cnKey);
+    if (enOff == UINT32_MAX || cnOff == UINT32_MAX || keyOff == UINT32_MAX) {
+        printf("[Error] 記憶體不足，無法再新增單字。\n");
+        return -1;
     }
 
-    printf("讀取完成：%d 個資料夾，%d 個單字。\n", folderCount, wordCount);
-    fclose(fp);
+    Word *w       = &s->words[s->count];
+    w->enOff      = enOff;
+    w->cnOff      = cnOff;
+    w->keyOff     = keyOff;
+    w->folderId   = (uint32_t)folderId;
+    w->errorCount = errorCount;
+    memset(&w->review, 0, sizeof(w->review));
+    w->review.ease = SM2_EASE_INIT;
+    return s->count++; // 先回傳目前的 count（新單字的索引），再遞增
 }
 
-
-/* ================================================================
-   洗牌（Fisher-Yates 演算法）
-   ================================================================
-
-   目的：把存放單字索引的陣列隨機打亂，讓測驗題目順序不固定。
-
-   Fisher-Yates 演算法步驟（以 4 個元素為例）：
-   → i=3：從 0~3 隨機選一個位置 j，把 arr[3] 和 arr[j] 交換
-   → i=2：從 0~2 隨機選一個位置 j，把 arr[2] 和 arr[j] 交換
-   → i=1：從 0~1 隨機選一個位置 j，把 arr[1] 和 arr[j] 交換
-   → 完成！每種排列出現的機率完全相同。
+/* storeReserve：事先把單字庫的空間配置好，之後新增時就不用一直擴充
+   -------------------------------------------------------
+   大量匯入時已經知道大概有幾個單字、字串總共多長，
+   一次配置好，比 1 → 2 → 4 → 8... 慢慢倍增少搬很多次資料。
 
    參數：
-     arr → 要打亂的整數陣列（存放 library[] 的索引，例如 [0,1,2,3,...]）
-     n   → 陣列長度*/
-void shuffle(int arr[], int n) {
-    for (int i = n - 1; i > 0; i--) {
-        int j    = rand() % (i + 1); // 從 0 到 i 之間隨機選一個位置
-        // 交換 arr[i] 和 arr[j]（需要一個暫存變數，就像交換兩杯飲料需要第三個杯子）
-        int temp = arr[i];
-        arr[i]   = arr[j];
-        arr[j]   = temp;
+     words → 總共要能放幾個單字
+     bytes → 字串池總共要能放幾個 bytes
+
+   回傳值：1 = 成功，0 = 記憶體不足（原本的資料不受影響）*/
+int storeReserve(WordStore *s, int words, size_t bytes) {
+    if (words > s->capacity) {
+        Word *p = growBuffer(s->words, (size_t)s->count * sizeof(Word),
+                             (size_t)words * sizeof(Word), &s->borrowed);
+        if (!p) return 0;
+        s->words    = p;
+        s->capacity = words;
     }
+    if (bytes > UINT32_MAX) bytes = UINT32_MAX;
+    if (bytes > s->strings.capacity) {
+        char *p = growBuffer(s->strings.data, s->strings.used, bytes, &s->strings.borrowed);
+        if (!p) return 0;
+        s->strings.data     = p;
+        s->strings.capacity = bytes;
+    }
+    return 1;
 }
 
+/* wordBytes：第 idx 個單字在字串池裡佔了幾個 byte（英文、中文，還有另外存的 key）*/
+static size_t wordBytes(const WordStore *s, int idx) {
+    const char *base = s->strings.data;
+    const Word *w    = &s->words[idx];
+    size_t bytes = strlen(base + w->enOff) + 1 + strlen(base + w->cnOff) + 1;
+    if (w->keyOff != w->enOff) {
+        const char *key = base + w->keyOff;
+        size_t enLen = strlen(key) + 1;
+        bytes += enLen + strlen(key + enLen) + 1;
+    }
+    return bytes;
+}
 
-/* ================================================================
-   資料夾選擇選單
-   ================================================================ */
-
-/* chooseFolder：顯示資料夾列表，讓使用者選要操作哪個範圍
+/* storeRemove：刪除索引 idx 的單字
    -------------------------------------------------------
-   回傳值：
-     1 ~ folderCount → 使用者選了某個資料夾（對應 folderList 的索引+1）
-     99              → 使用者選了「全部單字」
-     -1              → 使用者選擇離開，或目前完全沒有單字*/
-int chooseFolder(void) {
-    // 連單字都沒有，就沒什麼好選的
-    if (wordCount == 0) {
-        printf("[Notice] 目前沒有任何單字，請先新增。\n");
-        return -1;
-    }
+   刪除的方法（以最後元素覆蓋）：
+   → 把最後一格的 Word 複製過來蓋掉它，再把 count 減 1。
+   → Word 只有 36 bytes，複製非常快；字串本身留在字串池裡不動。
 
-    int option;
-    while (1) { // 無限迴圈，直到使用者輸入有效選項才 return 離開
-        printf("\n===== 選擇範圍 =====\n");
-        for (int i = 0; i < folderCount; i++) {
-            printf("  %d. %s\n", i + 1, folderList[i]);
-        }
-        printf(" 99. 全部單字\n");
-        printf("100. 返回主選單\n");
-        printf("請選擇: ");
+   被刪掉的字串會變成「垃圾」，累積超過字串池一半時就整理一次（storeCompact），
+   避免一直新增刪除之後字串池越長越大。*/
+void storeRemove(WordStore *s, int idx) {
+    s->strings.garbage += wordBytes(s, idx);
 
-        if (scanf("%d", &option) != 1) {
-            // 使用者輸入了非數字（例如打了「abc」），scanf 回傳 0 表示讀取失敗
-            clearInputBuffer(); // 清掉錯誤的輸入，不然下次還是會讀到它
-            printf("[Error] 請輸入數字。\n");
-            continue; // 回到迴圈開頭重新顯示選單
-        }
-        clearInputBuffer(); // 清掉數字後面殘留的換行符
+    s->words[idx] = s->words[s->count - 1];
+    s->count--;
 
-        if (option == 100) return -1;  // 使用者要返回
-        if (option == 99)  return 99;  // 全部單字
-        if (option >= 1 && option <= folderCount) return option; // 某個資料夾
+    if (s->strings.garbage > s->strings.used / 2) storeCompact(s);
+}
 
-        printf("[Error] 沒有這個選項，請重新輸入。\n");
+/* storeCompact：重建字串池，只留下還在使用的字串
+   -------------------------------------------------------
+   做法：先算出還在使用的字串總共多大，一次配置好新的字串池，
+   再把每個單字的字串依序複製過去，同時更新 Word 裡的位移。
+   先配置好足夠的空間，複製途中就不會因為記憶體不足而半途而廢；
+   如果一開始就配置失敗，就放棄整理，舊的字串池照樣可以用。*/
+void storeCompact(WordStore *s) {
+    const char *old = s->strings.data;
+    size_t live = 0;
+    for (int i = 0; i < s->count; i++) live += wordBytes(s, i);
+
+    StrArena fresh = {0};
+    fresh.data = malloc(live > 0 ? live : 1);
+    if (!fresh.data) return;
+    fresh.capacity = live > 0 ? live : 1;
+
+    for (int i = 0; i < s->count; i++) {
+        // 讀的是舊字串池、寫的是新字串池，兩邊不會互相干擾
+        Word *w = &s->words[i];
+        int sharedKey = (w->keyOff == w->enOff);
+        const char *key = old + w->keyOff;
+        w->enOff = arenaAdd(&fresh, old + w->enOff);
+        w->cnOff = arenaAdd(&fresh, old + w->cnOff);
+        if (sharedKey) {
+            w->keyOff = w->enOff;
+        } else {
+            w->keyOff = arenaAdd(&fresh, key);
+            arenaAdd(&fresh, key + strlen(key) + 1);
+        }
     }
+    if (!s->strings.borrowed) free(s->strings.data);
+    s->strings = fresh;
 }
 
+/* storeFree：釋放單字庫佔用的所有記憶體（程式結束前呼叫）*/
+void storeFree(WordStore *s) {
+    if (!s->borrowed)         free(s->words);
+    if (!s->strings.borrowed) free(s->strings.data);
+    memset(s, 0, sizeof(*s));
+}
 
-/* ================================================================
-   單字卡學習
-   ================================================================ */
-
-/* showSingleCard：顯示一張單字卡
+/* wordEnglish / wordChinese / wordFolder：取得第 idx 個單字的各個欄位
    -------------------------------------------------------
-   先秀英文，等使用者按 Enter 之後才顯示中文，
-   這樣可以讓使用者先想一下答案再對照。
+   Word 裡存的是位移和編號，不是字串本身，
+   所以寫成小函數把「位移 → 字串」的轉換藏起來，其他地方不用管細節。*/
+const char *wordEnglish(int idx) {
+    return library.strings.data + library.words[idx].enOff;
+}
 
-   參數：
-     idx → 這張單字卡在 library[] 裡的位置（索引）*/
-void showSingleCard(int idx) {
-    printf("----------------------------\n");
-    printf("英文: %s\n", library[idx].english);
-    printf("（按 Enter 查看中文）");
-    getchar(); // 等待使用者按 Enter（讀走那個換行符）
-    printf("中文: %s\n", library[idx].chinese);
+const char *wordChinese(int idx) {
+    return library.strings.data + library.words[idx].cnOff;
 }
 
-/* showAllCards：依序顯示所有單字的單字卡*/
-void showAllCards(void) {
-    printf("\n共 %d 個單字，按 Enter 逐張翻閱...\n", wordCount);
-    for (int i = 0; i < wordCount; i++) {
-        printf("\n[第 %d / %d 張]\n", i + 1, wordCount);
-        showSingleCard(i);
-    }
-    printf("\n===== 學習完畢！=====\n");
+const char *wordFolder(int idx) {
+    return folderName((int)library.words[idx].folderId);
 }
 
-/* showFolderCards：只顯示某個資料夾裡的單字卡
-   -------------------------------------------------------
-   參數：
-     folderIdx → chooseFolder() 回傳的數字（從 1 開始）*/
-void showFolderCards(int folderIdx) {
-    // folderIdx 是 1 開始，但陣列索引從 0 開始，所以要 -1
-    const char *target = folderList[folderIdx - 1];
-    int count = 0;
+/* wordKeyEn / wordKeyCn：第 idx 個單字正規化之後的英文、中文（比對用，不要拿來顯示）
+   中文的 key 一定緊接在英文的 key 後面，所以不用另外存位移。*/
+const char *wordKeyEn(int idx) {
+    return library.strings.data + library.words[idx].keyOff;
+}
 
-    printf("\n資料夾「%s」的單字卡：\n", target);
-    for (int i = 0; i < wordCount; i++) {
-        // strcmp 比較兩個字串是否相同，相同回傳 0
-        if (strcmp(library[i].folder, target) == 0) {
-            printf("\n[第 %d 張]\n", ++count);
-            showSingleCard(i);
+const char *wordKeyCn(int idx) {
+    const char *en = wordKeyEn(idx);
+    return en + strlen(en) + 1;
+}
+
+
+/* ================================================================
+   雜湊索引（Hash Index）
+   ================================================================
+
+   舊版刪除單字、檢查重複時，都要把 library 從頭到尾 strcmp 一遍，
+   一次匯入幾萬個單字，每個都要掃一遍，就變成 O(n²)。
+   有了雜湊表，這些查詢平均只要看一兩格就找到了，是 O(1)。
+   ================================================================ */
+
+/* hashGrow：把雜湊表換成 newCap 格，並把所有還在的東西重新放一次
+   -------------------------------------------------------
+   重新放的時候墓碑就不搬了，所以擴充的同時也順便清掉了墓碑。
+   回傳值：1 = 成功，0 = 記憶體不足（舊的表還是可以用）*/
+static int hashGrow(HashIndex *h, uint32_t newCap) {
+    HashSlot *fresh = malloc((size_t)newCap * sizeof(HashSlot));
+    if (!fresh) return 0;
+    for (uint32_t i = 0; i < newCap; i++) fresh[i].value = HASH_EMPTY;
+
+    uint32_t newMask = newCap - 1;
+    if (h->slots) {
+        for (uint32_t i = 0; i <= h->mask; i++) {
+            if (h->slots[i].value < 0) continue; // 空格和墓碑都不用搬
+            uint32_t pos = h->slots[i].hash & newMask;
+            while (fresh[pos].value != HASH_EMPTY) pos = (pos + 1) & newMask;
+            fresh[pos] = h->slots[i];
         }
     }
+    if (!h->borrowed) free(h->slots);
+    h->borrowed = 0;
+    h->slots = fresh;
+    h->mask  = newMask;
+    h->used  = h->live;
+    return 1;
+}
+
+/* hashInsert：把 (hash, value) 放進雜湊表
+   -------------------------------------------------------
+   同一個 hash 可以放很多次（例如同一個英文在好幾個資料夾），
+   查詢時用 hashNext 一個一個取出來。
+
+   用過的格數超過 3/4 就擴充：太滿的話，找空格要往下走很久，就不是 O(1) 了。*/
+void hashInsert(HashIndex *h, uint32_t hash, int value) {
+    uint32_t cap = h->slots ? h->mask + 1 : 0;
+    if ((uint32_t)(h->used + 1) * 4 > cap * 3) {
+        // 大部分是墓碑的話，同樣大小重建一次就夠了；真的滿了才加倍
+        uint32_t newCap = cap ? cap : HASH_INIT_CAP;
+        while ((uint32_t)(h->live + 1) * 2 > newCap) newCap *= 2;
+        // 記憶體不足又沒有空格可用的話，只好放棄這次插入
+        if (!hashGrow(h, newCap) && (!h->slots || (uint32_t)h->used + 1 >= cap)) return;
+    }
 
-    if (count == 0)
-        printf("這個資料夾目前沒有單字。\n");
-    else
-        printf("\n===== 學習完畢，共 %d 個單字！=====\n", count);
+    uint32_t pos = hash & h->mask;
+    while (h->slots[pos].value >= 0) pos = (pos + 1) & h->mask;
+    if (h->slots[pos].value == HASH_EMPTY) h->used++; // 重複利用墓碑的話 used 不變
+    h->slots[pos].hash  = hash;
+    h->slots[pos].value = value;
+    h->live++;
 }
 
-/* showCard：單字卡學習功能的入口*/
-void showCard(void) {
-    printf("\n===== 單字卡學習模式 =====\n");
-    int choice = chooseFolder();
-    if (choice == -1) return;           // 使用者選擇離開
-    if (choice == 99) showAllCards();   // 全部
-    else              showFolderCards(choice); // 某個資料夾
+/* hashNext：找出下一個雜湊值等於 hash 的東西
+   -------------------------------------------------------
+   用法（找出所有英文是 en 的單字）：
+     uint32_t pos = hash;
+     int idx;
+     while ((idx = hashNext(&englishIndex, hash, &pos)) >= 0) {
+         if (strcmp(wordEnglish(idx), en) == 0) ...
+     }
+   不同的字串也可能算出同樣的 hash（碰撞），所以取出來之後一定還要比對字串。
+
+   參數：
+     pos → 從哪一格開始找；第一次傳入 hash 本身，之後會自動往下移
+
+   回傳值：找到的 value；找完了回傳 -1*/
+int hashNext(const HashIndex *h, uint32_t hash, uint32_t *pos) {
+    if (!h->slots) return -1;
+    uint32_t p = *pos & h->mask;
+    for (uint32_t step = 0; step <= h->mask; step++) {
+        const HashSlot *slot = &h->slots[p];
+        p = (p + 1) & h->mask;
+        if (slot->value == HASH_EMPTY) break;  // 遇到空格就代表後面不會再有了
+        if (slot->value >= 0 && slot->hash == hash) {
+            *pos = p;
+            return slot->value;
+        }
+    }
+    *pos = p;
+    return -1;
+}
+
+/* hashReplace：把 (hash, oldValue) 那一格的 value 換成 newValue
+   -------------------------------------------------------
+   newValue 傳 HASH_TOMB 就等於「刪除」。
+   為什麼不直接把那格設成 HASH_EMPTY？
+   → 後面可能有別的東西是「因為這格被佔了才往下放」的，
+     設成空格的話，查詢走到這裡就會停下來，找不到後面那些東西。*/
+void hashReplace(HashIndex *h, uint32_t hash, int oldValue, int newValue) {
+    if (!h->slots) return;
+    uint32_t p = hash & h->mask;
+    for (uint32_t step = 0; step <= h->mask; step++) {
+        HashSlot *slot = &h->slots[p];
+        if (slot->value == HASH_EMPTY) return;
+        if (slot->hash == hash && slot->value == oldValue) {
+            slot->value = newValue;
+            if (newValue == HASH_TOMB) h->live--;
+            return;
+        }
+        p = (p + 1) & h->mask;
+    }
+}
+
+/* hashFree：釋放雜湊表佔用的記憶體*/
+void hashFree(HashIndex *h) {
+    if (!h->borrowed) free(h->slots);
+    memset(h, 0, sizeof(*h));
+}
+
+/* keyHash：把字串算成 32 位元的雜湊值（用 FNV-1a，再把高低 32 位元混在一起）*/
+uint32_t keyHash(const char *str) {
+    uint64_t h = fnvHash(FNV_OFFSET, str, strlen(str));
+    return (uint32_t)(h ^ (h >> 32));
+}
+
+/* folderKeyHash：把（資料夾編號, 英文）一起算成一個雜湊值*/
+uint32_t folderKeyHash(uint32_t folderId, const char *en) {
+    uint64_t h = fnvHash(FNV_OFFSET, (const char *)&folderId, sizeof(folderId));
+    h = fnvHash(h, en, strlen(en));
+    return (uint32_t)(h ^ (h >> 32));
+}
+
+/* findEnglish：找出英文是 en 的單字（不管在哪個資料夾）
+   比的是正規化之後的 key，所以 APPLE、ａｐｐｌｅ 都會找到 apple。
+   回傳值：單字索引；沒有的話回傳 -1*/
+int findEnglish(const char *en) {
+    char buf[LINE_BUF];
+    char *key = normalizeKey(en, buf, sizeof(buf));
+    if (!key) return -1;
+
+    uint32_t hash = keyHash(key);
+    uint32_t pos  = hash;
+    int idx;
+    while ((idx = hashNext(&englishIndex, hash, &pos)) >= 0) {
+        if (strcmp(wordKeyEn(idx), key) == 0) break;
+    }
+    if (key != buf) free(key);
+    return idx;
+}
+
+/* findInFolder：在某個資料夾裡找英文是 en 的單字
+   -------------------------------------------------------
+   參數：
+     cn → 如果不是 NULL，中文也要一樣才算找到（AddWord 檢查重複用）
+
+   回傳值：單字索引；沒有的話回傳 -1*/
+int findInFolder(int folderId, const char *en, const char *cn) {
+    char enBuf[LINE_BUF], cnBuf[LINE_BUF];
+    char *enKey = normalizeKey(en, enBuf, sizeof(enBuf));
+    char *cnKey = cn ? normalizeKey(cn, cnBuf, sizeof(cnBuf)) : NULL;
+    int idx = -1;
+    if (enKey && (cn == NULL || cnKey)) {
+        uint32_t hash = folderKeyHash((uint32_t)folderId, enKey);
+        uint32_t pos  = hash;
+        while ((idx = hashNext(&folderEnglishIndex, hash, &pos)) >= 0) {
+            if (library.words[idx].folderId == (uint32_t)folderId &&
+                strcmp(wordKeyEn(idx), enKey) == 0 &&
+                (cn == NULL || strcmp(wordKeyCn(idx), cnKey) == 0)) {
+                break;
+            }
+        }
+    }
+    if (enKey && enKey != enBuf) free(enKey);
+    if (cnKey && cnKey != cnBuf) free(cnKey);
+    return idx;
 }
 
 
+
 /* ================================================================
-   測驗功能
+   搜尋索引（片段倒排索引）
    ================================================================ */
 
-/* collectIndices：收集符合條件的單字，把它們在 library[] 的索引存進 result[]
+/* idListPush：在 IdList 最後面加一個索引
+   回傳值：1 = 成功，0 = 記憶體不足*/
+int idListPush(IdList *list, int id) {
+    if (list->count == list->capacity) {
+        int newCap = list->capacity ? list->capacity * 2 : 16;
+        int *p = realloc(list->ids, (size_t)newCap * sizeof(int));
+        if (!p) return 0;
+        list->ids      = p;
+        list->capacity = newCap;
+    }
+    list->ids[list->count++] = id;
+    return 1;
+}
+
+/* utf8Next：從 *p 讀出一個 UTF-8 字元，並把 *p 往後移
    -------------------------------------------------------
-   為什麼用索引而不是直接複製單字資料？
-   → 因為我們之後要修改 errorCount，如果是複製出來的副本，
-     改了不會影響到原本的 library[]，所以必須用索引來操作原本的資料。
+   UTF-8 的規則：第一個 byte 的開頭決定這個字佔幾個 byte
+     0xxxxxxx → 1 byte（英文字母）
+     110xxxxx → 2 bytes
+     1110xxxx → 3 bytes（大部分中文字）
+     11110xxx → 4 bytes
+   格式不對的 byte 就當成一個獨立的字元，至少不會讀超過字串結尾。
+
+   回傳值：字元的 Unicode 編號；讀到字串結尾回傳 0*/
+static uint32_t utf8Next(const char **p) {
+    const unsigned char *s = (const unsigned char *)*p;
+    uint32_t c = s[0];
+    int len = 1;
+    if (c == 0) return 0;
+    if      (c >= 0xF0 && (s[1] & 0xC0) == 0x80 && (s[2] & 0xC0) == 0x80 && (s[3] & 0xC0) == 0x80) {
+        c = ((c & 0x07) << 18) | ((s[1] & 0x3Fu) << 12) | ((s[2] & 0x3Fu) << 6) | (s[3] & 0x3Fu);
+        len = 4;
+    } else if (c >= 0xE0 && (s[1] & 0xC0) == 0x80 && (s[2] & 0xC0) == 0x80) {
+        c = ((c & 0x0F) << 12) | ((s[1] & 0x3Fu) << 6) | (s[2] & 0x3Fu);
+        len = 3;
+    } else if (c >= 0xC0 && (s[1] & 0xC0) == 0x80) {
+        c = ((c & 0x1F) << 6) | (s[1] & 0x3Fu);
+        len = 2;
+    }
+    *p += len;
+    return c;
+}
+
+/* gramKey：把 1~3 個字元編成一個片段整數（沒用到的字元傳 0）*/
+static uint64_t gramKey(uint64_t field, uint32_t a, uint32_t b, uint32_t c) {
+    return (field << 63) | ((uint64_t)a << 42) | ((uint64_t)b << 21) | c;
+}
 
+/* gramPush：把一個片段放進暫存區 k
+   回傳值：1 = 成功，0 = 記憶體不足*/
+static int gramPush(GramKeys *k, int *n, uint64_t key) {
+    if (*n == k->cap) {
+        int newCap = k->cap ? k->cap * 2 : 64;
+        uint64_t *p = realloc(k->keys, (size_t)newCap * sizeof(uint64_t));
+        if (!p) return 0;
+        k->keys = p;
+        k->cap  = newCap;
+    }
+    k->keys[(*n)++] = key;
+    return 1;
+}
+
+/* gramCollect：把一個字串拆成片段，放進暫存區 k
+   -------------------------------------------------------
    參數：
-     folder → 要篩選哪個資料夾；傳入 NULL 代表「全部都要」
-     result → 由呼叫者提供的陣列，用來存結果
+     str      → 要拆的字串
+     field    → GRAM_EN（拆 2~3 個字的片段）或 GRAM_CN（拆 1~2 個字的片段）
+     anchored → 1 = 字串前面加一個「開頭」記號（建索引、前綴查詢用）；
+                0 = 不加（子字串查詢用，因為要找的東西不一定在開頭）
+
+   回傳值：拆出幾個片段（同一個片段可能重複出現，例如 banana 的 an）*/
+static int gramCollect(GramKeys *k, const char *str, uint64_t field, int anchored) {
+    int n = 0;
+    uint32_t p2 = 0;                          // 前前一個字元（0 = 沒有）
+    uint32_t p1 = anchored ? GRAM_START : 0;  // 前一個字元（0 = 沒有）
+    uint32_t c;
+    while ((c = utf8Next(&str)) != 0) {
+        int ok = 1;
+        if (field == GRAM_CN) {
+            ok = ok && gramPush(k, &n, gramKey(field, c, 0, 0));
+        }
+        if (p1) {
+            ok = ok && gramPush(k, &n, gramKey(field, p1, c, 0));
+        }
+        if (field == GRAM_EN && p2) {
+            ok = ok && gramPush(k, &n, gramKey(field, p2, p1, c));
+        }
+        if (!ok) break; // 記憶體不足，能拆多少算多少
+        p2 = p1;
+        p1 = c;
+    }
+    return n;
+}
 
-   回傳值：符合條件的單字數量*/
-int collectIndices(const char *folder, int result[]) {
-    int count = 0;
-    for (int i = 0; i < wordCount; i++) {
-        // folder == NULL 代表不篩選，全部收集
-        if (folder == NULL || strcmp(library[i].folder, folder) == 0) {
-            result[count] = i; // 把索引 i 存進結果陣列
-            count++;
+/* gramHash：把片段整數打散成 32 位元雜湊值（乘上黃金比例常數，再取高位）*/
+static uint32_t gramHash(uint64_t key) {
+    return (uint32_t)((key * 0x9E3779B97F4A7C15ULL) >> 32);
+}
+
+/* gramFind：找出某個片段的單字清單；沒有這個片段回傳 NULL*/
+static Posting *gramFind(GramIndex *g, uint64_t key) {
+    uint32_t hash = gramHash(key);
+    uint32_t pos  = hash;
+    int id;
+    while ((id = hashNext(&g->lookup, hash, &pos)) >= 0) {
+        if (g->lists[id].key == key) return &g->lists[id];
+    }
+    return NULL;
+}
+
+/* gramGet：找出某個片段的單字清單；還沒有的話就新建一個*/
+static Posting *gramGet(GramIndex *g, uint64_t key) {
+    Posting *p = gramFind(g, key);
+    if (p) return p;
+
+    if (g->count == g->capacity) {
+        int newCap = g->capacity ? g->capacity * 2 : 1024;
+        Posting *q = realloc(g->lists, (size_t)newCap * sizeof(Posting)); // gramThaw 之後一定是自己的
+        if (!q) return NULL;
+        g->lists    = q;
+        g->capacity = newCap;
+    }
+    p = &g->lists[g->count];
+    memset(p, 0, sizeof(*p));
+    p->key = key;
+    hashInsert(&g->lookup, gramHash(key), g->count);
+    g->count++;
+    return p;
+}
+
+/* gramThaw：如果 lists 和 pool 是借來的（指向快照檔），先複製一份成自己的
+   回傳值：1 = 可以開始修改了，0 = 記憶體不足*/
+static int gramThaw(GramIndex *g) {
+    if (!g->borrowed) return 1;
+    Posting *lists = malloc((size_t)(g->capacity > 0 ? g->capacity : 1) * sizeof(Posting));
+    int32_t *pool  = malloc((size_t)(g->poolCap > 0 ? g->poolCap : 1) * sizeof(int32_t));
+    if (!lists || !pool) {
+        free(lists);
+        free(pool);
+        return 0;
+    }
+    if (g->count > 0)   memcpy(lists, g->lists, (size_t)g->count * sizeof(Posting));
+    if (g->poolUsed > 0) memcpy(pool, g->pool, (size_t)g->poolUsed * sizeof(int32_t));
+    g->lists    = lists;
+    g->pool     = pool;
+    g->borrowed = 0;
+    return 1;
+}
+
+/* gramCompact：重建 pool，把搬家留下的垃圾清掉
+   （每個清單的空間縮到剛好裝得下，之後要再長大時會自動搬到 pool 最後面）*/
+static void gramCompact(GramIndex *g) {
+    uint32_t live = 0;
+    for (int i = 0; i < g->count; i++) live += (uint32_t)g->lists[i].count;
+
+    int32_t *fresh = malloc((size_t)(live > 0 ? live : 1) * sizeof(int32_t));
+    if (!fresh) return;
+    uint32_t used = 0;
+    for (int i = 0; i < g->count; i++) {
+        Posting *p = &g->lists[i];
+        memcpy(fresh + used, g->pool + p->off, (size_t)p->count * sizeof(int32_t));
+        p->off      = used;
+        p->capacity = p->count;
+        used += (uint32_t)p->count;
+    }
+    free(g->pool);
+    g->pool        = fresh;
+    g->poolUsed    = used;
+    g->poolCap     = live > 0 ? live : 1;
+    g->poolGarbage = 0;
+}
+
+/* postingPush：在某個片段的清單最後面加一個單字索引
+   回傳值：1 = 成功，0 = 記憶體不足*/
+static int postingPush(GramIndex *g, Posting *p, int idx) {
+    if (p->count == p->capacity) {
+        uint32_t oldCap = (uint32_t)p->capacity;
+        uint32_t newCap = oldCap ? oldCap * 2 : 4;
+
+        if (oldCap > 0 && p->off + oldCap == g->poolUsed && g->poolUsed + (newCap - oldCap) <= g->poolCap) {
+            // 這個清單剛好是 pool 的最後一塊，後面還有空間，直接往後延伸就好
+            g->poolUsed += newCap - oldCap;
+        } else {
+            if (g->poolUsed + newCap > g->poolCap) {
+                uint32_t cap = g->poolCap ? g->poolCap : 4096;
+                while (cap < g->poolUsed + newCap) cap *= 2;
+                int32_t *q = realloc(g->pool, (size_t)cap * sizeof(int32_t));
+                if (!q) return 0;
+                g->pool    = q;
+                g->poolCap = cap;
+            }
+            // 搬到 pool 最後面，舊的那塊變成垃圾
+            memcpy(g->pool + g->poolUsed, g->pool + p->off, (size_t)p->count * sizeof(int32_t));
+            g->poolGarbage += oldCap;
+            p->off = g->poolUsed;
+            g->poolUsed += newCap;
         }
+        p->capacity = (int32_t)newCap;
     }
-    return count;
+    g->pool[p->off + (uint32_t)p->count++] = idx;
+
+    if (g->poolGarbage > 4096 && g->poolGarbage > g->poolUsed / 2) gramCompact(g);
+    return 1;
 }
 
-/* askQuestion：出一道題目，讀取使用者的答案，判斷對錯
+/* gramIndexAdd：把第 idx 個單字的英文、中文片段都加進索引*/
+void gramIndexAdd(GramIndex *g, int idx, const char *en, const char *cn) {
+    if (!gramThaw(g)) return;
+    const char *fields[2] = { en, cn };
+    for (int f = 0; f < 2; f++) {
+        int n = gramCollect(&g->scratch, fields[f], f == 0 ? GRAM_EN : GRAM_CN, 1);
+        for (int i = 0; i < n; i++) {
+            Posting *p = gramGet(g, g->scratch.keys[i]);
+            if (!p) continue;
+            // 同一個單字的片段是連續加進來的，所以重複的片段一定會看到清單最後一個就是自己
+            if (p->count > 0 && g->pool[p->off + (uint32_t)p->count - 1] == idx) continue;
+            postingPush(g, p, idx);
+        }
+    }
+}
+
+/* gramIndexRemove：把第 idx 個單字從它所有片段的清單裡拿掉
+   （清單不需要排序，所以找到之後用最後一個蓋掉就好）*/
+void gramIndexRemove(GramIndex *g, int idx, const char *en, const char *cn) {
+    const char *fields[2] = { en, cn };
+    for (int f = 0; f < 2; f++) {
+        int n = gramCollect(&g->scratch, fields[f], f == 0 ? GRAM_EN : GRAM_CN, 1);
+        for (int i = 0; i < n; i++) {
+            Posting *p = gramFind(g, g->scratch.keys[i]);
+            if (!p) continue;
+            int32_t *ids = g->pool + p->off;
+            for (int k = 0; k < p->count; k++) {
+                if (ids[k] == idx) {
+                    ids[k] = ids[--p->count];
+                    break;
+                }
+            }
+        }
+    }
+}
+
+/* gramIndexMove：單字從索引 from 搬到 to 了（libraryRemove 把最後一個單字補進空格時）*/
+void gramIndexMove(GramIndex *g, int from, int to, const char *en, const char *cn) {
+    const char *fields[2] = { en, cn };
+    for (int f = 0; f < 2; f++) {
+        int n = gramCollect(&g->scratch, fields[f], f == 0 ? GRAM_EN : GRAM_CN, 1);
+        for (int i = 0; i < n; i++) {
+            Posting *p = gramFind(g, g->scratch.keys[i]);
+            if (!p) continue;
+            int32_t *ids = g->pool + p->off;
+            for (int k = 0; k < p->count; k++) {
+                if (ids[k] == from) {
+                    ids[k] = to;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+/* gramCandidates：找出查詢字串「最少單字含有」的那個片段的清單
    -------------------------------------------------------
-   為什麼 score 要用「指標（*score）」而不是直接傳整數？
-   → C 語言函數的參數是「複製一份」傳進來的，
-     如果直接傳 score 這個整數，在函數裡改它，
-     改的是「複製品」，不會影響呼叫者的 score。
-   → 傳指標（&score）相當於傳「score 的地址」，
-     這樣函數就能直接到那個地址去修改它。
+   要符合查詢，單字一定要含有查詢字串的「每一個」片段，
+   所以挑清單最短的那個來一一確認就夠了，其他片段不用看。
+
+   回傳值：
+     找到 → 那個片段的清單
+     NULL → 查詢字串太短，拆不出任何片段（*noGram 會設成 1，呼叫者要改用逐一比對）
+            或是某個片段完全沒有單字含有（*noGram 設成 0，代表一定找不到）*/
+static Posting *gramCandidates(GramIndex *g, GramKeys *keys, const char *key, uint64_t field,
+                               int anchored, int *noGram) {
+    int n = gramCollect(keys, key, field, anchored);
+    *noGram = (n == 0);
+    Posting *best = NULL;
+    for (int i = 0; i < n; i++) {
+        Posting *p = gramFind(g, keys->keys[i]);
+        if (!p || p->count == 0) return NULL;
+        if (!best || p->count < best->count) best = p;
+    }
+    return best;
+}
+
+/* cmpInt：給 qsort 用的比較函數（由小到大）*/
+static int cmpInt(const void *a, const void *b) {
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+/* gramSearch：用片段索引搜尋英文或中文含有關鍵字的單字
+   -------------------------------------------------------
+   索引和比對用的都是正規化之後的 key（normalizeText），
+   所以 key 也要先轉好；英文、中文用同一個 key 查。
 
    參數：
-     wordIdx → 這題的單字在 library[] 的索引
-     qNum    → 目前是第幾題（顯示用）
-     total   → 總共幾題（顯示用）
-     score   → 分數的指標，答對時 *score 加 1
+     s      → 單字庫（用來確認候選單字是不是真的符合）
+     key    → 正規化之後的關鍵字
+     prefix → 1 = 只找「開頭是」關鍵字的單字（邊打字邊查用）；0 = 任何位置都算
+     out    → 結果放這裡（依照 library 的順序排好、不重複）
+
+   這個函數不會修改索引（查詢的片段放在自己的暫存區 keys），
+   所以沒有人在新增、刪除單字的時候，好幾個執行緒可以同時查詢。
+
+   回傳值：找到幾筆*/
+int gramSearch(GramIndex *g, const WordStore *s, const char *key, int prefix, IdList *out) {
+    uint64_t    started = metricNow();
+    const char *base    = s->strings.data;
+    size_t len = strlen(key);
+    GramKeys keys = {0};
+    out->count = 0;
+
+    for (int f = 0; f < 2; f++) {
+        uint64_t field = (f == 0) ? GRAM_EN : GRAM_CN;
+        int noGram;
+        Posting *cand = gramCandidates(g, &keys, key, field, prefix, &noGram);
+
+        // 查詢字串太短（例如只有一個英文字母）才需要逐一比對，這種情況很少
+        int total = cand ? cand->count : (noGram ? s->count : 0);
+        for (int k = 0; k < total; k++) {
+            int idx = cand ? g->pool[cand->off + (uint32_t)k] : k;
+            const char *text = base + s->words[idx].keyOff;     // 英文的 key
+            if (f == 1) text += strlen(text) + 1;                // 中文的 key 緊接在後面
+            int match = prefix ? (strncmp(text, key, len) == 0) : (strstr(text, key) != NULL);
+            if (match && !idListPush(out, idx)) break;
+        }
+    }
+    free(keys.keys);
+
+    // 排序後去掉重複的（英文、中文都符合的單字會出現兩次），順便恢復 library 的順序
+    // 0 筆時 ids 可能還是 NULL，不能交給 qsort；1 筆本來就不用排
+    if (out->count > 1) {
+        qsort(out->ids, (size_t)out->count, sizeof(int), cmpInt);
+        int unique = 0;
+        for (int i = 0; i < out->count; i++) {
+            if (unique == 0 || out->ids[unique - 1] != out->ids[i]) out->ids[unique++] = out->ids[i];
+        }
+        out->count = unique;
+    }
+    metricRecord(METRIC_SEARCH, started);
+    return out->count;
+}
+
+/* gramIndexFree：釋放片段索引佔用的記憶體*/
+void gramIndexFree(GramIndex *g) {
+    if (!g->borrowed) {
+        free(g->lists);
+        free(g->pool);
+    }
+    free(g->scratch.keys);
+    hashFree(&g->lookup);
+    memset(g, 0, sizeof(*g));
+}
 
-   回傳值：1 = 答對，0 = 答錯*/
-int askQuestion(int wordIdx, int qNum, int total, int *score) {
-    char answer[EN_LEN];
 
-    printf("\n--- 第 %d / %d 題 ---\n", qNum, total);
-    printf("中文：%s\n", library[wordIdx].chinese);
-    printf("請輸入英文單字：");
+/* ================================================================
+   資料夾登錄表
+   ================================================================ */
 
-    // %49s 最多讀 49 個字元（比陣列大小 EN_LEN=50 少 1，留給 '\0'）
-    scanf("%49s", answer);
-    clearInputBuffer(); // 清掉 scanf 後面殘留的換行符
+/* folderFind：找名稱是 name 的資料夾（找不到不會新增）
+   回傳值：資料夾編號；沒有這個資料夾回傳 -1*/
+int folderFind(const char *name) {
+    uint32_t hash = keyHash(name);
+    uint32_t pos  = hash;
+    int id;
+    while ((id = hashNext(&folders.index, hash, &pos)) >= 0) {
+        if (strcmp(folderName(id), name) == 0) return id;
+    }
+    return -1;
+}
 
-    toLowerEN(answer); // 把使用者的答案轉小寫，讓大小寫都算對
+/* folderIntern：取得資料夾的編號，還沒有這個資料夾就新增一個
+   -------------------------------------------------------
+   每次新增單字時都會呼叫，同一個名稱永遠拿到同一個編號，
+   這個編號會存進 Word.folderId。
+   用雜湊表查名稱，不用一個一個 strcmp，資料夾再多也一樣快。
+
+   回傳值：資料夾編號（folders.items 的索引）；記憶體不足時回傳 -1*/
+int folderIntern(const char *name) {
+    int id = folderFind(name);
+    if (id >= 0) return id; // 已經有了，直接回傳它的編號
+
+    // 沒有的話，加到登錄表最後面
+    uint32_t hash = keyHash(name);
+    if (folders.count == folders.capacity) {
+        int newCap = folders.capacity ? folders.capacity * 2 : 16;
+        Folder *p = realloc(folders.items, (size_t)newCap * sizeof(Folder));
+        if (!p) {
+            printf("[Error] 記憶體不足，無法新增資料夾。\n");
+            return -1;
+        }
+        folders.items    = p;
+        folders.capacity = newCap;
+    }
+    uint32_t off = arenaAdd(&folders.names, name);
+    if (off == UINT32_MAX) {
+        printf("[Error] 記憶體不足，無法新增資料夾。\n");
+        return -1;
+    }
 
-    if (strcmp(answer, library[wordIdx].english) == 0) {
-        (*score)++;   // *score 代表「解開指標，取得它指向的值」，然後 +1
-        printf("✓ 答對了！目前得分：%d / %d\n", *score, qNum);
-        return 1;
-    } else {
-        library[wordIdx].errorCount++; // 直接修改 library[] 裡的資料
-        printf("✗ 答錯了，正確答案是：%s（這題已答錯 %d 次）\n",
-               library[wordIdx].english,
-               library[wordIdx].errorCount);
-        printf("  目前得分：%d / %d\n", *score, qNum);
-        return 0;
+    Folder *f = &folders.items[folders.count];
+    f->nameOff = off;
+    memset(&f->members, 0, sizeof(f->members));
+    hashInsert(&folders.index, hash, folders.count);
+    return folders.count++;
+}
+
+/* folderName：取得資料夾編號 id 的名稱*/
+const char *folderName(int id) {
+    return folders.names.data + folders.items[id].nameOff;
+}
+
+/* folderBuildMembers：掃一遍單字庫，把每個資料夾的 members 建起來
+   只有從快照檔啟動之後第一次用到時會呼叫，之後 libraryAdd / libraryRemove 會隨時更新。
+   回傳值：1 = 成功；0 = 記憶體不足（membersReady 維持 0，下次用到時整個重建，不會相信只建一半的清單）*/
+static int folderBuildMembers(void) {
+    for (int f = 0; f < folders.count; f++) folders.items[f].members.count = 0;
+    for (int i = 0; i < library.count; i++) {
+        if (!idListPush(&folders.items[library.words[i].folderId].members, i)) {
+            printf("[Error] 記憶體不足，無法建立資料夾的單字清單。\n");
+            return 0;
+        }
     }
+    folders.membersReady = 1;
+    return 1;
 }
 
-/* runTest：執行一次完整的測驗流程，顯示最終結果
+/* folderMembers：資料夾 id 裡有哪些單字（索引由小到大）
+   清單建不起來（記憶體不足）時回傳空的清單，下次呼叫會再試一次。*/
+const IdList *folderMembers(int id) {
+    static const IdList none = { NULL, 0, 0 };
+    if (!folders.membersReady && !folderBuildMembers()) return &none;
+    return &folders.items[id].members;
+}
+
+/* memberPos：在排好序的 list 裡找 id 應該在的位置（二分搜尋）*/
+static int memberPos(const IdList *list, int id) {
+    int lo = 0, hi = list->count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (list->ids[mid] < id) lo = mid + 1;
+        else                     hi = mid;
+    }
+    return lo;
+}
+
+/* memberRemove / memberInsert：從排好序的 list 刪掉 / 插入一個索引，保持由小到大*/
+static void memberRemove(IdList *list, int id) {
+    int pos = memberPos(list, id);
+    if (pos == list->count || list->ids[pos] != id) return;
+    memmove(list->ids + pos, list->ids + pos + 1, (size_t)(list->count - pos - 1) * sizeof(int));
+    list->count--;
+}
+
+static void memberInsert(IdList *list, int id) {
+    if (!idListPush(list, id)) {
+        folders.membersReady = 0; // 記憶體不足：先放棄，下次用到時整個重建
+        return;
+    }
+    int pos = memberPos(list, id);
+    memmove(list->ids + pos + 1, list->ids + pos, (size_t)(list->count - 1 - pos) * sizeof(int));
+    list->ids[pos] = id;
+}
+
+/* folderFree：釋放資料夾登錄表（程式結束前呼叫）*/
+void folderFree(void) {
+    for (int f = 0; f < folders.count; f++) free(folders.items[f].members.ids);
+    free(folders.items);
+    if (!folders.names.borrowed) free(folders.names.data);
+    hashFree(&folders.index);
+    memset(&folders, 0, sizeof(folders));
+}
+
+
+/* ================================================================
+   優先順序佇列（錯題排行、複習佇列）
+   ================================================================ */
+
+/* heapMember：單字 idx 要不要放進這個 heap*/
+static int heapMember(const IndexHeap *h, int idx) {
+    const Word *w = &library.words[idx];
+    switch (h->kind) {
+        case HEAP_ERRORS: return w->errorCount > 0;
+        case HEAP_DUE:    return w->review.due != 0;
+        default:          return w->review.due == 0;
+    }
+}
+
+/* heapBefore：在這個 heap 裡，單字 a 是不是應該排在 b 前面
+   一樣的時候都是索引小的在前，每次列出來的順序才會固定。*/
+static int heapBefore(const IndexHeap *h, int a, int b) {
+    const Word *wa = &library.words[a];
+    const Word *wb = &library.words[b];
+    switch (h->kind) {
+        case HEAP_ERRORS:
+            return wa->errorCount > wb->errorCount || (wa->errorCount == wb->errorCount && a < b);
+        case HEAP_DUE:
+            return wa->review.due < wb->review.due || (wa->review.due == wb->review.due && a < b);
+        default:
+            return a < b;
+    }
+}
+
+/* heapSet：把單字 idx 放到 heap 的第 k 格，順便更新 pos*/
+static void heapSet(IndexHeap *h, int k, int idx) {
+    h->heap[k]  = idx;
+    h->pos[idx] = k;
+}
+
+/* heapSiftUp / heapSiftDown：第 k 格的單字往上 / 往下移到正確的位置
    -------------------------------------------------------
-   為什麼要獨立成一個函數？
-   → takeTest（一般測驗）和 takeErrorTest（錯題測驗）的流程幾乎一樣，
-     把共用的部分抽出來，就不用寫兩遍一樣的程式碼。
-   → 這種概念叫做「避免重複（Don't Repeat Yourself）」。
+   heap 存在陣列裡：第 k 格的父節點是 (k-1)/2，子節點是 2k+1 和 2k+2。
+   往上：比父節點「更該排前面」就交換，一直到不用換為止。
+   往下：和兩個子節點裡「比較該排前面」的那個比，它比較前面就交換。
+   樹的高度是 log n，所以最多換 log n 次。*/
+static void heapSiftUp(IndexHeap *h, int k) {
+    int idx = h->heap[k];
+    while (k > 0) {
+        int parent = (k - 1) / 2;
+        if (!heapBefore(h, idx, h->heap[parent])) break;
+        heapSet(h, k, h->heap[parent]);
+        k = parent;
+    }
+    heapSet(h, k, idx);
+}
 
-   參數：
-     indices → 要測驗的單字索引陣列（已經洗牌過）
-     total   → 陣列長度，也就是總題數*/
-void runTest(int indices[], int total) {
-    int score      = 0;
-    int wrongList[WORD_MAX]; // 記錄這次答錯的單字索引
-    int wrongCount = 0;
+static void heapSiftDown(IndexHeap *h, int k) {
+    int idx = h->heap[k];
+    for (;;) {
+        int child = 2 * k + 1;
+        if (child >= h->count) break;
+        if (child + 1 < h->count && heapBefore(h, h->heap[child + 1], h->heap[child])) {
+            child++;
+        }
+        if (!heapBefore(h, h->heap[child], idx)) break;
+        heapSet(h, k, h->heap[child]);
+        k = child;
+    }
+    heapSet(h, k, idx);
+}
 
-    for (int i = 0; i < total; i++) {
-        if (!askQuestion(indices[i], i + 1, total, &score)) {
-            // askQuestion 回傳 0 表示答錯
-            wrongList[wrongCount] = indices[i];
-            wrongCount++;
+/* heapReserve：確保 heap 和 pos 放得下 n 個單字（新的 pos 都設成 -1）
+   回傳值：1 = 成功，0 = 記憶體不足*/
+static int heapReserve(IndexHeap *h, int n) {
+    if (n <= h->capacity) return 1;
+    int newCap = h->capacity ? h->capacity : 256;
+    while (newCap < n) newCap *= 2;
+    int32_t *p = realloc(h->heap, (size_t)newCap * sizeof(int32_t));
+    if (!p) return 0;
+    h->heap = p;
+    p = realloc(h->pos, (size_t)newCap * sizeof(int32_t));
+    if (!p) return 0;
+    for (int i = h->capacity; i < newCap; i++) p[i] = -1;
+    h->pos      = p;
+    h->capacity = newCap;
+    return 1;
+}
+
+/* heapBuild：把所有該放進來的單字一次建成 heap
+   -------------------------------------------------------
+   從最後一個有子節點的位置開始往前，每格都 heapSiftDown 一次，
+   整體只要 O(n)，比一個一個插入的 O(n log n) 快。*/
+static int heapBuild(IndexHeap *h) {
+    if (!heapReserve(h, library.count > 0 ? library.count : 1)) return 0;
+    h->count = 0;
+    for (int i = 0; i < library.count; i++) {
+        h->pos[i] = -1;
+        if (heapMember(h, i)) heapSet(h, h->count++, i);
+    }
+    for (int k = h->count / 2 - 1; k >= 0; k--) heapSiftDown(h, k);
+    h->ready = 1;
+    return 1;
+}
+
+/* heapRemoveAt：把 heap 第 k 格的單字拿掉（用最後一格補上，再調整它的位置）*/
+static void heapRemoveAt(IndexHeap *h, int k) {
+    h->pos[h->heap[k]] = -1;
+    h->count--;
+    if (k == h->count) return;
+    int moved = h->heap[h->count];
+    heapSet(h, k, moved);
+    heapSiftUp(h, k);
+    heapSiftDown(h, h->pos[moved]);
+}
+
+/* heapUpdate：第 idx 個單字的資料改變了，調整它在 heap 的位置
+   -------------------------------------------------------
+   → 該放進來但不在 heap：放到最後面再往上調整
+   → 不該放進來但還在 heap：拿掉
+   → 本來就在 heap：往上、往下各調整一次（只有一個方向會真的移動）*/
+void heapUpdate(IndexHeap *h, int idx) {
+    if (!h->ready) return; // 還沒建，等第一次用到時再整個建
+    if (!heapReserve(h, idx + 1)) { h->ready = 0; return; }
+
+    int k = h->pos[idx];
+    if (heapMember(h, idx)) {
+        if (k < 0) {
+            k = h->count++;
+            heapSet(h, k, idx);
         }
+        heapSiftUp(h, k);
+        heapSiftDown(h, h->pos[idx]);
+    } else if (k >= 0) {
+        heapRemoveAt(h, k);
     }
+}
 
-    // 顯示最終結果
-    printf("\n===== 測驗結束 =====\n");
-    // (double) 是強制型別轉換，讓除法結果是小數而不是整數
-    printf("最終得分：%d / %d（正確率 %.0f%%）\n",
-           score, total, (double)score / total * 100);
+/* heapAdd：第 idx 個單字剛新增（這格的 pos 可能是刪掉的舊單字留下的，要先清掉）*/
+static void heapAdd(IndexHeap *h, int idx) {
+    if (h->ready && idx < h->capacity) h->pos[idx] = -1;
+    heapUpdate(h, idx);
+}
 
-    if (wrongCount > 0) {
-        printf("\n這次答錯的單字（共 %d 個）：\n", wrongCount);
-        for (int i = 0; i < wrongCount; i++) {
-            printf("  ✗  %-20s %s\n",
-                   library[wrongList[i]].english,
-                   library[wrongList[i]].chinese);
+/* heapForget：第 idx 個單字要被刪除了，而最後一個單字（last）會搬到 idx
+   -------------------------------------------------------
+   要在 storeRemove 之前呼叫：先把 idx 拿掉，
+   再把 last 在 heap 裡的索引改成 idx（位置先不動，storeRemove 之後再 heapUpdate 調整）。*/
+static void heapForget(IndexHeap *h, int idx, int last) {
+    if (!h->ready) return;
+    if (h->pos[idx] >= 0) heapRemoveAt(h, h->pos[idx]);
+    if (idx != last && h->pos[last] >= 0) {
+        heapSet(h, h->pos[last], idx);
+        h->pos[last] = -1;
+    }
+}
+
+/* heapCount：heap 裡有幾個單字*/
+int heapCount(IndexHeap *h) {
+    if (!h->ready && !heapBuild(h)) return 0;
+    return h->count;
+}
+
+/* heapTop：依照順序取出第 offset+1 名到第 offset+k 名（分頁用）
+   -------------------------------------------------------
+   不用把整個 heap 排序：另外準備一個小的「候選 heap」，一開始只放 heap 的根（第 1 名），
+   每拿出一個，就把它在 heap 裡的兩個子節點放進候選（下一名一定在候選裡面）。
+   拿 m 個只要 O(m log m)，和單字庫有多大無關。
+
+   參數：
+     offset → 要跳過前面幾名（第一頁傳 0）
+     k      → 最多取幾個
+     out    → 結果（至少 k 格），依照順序排好
+     filter → 篩選條件（NULL = 全部都要）；被跳過的不算名次
+     ctx    → 傳給 filter 的資料
+
+   回傳值：實際取出幾個*/
+int heapTop(IndexHeap *h, int offset, int k, int out[], HeapFilter filter, const void *ctx) {
+    int total = heapCount(h);
+    if (offset < 0 || k <= 0 || offset >= total) return 0;
+
+    // 候選 heap 存的是「heap 裡的位置」，每拿一個最多多兩個
+    int cap = offset + k + 1;
+    int *cand = malloc((size_t)cap * sizeof(int));
+    if (!cand) return 0;
+    int n = 0, rank = 0, got = 0;
+    cand[n++] = 0;
+
+    while (n > 0 && got < k) {
+        // 拿出候選裡排最前面的（cand[0]），用最後一個補上再往下調整
+        int top  = cand[0];
+        int last = cand[--n];
+        int c = 0;
+        for (;;) {
+            int child = 2 * c + 1;
+            if (child >= n) break;
+            if (child + 1 < n && heapBefore(h, h->heap[cand[child + 1]], h->heap[cand[child]])) child++;
+            if (!heapBefore(h, h->heap[cand[child]], h->heap[last])) break;
+            cand[c] = cand[child];
+            c = child;
+        }
+        if (n > 0) cand[c] = last;
+
+        int pass = filter ? filter(h->heap[top], ctx) : 1;
+        if (pass < 0) break;
+        if (pass > 0 && rank++ >= offset) out[got++] = h->heap[top];
+
+        // 把 top 的兩個子節點放進候選（往上調整）
+        for (int child = 2 * top + 1; child <= 2 * top + 2 && child < h->count; child++) {
+            if (n == cap) {
+                int *p = realloc(cand, (size_t)cap * 2 * sizeof(int));
+                if (!p) { n = 0; break; }
+                cand = p;
+                cap *= 2;
+            }
+            int j = n++;
+            while (j > 0 && heapBefore(h, h->heap[child], h->heap[cand[(j - 1) / 2]])) {
+                cand[j] = cand[(j - 1) / 2];
+                j = (j - 1) / 2;
+            }
+            cand[j] = child;
         }
+    }
+    free(cand);
+    return got;
+}
+
+/* heapCollect：把 heap 裡所有單字的索引放進 out（不排序）
+   回傳值：幾個單字*/
+int heapCollect(IndexHeap *h, int out[]) {
+    int total = heapCount(h);
+    memcpy(out, h->heap, (size_t)total * sizeof(int));
+    return total;
+}
+
+/* heapFree：釋放 heap（程式結束前呼叫；kind 保留，之後還能再用）*/
+void heapFree(IndexHeap *h) {
+    free(h->heap);
+    free(h->pos);
+    h->heap     = NULL;
+    h->pos      = NULL;
+    h->count    = 0;
+    h->capacity = 0;
+    h->ready    = 0;
+}
+
+
+/* ================================================================
+   複習排程（SM-2 間隔重複法）
+   ================================================================ */
+
+/* nowMinutes：現在時間（從 1970 年起算的分鐘數）*/
+uint32_t nowMinutes(void) {
+    return (uint32_t)(time(NULL) / 60);
+}
+
+/* reviewIsDefault：這個排程是不是還沒動過（新單字的樣子）
+   存檔時只有動過的才要多寫幾欄，舊格式的檔案不會平白變大。*/
+int reviewIsDefault(const Review *r) {
+    return r->due == 0 && r->lastReview == 0 && r->interval == 0 &&
+           r->ease == SM2_EASE_INIT && r->reps == 0 && r->lapses == 0;
+}
+
+/* reviewSchedule：依照這次答對或答錯，算出下次什麼時候要複習
+   -------------------------------------------------------
+   SM-2 的規則（答對算 4 分、答錯算 2 分，滿分 5 分）：
+   → 答對：第 1 次隔 1 天、第 2 次隔 6 天，之後每次是「上次間隔 × 難易係數」
+   → 答錯：連續答對次數歸零，RELEARN_MINUTES 分鐘後再考一次
+   → 難易係數 EF' = EF + (0.1 - (5-q) × (0.08 + (5-q) × 0.02))，最低 1.3
+     答對（q=4）不變，答錯（q=2）減少 0.32，所以常錯的字間隔拉長得比較慢。
+
+   參數：
+     r       → 要更新的排程
+     correct → 1 = 答對，0 = 答錯
+     now     → 現在時間（nowMinutes）*/
+void reviewSchedule(Review *r, int correct, uint32_t now) {
+    int q = correct ? 4 : 2;
+    int ease = r->ease + (10 - (5 - q) * (8 + (5 - q) * 2)); // 全部 ×100，避免浮點數誤差
+    r->ease = (uint16_t)(ease < SM2_EASE_MIN ? SM2_EASE_MIN : ease);
+
+    if (correct) {
+        uint32_t interval;
+        if (r->reps == 0)      interval = 1;
+        else if (r->reps == 1) interval = 6;
+        else                   interval = ((uint32_t)r->interval * r->ease + 50) / 100;
+        if (interval < 1) interval = 1;
+        if (interval > SM2_INTERVAL_MAX) interval = SM2_INTERVAL_MAX;
+        r->interval = (uint16_t)interval;
+        if (r->reps < UINT16_MAX) r->reps++;
+        r->due = now + interval * 24 * 60;
     } else {
-        printf("太厲害了！全部答對！\n");
+        if (r->reps > 0 && r->lapses < UINT16_MAX) r->lapses++; // 學會之後又忘了
+        r->reps     = 0;
+        r->interval = 0;
+        r->due      = now + RELEARN_MINUTES;
     }
+    r->lastReview = now;
+}
 
-    saveToFile(); // 把更新後的錯誤次數存回檔案
+/* SessionFilter：buildReviewSession 篩選單字用的條件*/
+typedef struct {
+    int      folderId;  // -1 = 不限資料夾
+    uint32_t now;       // 只要 due <= now 的（新單字不看這個）
+} SessionFilter;
+
+static int sessionAccept(int idx, const void *ctx) {
+    const SessionFilter *f = ctx;
+    const Word *w = &library.words[idx];
+    if (w->review.due > f->now) return -1; // 複習佇列是照到期時間排的，後面的都還沒到期
+    return f->folderId < 0 || (int)w->folderId == f->folderId;
 }
 
-/* takeTest：一般測驗（可選資料夾，隨機出題）*/
-void takeTest(void) {
-    printf("\n===== 單字測驗模式 =====\n");
+/* buildReviewSession：挑出這次測驗要考的單字
+   -------------------------------------------------------
+   先放已經到期的單字（越早到期的越前面、越該複習），
+   還有空位就補上還沒學過的新單字。
+   兩個都是從 heap 直接取前 max 個，O(max log max)，不用把整個單字庫排序。
 
-    int folderChoice = chooseFolder();
-    if (folderChoice == -1) return;
+   參數：
+     folderId → 只挑這個資料夾的單字（-1 = 全部）
+     out      → 結果（至少 max 格）
+     max      → 最多挑幾個
+     dueCount → 回傳其中有幾個是到期的複習（其餘是新單字）
+
+   回傳值：總共挑了幾個*/
+int buildReviewSession(int folderId, int out[], int max, int *dueCount) {
+    SessionFilter f = { folderId, nowMinutes() };
+    int due = heapTop(&dueQueue, 0, max, out, sessionAccept, &f);
+    // 新單字的 due 都是 0，sessionAccept 不會因為時間停下來
+    int added = heapTop(&newQueue, 0, max - due, out + due, sessionAccept, &f);
+    *dueCount = due;
+    return due + added;
+}
+
+
+/* ================================================================
+   亂數與加權抽題
+   ================================================================ */
+
+static uint64_t rotl64(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
 
-    // 選了 99 就是全部，否則取對應資料夾名稱
-    const char *folder = (folderChoice == 99) ? NULL : folderList[folderChoice - 1];
+/* rngInit：用一個 64-bit 的種子設定亂數產生器 r
+   xoshiro 的四個狀態不能全是 0，所以先用 splitmix64 把種子攪散成四個不一樣的數。
+
+   rngInit / rngStep / rngRange 操作的是呼叫者給的 r（伺服器模式每個連線各有一個），
+   rngSeed / rngNext / rngBelow 則是操作全域的 rng，給一般的選單模式用。*/
+void rngInit(Rng *r, uint64_t seed) {
+    for (int i = 0; i < 4; i++) {
+        uint64_t z = (seed += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        r->s[i] = z ^ (z >> 31);
+    }
+}
+
+/* rngStep：產生 r 的下一個 64-bit 亂數（xoshiro256**）*/
+uint64_t rngStep(Rng *r) {
+    uint64_t *s     = r->s;
+    uint64_t result = rotl64(s[1] * 5, 7) * 9;
+    uint64_t t      = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3]  = rotl64(s[3], 45);
+    return result;
+}
+
+/* rngRange：用 r 產生 0 ~ n-1 之間的亂數，每個數的機率完全一樣（n 一定要大於 0）
+   -------------------------------------------------------
+   為什麼不直接 rngStep(r) % n？
+   → 2^64 通常不能被 n 整除，多出來的那一小段會讓小的數字多出現一點點。
+   → 做法是抽到那一小段（小於 threshold = 2^64 mod n）就丟掉重抽，實際上幾乎不會重抽。*/
+uint64_t rngRange(Rng *r, uint64_t n) {
+    uint64_t threshold = (0 - n) % n; // unsigned 的 0 - n 就是 2^64 - n，再 mod n 就是 2^64 mod n
+    uint64_t x;
+    do {
+        x = rngStep(r);
+    } while (x < threshold);
+    return x % n;
+}
+
+/* rngSeed / rngNext / rngBelow：全域 rng 的版本*/
+void rngSeed(uint64_t seed) {
+    rngInit(&rng, seed);
+}
+
+uint64_t rngNext(void) {
+    return rngStep(&rng);
+}
+
+uint64_t rngBelow(uint64_t n) {
+    return rngRange(&rng, n);
+}
+
+/* wordWeight：第 idx 個單字被抽到的權重 = 1 + 錯誤次數 × ERROR_WEIGHT
+   沒錯過的字權重是 1（還是有機會抽到），錯 3 次的字被抽到的機會是它的 10 倍。*/
+static uint64_t wordWeight(int idx) {
+    int err = library.words[idx].errorCount;
+    return 1 + (uint64_t)(err > 0 ? err : 0) * ERROR_WEIGHT;
+}
+
+/* weightReserve：確保 sum 放得下 n 個位置（sum[0] 不用，所以要 n + 1 格）*/
+static int weightReserve(WeightTree *t, int n) {
+    if (n < t->capacity) return 1;
+    int cap = t->capacity ? t->capacity : STORE_INIT_CAP;
+    while (cap <= n) cap *= 2;
+    uint64_t *bigger = realloc(t->sum, (size_t)cap * sizeof(uint64_t));
+    if (!bigger) return 0;
+    t->sum      = bigger;
+    t->capacity = cap;
+    return 1;
+}
+
+/* weightAdd：第 pos 個位置（從 1 開始）的權重加上 delta
+   pos += pos & -pos 是往上找「也包含這個位置」的下一段。
+   要減少權重時 delta 傳 2^64 - x 就好：unsigned 溢位會剛好繞回來，總和還是對的。*/
+static void weightAdd(WeightTree *t, int pos, uint64_t delta) {
+    for (; pos <= t->count; pos += pos & -pos) t->sum[pos] += delta;
+}
+
+/* weightPrefix：前 pos 個位置的權重總和*/
+static uint64_t weightPrefix(const WeightTree *t, int pos) {
+    uint64_t total = 0;
+    for (; pos > 0; pos -= pos & -pos) total += t->sum[pos];
+    return total;
+}
+
+/* weightAt：第 pos 個位置自己的權重*/
+static uint64_t weightAt(const WeightTree *t, int pos) {
+    return weightPrefix(t, pos) - weightPrefix(t, pos - 1);
+}
+
+/* weightPush：在最後面接一個權重是 w 的位置
+   新的 sum[n] 管的是 (n - lowbit(n), n] 這一段，前面那幾個位置的總和用兩個 prefix 相減就有了。*/
+static int weightPush(WeightTree *t, uint64_t w) {
+    if (!weightReserve(t, t->count + 1)) return 0;
+    int n    = ++t->count;
+    t->sum[n] = w + weightPrefix(t, n - 1) - weightPrefix(t, n - (n & -n));
+    return 1;
+}
+
+/* weightBuild：把 n 個單字的權重一次建成 Fenwick tree（O(n)）
+   -------------------------------------------------------
+   先把每格填上自己的權重，再由小到大把每格加進「上一層」那格，就建好了。
+   ids 是 NULL 時，第 i 個位置就是第 i-1 個單字；否則是 ids[i-1] 這個單字。*/
+static int weightBuild(WeightTree *t, const int *ids, int n) {
+    t->count = 0;
+    if (!weightReserve(t, n)) return 0;
+    t->count = n;
+    for (int i = 1; i <= n; i++) t->sum[i] = wordWeight(ids ? ids[i - 1] : i - 1);
+    for (int i = 1; i <= n; i++) {
+        int parent = i + (i & -i);
+        if (parent <= n) t->sum[parent] += t->sum[i];
+    }
+    return 1;
+}
+
+/* weightFind：找出累計權重「超過 r」的第一個位置（r 從 0 算起，回傳的位置從 1 開始）
+   從最大的 2 的次方往下試：整段的總和都不超過 r 就整段跳過，跟二分搜尋一樣是 O(log n)。*/
+static int weightFind(const WeightTree *t, uint64_t r) {
+    int pos  = 0;
+    int step = 1;
+    while (step * 2 <= t->count) step *= 2;
+    for (; step > 0; step /= 2) {
+        if (pos + step <= t->count && t->sum[pos + step] <= r) {
+            pos += step;
+            r   -= t->sum[pos];
+        }
+    }
+    return pos + 1;
+}
+
+/* weightSync：第 idx 個單字的權重變了（錯誤次數改了、或別的單字搬進這格），把 errorWeights 改成最新的*/
+static void weightSync(int idx) {
+    if (!errorWeights.ready) return;
+    weightAdd(&errorWeights, idx + 1, wordWeight(idx) - weightAt(&errorWeights, idx + 1));
+}
+
+/* weightedSample：依照權重從 t 裡抽出最多 k 個「不重複」的位置（存進 out，從 0 開始）
+   -------------------------------------------------------
+   每抽到一個，就先把它的權重暫時扣成 0，下一次就不會再抽到；
+   全部抽完再把權重加回去。整個過程只碰到大約 k × log n 格，跟單字庫多大無關。
+
+   回傳值：實際抽到幾個（位置比 k 少就全部抽完）；-1 = 記憶體不足*/
+static int weightedSample(WeightTree *t, int k, int out[]) {
+    if (k > t->count) k = t->count;
+    if (k <= 0) return 0;
+    uint64_t *taken = malloc((size_t)k * sizeof(uint64_t)); // 抽走的權重，最後要加回去
+    if (!taken) return -1;
+
+    uint64_t total = weightPrefix(t, t->count);
+    int n = 0;
+    while (n < k && total > 0) {
+        int pos  = weightFind(t, rngBelow(total));
+        taken[n] = weightAt(t, pos);
+        weightAdd(t, pos, 0 - taken[n]);
+        total   -= taken[n];
+        out[n++] = pos - 1;
+    }
+    for (int i = 0; i < n; i++) weightAdd(t, out[i] + 1, taken[i]);
+    free(taken);
+    return n;
+}
+
+/* drawWeighted：從 folderId（-1 = 全部單字）裡依照錯誤次數加權，抽出最多 k 個不重複的單字
+   -------------------------------------------------------
+   全部單字就用隨時保持最新的 errorWeights；
+   指定資料夾時，只拿那個資料夾的單字臨時建一棵（O(資料夾大小)），抽完就丟掉。
+
+   回傳值：抽到幾個；-1 = 記憶體不足*/
+int drawWeighted(int folderId, int k, int out[]) {
+    if (folderId < 0) {
+        if (!errorWeights.ready) {
+            if (!weightBuild(&errorWeights, NULL, library.count)) return -1;
+            errorWeights.ready = 1;
+        }
+        return weightedSample(&errorWeights, k, out);
+    }
+
+    const IdList *members = folderMembers(folderId);
+    WeightTree local = {0};
+    int n = -1;
+    if (weightBuild(&local, members->ids, members->count)) {
+        n = weightedSample(&local, k, out);
+        for (int i = 0; i < n; i++) out[i] = members->ids[out[i]]; // 位置換回單字索引
+    }
+    weightFree(&local);
+    return n;
+}
+
+/* weightFree：釋放 Fenwick tree 的記憶體*/
+void weightFree(WeightTree *t) {
+    free(t->sum);
+    memset(t, 0, sizeof(*t));
+}
+
+
+/* ================================================================
+   模糊比對（打錯字、找最接近的單字）
+   ================================================================
+
+   編輯距離：把一個字串改成另一個最少要幾步，每一步可以
+     換掉一個字母（aple → apple 是 1）、多一個、少一個，
+     transpose = 1 時「兩個相鄰字母對調」也只算 1 步（recieve → receive）。
+   打錯字最常見的就是對調，所以判斷「差一點」時會打開；
+   BK-tree 需要三角不等式，對調算 1 步的版本不一定滿足，所以 BK-tree 用一般的版本。*/
+
+/* editPrepare：把 str 預先處理成 EditPattern（str 要在用完 p 之前都有效）*/
+void editPrepare(EditPattern *p, const char *str) {
+    memset(p->peq, 0, sizeof(p->peq));
+    p->str = str;
+    p->len = (int)strlen(str);
+    if (p->len > 64) return; // 太長的字走 editDistanceSlow，用不到 peq
+    for (int i = 0; i < p->len; i++) {
+        p->peq[(unsigned char)str[i]] |= 1ULL << i;
+    }
+}
+
+/* editDistanceSlow：一般的動態規劃（字串超過 64 個 byte 時才用）
+   只保留三列：上上一列（算對調用）、上一列、這一列。*/
+static int editDistanceSlow(const char *a, int la, const char *b, int lb, int limit, int transpose) {
+    int *rows = malloc((size_t)(lb + 1) * 3 * sizeof(int));
+    if (!rows) return limit + 1;
+    int *prev2 = rows, *prev = rows + lb + 1, *cur = rows + 2 * (lb + 1);
+    for (int j = 0; j <= lb; j++) prev[j] = j;
+    for (int i = 1; i <= la; i++) {
+        cur[0] = i;
+        int rowMin = cur[0];
+        for (int j = 1; j <= lb; j++) {
+            int cost = (a[i - 1] != b[j - 1]);
+            int best = prev[j - 1] + cost;
+            if (prev[j] + 1 < best)    best = prev[j] + 1;
+            if (cur[j - 1] + 1 < best) best = cur[j - 1] + 1;
+            if (transpose && i > 1 && j > 1 && a[i - 1] == b[j - 2] && a[i - 2] == b[j - 1] &&
+                prev2[j - 2] + 1 < best) {
+                best = prev2[j - 2] + 1;
+            }
+            cur[j] = best;
+            if (best < rowMin) rowMin = best;
+        }
+        // 距離只會越來越大，這一列最小的都超過 limit 就不用算了
+        if (rowMin > limit && !transpose) { free(rows); return limit + 1; }
+        int *t = prev2; prev2 = prev; prev = cur; cur = t;
+    }
+    int d = prev[lb];
+    free(rows);
+    return d > limit ? limit + 1 : d;
+}
+
+/* editDistanceTo：p 的字串和 b（長度 lb）的編輯距離
+   -------------------------------------------------------
+   Myers（1999）的位元平行演算法，transpose 的部分是 Hyyrö（2003）的延伸：
+   VP / VN 記錄這一欄「往下一格，距離是 +1 還是 -1」，
+   每讀 b 的一個字元，用幾個位元運算就把整欄更新完，score 是最下面那格（整個 p 對到目前的 b）。
+   一整個 answer 大約只要幾十奈秒。
+
+   limit：超過 limit 就不用算準確的值了，直接回傳 limit + 1
+   （剩下的字元每個最多讓距離減 1，score 減掉剩下的長度還超過 limit，就不可能回到 limit 以內）。
+
+   回傳值：編輯距離；超過 limit 時回傳 limit + 1*/
+int editDistanceTo(const EditPattern *p, const char *b, int lb, int limit, int transpose) {
+    int m = p->len;
+    if (m - lb > limit || lb - m > limit) return limit + 1; // 長度差太多，至少要那麼多步
+    if (m == 0) return lb;
+    if (m > 64) return editDistanceSlow(p->str, m, b, lb, limit, transpose);
+
+    uint64_t last   = 1ULL << (m - 1);
+    uint64_t vp     = (m == 64) ? ~0ULL : (1ULL << m) - 1;
+    uint64_t vn     = 0;
+    uint64_t d0     = 0;
+    uint64_t pmPrev = 0;
+    int score = m;
+    for (int j = 0; j < lb; j++) {
+        uint64_t pm = p->peq[(unsigned char)b[j]];
+        uint64_t tr = transpose ? (((~d0) & pm) << 1) & pmPrev : 0;
+        d0 = tr | (((pm & vp) + vp) ^ vp) | pm | vn;
+        uint64_t hp = vn | ~(d0 | vp);
+        uint64_t hn = vp & d0;
+        if (hp & last)      score++;
+        else if (hn & last) score--;
+        uint64_t x = (hp << 1) | 1;
+        vn = x & d0;
+        vp = (hn << 1) | ~(x | d0);
+        pmPrev = pm;
+        if (score - (lb - j - 1) > limit) return limit + 1;
+    }
+    return score > limit ? limit + 1 : score;
+}
+
+/* isNearMiss：answer 是不是 correct 打錯一點點（拼錯、漏字、多字、相鄰兩個字母對調）
+   -------------------------------------------------------
+   容忍幾個錯要看單字長短：cat 打成 car 已經是另一個字了，不能算「差一點」，
+   所以每 TYPO_CHARS_PER_EDIT 個字母才容忍 1 個，最多 typoLimit 個。
+   answer 本身就是單字庫裡的另一個字的話，也不算打錯字（那是真的記錯了）。
+   answer、correct 都要是正規化之後的 key。*/
+int isNearMiss(const char *answer, const char *correct) {
+    int len     = (int)strlen(correct);
+    int allowed = len / TYPO_CHARS_PER_EDIT;
+    if (allowed > typoLimit) allowed = typoLimit;
+    if (allowed <= 0) return 0;
+    if (findEnglish(answer) >= 0) return 0;
+
+    EditPattern p;
+    editPrepare(&p, answer);
+    return editDistanceTo(&p, correct, len, allowed, 1) <= allowed;
+}
+
+/* bkNewNode：新增一個節點（字串複製進 names）*/
+static int bkNewNode(BkTree *t, const char *en, int len, int dist) {
+    if (t->count == t->capacity) {
+        int newCap = t->capacity ? t->capacity * 2 : STORE_INIT_CAP;
+        BkNode *bigger = realloc(t->nodes, (size_t)newCap * sizeof(BkNode));
+        if (!bigger) return -1;
+        t->nodes    = bigger;
+        t->capacity = newCap;
+    }
+    uint32_t off = arenaAdd(&t->names, en);
+    if (off == UINT32_MAX) return -1;
+    BkNode *n = &t->nodes[t->count];
+    n->nameOff     = off;
+    n->len         = len;
+    n->dist        = dist;
+    n->maxChild    = 0;
+    n->refs        = 1;
+    n->firstChild  = -1;
+    n->nextSibling = -1;
+    return t->count++;
+}
+
+/* bkChild：找出 node 底下「邊上距離是 dist」的子節點；沒有的話回傳 -1*/
+static int bkChild(const BkTree *t, int node, int dist) {
+    for (int c = t->nodes[node].firstChild; c >= 0; c = t->nodes[c].nextSibling) {
+        if (t->nodes[c].dist == dist) return c;
+    }
+    return -1;
+}
+
+/* bkInsert：把英文 en 加進樹裡（已經有了就 refs + 1）
+   回傳值：1 = 成功，0 = 記憶體不足*/
+static int bkInsert(BkTree *t, const char *en) {
+    int len = (int)strlen(en);
+    if (t->count == 0) return bkNewNode(t, en, len, 0) >= 0;
+
+    EditPattern p;
+    editPrepare(&p, en);
+    int node = 0;
+    while (1) {
+        BkNode *n = &t->nodes[node];
+        int d = editDistanceTo(&p, t->names.data + n->nameOff, n->len, INT32_MAX - 1, 0);
+        if (d == 0) {
+            if (n->refs++ == 0) t->dead--;
+            return 1;
+        }
+        int child = bkChild(t, node, d);
+        if (child < 0) {
+            child = bkNewNode(t, en, len, d);
+            if (child < 0) return 0;
+            // bkNewNode 可能 realloc 過，不能再用上面的 n
+            t->nodes[child].nextSibling = t->nodes[node].firstChild;
+            t->nodes[node].firstChild   = child;
+            if (d > t->nodes[node].maxChild) t->nodes[node].maxChild = d;
+            return 1;
+        }
+        node = child;
+    }
+}
+
+/* bkBuild：用目前的單字庫重建整棵樹*/
+static int bkBuild(BkTree *t) {
+    bkFree(t);
+    for (int i = 0; i < library.count; i++) {
+        if (!bkInsert(t, wordKeyEn(i))) return 0;
+    }
+    t->ready = 1;
+    return 1;
+}
+
+/* bkForget：單字庫裡少了一個英文是 en 的單字（refs - 1）
+   刪掉的節點超過一半，就等下次用到時整棵重建，不然查詢時一直繞過死掉的節點。*/
+static void bkForget(BkTree *t, const char *en) {
+    if (!t->ready || t->count == 0) return;
+    EditPattern p;
+    editPrepare(&p, en);
+    int node = 0;
+    while (node >= 0) {
+        BkNode *n = &t->nodes[node];
+        int d = editDistanceTo(&p, t->names.data + n->nameOff, n->len, INT32_MAX - 1, 0);
+        if (d == 0) {
+            if (n->refs > 0 && --n->refs == 0) t->dead++;
+            break;
+        }
+        node = bkChild(t, node, d);
+    }
+    if (t->dead * 2 > t->count) t->ready = 0;
+}
+
+/* bkSearch：在樹裡找距離 p 不超過 radius 的英文裡最近的那個
+   -------------------------------------------------------
+   找到一個距離 d 的候選之後，範圍就縮小成 d - 1，越找越快。
+   每個節點的距離只要算到 radius + maxChild 就夠了：超過的話它不是答案，
+   子節點的邊也全都太短、一個都不用找，大部分的葉子節點算到長度差就直接放棄。
+   子節點裡「邊上距離最接近 d」的最可能是答案，所以最後才推進 stack，最先拿出來找。
+
+   回傳值：節點編號；找不到回傳 -1*/
+static int bkSearch(const BkTree *t, const EditPattern *p, int radius, int *distOut) {
+    IdList stack = {0};  // 還沒看過的節點
+    int best = -1;
+    if (!idListPush(&stack, 0)) return -1;
+
+    while (stack.count > 0 && radius >= 0) {
+        const BkNode *n = &t->nodes[stack.ids[--stack.count]];
+        int bound = radius + n->maxChild;
+        int d = editDistanceTo(p, t->names.data + n->nameOff, n->len, bound, 0);
+        if (d > bound) continue;
+        if (n->refs > 0 && d <= radius) {
+            best   = (int)(n - t->nodes);
+            radius = d - 1; // 之後只要找比它更近的
+            *distOut = d;
+        }
+        for (int gap = radius; gap >= 0; gap--) {
+            for (int c = n->firstChild; c >= 0; c = t->nodes[c].nextSibling) {
+                int k = t->nodes[c].dist;
+                if (k == d - gap || k == d + gap) idListPush(&stack, c); // 失敗頂多少找幾個節點
+            }
+        }
+    }
+    free(stack.ids);
+    return best;
+}
+
+/* bkNearest：找出單字庫裡和 word 最接近的英文（編輯距離不超過 limit）
+   -------------------------------------------------------
+   BK-tree 要走幾個節點，跟搜尋半徑很有關係：半徑 1 時每層只要看 3 種邊，
+   半徑 2 就要看 5 種，整棵樹幾乎都要走過一遍。
+   打錯字大部分只差 1 個字母，所以先用半徑 1 找，找不到才放大。
+
+   參數：
+     distOut → 存最接近的距離（不需要就傳 NULL）
+
+   回傳值：最接近的英文（指向 BK-tree 自己的字串，下次新增單字之前都有效）；
+           距離都超過 limit 就回傳 NULL*/
+const char *bkNearest(const char *word, int limit, int *distOut) {
+    if (!headwords.ready && !bkBuild(&headwords)) return NULL;
+    if (headwords.count == 0) return NULL;
+
+    EditPattern p;
+    editPrepare(&p, word);
+    for (int radius = 1; radius <= limit; radius++) {
+        int d;
+        int best = bkSearch(&headwords, &p, radius, &d);
+        if (best >= 0) {
+            if (distOut) *distOut = d;
+            return headwords.names.data + headwords.nodes[best].nameOff;
+        }
+    }
+    return NULL;
+}
+
+/* bkFree：釋放 BK-tree 的記憶體*/
+void bkFree(BkTree *t) {
+    free(t->nodes);
+    free(t->names.data);
+    memset(t, 0, sizeof(*t));
+}
+
+
+/* ================================================================
+   字母順序索引（單字一覽、範圍查詢、單字卡）
+   ================================================================
+
+   library 本身沒有順序：新增的接在最後面，刪除時最後一個會搬到被刪的那一格，
+   所以「照 library 的順序列出來」每刪一個字就會亂掉。
+   要照字母排的話，以前只能每次都整個排序一遍，100 萬個單字要好幾百毫秒。
+
+   這裡維護幾份「排好的單字索引」（SortedIndex）：
+   → alphaOrder：全部照英文排（一樣的英文再照資料夾、中文），給「全部單字」用。
+   → folderAlphaOrder：先照資料夾分開，資料夾裡再照英文排，
+     一個資料夾的單字就是連續的一段，「ch3 裡 a~c 開頭的字」用二分搜尋找出頭尾就好。
+   → folderGlossOrder：資料夾裡照中文排，選擇題找「意思相近的字」用（見「選擇題的干擾選項」）。
+
+   為什麼用排好的陣列，不用 B-tree？
+   → 新增一個字要把後面的往後挪一格（memmove），100 萬個也只是搬 4 MB，
+     一次不到 1 毫秒，和資料夾清單（memberInsert）的做法一樣。
+   → 陣列最大的好處是「第 k 個」直接就是 ids[k]：第 500 頁就是從第 500 × LIST_PAGE 個開始，
+     不用排序、也不用從頭數。
+
+   和其他索引一樣第一次用到才整個排序（sortedBuild），之後 libraryAdd / libraryRemove 順手維護。
+
+   SortCursor：記住「看到哪個字」（資料夾、英文、中文），而不是「看到第幾個」。
+   → 中間有人新增、刪除單字，第幾個就不準了；用字本身當記號，
+     下次用二分搜尋找「排在它後面的第一個字」，一定接得上。
+   ================================================================ */
+
+/* sortKeyCompare：比較兩個單字的排序順序（英文、中文都比正規化過的 key）
+   參數：
+     kind → SORT_ALPHA / SORT_FOLDER / SORT_GLOSS*/
+static int sortKeyCompare(int kind, uint32_t fa, const char *ea, const char *ca,
+                          uint32_t fb, const char *eb, const char *cb) {
+    if (kind != SORT_ALPHA && fa != fb) return fa < fb ? -1 : 1;
+    if (kind == SORT_GLOSS) {
+        int c = strcmp(ca, cb);
+        return c != 0 ? c : strcmp(ea, eb);
+    }
+    int c = strcmp(ea, eb);
+    if (c != 0) return c;
+    if (fa != fb) return fa < fb ? -1 : 1;
+    return strcmp(ca, cb);
+}
+
+/* sortWordCompare：比較第 a 個和第 b 個單字在 s 裡的順序*/
+static int sortWordCompare(const SortedIndex *s, int a, int b) {
+    return sortKeyCompare(s->kind, library.words[a].folderId, wordKeyEn(a), wordKeyCn(a),
+                          library.words[b].folderId, wordKeyEn(b), wordKeyCn(b));
+}
+
+/* sortCmpAlpha / sortCmpFolder / sortCmpGloss：qsort 用的比較函數（qsort 不能多傳參數，所以每種分開寫）*/
+static int sortCmpAlpha(const void *a, const void *b) {
+    return sortWordCompare(&alphaOrder, *(const int *)a, *(const int *)b);
+}
+
+static int sortCmpFolder(const void *a, const void *b) {
+    return sortWordCompare(&folderAlphaOrder, *(const int *)a, *(const int *)b);
+}
+
+static int sortCmpGloss(const void *a, const void *b) {
+    return sortWordCompare(&folderGlossOrder, *(const int *)a, *(const int *)b);
+}
+
+/* sortedBuild：把整個單字庫排好放進 s
+   回傳值：1 = 成功，0 = 記憶體不足*/
+int sortedBuild(SortedIndex *s) {
+    s->list.count = 0;
+    for (int i = 0; i < library.count; i++) {
+        if (!idListPush(&s->list, i)) return 0;
+    }
+    qsort(s->list.ids, (size_t)s->list.count, sizeof(int),
+          s->kind == SORT_GLOSS ? sortCmpGloss : s->kind == SORT_FOLDER ? sortCmpFolder : sortCmpAlpha);
+    s->ready = 1;
+    return 1;
+}
+
+/* sortedBound：在 s 裡找 (folder, en, cn) 應該排在第幾個（二分搜尋）
+   參數：
+     after → 0 = 第一個「>=」它的位置；1 = 第一個「>」它的位置*/
+static int sortedBound(const SortedIndex *s, uint32_t folder, const char *en, const char *cn, int after) {
+    int lo = 0, hi = s->list.count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        int w = s->list.ids[mid];
+        int c = sortKeyCompare(s->kind, library.words[w].folderId, wordKeyEn(w), wordKeyCn(w),
+                               folder, en, cn);
+        if (c < 0 || (after && c == 0)) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+/* sortedPos：第 idx 個單字在 s 的第幾個（一樣的 key 可能有好幾個，要再往後找到 idx 本人）
+   回傳值：位置；找不到回傳 -1*/
+static int sortedPos(const SortedIndex *s, int idx) {
+    const Word *w = &library.words[idx];
+    for (int k = sortedBound(s, w->folderId, wordKeyEn(idx), wordKeyCn(idx), 0); k < s->list.count; k++) {
+        if (s->list.ids[k] == idx) return k;
+        if (sortWordCompare(s, s->list.ids[k], idx) != 0) break;
+    }
+    return -1;
+}
+
+/* sortedAdd：第 idx 個單字剛新增，插到排好的位置（還沒建的話不用管）*/
+void sortedAdd(SortedIndex *s, int idx) {
+    if (!s->ready) return;
+    const Word *w = &library.words[idx];
+    int k = sortedBound(s, w->folderId, wordKeyEn(idx), wordKeyCn(idx), 1); // 要在放進去之前找
+    if (!idListPush(&s->list, idx)) {
+        s->ready = 0; // 記憶體不足：先放棄，下次用到時整個重建
+        return;
+    }
+    int *ids = s->list.ids;
+    memmove(ids + k + 1, ids + k, (size_t)(s->list.count - 1 - k) * sizeof(int));
+    ids[k] = idx;
+}
+
+/* sortedForget：第 idx 個單字要被刪除了，最後一個（last）會搬到 idx（要在 storeRemove 之前呼叫）
+   搬過去的單字內容沒變，排序位置也不變，只要把那一格的索引從 last 改成 idx。*/
+void sortedForget(SortedIndex *s, int idx, int last) {
+    if (!s->ready) return;
+    int k = sortedPos(s, idx);
+    int m = idx != last ? sortedPos(s, last) : -1;
+    if (k < 0 || (idx != last && m < 0)) {
+        s->ready = 0; // 不應該發生：索引和單字庫對不上，下次用到時重建
+        return;
+    }
+    if (m >= 0) s->list.ids[m] = idx;
+    memmove(s->list.ids + k, s->list.ids + k + 1, (size_t)(s->list.count - k - 1) * sizeof(int));
+    s->list.count--;
+}
+
+/* sortedRange：找出某個範圍的單字在排好的順序裡是哪一段
+   -------------------------------------------------------
+   範圍是「英文 >= from，而且 <= to 或是 to 開頭的」，所以 a~c 會包含 cat、cup，
+   from 和 to 都一樣的話就是「這個開頭的字」。兩個都用二分搜尋，不用掃過任何單字：
+   排好之後 to 開頭的字一定緊接在 to 後面，「還在範圍裡」是一段連續的開頭。
+
+   參數：
+     folderId → 資料夾編號；-1 = 全部單字
+     from, to → 範圍（要先正規化過）；空字串 = 不限
+     out      → 成功時設成用到的索引（alphaOrder 或 folderAlphaOrder）
+     first    → 成功時設成這一段從第幾個開始
+
+   回傳值：這一段有幾個單字；記憶體不足回傳 -1*/
+int sortedRange(int folderId, const char *from, const char *to, const SortedIndex **out, int *first) {
+    SortedIndex *s = folderId >= 0 ? &folderAlphaOrder : &alphaOrder;
+    if (!s->ready && !sortedBuild(s)) return -1;
+    uint32_t f = folderId >= 0 ? (uint32_t)folderId : 0;
+    size_t toLen = strlen(to);
+
+    int lo = sortedBound(s, f, from, "", 0);
+    int a = lo, b = s->list.count; // 找第一個「不在範圍裡」的位置
+    while (a < b) {
+        int mid = a + (b - a) / 2;
+        int w = s->list.ids[mid];
+        const char *en = wordKeyEn(w);
+        int inside = (folderId < 0 || library.words[w].folderId == f) &&
+                     (toLen == 0 || strcmp(en, to) <= 0 || strncmp(en, to, toLen) == 0);
+        if (inside) a = mid + 1;
+        else b = mid;
+    }
+    *out   = s;
+    *first = lo;
+    return a - lo;
+}
+
+/* sortedCursorSave：記住「看到第 idx 個單字了」（記憶體不足就記不住，下次從頭開始）*/
+void sortedCursorSave(SortCursor *c, int idx) {
+    size_t enLen = strlen(wordKeyEn(idx)) + 1;
+    size_t cnLen = strlen(wordKeyCn(idx)) + 1;
+    char  *p     = realloc(c->en, enLen + cnLen);
+    if (!p) {
+        c->valid = 0;
+        return;
+    }
+    memcpy(p, wordKeyEn(idx), enLen);
+    memcpy(p + enLen, wordKeyCn(idx), cnLen);
+    c->en       = p;
+    c->cn       = p + enLen;
+    c->folderId = (int)library.words[idx].folderId;
+    c->valid    = 1;
+}
+
+/* sortedCursorNext：c 記住的那個字的「下一個」在 s 的第幾個（那個字被刪掉了也接得上）*/
+int sortedCursorNext(const SortedIndex *s, const SortCursor *c) {
+    return sortedBound(s, (uint32_t)c->folderId, c->en, c->cn, 1);
+}
+
+/* sortedFree：釋放排好的索引（kind 保留，之後還能再用）*/
+void sortedFree(SortedIndex *s) {
+    free(s->list.ids);
+    memset(&s->list, 0, sizeof(s->list));
+    s->ready = 0;
+}
+
+
+/* ================================================================
+   選擇題的干擾選項
+   ================================================================
+
+   選擇題的錯誤選項如果是隨便抽的（「蘋果」的選項是 apple、government、run、blue），
+   看長相就猜得到答案。好的干擾選項要「像」：同一個資料夾、拼法或長度接近、中文意思也沾得上邊。
+
+   怎麼找候選，又不用掃整個單字庫？
+   → 拼法接近的字在 folderAlphaOrder 裡本來就排在附近，
+     中文接近的字在 folderGlossOrder（照資料夾、中文排）裡也排在附近，
+     兩邊都前後各看 DISTRACT_WINDOW 個字；再加上 alphaOrder 的鄰居，資料夾太小時才湊得滿。
+   → 每個候選算一個分數（編輯距離、長度差、有幾個中文字一樣、是不是同資料夾），留最好的 DISTRACT_KEEP 個。
+
+   挑好的存在 distractors 裡：第一次出到這個字才挑，之後出題直接拿，一題只要 O(1)。
+   → 新增單字時，問它附近的字「要不要換成我」（distractOffer）。
+   → 刪除單字時，把它從附近的字的選項裡拿掉；最後一個字搬家的話，附近的字記著它的那一格也改成新位置。
+   → 萬一有漏掉的（例如離得比較遠的字也選了它），tags 對不上就當作空格，
+     剩下的選項不夠的時候再重挑一次。
+   ================================================================ */
+
+/* distractTag：第 idx 個單字的記號（資料夾 + 英文），用來確認某一格還是當初挑的那個字*/
+static uint32_t distractTag(int idx) {
+    return folderKeyHash(library.words[idx].folderId, wordKeyEn(idx));
+}
+
+/* glossShared：中文 a 的前 DISTRACT_GLOSS 個中文字有幾個也出現在 b 裡（標點、英文不算）*/
+static int glossShared(const char *a, const char *b) {
+    uint32_t mine[DISTRACT_GLOSS];
+    uint32_t c;
+    int n = 0, shared = 0;
+    while (n < DISTRACT_GLOSS && (c = utf8Next(&a)) != 0) {
+        if (c >= 0x80) mine[n++] = c;
+    }
+    while (shared < n && (c = utf8Next(&b)) != 0) {
+        for (int k = 0; k < n; k++) {
+            if (mine[k] == c) {
+                mine[k] = 0; // 一個字只算一次
+                shared++;
+                break;
+            }
+        }
+    }
+    return shared;
+}
+
+/* distractScore：候選 c 當第 q 個單字的干擾選項有多「像」（越小越像）
+   參數：
+     p → 先用 editPrepare 處理好的 q 的英文 key
+   回傳值：分數；c 不能當選項（就是 q、英文一樣、中文一樣）回傳 -1*/
+static int distractScore(const EditPattern *p, int q, int c) {
+    const char *en = wordKeyEn(c);
+    if (c == q || strcmp(en, p->str) == 0 || strcmp(wordKeyCn(c), wordKeyCn(q)) == 0) return -1;
+    int len  = (int)strlen(en);
+    int dist = editDistanceTo(p, en, len, DISTRACT_FAR, 0);
+    int score = dist * 2 + abs(len - p->len)
+              + (DISTRACT_GLOSS - glossShared(wordKeyCn(q), wordKeyCn(c))) * 3;
+    if (library.words[c].folderId != library.words[q].folderId) score += DISTRACT_FAR * 4;
+    return score;
+}
+
+/* distractCandidates：第 idx 個單字在三份字母順序索引裡的鄰居（不重複）
+   回傳值：幾個，放在 out[]（至少 DISTRACT_CANDIDATES 格）*/
+static int distractCandidates(int idx, int out[]) {
+    const SortedIndex *orders[] = { &folderAlphaOrder, &folderGlossOrder, &alphaOrder };
+    int n = 0;
+    for (int o = 0; o < 3; o++) {
+        const SortedIndex *s = orders[o];
+        int k = s->ready ? sortedPos(s, idx) : -1;
+        if (k < 0) continue;
+        int lo = k - DISTRACT_WINDOW > 0 ? k - DISTRACT_WINDOW : 0;
+        int hi = k + DISTRACT_WINDOW < s->list.count - 1 ? k + DISTRACT_WINDOW : s->list.count - 1;
+        for (int j = lo; j <= hi; j++) {
+            int c = s->list.ids[j], dup = (j == k);
+            for (int m = 0; m < n && !dup; m++) dup = (out[m] == c);
+            if (!dup) out[n++] = c;
+        }
+    }
+    return n;
+}
+
+/* distractReserve：確定 distractors 放得下 count 個單字，新的格子都是「還沒挑過」
+   回傳值：1 = 成功，0 = 記憶體不足*/
+static int distractReserve(int count) {
+    if (count <= distractors.capacity) return 1;
+    int newCap = distractors.capacity ? distractors.capacity : 64;
+    while (newCap < count) newCap *= 2;
+    int32_t  *ids  = realloc(distractors.ids,  (size_t)newCap * DISTRACT_KEEP * sizeof(int32_t));
+    if (ids) distractors.ids = ids;
+    uint32_t *tags = realloc(distractors.tags, (size_t)newCap * DISTRACT_KEEP * sizeof(uint32_t));
+    if (tags) distractors.tags = tags;
+    if (!ids || !tags) return 0;
+    for (size_t i = (size_t)distractors.capacity * DISTRACT_KEEP; i < (size_t)newCap * DISTRACT_KEEP; i++) {
+        ids[i] = DISTRACT_UNSET;
+    }
+    distractors.capacity = newCap;
+    return 1;
+}
+
+/* distractValid：第 q 個單字的第 j 格還是當初挑的那個字嗎？*/
+static int distractValid(int q, int j) {
+    int32_t c = distractors.ids[(size_t)q * DISTRACT_KEEP + j];
+    return c >= 0 && c < library.count && c != q && distractors.tags[(size_t)q * DISTRACT_KEEP + j] == distractTag(c);
+}
+
+/* distractFill：幫第 q 個單字挑干擾選項（從鄰居裡留分數最好的 DISTRACT_KEEP 個）*/
+static void distractFill(int q) {
+    int cand[DISTRACT_CANDIDATES];
+    int n = distractCandidates(q, cand);
+    EditPattern p;
+    editPrepare(&p, wordKeyEn(q));
+
+    int best[DISTRACT_KEEP], bestScore[DISTRACT_KEEP], kept = 0;
+    for (int i = 0; i < n; i++) {
+        int score = distractScore(&p, q, cand[i]);
+        if (score < 0 || (kept == DISTRACT_KEEP && score >= bestScore[kept - 1])) continue;
+        // 照分數插進去（只有幾格，直接往後挪）
+        int k = kept < DISTRACT_KEEP ? kept++ : DISTRACT_KEEP - 1;
+        while (k > 0 && bestScore[k - 1] > score) {
+            best[k]      = best[k - 1];
+            bestScore[k] = bestScore[k - 1];
+            k--;
+        }
+        best[k]      = cand[i];
+        bestScore[k] = score;
+    }
+    int32_t  *ids  = distractors.ids  + (size_t)q * DISTRACT_KEEP;
+    uint32_t *tags = distractors.tags + (size_t)q * DISTRACT_KEEP;
+    for (int j = 0; j < DISTRACT_KEEP; j++) {
+        ids[j]  = j < kept ? best[j] : -1;
+        tags[j] = j < kept ? distractTag(best[j]) : 0;
+    }
+}
+
+/* distractOffer：剛新增的第 x 個單字，要不要換掉第 c 個單字最不像的那個選項？*/
+static void distractOffer(int c, int x) {
+    int32_t  *ids  = distractors.ids  + (size_t)c * DISTRACT_KEEP;
+    uint32_t *tags = distractors.tags + (size_t)c * DISTRACT_KEEP;
+    if (ids[0] == DISTRACT_UNSET) return; // c 還沒挑過，輪到它出題時自然會看到 x
+
+    EditPattern p;
+    editPrepare(&p, wordKeyEn(c));
+    int score = distractScore(&p, c, x);
+    if (score < 0) return;
+    int worst = -1, worstScore = score;
+    for (int j = 0; j < DISTRACT_KEEP; j++) {
+        if (!distractValid(c, j)) { worst = j; break; } // 有空格就直接放
+        int s = distractScore(&p, c, ids[j]);
+        if (s > worstScore) {
+            worst      = j;
+            worstScore = s;
+        }
+    }
+    if (worst < 0) return;
+    ids[worst]  = x;
+    tags[worst] = distractTag(x);
+}
+
+/* distractorPick：第 q 個單字出選擇題要用的干擾選項
+   -------------------------------------------------------
+   需要的索引（三份字母順序、distractors 本身）還沒建的話這裡才建。
+
+   回傳值：放進 out[] 幾個（最多 DISTRACT_CHOICES 個；單字庫太小時會比較少）；
+           記憶體不足時回傳 -1*/
+int distractorPick(int q, int out[]) {
+    SortedIndex *orders[] = { &folderAlphaOrder, &folderGlossOrder, &alphaOrder };
+    for (int o = 0; o < 3; o++) {
+        if (!orders[o]->ready && !sortedBuild(orders[o])) return -1;
+    }
+    if (!distractors.ready) {
+        if (!distractReserve(library.count)) return -1;
+        distractors.ready = 1;
+    }
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+        if (attempt == 1 || distractors.ids[(size_t)q * DISTRACT_KEEP] == DISTRACT_UNSET) distractFill(q);
+        int n = 0;
+        for (int j = 0; j < DISTRACT_KEEP && n < DISTRACT_CHOICES; j++) {
+            if (distractValid(q, j)) out[n++] = distractors.ids[(size_t)q * DISTRACT_KEEP + j];
+        }
+        if (n == DISTRACT_CHOICES || attempt == 1) return n;
+        // 有些選項被刪掉了：重挑一次
+    }
+    return 0;
+}
+
+/* distractorAdd：第 idx 個單字剛新增（字母順序索引要先更新好）*/
+void distractorAdd(int idx) {
+    if (!distractors.ready) return;
+    if (!distractReserve(library.count)) {
+        distractorFree(); // 記憶體不足：先放棄，下次出選擇題時再從頭挑
+        return;
+    }
+    for (int j = 0; j < DISTRACT_KEEP; j++) distractors.ids[(size_t)idx * DISTRACT_KEEP + j] = DISTRACT_UNSET;
+    int cand[DISTRACT_CANDIDATES];
+    int n = distractCandidates(idx, cand);
+    for (int i = 0; i < n; i++) distractOffer(cand[i], idx);
+}
+
+/* distractorForget：第 idx 個單字要被刪除了，最後一個（last）會搬到 idx
+   要在 storeRemove、sortedForget 之前呼叫（要用字母順序索引找鄰居）。*/
+void distractorForget(int idx, int last) {
+    if (!distractors.ready) return;
+    int cand[DISTRACT_CANDIDATES];
+    int n = distractCandidates(idx, cand);
+    for (int i = 0; i < n; i++) {
+        int32_t *ids = distractors.ids + (size_t)cand[i] * DISTRACT_KEEP;
+        for (int j = 0; j < DISTRACT_KEEP; j++) if (ids[j] == idx) ids[j] = -1;
+    }
+    if (idx == last) return;
+
+    n = distractCandidates(last, cand);
+    for (int i = 0; i < n; i++) {
+        int32_t *ids = distractors.ids + (size_t)cand[i] * DISTRACT_KEEP;
+        for (int j = 0; j < DISTRACT_KEEP; j++) if (ids[j] == last) ids[j] = idx;
+    }
+    // 搬家的字自己挑好的選項也跟著搬（tag 記的是字本身，不用改）
+    memcpy(distractors.ids  + (size_t)idx * DISTRACT_KEEP, distractors.ids  + (size_t)last * DISTRACT_KEEP,
+           DISTRACT_KEEP * sizeof(int32_t));
+    memcpy(distractors.tags + (size_t)idx * DISTRACT_KEEP, distractors.tags + (size_t)last * DISTRACT_KEEP,
+           DISTRACT_KEEP * sizeof(uint32_t));
+}
+
+/* distractorFree：釋放干擾選項*/
+void distractorFree(void) {
+    free(distractors.ids);
+    free(distractors.tags);
+    memset(&distractors, 0, sizeof(distractors));
+}
+
+
+/* ================================================================
+   新增 / 刪除單字（同時更新所有索引）
+   ================================================================ */
+
+/* libraryAdd：新增一個單字，同時更新所有索引
+   -------------------------------------------------------
+   為什麼不直接呼叫 storeAdd？
+   → storeAdd 只管單字庫本身，索引不會跟著更新，之後就會查不到這個字。
+   → 所有「新增單字」的地方都要走這個函數，索引才會永遠和 library 一致。
+
+   回傳值：新單字的索引；失敗時回傳 -1*/
+int libraryAdd(int folderId, const char *en, const char *cn, int errorCount) {
+    int idx = storeAdd(&library, folderId, en, cn, errorCount);
+    if (idx < 0) return -1;
+    // 索引用的都是正規化之後的 key（storeAdd 已經算好了）
+    const char *enKey = wordKeyEn(idx);
+    hashInsert(&englishIndex,       keyHash(enKey),                          idx);
+    hashInsert(&folderEnglishIndex, folderKeyHash((uint32_t)folderId, enKey), idx);
+    gramIndexAdd(&textIndex, idx, enKey, wordKeyCn(idx));
+    // 新單字的索引一定是目前最大的，直接接在資料夾清單最後面，順序還是由小到大
+    if (folders.membersReady && !idListPush(&folders.items[folderId].members, idx)) {
+        folders.membersReady = 0;
+    }
+    heapAdd(&errorRank, idx);
+    heapAdd(&dueQueue, idx);
+    heapAdd(&newQueue, idx);
+    if (errorWeights.ready && !weightPush(&errorWeights, wordWeight(idx))) {
+        errorWeights.ready = 0; // 記憶體不夠就先放棄，下次抽題時再整個重建
+    }
+    if (headwords.ready && !bkInsert(&headwords, enKey)) headwords.ready = 0;
+    sortedAdd(&alphaOrder, idx);
+    sortedAdd(&folderAlphaOrder, idx);
+    sortedAdd(&folderGlossOrder, idx);
+    distractorAdd(idx); // 要用字母順序索引找鄰居，所以放在後面
+    statsAdd(idx);
+    return idx;
+}
+
+/* libraryRemove：刪除第 idx 個單字，同時更新所有索引
+   -------------------------------------------------------
+   storeRemove 會把最後一個單字搬到 idx 這格，
+   所以除了刪掉 idx 的索引，還要把最後一個單字的索引從「最後一格」改成「idx」。*/
+void libraryRemove(int idx) {
+    int last = library.count - 1;
+
+    hashReplace(&englishIndex, keyHash(wordKeyEn(idx)), idx, HASH_TOMB);
+    hashReplace(&folderEnglishIndex,
+                folderKeyHash(library.words[idx].folderId, wordKeyEn(idx)), idx, HASH_TOMB);
+    gramIndexRemove(&textIndex, idx, wordKeyEn(idx), wordKeyCn(idx));
+    if (folders.membersReady) {
+        memberRemove(&folders.items[library.words[idx].folderId].members, idx);
+        if (idx != last) {
+            // 最後一個單字搬到 idx：在它的資料夾清單裡，last（最大）換成 idx，要重新排到正確位置
+            IdList *m = &folders.items[library.words[last].folderId].members;
+            memberRemove(m, last);
+            memberInsert(m, idx);
+        }
+    }
+    heapForget(&errorRank, idx, last);
+    heapForget(&dueQueue, idx, last);
+    heapForget(&newQueue, idx, last);
+    bkForget(&headwords, wordKeyEn(idx));
+    distractorForget(idx, last); // 要用字母順序索引找鄰居，所以放在前面
+    sortedForget(&alphaOrder, idx, last);
+    sortedForget(&folderAlphaOrder, idx, last);
+    sortedForget(&folderGlossOrder, idx, last);
+    statsForget(idx);
+    if (idx != last) {
+        hashReplace(&englishIndex, keyHash(wordKeyEn(last)), last, idx);
+        hashReplace(&folderEnglishIndex,
+                    folderKeyHash(library.words[last].folderId, wordKeyEn(last)), last, idx);
+        gramIndexMove(&textIndex, last, idx, wordKeyEn(last), wordKeyCn(last));
+    }
+
+    storeRemove(&library, idx);
+    // 最後一個位置只出現在 sum[count] 這一格，直接拿掉，前面的總和都不受影響
+    if (errorWeights.ready) errorWeights.count--;
+    // 搬過來的單字索引變小了，「一樣就索引小的在前」的順序要重新調整
+    if (idx < library.count) {
+        heapUpdate(&errorRank, idx);
+        heapUpdate(&dueQueue, idx);
+        heapUpdate(&newQueue, idx);
+        weightSync(idx);
+    }
+}
+
+/* libraryAddError：第 idx 個單字的錯誤次數加上 delta，同時更新錯題排行和抽題權重
+   所有修改 errorCount 的地方都要走這個函數，排行才會和 library 一致。*/
+void libraryAddError(int idx, int delta) {
+    int before = library.words[idx].errorCount;
+    library.words[idx].errorCount += delta;
+    heapUpdate(&errorRank, idx);
+    weightSync(idx);
+    statsError(idx, before);
+}
+
+/* libraryReview：第 idx 個單字剛被考過，依照結果排下次複習的時間（並交給儲存後端記下來）*/
+void libraryReview(int idx, int correct) {
+    Review rv = library.words[idx].review;
+    reviewSchedule(&rv, correct, nowMinutes());
+    librarySetReview(idx, &rv);
+    storageReview(idx);
+}
+
+/* librarySetReview：改寫第 idx 個單字的複習排程，同時更新複習佇列*/
+void librarySetReview(int idx, const Review *r) {
+    library.words[idx].review = *r;
+    heapUpdate(&dueQueue, idx);
+    heapUpdate(&newQueue, idx);
+}
+
+
+/* ================================================================
+   檔案讀寫
+   ================================================================ */
+
+/* nextField：從 *cur 開始切出下一個欄位（strtok 的「可重入」版本）
+   -------------------------------------------------------
+   規則和 strtok 一模一樣：先跳過開頭的分隔符，再一直讀到下一個分隔符為止，
+   所以連續兩個 Tab 會被當成一個。
+
+   為什麼不直接用 strtok？
+   → strtok 把「切到哪裡」記在函式庫內部的一個變數裡，
+     兩個執行緒同時呼叫就會互相干擾（這叫「不可重入」）。
+   → nextField 把位置存在呼叫者給的 *cur，每個執行緒各用各的，就不會打架。
+   → 而且它不會把分隔符改成 '\0'，檔案內容完全不動。
+
+   參數：
+     cur   → 目前切到哪裡（切完會往後移）
+     end   → 這一行的結尾（不包含 '\n'）
+     cr    → 1 = '\r' 也算分隔符（中文和錯誤次數欄位用，處理 Windows 的換行）
+     out   → 切出來的欄位
+
+   回傳值：1 = 有切到欄位，0 = 這一行沒有東西了*/
+static int nextField(char **cur, char *end, int cr, TextView *out) {
+    char *p = *cur;
+    while (p < end && (*p == '\t' || (cr && *p == '\r'))) p++;
+    if (p == end) return 0;
+
+    char *start = p;
+    while (p < end && *p != '\t' && !(cr && *p == '\r')) p++;
+    out->p   = start;
+    out->len = (size_t)(p - start);
+    *cur = p;
+    return 1;
+}
+
+/* splitFields：把一行拆成 資料夾 / 英文 / 中文 / 錯誤次數 / 複習排程 這些欄位
+   -------------------------------------------------------
+   參數：
+     p, end → 這一行的範圍（不包含 '\n'）
+     f      → 拆出來的欄位（都指向原本的那一行，不複製）
+
+   回傳值：1 = 三個必要欄位都有，0 = 格式不對*/
+int splitFields(char *p, char *end, LineFields *f) {
+    memset(f, 0, sizeof(*f));
+    if (!nextField(&p, end, 0, &f->folder) ||
+        !nextField(&p, end, 0, &f->en) ||
+        !nextField(&p, end, 1, &f->cn)) return 0;
+
+    // 第四欄以後都可有可無
+    if (nextField(&p, end, 1, &f->err)) {
+        for (int i = 0; i < REVIEW_FIELDS && nextField(&p, end, 1, &f->review[i]); i++) {}
+    }
+    return 1;
+}
+
+/* viewToInt：把 TextView 轉成整數（和 atoi 的規則一樣，但不需要 '\0' 結尾）*/
+static int viewToInt(TextView v) {
+    size_t i = 0;
+    int sign = 1, n = 0;
+    while (i < v.len && (v.p[i] == ' ' || v.p[i] == '\t')) i++;
+    if (i < v.len && (v.p[i] == '-' || v.p[i] == '+')) sign = (v.p[i++] == '-') ? -1 : 1;
+    while (i < v.len && v.p[i] >= '0' && v.p[i] <= '9') n = n * 10 + (v.p[i++] - '0');
+    return sign * n;
+}
+
+/* addFields：把 splitFields 拆好的一行加進 library
+   -------------------------------------------------------
+   先把每個欄位後面的分隔符換成 '\0'，讓它們變成一般的 C 字串。
+   → 分隔符在拆欄位時已經用過了，換掉也沒關係；但原本那一行之後就不能再用了。
+
+   參數：
+     f              → 拆好的欄位（會修改它指向的那一行）
+     skipDuplicates → 1 = 同一個資料夾已經有一模一樣的單字就不加
+     lastFolder / lastId → 不是 NULL 的話，記住上一行的資料夾名稱和編號：
+                      檔案裡同一個資料夾的單字通常連在一起，名稱一樣就不用再查雜湊表
+
+   回傳值：新單字在 library 的索引；沒有加進去時回傳 -1*/
+static int addFields(LineFields *f, int skipDuplicates, LineFields *lastFolder, int *lastId) {
+    f->en.p[f->en.len] = '\0';
+    f->cn.p[f->cn.len] = '\0';
+
+    int folderId;
+    if (lastFolder && lastFolder->folder.p && lastFolder->folder.len == f->folder.len &&
+        memcmp(lastFolder->folder.p, f->folder.p, f->folder.len) == 0) {
+        folderId = *lastId;
+    } else {
+        f->folder.p[f->folder.len] = '\0';
+        folderId = folderIntern(f->folder.p); // 登錄這個資料夾，順便取得編號
+        if (lastFolder) {
+            lastFolder->folder = f->folder;
+            *lastId = folderId;
+        }
+    }
+    if (folderId < 0) return -1;
+    if (skipDuplicates && findInFolder(folderId, f->en.p, f->cn.p) >= 0) return -1;
+
+    // 舊格式沒有錯誤次數這欄，f->err.len 是 0，viewToInt 會回傳 0
+    int idx = libraryAdd(folderId, f->en.p, f->cn.p, viewToInt(f->err));
+    if (idx >= 0 && f->review[0].len > 0) {
+        Review rv = library.words[idx].review;
+        rv.due        = (uint32_t)viewToInt(f->review[0]);
+        rv.lastReview = (uint32_t)viewToInt(f->review[1]);
+        rv.interval   = (uint16_t)viewToInt(f->review[2]);
+        if (f->review[3].len > 0) rv.ease = (uint16_t)viewToInt(f->review[3]);
+        rv.reps       = (uint16_t)viewToInt(f->review[4]);
+        rv.lapses     = (uint16_t)viewToInt(f->review[5]);
+        librarySetReview(idx, &rv);
+    }
+    return idx;
+}
+
+/* parseLine：解析一行文字，把單字資料存進 library
+   -------------------------------------------------------
+   檔案裡每行的格式是：
+     資料夾 [Tab] 英文 [Tab] 中文 [Tab] 錯誤次數 [換行]
+
+   參數：
+     line → 一行文字（會被修改，呼叫後不能再用）
+
+   回傳值：新單字在 library 的索引；格式不對或無法新增時回傳 -1*/
+int parseLine(char *line) {
+    LineFields f;
+    // 三個必要欄位缺一個就跳過這行（格式不對）
+    if (!splitFields(line, line + strcspn(line, "\n"), &f)) return -1;
+    return addFields(&f, 0, NULL, NULL);
+}
+
+/* readLine：從檔案讀一整行，不管這一行有多長
+   -------------------------------------------------------
+   fgets 一次最多只能讀「暫存區大小 - 1」個字元，
+   一行比暫存區長的話會被切成好幾段，每一段都被當成獨立的一行。
+   readLine 在暫存區不夠時會自動把它加大，保證一次拿到完整的一行。
+
+   為什麼不用 strlen 算 fgets 讀了多少？
+   → 壞掉的檔案可能在一行中間有 '\0'，strlen 會在那裡停下來，
+     以為這一段沒有換行，就把下一行接上來（最頭的 byte 是 '\0' 的話還會讀到暫存區前面）。
+   → 所以 fgets 之前先把那一段填滿 '\n'：fgets 讀完之後，
+     第一個「後面緊接著 '\0'」的 '\n' 就是真的換行；
+     找到的 '\n' 後面不是 '\0' 的話，它是填進去的，前一格的 '\0' 就是這一段的結尾。
+   → 一次最多只填、只讀 READ_STEP 個 byte，暫存區因為某一行很長變大之後，
+     讀短短的一行也不用把整個暫存區填一遍。
+
+   參數：
+     buf → 暫存區（第一次可以傳指向 NULL 的指標，用完要 free）
+     cap → 暫存區目前的大小
+
+   回傳值：這一行的長度（包含 '\n'，最後一行可能沒有）；
+           檔案結束或記憶體不足時回傳 -1*/
+long readLine(FILE *fp, char **buf, size_t *cap) {
+    size_t len = 0;
+    for (;;) {
+        if (*cap - len < 2) {
+            size_t newCap = *cap ? *cap * 2 : LINE_BUF;
+            char *p = realloc(*buf, newCap);
+            if (!p) return -1;
+            *buf = p;
+            *cap = newCap;
+        }
+        char  *part = *buf + len;
+        size_t room = *cap - len < READ_STEP ? *cap - len : READ_STEP;
+        memset(part, '\n', room);
+        if (!fgets(part, (int)room, fp)) break;
+
+        char *nl = memchr(part, '\n', room);
+        if (!nl) {
+            len += room - 1; // 整段都填滿了，這一行還沒完
+            continue;
+        }
+        if (nl + 1 < part + room && nl[1] == '\0') {
+            len = (size_t)(nl + 1 - *buf); // 讀到換行，這一行完整了
+            break;
+        }
+        len = (size_t)(nl - 1 - *buf); // 檔案結束了，最後一行沒有換行
+        break;
+    }
+    if (len > 0) (*buf)[len] = '\0';
+    return len > 0 ? (long)len : -1;
+}
+
+/* fnvHash：FNV-1a 雜湊，把一段資料變成一個 64 位元的「指紋」
+   -------------------------------------------------------
+   用途：記住「日誌是接在哪一版 english_word.txt 後面寫的」。
+   只要檔案內容有任何一個 byte 不同，算出來的指紋幾乎一定不同。
+
+   參數：
+     h   → 目前的雜湊值（第一次呼叫請傳 FNV_OFFSET）
+     buf → 要加進來的資料
+     len → 資料長度
+
+   回傳值：加入這段資料之後的新雜湊值（可以一段一段接著算）*/
+uint64_t fnvHash(uint64_t h, const char *buf, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)buf[i];
+        h *= FNV_PRIME;
+    }
+    return h;
+}
+
+/* syncFile：要求作業系統把檔案「真的」寫到磁碟上
+   -------------------------------------------------------
+   fflush 只是把 C 函式庫的緩衝區交給作業系統，
+   作業系統可能還放在記憶體裡，這時候停電資料一樣會不見。
+   fsync（Windows 上叫 _commit）會等到資料確實落到磁碟才回來。*/
+void syncFile(FILE *fp) {
+    metricCount(&metrics.fsyncs, 1);
+    fflush(fp);
+#ifdef _WIN32
+    _commit(_fileno(fp));
+#else
+    fsync(fileno(fp));
+#endif
+}
+
+/* textAppend：把 n 個 byte 接在緩衝區後面（空間不夠就加倍）*/
+void textAppend(TextBuf *b, const char *s, size_t n) {
+    if (b->failed) return;
+    if (b->len + n > b->cap) {
+        size_t newCap = b->cap ? b->cap : ARENA_INIT_CAP;
+        while (newCap < b->len + n) newCap *= 2;
+        char *p = realloc(b->data, newCap);
+        if (!p) { b->failed = 1; return; }
+        b->data = p;
+        b->cap  = newCap;
+    }
+    memcpy(b->data + b->len, s, n);
+    b->len += n;
+}
+
+/* tsvRender：把整個 library 排成 english_word.txt 的內容（只在記憶體裡，不碰磁碟）
+   -------------------------------------------------------
+   為什麼要和「寫到檔案」分開？
+   → 背景寫入的時候，主執行緒還會繼續改 library，寫入執行緒不能邊讀邊寫；
+     所以由主執行緒先排好一份完整的內容，寫入執行緒只負責把這塊記憶體寫到磁碟。
+
+   回傳值：1 = 成功，0 = 記憶體不足（out 裡的東西仍然要 free）*/
+int tsvRender(TextBuf *out) {
+    for (int i = 0; i < library.count; i++) {
+        const Review *rv = &library.words[i].review;
+        char errStr[16];
+        char reviewStr[80] = "";
+        snprintf(errStr, sizeof(errStr), "%d", library.words[i].errorCount);
+        // 複習過的單字才多寫排程那幾欄（開頭的 Tab 接在錯誤次數後面）
+        if (!reviewIsDefault(rv)) {
+            snprintf(reviewStr, sizeof(reviewStr), "\t%u\t%u\t%u\t%u\t%u\t%u",
+                     (unsigned)rv->due, (unsigned)rv->lastReview, (unsigned)rv->interval,
+                     (unsigned)rv->ease, (unsigned)rv->reps, (unsigned)rv->lapses);
+        }
+        const char *fields[5] = { wordFolder(i), wordEnglish(i), wordChinese(i), errStr, reviewStr };
+        for (int f = 0; f < 5; f++) {
+            const char *sep = (f < 3) ? "\t" : (f == 4) ? "\n" : "";
+            textAppend(out, fields[f], strlen(fields[f]));
+            textAppend(out, sep, strlen(sep));
+        }
+    }
+    return !out->failed;
+}
+
+/* replaceFile：把 data 寫成新的 path（整個檔案換掉）
+   -------------------------------------------------------
+   為什麼先寫到 tmp 再改名（rename）？
+   → 如果直接用 "w" 開 english_word.txt，檔案會先被清空，
+     寫到一半當機的話整個單字庫就沒了。
+   → 先完整寫好暫存檔、確定寫到磁碟，再一口氣改名蓋掉舊檔，
+     任何時間點當機，磁碟上都至少有一份完整的檔案。
+
+   回傳值：1 = 成功，0 = 失敗（原本的檔案沒有被修改）*/
+int replaceFile(const char *path, const char *tmp, const char *data, size_t len) {
+    FILE *fp = fopen(tmp, "w");
+    if (!fp) {
+        // 開檔失敗通常是因為沒有寫入權限
+        printf("[Error] 無法儲存！請確認程式所在的資料夾有寫入權限。\n");
+        return 0;
+    }
+    // fwrite 跟 fputs 一樣會輸出到檔案，但一次寫一整塊，不用管裡面有沒有 '\0'
+    if (len) fwrite(data, 1, len, fp);
+    syncFile(fp);
+    if (ferror(fp)) {
+        fclose(fp);
+        remove(tmp);
+        printf("[Error] 寫入檔案時發生錯誤，原本的 %s 沒有被修改。\n", path);
+        return 0;
+    }
+    fclose(fp); // 一定要記得關檔案！不然資料可能沒有真正寫進去
+
+#ifdef _WIN32
+    remove(path); // Windows 的 rename 不能蓋掉已存在的檔案
+#endif
+    if (rename(tmp, path) != 0) {
+        printf("[Error] 無法更新 %s。\n", path);
+        return 0;
+    }
+    metricCount(&metrics.bytesWritten, len);
+    return 1;
+}
+
+/* tsvWrite：把排好的內容寫成新的 english_word.txt
+   這個函數不讀 library，所以背景寫入執行緒也可以呼叫。
+
+   回傳值：1 = 成功，0 = 失敗（原本的單字檔沒有被修改）*/
+int tsvWrite(const char *data, size_t len) {
+    int ok = replaceFile(WORD_FILE, WORD_FILE_TMP, data, len);
+    if (ok) metricCount(&metrics.saves, 1);
+    return ok;
+}
+
+/* saveToFile：把整個 library 寫入 english_word.txt（壓縮日誌）
+   -------------------------------------------------------
+   平常的新增、刪除、答錯都只追加到日誌（journalAppend...），
+   只有在日誌太長、或是離開程式時，才會呼叫這個函數整個重寫一次，
+   之後日誌就可以清空重新開始。
+
+   這是「同步」的版本：寫完才回來，順便更新快照。
+   選單模式裡日誌太長時改由背景寫入執行緒壓縮（persistCompact），不會用到這個函數；
+   離開程式、匯入，或是日誌開不起來的時候才用它。
+
+   回傳值：1 = 儲存成功，0 = 失敗*/
+int saveToFile(void) {
+    uint64_t started = metricNow();
+    TextBuf buf = {0};
+    if (!tsvRender(&buf)) {
+        free(buf.data);
+        printf("[Error] 記憶體不足，無法儲存！原本的單字檔沒有被修改。\n");
+        return 0;
+    }
+    uint64_t hash = fnvHash(FNV_OFFSET, buf.data ? buf.data : "", buf.len); // 新檔案的指紋
+    int ok = tsvWrite(buf.data, buf.len);
+    free(buf.data);
+    if (!ok) return 0;
+
+    // 新的 english_word.txt 已經包含所有變更，日誌重新開始
+    journalReset(hash);
+
+    // 順便寫一份快照，下次啟動就不用再解析文字檔（失敗也沒關係，會改讀文字檔）
+    struct stat st;
+    if (stat(WORD_FILE, &st) == 0) {
+        snapshotSave(SNAP_FILE, hash, (uint64_t)st.st_size, (int64_t)st.st_mtime);
+    }
+    metricRecord(METRIC_SAVE, started);
+    return 1;
+}
+
+/* loadFile：程式啟動時，從 english_word.txt 讀取所有單字，再重播日誌
+   -------------------------------------------------------
+   "r" 模式代表「唯讀」：
+   → 如果檔案不存在，fopen 會回傳 NULL（不會建立新檔）。
+   → 第一次使用這個程式時，english_word.txt 還不存在，是正常的。
+
+   讀完主檔之後，再把 english_word.journal 裡記錄的變更依序做一遍，
+   就會回到上次離開（或當機）前的狀態。
+
+   如果有和主檔對得上的快照檔（english_word.snap），就直接用快照，
+   完全不用解析文字檔；快照過期或不存在時才讀文字檔，讀完順便寫一份新的快照。*/
+void loadFile(void) {
+    uint64_t started = metricNow();
+    uint64_t hash    = FNV_OFFSET; // 一邊讀一邊算主檔的指紋，用來核對日誌
+    if (snapshotLoad(SNAP_FILE, 1, &hash)) {
+        journalReplay(hash);
+        metricRecord(METRIC_LOAD, started);
+        printf("讀取完成：%d 個資料夾，%d 個單字。\n", folders.count, library.count);
+        return;
+    }
+
+    // 用大量匯入一次讀完整個主檔（多個執行緒一起解析），順便算指紋
+    int found = bulkImport(WORD_FILE, 0, &hash, NULL);
+    if (found) {
+        // 這時候 library 剛好就是主檔的內容（還沒重播日誌），寫成快照給下次啟動用
+        struct stat st;
+        if (stat(WORD_FILE, &st) == 0) {
+            snapshotSave(SNAP_FILE, hash, (uint64_t)st.st_size, (int64_t)st.st_mtime);
+        }
+    }
+
+    journalReplay(hash);
+    metricRecord(METRIC_LOAD, started);
+
+    if (library.count == 0 && !found) {
+        printf("[Notice] 還沒有單字資料，請先用「1. 新增單字」開始。\n");
+        return;
+    }
+    printf("讀取完成：%d 個資料夾，%d 個單字。\n", folders.count, library.count);
+}
+
+
+/* ================================================================
+   二進位快照（english_word.snap）
+   ================================================================ */
+
+/* snapWriteSection：把一個區段寫進快照檔（或壓縮字典），位置記進 sec，並補 0 到 8 的倍數
+   -------------------------------------------------------
+   為什麼要補到 8 的倍數？
+   → 對應到記憶體之後，uint64_t 這種 8 bytes 的資料要放在 8 的倍數的地址上，
+     有些 CPU 讀「沒對齊」的資料會變慢，甚至直接當掉。
+
+   參數：
+     pos → 目前寫到檔案的第幾個 byte（寫完會更新）
+
+   回傳值：1 = 成功，0 = 寫入失敗*/
+static int snapWriteSection(FILE *fp, SnapSection *sec, const void *data,
+                            size_t size, uint64_t *pos) {
+    static const char zeros[8] = {0};
+    size_t pad = (8 - size % 8) % 8;
+
+    sec->off  = *pos;
+    sec->size = size;
+    if (size > 0 && fwrite(data, 1, size, fp) != size) return 0;
+    if (pad > 0 && fwrite(zeros, 1, pad, fp) != pad) return 0;
+    *pos += size + pad;
+    return 1;
+}
+
+/* snapHashMeta：把 HashIndex 的計數記到檔頭裡，回傳它的 slots 要寫幾個 byte*/
+static size_t snapHashMeta(const HashIndex *h, SnapHash *m) {
+    m->mask     = h->slots ? h->mask : 0;
+    m->used     = h->used;
+    m->live     = h->live;
+    m->reserved = 0;
+    return h->slots ? ((size_t)h->mask + 1) * sizeof(HashSlot) : 0;
+}
+
+/* snapshotSave：把目前的單字庫和所有索引寫成快照檔
+   -------------------------------------------------------
+   一樣先寫到暫存檔、確定寫到磁碟之後再改名，不會留下寫一半的快照。
+
+   參數：
+     path     → 快照檔名
+     tsvHash  → 這份快照對應的 english_word.txt 指紋
+     tsvSize  → 對應的 english_word.txt 大小（啟動時用來判斷快照是否過期）
+     tsvMtime → 對應的 english_word.txt 修改時間
+
+   回傳值：1 = 成功，0 = 失敗*/
+int snapshotSave(const char *path, uint64_t tsvHash, uint64_t tsvSize, int64_t tsvMtime) {
+    char tmpPath[1024];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+    FILE *fp = fopen(tmpPath, "wb"); // "b" = 二進位模式，Windows 才不會把 \n 改成 \r\n
+    if (!fp) return 0;
+
+    SnapHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, SNAP_MAGIC, sizeof(SNAP_MAGIC));
+    h.version        = SNAP_VERSION;
+    h.endian         = SNAP_ENDIAN;
+    h.sizeWord       = sizeof(Word);
+    h.sizeSlot       = sizeof(HashSlot);
+    h.sizePosting    = sizeof(Posting);
+    h.tsvHash        = tsvHash;
+    h.tsvSize        = tsvSize;
+    h.tsvMtime       = tsvMtime;
+    h.wordCount      = library.count;
+    h.folderCount    = folders.count;
+    h.folderNamesUsed = folders.names.used;
+    h.stringsUsed    = library.strings.used;
+    h.stringsGarbage = library.strings.garbage;
+    // 清單的預留空間和搬家留下的垃圾不用寫進檔案，先整理成緊密排列
+    // （借來的索引本來就是從整理過的快照讀進來的，不用再整理）
+    if (!textIndex.borrowed && textIndex.count > 0) gramCompact(&textIndex);
+    h.gramCount      = textIndex.count;
+    h.poolUsed       = textIndex.poolUsed;
+    h.poolGarbage    = textIndex.poolGarbage;
+
+    const HashIndex *hashes[4] = { &englishIndex, &folderEnglishIndex, &folders.index, &textIndex.lookup };
+    size_t hashBytes[4];
+    for (int i = 0; i < 4; i++) hashBytes[i] = snapHashMeta(hashes[i], &h.hashes[i]);
+
+    // Folder 裡有 members 指標，不能直接寫進檔案，只寫名稱的位移
+    // （members 啟動後第一次用到時再從 words 重建）
+    uint32_t *folderOffs = malloc((size_t)(folders.count > 0 ? folders.count : 1) * sizeof(uint32_t));
+    if (!folderOffs) {
+        fclose(fp);
+        remove(tmpPath);
+        return 0;
+    }
+    for (int i = 0; i < folders.count; i++) folderOffs[i] = folders.items[i].nameOff;
+
+    // 先寫一個空的檔頭佔位置，區段都寫完、知道位置之後再回來重寫
+    uint64_t pos = sizeof(h);
+    int ok = fwrite(&h, sizeof(h), 1, fp) == 1;
+    ok = ok && snapWriteSection(fp, &h.sec[SEC_WORDS], library.words,
+                                (size_t)library.count * sizeof(Word), &pos);
+    ok = ok && snapWriteSection(fp, &h.sec[SEC_STRINGS], library.strings.data,
+                                library.strings.used, &pos);
+    ok = ok && snapWriteSection(fp, &h.sec[SEC_FOLDERS], folderOffs,
+                                (size_t)folders.count * sizeof(uint32_t), &pos);
+    for (int i = 0; i < 4; i++) {
+        int sec = (i < 3) ? SEC_IDX_EN + i : SEC_GRAM_LOOKUP;
+        ok = ok && snapWriteSection(fp, &h.sec[sec], hashes[i]->slots, hashBytes[i], &pos);
+    }
+    ok = ok && snapWriteSection(fp, &h.sec[SEC_GRAM_LISTS], textIndex.lists,
+                                (size_t)textIndex.count * sizeof(Posting), &pos);
+    ok = ok && snapWriteSection(fp, &h.sec[SEC_GRAM_POOL], textIndex.pool,
+                                (size_t)textIndex.poolUsed * sizeof(int32_t), &pos);
+    ok = ok && snapWriteSection(fp, &h.sec[SEC_FOLDER_NAMES], folders.names.data,
+                                folders.names.used, &pos);
+    ok = ok && fseek(fp, 0, SEEK_SET) == 0;
+    free(folderOffs);
+    ok = ok && fwrite(&h, sizeof(h), 1, fp) == 1;
+
+    syncFile(fp);
+    ok = ok && !ferror(fp);
+    fclose(fp);
+    if (!ok) {
+        remove(tmpPath);
+        return 0;
+    }
+#ifdef _WIN32
+    remove(path);
+#endif
+    if (rename(tmpPath, path) != 0) return 0;
+    metricCount(&metrics.bytesWritten, pos);
+    return 1;
+}
+
+/* mapFile：把整個檔案對應到記憶體
+   -------------------------------------------------------
+   mmap 不會真的把檔案讀進來，作業系統會等到程式用到哪一頁才載入那一頁，
+   所以不管檔案多大，這一步都幾乎不花時間。
+   MAP_PRIVATE 代表「寫入只改記憶體裡自己的那份，不會改到檔案」，
+   所以答錯時直接改 errorCount 也沒問題。
+
+   Windows 沒有 mmap，就用 fread 整個讀進來（一樣不需要解析）。
+
+   回傳值：1 = 成功，0 = 失敗*/
+static int mapFile(const char *path, MappedFile *m) {
+#ifdef _WIN32
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return 0;
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if (size <= 0 || !(m->data = malloc((size_t)size))) {
+        fclose(fp);
+        return 0;
+    }
+    m->size = fread(m->data, 1, (size_t)size, fp);
+    fclose(fp);
+    if (m->size != (size_t)size) {
+        free(m->data);
+        m->data = NULL;
+        return 0;
+    }
+    return 1;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return 0;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return 0;
+    }
+    void *p = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd); // 對應完成之後，檔案描述子就可以關了，對應關係還在
+    if (p == MAP_FAILED) return 0;
+    m->data = p;
+    m->size = (size_t)st.st_size;
+    return 1;
+#endif
+}
+
+/* unmapFile：解除 mapFile 的對應*/
+static void unmapFile(MappedFile *m) {
+    if (!m->data) return;
+#ifdef _WIN32
+    free(m->data);
+#else
+    munmap(m->data, m->size);
+#endif
+    m->data = NULL;
+    m->size = 0;
+}
+
+/* snapSection：取得區段在記憶體中的位置；區段超出檔案範圍時回傳 NULL*/
+static char *snapSection(const MappedFile *m, const SnapHeader *h, int sec) {
+    const SnapSection *s = &h->sec[sec];
+    if (s->off % 8 != 0 || s->off > m->size || s->size > m->size - s->off) return NULL;
+    return m->data + s->off;
+}
+
+/* snapHashRestore：讓 HashIndex 直接使用快照檔裡的雜湊表
+   limit：每一格存的東西（單字索引、資料夾編號或片段編號）一定要小於它
+   回傳值：1 = 成功，0 = 區段大小不對或有一格指到範圍外*/
+static int snapHashRestore(HashIndex *h, const SnapHash *m, char *data, uint64_t size, int32_t limit) {
+    memset(h, 0, sizeof(*h));
+    if (size == 0) return m->used == 0 && m->live == 0;
+    if ((m->mask & (m->mask + 1)) != 0) return 0;               // 格數一定是 2 的次方
+    if (size != ((uint64_t)m->mask + 1) * sizeof(HashSlot)) return 0;
+    const HashSlot *slots = (const HashSlot *)data;
+    for (uint64_t i = 0; i <= m->mask; i++) {
+        int32_t v = slots[i].value;
+        if (v != HASH_EMPTY && v != HASH_TOMB && (v < 0 || v >= limit)) return 0;
+    }
+    h->slots    = (HashSlot *)data;
+    h->mask     = m->mask;
+    h->used     = m->used;
+    h->live     = m->live;
+    h->borrowed = 1;
+    return 1;
+}
+
+/* snapWordsValid：快照裡每個單字的字串位移和資料夾編號是不是都在範圍內
+   -------------------------------------------------------
+   快照檔雖然是程式自己寫的，但磁碟壞掉或被別的程式改過時，
+   一個位移超出字串池，之後 strlen / folderName 就會讀到別人的記憶體。
+   字串池最後一個 byte 一定是 '\0'（呼叫前已經檢查），所以從範圍內的位移開始 strlen 不會跑出去；
+   中文的 key 緊接在英文的 key 後面（wordKeyCn），也要確認它還在字串池裡。*/
+static int snapWordsValid(const SnapHeader *h, const Word *words, const char *strings) {
+    for (int i = 0; i < h->wordCount; i++) {
+        const Word *w = &words[i];
+        if (w->enOff >= h->stringsUsed || w->cnOff >= h->stringsUsed ||
+            w->keyOff >= h->stringsUsed || w->folderId >= (uint32_t)h->folderCount) return 0;
+        uint64_t keyCn = w->keyOff + strlen(strings + w->keyOff) + 1;
+        if (keyCn >= h->stringsUsed) return 0;
+    }
+    return 1;
+}
+
+/* snapPostingsValid：每個片段清單都在 pool 裡面，清單裡的單字索引也都在範圍內*/
+static int snapPostingsValid(const SnapHeader *h, const Posting *lists, const int32_t *pool) {
+    for (int i = 0; i < h->gramCount; i++) {
+        const Posting *p = &lists[i];
+        if (p->count < 0 || p->count > p->capacity ||
+            (uint64_t)p->off + (uint64_t)p->capacity > h->poolUsed) return 0;
+        for (int k = 0; k < p->count; k++) {
+            if (pool[p->off + (uint32_t)k] < 0 || pool[p->off + (uint32_t)k] >= h->wordCount) return 0;
+        }
+    }
+    return 1;
+}
+
+/* snapshotLoad：把快照檔對應到記憶體，讓單字庫和所有索引直接使用它
+   -------------------------------------------------------
+   只能在單字庫還是空的時候呼叫（程式一啟動時）。
+   除了檔頭和各區段的範圍，也會把每個單字、每格雜湊表、每個片段清單掃過一次，
+   確認裡面的位移和編號都沒有超出範圍（只是比大小，10 萬個單字也只要幾毫秒）；
+   有一個不對就整份不用，改讀文字檔。
+
+   參數：
+     path     → 快照檔名
+     checkTsv → 1 = 要確認快照和目前的 english_word.txt 對得上（啟動時用）；
+                0 = 不用確認（從別的快照檔匯入時用）
+     tsvHash  → 成功時填入快照對應的主檔指紋（給日誌核對用）
+
+   回傳值：1 = 成功；0 = 沒有快照、快照過期或格式不對（呼叫者改讀文字檔）*/
+int snapshotLoad(const char *path, int checkTsv, uint64_t *tsvHash) {
+    MappedFile m = {0};
+    if (!mapFile(path, &m)) return 0;
+    if (m.size < sizeof(SnapHeader)) {
+        unmapFile(&m);
+        return 0;
+    }
+
+    const SnapHeader *h = (const SnapHeader *)m.data;
+    int ok = memcmp(h->magic, SNAP_MAGIC, sizeof(SNAP_MAGIC)) == 0 &&
+             h->version == SNAP_VERSION && h->endian == SNAP_ENDIAN &&
+             h->sizeWord == sizeof(Word) && h->sizeSlot == sizeof(HashSlot) &&
+             h->sizePosting == sizeof(Posting) &&
+             h->wordCount >= 0 && h->folderCount >= 0 &&
+             h->gramCount >= 0;
+
+    if (ok && checkTsv) {
+        // 主檔被別的程式改過（大小或修改時間不同），這份快照就過期了
+        struct stat st;
+        ok = stat(WORD_FILE, &st) == 0 &&
+             (uint64_t)st.st_size == h->tsvSize && (int64_t)st.st_mtime == h->tsvMtime;
+    }
+
+    char *sec[SNAP_SECTIONS];
+    for (int i = 0; ok && i < SNAP_SECTIONS; i++) {
+        sec[i] = snapSection(&m, h, i);
+        ok = sec[i] != NULL;
+    }
+    ok = ok && h->sec[SEC_WORDS].size      == (uint64_t)h->wordCount * sizeof(Word)
+            && h->sec[SEC_STRINGS].size    == h->stringsUsed
+            && h->sec[SEC_FOLDERS].size    == (uint64_t)h->folderCount * sizeof(uint32_t)
+            && h->sec[SEC_FOLDER_NAMES].size == h->folderNamesUsed
+            && h->sec[SEC_GRAM_LISTS].size == (uint64_t)h->gramCount * sizeof(Posting)
+            && h->sec[SEC_GRAM_POOL].size  == (uint64_t)h->poolUsed * sizeof(int32_t)
+            && (h->stringsUsed == 0 || sec[SEC_STRINGS][h->stringsUsed - 1] == '\0')
+            && (h->folderNamesUsed == 0 || sec[SEC_FOLDER_NAMES][h->folderNamesUsed - 1] == '\0');
+
+    ok = ok && snapWordsValid(h, (const Word *)sec[SEC_WORDS], sec[SEC_STRINGS])
+            && snapPostingsValid(h, (const Posting *)sec[SEC_GRAM_LISTS], (const int32_t *)sec[SEC_GRAM_POOL]);
+
+    HashIndex restored[4];
+    const int hashSec[4]   = { SEC_IDX_EN, SEC_IDX_FOLDER_EN, SEC_IDX_FOLDER, SEC_GRAM_LOOKUP };
+    const int32_t limit[4] = { h->wordCount, h->wordCount, h->folderCount, h->gramCount };
+    for (int i = 0; ok && i < 4; i++) {
+        ok = snapHashRestore(&restored[i], &h->hashes[i], sec[hashSec[i]], h->sec[hashSec[i]].size, limit[i]);
+    }
+
+    // 資料夾登錄表要自己配置（members 會一直變動），名稱還是直接用快照檔裡的
+    Folder *items = NULL;
+    if (ok && h->folderCount > 0) {
+        items = calloc((size_t)h->folderCount, sizeof(Folder));
+        ok = items != NULL;
+        const uint32_t *offs = (const uint32_t *)sec[SEC_FOLDERS];
+        for (int i = 0; ok && i < h->folderCount; i++) {
+            ok = offs[i] < h->folderNamesUsed;
+            if (ok) items[i].nameOff = offs[i];
+        }
+    }
+    if (!ok) {
+        free(items);
+        unmapFile(&m);
+        return 0;
+    }
+
+    // 檢查都通過了，讓各個結構直接指向快照檔的內容（全部標成「借來的」）
+    library.words            = h->wordCount ? (Word *)sec[SEC_WORDS] : NULL;
+    library.count            = h->wordCount;
+    library.capacity         = h->wordCount;
+    library.borrowed         = h->wordCount > 0;
+    library.strings.data     = h->stringsUsed ? sec[SEC_STRINGS] : NULL;
+    library.strings.used     = (size_t)h->stringsUsed;
+    library.strings.capacity = (size_t)h->stringsUsed;
+    library.strings.garbage  = (size_t)h->stringsGarbage;
+    library.strings.borrowed = h->stringsUsed > 0;
+
+    memset(&folders, 0, sizeof(folders));
+    folders.items          = items;
+    folders.count          = h->folderCount;
+    folders.capacity       = h->folderCount;
+    folders.names.data     = h->folderNamesUsed ? sec[SEC_FOLDER_NAMES] : NULL;
+    folders.names.used     = (size_t)h->folderNamesUsed;
+    folders.names.capacity = (size_t)h->folderNamesUsed;
+    folders.names.borrowed = h->folderNamesUsed > 0;
+    folders.index          = restored[2];
+    folders.membersReady   = 0; // 第一次用到時才建，啟動時間不受單字數量影響
+
+    englishIndex       = restored[0];
+    folderEnglishIndex = restored[1];
+
+    memset(&textIndex, 0, sizeof(textIndex));
+    textIndex.lists       = h->gramCount ? (Posting *)sec[SEC_GRAM_LISTS] : NULL;
+    textIndex.count       = h->gramCount;
+    textIndex.capacity    = h->gramCount;
+    textIndex.pool        = h->poolUsed ? (int32_t *)sec[SEC_GRAM_POOL] : NULL;
+    textIndex.poolUsed    = h->poolUsed;
+    textIndex.poolCap     = h->poolUsed;
+    textIndex.poolGarbage = h->poolGarbage;
+    textIndex.lookup      = restored[3];
+    textIndex.borrowed    = 1;
+
+    *tsvHash = h->tsvHash;
+    snapMap  = m;
+    return 1;
+}
+
+/* snapshotRelease：解除快照檔的對應（要在所有結構都釋放之後才能呼叫）*/
+void snapshotRelease(void) {
+    unmapFile(&snapMap);
+}
+
+/* libraryFree：釋放單字庫、所有索引和快照檔（程式結束前呼叫）*/
+void libraryFree(void) {
+    storeFree(&library);
+    hashFree(&englishIndex);
+    hashFree(&folderEnglishIndex);
+    folderFree();
+    heapFree(&errorRank);
+    heapFree(&dueQueue);
+    heapFree(&newQueue);
+    weightFree(&errorWeights);
+    bkFree(&headwords);
+    sortedFree(&alphaOrder);
+    sortedFree(&folderAlphaOrder);
+    sortedFree(&folderGlossOrder);
+    distractorFree();
+    gramIndexFree(&textIndex);
+    changesFree();
+    statsFree();
+    snapshotRelease();
+}
+
+
+/* ================================================================
+   壓縮字典（english_word.dict）
+   ================================================================
+
+   快照檔是「記憶體原封不動」寫出去，啟動快，但每個單字都要存一份 Word、
+   英文和中文各存原文和 key，100 萬個單字就要上百 MB。
+   平板這種記憶體很少的機器，只需要「查得到」的參考字典的話，可以改用壓縮字典：
+
+   → 資料夾字典：資料夾名稱只存一次，每個單字只記一個小小的編號。
+   → 中文去重：同樣的中文解釋（例如「蘋果」）只存一次，每個單字只記解釋的編號。
+   → 英文前綴壓縮（front-coding）：英文按照 key 排好，每 DICT_BLOCK 個分成一塊，
+     塊裡每個字只存「和上一個字一樣的前幾個 byte 有幾個」加上後面不一樣的部分，
+     例如 apple、applet、apply → apple、(5)t、(4)y。
+   → 數字都用 varint（一個 byte 存 7 個 bit，小的數字只要 1 byte）。
+   → 每一塊的開頭都是完整的英文，而且另外記著每一塊從哪裡開始（blockOffs）：
+     要第 n 個單字就直接跳到第 n / DICT_BLOCK 塊，最多往下解 DICT_BLOCK - 1 個；
+     要查某個英文就先對「每一塊的第一個字」二分搜尋，再到那一塊裡往下找。
+
+   一個單字在塊裡的樣子（都是 varint，除了字串）：
+     [相同前綴長度] [後綴長度] [後綴] [資料夾編號×2 + 有沒有原文] ([原文] '\0') [中文編號] [錯誤次數]
+   → 英文存的是 key（正規化過）；原文和 key 不一樣（例如有大寫）才另外存原文。
+
+   整個檔案用 mapFile 對應到記憶體，查詢時直接在檔案內容裡解，
+   除了一個 DictCursor（不到 300 bytes），什麼都不用配置。
+   壓縮字典是唯讀的參考字典，不存複習排程；要改內容就匯入回單字庫（--import-dict）再匯出。
+   ================================================================ */
+
+/* dictPutVarint：把 v 用 varint 接在 b 後面（每個 byte 存 7 個 bit，最高位元 = 後面還有）*/
+static void dictPutVarint(TextBuf *b, uint32_t v) {
+    char tmp[5];
+    int  n = 0;
+    while (v >= 0x80) {
+        tmp[n++] = (char)(v | 0x80);
+        v >>= 7;
+    }
+    tmp[n++] = (char)v;
+    textAppend(b, tmp, (size_t)n);
+}
+
+/* dictGetVarint：從 *p 讀一個 varint（不會讀超過 end）
+   回傳值：1 = 成功，0 = 資料壞了*/
+static int dictGetVarint(const uint8_t **p, const uint8_t *end, uint32_t *v) {
+    uint32_t x = 0;
+    for (int shift = 0; shift < 35 && *p < end; shift += 7) {
+        uint8_t c = *(*p)++;
+        x |= (uint32_t)(c & 0x7f) << shift;
+        if (!(c & 0x80)) {
+            *v = x;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* dictOrder：qsort 用的比較函數，照英文 key 排，一樣的話照資料夾、再照原本的順序*/
+static int dictOrder(const void *a, const void *b) {
+    int x = *(const int *)a, y = *(const int *)b;
+    int c = strcmp(wordKeyEn(x), wordKeyEn(y));
+    if (c != 0) return c;
+    if (library.words[x].folderId != library.words[y].folderId) {
+        return library.words[x].folderId < library.words[y].folderId ? -1 : 1;
+    }
+    return (x > y) - (x < y);
+}
+
+/* dictSave：把目前的單字庫寫成壓縮字典
+   -------------------------------------------------------
+   一樣先寫到暫存檔、確定寫到磁碟之後再改名。
+   英文 key 超過 DICT_KEY_MAX 的單字（正常的字不會這麼長）會略過。
+
+   回傳值：寫進去幾個單字；失敗時回傳 -1*/
+int dictSave(const char *path) {
+    int n = library.count;
+    int      *order     = malloc((size_t)(n ? n : 1) * sizeof(int));
+    int      *glossOf   = malloc((size_t)(n ? n : 1) * sizeof(int)); // glossOf[idx]：第 idx 個單字的中文編號
+    uint32_t *folderOff = malloc((size_t)(folders.count ? folders.count : 1) * sizeof(uint32_t));
+    uint32_t *blockOffs = malloc((size_t)(n / DICT_BLOCK + 1) * sizeof(uint32_t));
+    IdList    glossFirst = {0};  // glossFirst.ids[g]：第一個用到第 g 種中文的單字
+    HashIndex glossIndex = {0};  // 中文 → 中文編號
+    TextBuf   names = {0}, glossOffs = {0}, glosses = {0}, blocks = {0};
+    int ok = order && glossOf && folderOff && blockOffs;
+
+    for (int f = 0; ok && f < folders.count; f++) {
+        folderOff[f] = (uint32_t)names.len;
+        textAppend(&names, folderName(f), strlen(folderName(f)) + 1);
+    }
+
+    // 中文去重：一樣的中文只給一個編號，字串只存一次
+    for (int i = 0; ok && i < n; i++) {
+        const char *cn = wordChinese(i);
+        uint32_t hash = keyHash(cn);
+        uint32_t pos  = hash;
+        int g;
+        while ((g = hashNext(&glossIndex, hash, &pos)) >= 0) {
+            if (strcmp(wordChinese(glossFirst.ids[g]), cn) == 0) break;
+        }
+        if (g < 0) {
+            g = glossFirst.count;
+            uint32_t off = (uint32_t)glosses.len;
+            ok = idListPush(&glossFirst, i);
+            hashInsert(&glossIndex, hash, g);
+            textAppend(&glossOffs, (const char *)&off, sizeof(off));
+            textAppend(&glosses, cn, strlen(cn) + 1);
+        }
+        glossOf[i] = g;
+    }
+
+    // 英文照 key 排好，每 DICT_BLOCK 個一塊做前綴壓縮
+    int kept = 0, skipped = 0;
+    if (ok) {
+        for (int i = 0; i < n; i++) order[i] = i;
+        qsort(order, (size_t)n, sizeof(int), dictOrder);
+    }
+    const char *prev = "";
+    for (int k = 0; ok && k < n; k++) {
+        int i = order[k];
+        const char *key = wordKeyEn(i);
+        size_t len = strlen(key);
+        if (len >= DICT_KEY_MAX) {
+            skipped++;
+            continue;
+        }
+        size_t shared = 0;
+        if (kept % DICT_BLOCK == 0) {
+            blockOffs[kept / DICT_BLOCK] = (uint32_t)blocks.len; // 每一塊的第一個字存完整的英文
+        } else {
+            while (prev[shared] && prev[shared] == key[shared]) shared++;
+        }
+        int display = strcmp(wordEnglish(i), key) != 0;
+        dictPutVarint(&blocks, (uint32_t)shared);
+        dictPutVarint(&blocks, (uint32_t)(len - shared));
+        textAppend(&blocks, key + shared, len - shared);
+        dictPutVarint(&blocks, library.words[i].folderId * 2 + (uint32_t)display);
+        if (display) textAppend(&blocks, wordEnglish(i), strlen(wordEnglish(i)) + 1);
+        dictPutVarint(&blocks, (uint32_t)glossOf[i]);
+        dictPutVarint(&blocks, (uint32_t)library.words[i].errorCount);
+        prev = key;
+        kept++;
+    }
+    ok = ok && !names.failed && !glossOffs.failed && !glosses.failed && !blocks.failed &&
+         blocks.len <= UINT32_MAX && glosses.len <= UINT32_MAX;
+
+    char tmpPath[1024];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+    FILE *fp = ok ? fopen(tmpPath, "wb") : NULL;
+    DictHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, DICT_MAGIC, sizeof(DICT_MAGIC));
+    h.version     = DICT_VERSION;
+    h.endian      = SNAP_ENDIAN;
+    h.wordCount   = kept;
+    h.folderCount = folders.count;
+    h.glossCount  = glossFirst.count;
+    h.blockCount  = (kept + DICT_BLOCK - 1) / DICT_BLOCK;
+
+    // 和快照檔一樣：先寫一個空的檔頭佔位置，區段都寫完之後再回來重寫
+    uint64_t pos = sizeof(h);
+    ok = fp && fwrite(&h, sizeof(h), 1, fp) == 1;
+    ok = ok && snapWriteSection(fp, &h.sec[DSEC_FOLDER_OFFS], folderOff,
+                                (size_t)folders.count * sizeof(uint32_t), &pos);
+    ok = ok && snapWriteSection(fp, &h.sec[DSEC_FOLDER_NAMES], names.data, names.len, &pos);
+    ok = ok && snapWriteSection(fp, &h.sec[DSEC_GLOSS_OFFS], glossOffs.data, glossOffs.len, &pos);
+    ok = ok && snapWriteSection(fp, &h.sec[DSEC_GLOSSES], glosses.data, glosses.len, &pos);
+    ok = ok && snapWriteSection(fp, &h.sec[DSEC_BLOCK_OFFS], blockOffs,
+                                (size_t)h.blockCount * sizeof(uint32_t), &pos);
+    ok = ok && snapWriteSection(fp, &h.sec[DSEC_BLOCKS], blocks.data, blocks.len, &pos);
+    ok = ok && fseek(fp, 0, SEEK_SET) == 0 && fwrite(&h, sizeof(h), 1, fp) == 1;
+
+    free(order);
+    free(glossOf);
+    free(folderOff);
+    free(blockOffs);
+    free(glossFirst.ids);
+    hashFree(&glossIndex);
+    free(names.data);
+    free(glossOffs.data);
+    free(glosses.data);
+    free(blocks.data);
+    if (fp) {
+        syncFile(fp);
+        ok = ok && !ferror(fp);
+        fclose(fp);
+    }
+    if (!ok) {
+        if (fp) remove(tmpPath);
+        return -1;
+    }
+#ifdef _WIN32
+    remove(path);
+#endif
+    if (rename(tmpPath, path) != 0) return -1;
+    metricCount(&metrics.bytesWritten, pos);
+    if (skipped) printf("[Warning] 有 %d 個單字的英文太長，沒有寫進壓縮字典。\n", skipped);
+    return kept;
+}
+
+/* dictSection：取得壓縮字典一個區段的位置；超出檔案範圍，或大小不是 unit 的倍數時回傳 NULL*/
+static const char *dictSection(const MappedFile *m, const DictHeader *h, int sec, size_t unit) {
+    const SnapSection *s = &h->sec[sec];
+    if (s->off % 8 != 0 || s->off > m->size || s->size > m->size - s->off || s->size % unit != 0) {
+        return NULL;
+    }
+    return m->data + s->off;
+}
+
+/* dictOpen：把壓縮字典對應到記憶體
+   -------------------------------------------------------
+   只檢查檔頭和各區段的範圍；每一塊裡面的內容在解的時候（dictNext）才檢查，
+   所以不管字典多大，開啟都只碰到檔頭那一頁。
+
+   回傳值：1 = 成功，0 = 沒有這個檔案或格式不對*/
+int dictOpen(const char *path, CompactDict *d) {
+    memset(d, 0, sizeof(*d));
+    if (!mapFile(path, &d->map)) return 0;
+    const DictHeader *h = (const DictHeader *)d->map.data;
+    int ok = d->map.size >= sizeof(DictHeader) &&
+             memcmp(h->magic, DICT_MAGIC, sizeof(DICT_MAGIC)) == 0 &&
+             h->version == DICT_VERSION && h->endian == SNAP_ENDIAN &&
+             h->wordCount >= 0 && h->folderCount >= 0 && h->glossCount >= 0 &&
+             h->blockCount == (h->wordCount + DICT_BLOCK - 1) / DICT_BLOCK;
+    const char *sec[DICT_SECTIONS];
+    const size_t unit[DICT_SECTIONS] = { sizeof(uint32_t), 1, sizeof(uint32_t), 1, sizeof(uint32_t), 1 };
+    for (int i = 0; ok && i < DICT_SECTIONS; i++) {
+        sec[i] = dictSection(&d->map, h, i, unit[i]);
+        ok = sec[i] != NULL;
+    }
+    ok = ok && h->sec[DSEC_FOLDER_OFFS].size == (uint64_t)h->folderCount * sizeof(uint32_t)
+            && h->sec[DSEC_GLOSS_OFFS].size  == (uint64_t)h->glossCount * sizeof(uint32_t)
+            && h->sec[DSEC_BLOCK_OFFS].size  == (uint64_t)h->blockCount * sizeof(uint32_t)
+            && (h->sec[DSEC_FOLDER_NAMES].size == 0 || sec[DSEC_FOLDER_NAMES][h->sec[DSEC_FOLDER_NAMES].size - 1] == '\0')
+            && (h->sec[DSEC_GLOSSES].size == 0 || sec[DSEC_GLOSSES][h->sec[DSEC_GLOSSES].size - 1] == '\0');
+    if (!ok) {
+        unmapFile(&d->map);
+        return 0;
+    }
+    d->h          = h;
+    d->folderOffs = (const uint32_t *)sec[DSEC_FOLDER_OFFS];
+    d->folderNames = sec[DSEC_FOLDER_NAMES];
+    d->glossOffs  = (const uint32_t *)sec[DSEC_GLOSS_OFFS];
+    d->glosses    = sec[DSEC_GLOSSES];
+    d->blockOffs  = (const uint32_t *)sec[DSEC_BLOCK_OFFS];
+    d->blocks     = (const uint8_t *)sec[DSEC_BLOCKS];
+    return 1;
+}
+
+/* dictClose：解除壓縮字典的對應*/
+void dictClose(CompactDict *d) {
+    unmapFile(&d->map);
+    memset(d, 0, sizeof(*d));
+}
+
+/* dictBlockEnd：第 b 塊在 blocks 裡的結尾*/
+static const uint8_t *dictBlockEnd(const CompactDict *d, int b) {
+    uint64_t size = d->h->sec[DSEC_BLOCKS].size;
+    uint64_t end  = b + 1 < d->h->blockCount ? d->blockOffs[b + 1] : size;
+    return d->blocks + (end <= size ? end : size);
+}
+
+/* dictNext：解出下一個單字，放進 c 的各個欄位
+   回傳值：1 = 成功，0 = 已經沒有了（或是資料壞了）*/
+int dictNext(DictCursor *c) {
+    const CompactDict *d = c->d;
+    if (c->ordinal >= d->h->wordCount) return 0;
+    int b = c->ordinal / DICT_BLOCK;
+    if (c->ordinal % DICT_BLOCK == 0) {
+        // 新的一塊：從 blockOffs 跳過去，英文從頭開始
+        if (d->blockOffs[b] > d->h->sec[DSEC_BLOCKS].size) return 0;
+        c->p      = d->blocks + d->blockOffs[b];
+        c->keyLen = 0;
+    }
+    const uint8_t *end = dictBlockEnd(d, b);
+    uint32_t shared, suffix, folderTag, gloss, errors;
+    if (!dictGetVarint(&c->p, end, &shared) || !dictGetVarint(&c->p, end, &suffix)) return 0;
+    if (shared > (uint32_t)c->keyLen || suffix >= DICT_KEY_MAX - shared ||
+        suffix > (size_t)(end - c->p)) {
+        return 0;
+    }
+    memcpy(c->key + shared, c->p, suffix);
+    c->p += suffix;
+    c->keyLen = (int)(shared + suffix);
+    c->key[c->keyLen] = '\0';
+
+    if (!dictGetVarint(&c->p, end, &folderTag) || (folderTag >> 1) >= (uint32_t)d->h->folderCount) return 0;
+    c->english = c->key;
+    if (folderTag & 1) {
+        const uint8_t *z = memchr(c->p, '\0', (size_t)(end - c->p));
+        if (!z) return 0;
+        c->english = (const char *)c->p;
+        c->p = z + 1;
+    }
+    if (!dictGetVarint(&c->p, end, &gloss) || gloss >= (uint32_t)d->h->glossCount ||
+        !dictGetVarint(&c->p, end, &errors)) {
+        return 0;
+    }
+    uint32_t folderOff = d->folderOffs[folderTag >> 1];
+    uint32_t glossOff  = d->glossOffs[gloss];
+    if (folderOff >= d->h->sec[DSEC_FOLDER_NAMES].size || glossOff >= d->h->sec[DSEC_GLOSSES].size) return 0;
+    c->folder     = d->folderNames + folderOff;
+    c->chinese    = d->glosses + glossOff;
+    c->errorCount = (int)errors;
+    c->ordinal++;
+    return 1;
+}
+
+/* dictSeek：讓 c 的下一個 dictNext 解出第 ordinal 個單字（跳到那一塊，再往下解幾個）*/
+void dictSeek(DictCursor *c, const CompactDict *d, int ordinal) {
+    c->d       = d;
+    c->ordinal = ordinal - ordinal % DICT_BLOCK;
+    c->keyLen  = 0;
+    while (c->ordinal < ordinal && dictNext(c)) {}
+    c->ordinal = ordinal; // 中間壞掉的話，之後的 dictNext 會自己失敗
+}
+
+/* dictFirstKey：第 b 塊第一個字的英文（完整的，不是壓縮過的）
+   回傳值：英文的位置（沒有 '\0'，長度放進 *len）；資料壞了回傳 NULL*/
+static const char *dictFirstKey(const CompactDict *d, int b, uint32_t *len) {
+    const uint8_t *end = dictBlockEnd(d, b);
+    if (d->blockOffs[b] > d->h->sec[DSEC_BLOCKS].size) return NULL;
+    const uint8_t *p = d->blocks + d->blockOffs[b];
+    uint32_t shared;
+    if (!dictGetVarint(&p, end, &shared) || !dictGetVarint(&p, end, len) || *len > (size_t)(end - p)) {
+        return NULL;
+    }
+    return (const char *)p;
+}
+
+/* dictLowerBound：第一個英文 key >= key 的單字是第幾個（都比 key 小就回傳單字總數）
+   -------------------------------------------------------
+   先對每一塊的第一個字二分搜尋，找出「第一個字 <= key」的最後一塊，
+   答案一定在這一塊裡，或是下一塊的第一個字。*/
+int dictLowerBound(const CompactDict *d, const char *key) {
+    size_t keyLen = strlen(key);
+    int lo = 0, hi = d->h->blockCount; // 找第一個「第一個字 > key」的塊
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        uint32_t len;
+        const char *first = dictFirstKey(d, mid, &len);
+        if (!first) return d->h->wordCount;
+        int c = memcmp(first, key, len < keyLen ? len : keyLen);
+        if (c < 0 || (c == 0 && len <= keyLen)) lo = mid + 1;
+        else hi = mid;
+    }
+    int ordinal = lo > 0 ? (lo - 1) * DICT_BLOCK : 0;
+    DictCursor c;
+    dictSeek(&c, d, ordinal);
+    while (dictNext(&c)) {
+        if (strcmp(c.key, key) >= 0) return c.ordinal - 1;
+    }
+    return c.ordinal;
+}
+
+/* dictLookup：參考字典模式（--lookup）：一直讀查詢，直到 end 或是輸入結束
+   -------------------------------------------------------
+   不讀 english_word.txt，也不建任何索引，只用 dictOpen 對應到記憶體的壓縮字典，
+   記憶體只要作業系統實際讀進來的那幾頁。
+   打完整的英文就列出這個字；最後加 *（例如 app*）就列出開頭是 app 的字（最多 LIST_PAGE 個）。
+
+   回傳值：給 main 回傳的結束代碼（0 = 正常結束）*/
+int dictLookup(const char *path) {
+    CompactDict d;
+    if (!dictOpen(path, &d)) {
+        printf("[Error] 無法讀取壓縮字典：%s\n", path);
+        return 1;
+    }
+    printf("壓縮字典：%d 個單字、%d 個資料夾、%d 種中文解釋（%.1f MB）。輸入 end 結束。\n",
+           d.h->wordCount, d.h->folderCount, d.h->glossCount, d.map.size / 1048576.0);
+
+    char  *query = NULL;
+    size_t cap   = 0;
+    while (1) {
+        printf("\n查詢：");
+        if (inputText(&query, &cap) < 0) break;
+        if (strcmp(query, "end") == 0) break;
+        size_t len = strlen(query);
+        int prefix = len > 0 && query[len - 1] == '*';
+        if (prefix) query[--len] = '\0';
+        normalizeText(query, query);
+        len = strlen(query);
+        if (len == 0) continue;
+
+        DictCursor c;
+        int shown = 0;
+        dictSeek(&c, &d, dictLowerBound(&d, query));
+        while (dictNext(&c) && strncmp(c.key, query, len) == 0) {
+            if (!prefix && c.key[len] != '\0') break;
+            if (shown == LIST_PAGE) {
+                printf("  ……還有更多，請打長一點的開頭。\n");
+                break;
+            }
+            printf("  [%s]  %-20s ／ %s\n", c.folder, c.english, c.chinese);
+            shown++;
+        }
+        if (shown == 0) printf("  字典裡沒有「%s」。\n", query);
+    }
+    printf("\n");
+    free(query);
+    dictClose(&d);
+    return 0;
+}
+
+/* dictImport：把壓縮字典裡的單字全部加進單字庫（--import-dict 用）
+   回傳值：加了幾個單字；檔案讀不了回傳 -1*/
+int dictImport(const char *path) {
+    CompactDict d;
+    if (!dictOpen(path, &d)) return -1;
+    DictCursor c;
+    int added = 0;
+    dictSeek(&c, &d, 0);
+    while (dictNext(&c)) {
+        int f = folderIntern(c.folder);
+        if (f >= 0 && libraryAdd(f, c.english, c.chinese, c.errorCount) >= 0) added++;
+    }
+    if (c.ordinal < d.h->wordCount) printf("[Warning] 壓縮字典從第 %d 個單字之後壞掉了，後面的沒有匯入。\n", c.ordinal + 1);
+    dictClose(&d);
+    return added;
+}
+
+
+/* ================================================================
+   大量匯入（多執行緒解析 TSV）
+   ================================================================
+   一次匯入好幾 MB 的單字表時，一行一行 fgets + parseLine 只會用到一個 CPU 核心。
+   bulkImport 的做法：
+     1. 用 mapFile 把整個檔案對應到記憶體（不用一行一行讀）
+     2. 依照 CPU 核心數切成幾塊，每一塊都在 '\n' 後面切，不會把一行切成兩半
+     3. 每個執行緒解析自己那一塊，結果只記錄欄位的位置（TextView），不複製字串；
+        拆欄位之前先檢查這一行是不是合法的 UTF-8（utf8Valid），不是的話整行略過，
+        不會把 Big5 之類的亂碼、被切一半的中文字存進單字庫
+     4. 全部解析完之後，主執行緒再照檔案順序一筆一筆加進單字庫
+   第 4 步一定要照順序、一次一個做，因為單字的索引必須和檔案的行數順序一致
+   （寫入日誌靠索引記錄刪除和答錯）。*/
+
+/* ThreadHandle / threadStart / threadJoin：開執行緒、等執行緒結束
+   -------------------------------------------------------
+   POSIX（Linux、macOS）用 pthread，Windows 用 CreateThread，
+   包一層小函數，其他地方就不用管是哪一種系統。*/
+typedef void *(*ThreadFunc)(void *arg);
+#ifdef _WIN32
+typedef HANDLE ThreadHandle;
+
+typedef struct {
+    ThreadFunc fn;
+    void      *arg;
+} ThreadStart;
+
+static DWORD WINAPI threadTrampoline(LPVOID p) {
+    ThreadStart start = *(ThreadStart *)p;
+    free(p);
+    start.fn(start.arg);
+    return 0;
+}
+
+static int threadStart(ThreadHandle *t, ThreadFunc fn, void *arg) {
+    ThreadStart *start = malloc(sizeof(ThreadStart));
+    if (!start) return 0;
+    start->fn  = fn;
+    start->arg = arg;
+    *t = CreateThread(NULL, 0, threadTrampoline, start, 0, NULL);
+    if (!*t) free(start);
+    return *t != NULL;
+}
+
+static void threadJoin(ThreadHandle t) {
+    WaitForSingleObject(t, INFINITE);
+    CloseHandle(t);
+}
+#else
+typedef pthread_t ThreadHandle;
+
+static int threadStart(ThreadHandle *t, ThreadFunc fn, void *arg) {
+    return pthread_create(t, NULL, fn, arg) == 0;
+}
+
+static void threadJoin(ThreadHandle t) {
+    pthread_join(t, NULL);
+}
+#endif
+
+/* cpuCount：這台電腦有幾個 CPU 核心可以用*/
+int cpuCount(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+#endif
+}
+
+/* importWorker：一個執行緒的工作，解析自己分到的那一塊
+   -------------------------------------------------------
+   只讀、不寫檔案內容，也不碰 library，所以好幾個執行緒同時跑也不會互相干擾。*/
+static void *importWorker(void *arg) {
+    ImportChunk *c = arg;
+    char *p = c->begin;
+
+    while (p < c->end) {
+        char *nl  = memchr(p, '\n', (size_t)(c->end - p));
+        char *end = nl ? nl : c->end;
+        LineFields f;
+
+        if (!utf8Valid(p, (size_t)(end - p))) {
+            c->invalid++;
+        } else if (splitFields(p, end, &f)) {
+            if (c->count == c->capacity) {
+                int newCap = c->capacity ? c->capacity * 2 : 1024;
+                LineFields *q = realloc(c->lines, (size_t)newCap * sizeof(LineFields));
+                if (!q) { c->failed = 1; break; }
+                c->lines    = q;
+                c->capacity = newCap;
+            }
+            c->lines[c->count++] = f;
+        }
+        p = end + 1;
+    }
+    return NULL;
+}
+
+/* bulkImport：把一個 TSV 檔案整個匯入 library
+   -------------------------------------------------------
+   每一行的格式和 english_word.txt 一樣，一行多長都可以（不受 LINE_BUF 限制）。
+
+   參數：
+     path           → 要匯入的檔案
+     skipDuplicates → 1 = 同一個資料夾裡已經有一模一樣的單字就跳過（匯入廠商單字表用）；
+                      0 = 全部照檔案加進來（讀主檔用）
+     hash           → 不是 NULL 的話，傳入起始值，回傳加上整個檔案內容之後的指紋
+     added          → 不是 NULL 的話，回傳實際加了幾個單字
+
+   回傳值：1 = 成功讀到檔案（檔案是空的也算），0 = 檔案打不開*/
+int bulkImport(const char *path, int skipDuplicates, uint64_t *hash, int *added) {
+    MappedFile m = {0};
+    if (added) *added = 0;
+    if (!mapFile(path, &m)) {
+        // mapFile 遇到空檔案也會失敗，空檔案就當作成功讀完
+        FILE *fp = fopen(path, "r");
+        if (!fp) return 0;
+        fclose(fp);
+        return 1;
+    }
+
+    // 最後一行如果沒有 '\n'，它的最後一個欄位後面就沒有位置放 '\0'，
+    // 所以另外複製一份出來，最後再用 parseLine 處理
+    char *tailStart = m.data + m.size;
+    while (tailStart > m.data && tailStart[-1] != '\n') tailStart--;
+    size_t tailLen = (size_t)(m.data + m.size - tailStart);
+
+    // 決定要開幾個執行緒：核心數，但每個執行緒至少要分到 IMPORT_MIN_CHUNK
+    size_t body = (size_t)(tailStart - m.data);
+    int threads = cpuCount();
+    if (threads > IMPORT_MAX_THREADS) threads = IMPORT_MAX_THREADS;
+    if ((size_t)threads > body / IMPORT_MIN_CHUNK) threads = (int)(body / IMPORT_MIN_CHUNK);
+    if (threads < 1) threads = 1;
+
+    // 切塊：每一塊的結尾往後找到 '\n' 為止
+    ImportChunk chunks[IMPORT_MAX_THREADS];
+    memset(chunks, 0, sizeof(chunks));
+    char *p = m.data;
+    for (int i = 0; i < threads; i++) {
+        char *end = (i == threads - 1) ? tailStart : m.data + body / (size_t)threads * (size_t)(i + 1);
+        if (end < p) end = p;
+        while (end < tailStart && end[-1] != '\n') end++;
+        chunks[i].begin = p;
+        chunks[i].end   = end;
+        p = end;
+    }
+
+    // 第一塊由主執行緒自己做；主執行緒做完還要算指紋（FNV 只能從頭算到尾，沒辦法分工）
+    ThreadHandle handles[IMPORT_MAX_THREADS];
+    int started[IMPORT_MAX_THREADS] = {0};
+    for (int i = 1; i < threads; i++) {
+        started[i] = threadStart(&handles[i], importWorker, &chunks[i]);
+    }
+    importWorker(&chunks[0]);
+    if (hash) *hash = fnvHash(*hash, m.data, m.size);
+    for (int i = 1; i < threads; i++) {
+        if (started[i]) threadJoin(handles[i]);
+        else            importWorker(&chunks[i]); // 開不了執行緒就自己做
+    }
+
+    // 照檔案順序加進單字庫。先把空間一次配置好，避免一直倍增搬資料
+    int total = 0;
+    for (int i = 0; i < threads; i++) total += chunks[i].count;
+    storeReserve(&library, library.count + total + 1, library.strings.used + m.size + tailLen + 2);
+
+    int        count = 0, invalid = 0;
+    LineFields last;            // 上一行的資料夾（給 addFields 省掉重複查詢）
+    int        lastId = -1;
+    memset(&last, 0, sizeof(last));
+    for (int i = 0; i < threads; i++) {
+        ImportChunk *c = &chunks[i];
+        if (c->failed) printf("[Error] 記憶體不足，%s 有部分內容沒有匯入。\n", path);
+        invalid += c->invalid;
+        for (int j = 0; j < c->count; j++) {
+            if (addFields(&c->lines[j], skipDuplicates, &last, &lastId) >= 0) count++;
+        }
+        free(c->lines);
+    }
+
+    if (tailLen > 0) {
+        char *line = malloc(tailLen + 1);
+        LineFields f;
+        if (line) {
+            memcpy(line, tailStart, tailLen);
+            line[tailLen] = '\0';
+            if (!utf8Valid(line, tailLen)) invalid++;
+            else if (splitFields(line, line + tailLen, &f) &&
+                     addFields(&f, skipDuplicates, NULL, NULL) >= 0) count++;
+            free(line);
+        }
+    }
+
+    unmapFile(&m);
+    if (invalid) printf("[Warning] %s 有 %d 行不是 UTF-8 編碼（可能是用 Big5 存的），已略過。\n", path, invalid);
+    if (added) *added = count;
+    return 1;
+}
+
+
+/* ================================================================
+   寫入日誌（Journal）
+   ================================================================
+
+   為什麼需要日誌？
+   → 舊版每新增一個單字就把整個 english_word.txt 重寫一次，
+     新增 N 個單字要寫 1 + 2 + ... + N 行，也就是 O(N²)。
+   → 現在每一筆變更只在 english_word.journal 後面「追加」一行：
+       A [Tab] 資料夾 [Tab] 英文 [Tab] 中文 [Tab] 錯誤次數   ← 新增
+       D [Tab] 索引 [Tab] 英文                             ← 刪除
+       E [Tab] 索引 [Tab] 增加的錯誤次數                     ← 答錯
+     每攢滿 JOURNAL_BATCH 筆（或一個動作結束）才真正寫到磁碟一次。
+   → 日誌超過 JOURNAL_COMPACT_AT 筆時重寫主檔，日誌清空重來（這叫「壓縮」）。
+   → 選單模式裡，真正寫檔、fsync、壓縮都交給背景寫入執行緒（見下一段），
+     這裡的函數只是把紀錄排好交給它，不會等磁碟。
+
+   日誌第一行記錄主檔的指紋（fnvHash）：
+     #journal [Tab] 指紋
+   如果壓縮時剛好在「主檔已換新、日誌還沒清空」的瞬間當機，
+   下次啟動時指紋就對不上，這份舊日誌會被忽略，不會重複套用。
+   ================================================================ */
+
+/* journalCreate：開一份全新的空日誌檔，寫好第一行的指紋
+   只碰檔案、不碰 journal 的計數，所以背景寫入執行緒壓縮完也可以用它開新日誌。
+
+   回傳值：開好的日誌檔；失敗時回傳 NULL*/
+static FILE *journalCreate(uint64_t baseHash) {
+    FILE *fp = fopen(JOURNAL_FILE, "w");
+    if (!fp) {
+        printf("[Error] 無法建立日誌檔 %s，之後的變更只會在離開時儲存。\n", JOURNAL_FILE);
+        return NULL;
+    }
+    fprintf(fp, "#journal\t%016llx\n", (unsigned long long)baseHash);
+    syncFile(fp);
+    return fp;
+}
+
+/* journalReset：建立一份全新的空日誌，對應指紋為 baseHash 的主檔*/
+void journalReset(uint64_t baseHash) {
+    if (journal.fp) fclose(journal.fp);
+    journal.fp      = journalCreate(baseHash);
+    journal.records = 0;
+    journal.pending = 0;
+}
+
+/* journalReplay：啟動時把日誌裡的變更依序套用到 library
+   -------------------------------------------------------
+   為什麼刪除、答錯可以用「索引」記錄？
+   → 每次啟動都是先讀同一份主檔（指紋相同），再照同樣順序套用同樣的變更，
+     所以每一步的 library 都和當初寫日誌時一模一樣，索引也就一樣。
+   → 刪除紀錄另外附上英文，重播時核對一下，萬一對不上就停止重播，不會刪錯字。
+
+   參數：
+     baseHash → 剛讀完的主檔指紋，要和日誌第一行的指紋相同才會重播*/
+void journalReplay(uint64_t baseHash) {
+    FILE *fp = fopen(JOURNAL_FILE, "r");
+    int applied = 0;
+    int broken  = 0; // 日誌有沒有壞掉（例如最後一行只寫了一半就當機）
+
+    char  *line = NULL; // readLine 會依照每一行的長度自動加大
+    size_t cap  = 0;
+    long   len;
+
+    if (fp) {
+        unsigned long long fileHash = 0;
+        if (readLine(fp, &line, &cap) < 0 ||
+            sscanf(line, "#journal\t%llx", &fileHash) != 1 ||
+            fileHash != baseHash) {
+            // 指紋對不上：這是已經壓縮進主檔的舊日誌，直接忽略
+            fclose(fp);
+            fp = NULL;
+        }
+    }
+
+    if (fp) {
+        while ((len = readLine(fp, &line, &cap)) >= 0) {
+            // 沒有 '\n' 結尾 = 這一行沒寫完，後面都不可信
+            if (line[len - 1] != '\n') { broken = 1; break; }
+
+            if (line[0] == 'A' && line[1] == '\t') {
+                if (parseLine(line + 2) < 0) { broken = 1; break; }
+            } else if (line[0] == 'D' && line[1] == '\t') {
+                char *en  = NULL;
+                long  idx = strtol(line + 2, &en, 10);
+                if (*en != '\t' || idx < 0 || idx >= library.count) { broken = 1; break; }
+                en++;
+                en[strcspn(en, "\r\n")] = '\0';
+                if (strcmp(wordEnglish((int)idx), en) != 0) { broken = 1; break; }
+                libraryRemove((int)idx);
+            } else if (line[0] == 'E' && line[1] == '\t') {
+                int idx, delta;
+                if (sscanf(line + 2, "%d\t%d", &idx, &delta) != 2 ||
+                    idx < 0 || idx >= library.count) { broken = 1; break; }
+                libraryAddError(idx, delta);
+            } else if (line[0] == 'R' && line[1] == '\t') {
+                int idx;
+                unsigned due, last, interval, ease, reps, lapses;
+                if (sscanf(line + 2, "%d\t%u\t%u\t%u\t%u\t%u\t%u", &idx, &due, &last,
+                           &interval, &ease, &reps, &lapses) != 7 ||
+                    idx < 0 || idx >= library.count) { broken = 1; break; }
+                Review rv = { due, last, (uint16_t)interval, (uint16_t)ease,
+                              (uint16_t)reps, (uint16_t)lapses };
+                librarySetReview(idx, &rv);
+            } else {
+                broken = 1;
+                break;
+            }
+            applied++;
+        }
+        fclose(fp);
+    }
+    free(line);
+
+    if (broken) {
+        printf("[Warning] 日誌最後有不完整的紀錄，已套用前面 %d 筆，其餘略過。\n", applied);
+    }
+
+    if (broken || applied >= JOURNAL_COMPACT_AT) {
+        // 日誌壞了或太長：直接把目前狀態寫成新的主檔，順便開一份乾淨的日誌
+        if (saveToFile()) return;
+    }
+
+    // 日誌正常：繼續接在後面寫；沒有日誌（或是舊的）就開一份新的
+    if (applied > 0 && !broken) {
+        journal.fp      = fopen(JOURNAL_FILE, "a");
+        journal.records = applied;
+        journal.pending = 0;
+        if (journal.fp) return;
+    }
+    journalReset(baseHash);
+}
+
+/* journalWrite：把一筆紀錄（和 printf 一樣的格式）寫進日誌
+   -------------------------------------------------------
+   背景寫入執行緒開著的話，先把紀錄排成一行文字交給它（persistAppend），馬上回來；
+   沒開的話（匯入模式、或是寫入執行緒開不起來）就和以前一樣直接寫進 journal.fp。
+
+   為什麼要呼叫兩次 vsnprintf？
+   → 第一次給 NULL、長度 0，它只會回傳「排好之後有多長」，
+     照這個長度 malloc 剛好的大小，第二次才真的排進去，多長的單字都放得下。*/
+static void journalWrite(const char *fmt, ...) {
+    va_list ap;
+    if (!persistRunning()) {
+        if (!journal.fp) return;
+        va_start(ap, fmt);
+        int len = vfprintf(journal.fp, fmt, ap);
+        va_end(ap);
+        if (len > 0) metricCount(&metrics.bytesWritten, (uint64_t)len);
+    } else {
+        va_start(ap, fmt);
+        int len = vsnprintf(NULL, 0, fmt, ap);
+        va_end(ap);
+        char *text = len >= 0 ? malloc((size_t)len + 1) : NULL;
+        if (!text) {
+            printf("[Error] 記憶體不足，這筆變更要等離開程式時才會儲存。\n");
+            return;
+        }
+        va_start(ap, fmt);
+        vsnprintf(text, (size_t)len + 1, fmt, ap);
+        va_end(ap);
+        persistAppend(text, (size_t)len);
+    }
+    journal.records++;
+    journal.pending++;
+    metricCount(&metrics.journalRecords, 1);
+}
+
+/* journalAppendAdd：記錄「新增了第 idx 個單字」*/
+void journalAppendAdd(int idx) {
+    journalWrite("A\t%s\t%s\t%s\t%d\n",
+                 wordFolder(idx), wordEnglish(idx), wordChinese(idx),
+                 library.words[idx].errorCount);
+}
+
+/* journalAppendDelete：記錄「刪除了第 idx 個單字」（要在真正刪除之前呼叫）*/
+void journalAppendDelete(int idx) {
+    journalWrite("D\t%d\t%s\n", idx, wordEnglish(idx));
+}
+
+/* journalAppendError：記錄「第 idx 個單字的錯誤次數增加了 delta」*/
+void journalAppendError(int idx, int delta) {
+    journalWrite("E\t%d\t%d\n", idx, delta);
+}
+
+/* journalAppendReview：記錄「第 idx 個單字的複習排程變成現在這樣」
+   記錄的是結果而不是「答對還是答錯」，重播時不用再算一次，也不受重播當下的時間影響。*/
+void journalAppendReview(int idx) {
+    const Review *rv = &library.words[idx].review;
+    journalWrite("R\t%d\t%u\t%u\t%u\t%u\t%u\t%u\n", idx,
+                 (unsigned)rv->due, (unsigned)rv->lastReview, (unsigned)rv->interval,
+                 (unsigned)rv->ease, (unsigned)rv->reps, (unsigned)rv->lapses);
+}
+
+/* journalCommit：把累積的日誌紀錄真正寫到磁碟
+   -------------------------------------------------------
+   為什麼不要每一筆都 fsync？
+   → fsync 要等磁碟，一次可能要好幾毫秒；
+     攢一批再寫一次（group commit），速度快很多，當機時最多只掉最後一小批。
+
+   背景寫入執行緒開著的話，這裡只是按門鈴叫它去寫（persistFlush），
+   日誌太長時也只是在記憶體裡排好新主檔交給它（persistCompact），都不會等磁碟。
+
+   參數：
+     force → 1 = 不管攢了幾筆都立刻寫入（一個動作結束時用）；
+             0 = 攢滿 JOURNAL_BATCH 筆才寫入（連續新增單字時用）*/
+void journalCommit(int force) {
+    int background = persistRunning();
+    if (!background && !journal.fp) {
+        // 日誌開不起來的話，只好退回整個重寫的舊方法
+        if (force) saveToFile();
+        return;
+    }
+    if (journal.pending == 0) return;
+    if (!force && journal.pending < JOURNAL_BATCH) return;
+    journal.pending = 0;
+
+    if (background) {
+        if (journal.records >= JOURNAL_COMPACT_AT) persistCompact();
+        persistFlush();
+        return;
+    }
+    syncFile(journal.fp);
+    if (journal.records >= JOURNAL_COMPACT_AT) {
+        saveToFile(); // 日誌太長了，壓縮進主檔
+    }
+}
+
+
+/* ================================================================
+   背景寫入執行緒
+   ================================================================
+
+   為什麼要另外開一個執行緒寫檔？
+   → fsync 要等磁碟真的寫好才回來，慢的隨身碟一次可能要好幾十毫秒；
+     壓縮日誌更要把整個 english_word.txt 重寫一遍。以前這些時間使用者都只能乾等。
+   → 現在主執行緒（和使用者互動的那個）只把變更排成一行文字、放進佇列就繼續，
+     真正的 fwrite、fsync、rename 都交給背景的寫入執行緒。
+
+   佇列為什麼不用鎖（lock-free）？
+   → 只有一個執行緒放（主執行緒）、一個執行緒拿（寫入執行緒），
+     放的人只改 head、拿的人只改 tail，不會兩個人搶著改同一個變數。
+   → 只要保證「先把格子填好，才讓 head 往前」（atomic 的 release / acquire），
+     拿的人看到 head 變了，格子裡的內容就一定已經填好，完全不需要互斥鎖。
+   → head、tail 只會一直加上去，用 (head & (PERSIST_RING - 1)) 換算成格子，
+     head - tail 就是佇列裡有幾筆（溢位繞回來也算得對，因為是 unsigned）。
+
+   佇列空了，寫入執行緒就去睡覺，這時才用到「門鈴」（mutex + 條件變數）：
+   → 主執行緒不會每放一筆就按門鈴，只有一個動作結束（journalCommit）才按一次，
+     寫入執行緒醒來就把佇列裡所有的紀錄一口氣寫完（合併寫入），
+     佇列清空或寫滿 JOURNAL_BATCH 筆才 fsync 一次（group commit）。
+
+   壓縮：
+   → 主執行緒在記憶體裡排好新主檔的內容（tsvRender，只花 CPU 不碰磁碟），
+     連同指紋放進佇列；寫入執行緒照順序換掉主檔、開一份新日誌，
+     排在它後面的紀錄就自然寫進新日誌。
+   → 快照檔這時會先刪掉，不重寫（寫入執行緒不能讀正在變動的 library），
+     下次啟動時改讀文字檔，順便寫一份新的快照。
+
+   選 8 離開時（persistStop），先讓寫入執行緒把佇列全部寫完、結束，
+   再照舊同步地 saveToFile 一次。
+   ================================================================ */
+
+#define PERSIST_RECORD  0  // 一筆日誌紀錄
+#define PERSIST_COMPACT 1  // 用 text 換掉主檔，再開一份指紋為 hash 的新日誌
+#define PERSIST_STOP    2  // 前面的都寫完之後結束執行緒
+
+/* atomicLoad / atomicStore：兩個執行緒之間安全地讀寫 head、tail
+   GCC、Clang 用內建的 __atomic 函數，Visual C++ 用 Interlocked 系列。*/
+#if defined(_MSC_VER)
+#define atomicLoad(p)     ((unsigned long)InterlockedCompareExchange((volatile LONG *)(p), 0, 0))
+#define atomicStore(p, v) InterlockedExchange((volatile LONG *)(p), (LONG)(v))
+#define atomicLoadFull    atomicLoad   // Interlocked 系列本來就是完整的記憶體屏障
+#define atomicStoreFull   atomicStore
+#else
+#define atomicLoad(p)     __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define atomicStore(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define atomicLoadFull(p)     __atomic_load_n((p), __ATOMIC_SEQ_CST)
+#define atomicStoreFull(p, v) __atomic_store_n((p), (v), __ATOMIC_SEQ_CST)
+#endif
+
+/* atomicLoadFull / atomicStoreFull：比 acquire / release 更嚴格的版本
+   「先寫 A 再讀 B」的順序也保證不會被 CPU 調換（伺服器的讀取席位要靠這個，見「伺服器模式」）。*/
+
+/* Mutex：互斥鎖；Doorbell：讓寫入執行緒睡覺、等主執行緒叫醒它（POSIX 和 Windows 各一套）*/
+#ifdef _WIN32
+typedef CRITICAL_SECTION Mutex;
+
+typedef struct {
+    Mutex              lock;
+    CONDITION_VARIABLE cond;
+} Doorbell;
+
+static void mutexInit(Mutex *m)      { InitializeCriticalSection(m); }
+static void mutexDestroy(Mutex *m)   { DeleteCriticalSection(m); }
+static void mutexLock(Mutex *m)      { EnterCriticalSection(m); }
+static void mutexUnlock(Mutex *m)    { LeaveCriticalSection(m); }
+static void bellInit(Doorbell *d)    { mutexInit(&d->lock); InitializeConditionVariable(&d->cond); }
+static void bellDestroy(Doorbell *d) { mutexDestroy(&d->lock); }
+static void bellWait(Doorbell *d)    { SleepConditionVariableCS(&d->cond, &d->lock, INFINITE); }
+static void bellSignal(Doorbell *d)  { WakeConditionVariable(&d->cond); }
+static void threadYield(void)        { SwitchToThread(); }
+#else
+typedef pthread_mutex_t Mutex;
+
+typedef struct {
+    Mutex          lock;
+    pthread_cond_t cond;
+} Doorbell;
+
+static void mutexInit(Mutex *m)      { pthread_mutex_init(m, NULL); }
+static void mutexDestroy(Mutex *m)   { pthread_mutex_destroy(m); }
+static void mutexLock(Mutex *m)      { pthread_mutex_lock(m); }
+static void mutexUnlock(Mutex *m)    { pthread_mutex_unlock(m); }
+static void bellInit(Doorbell *d)    { mutexInit(&d->lock); pthread_cond_init(&d->cond, NULL); }
+static void bellDestroy(Doorbell *d) { pthread_cond_destroy(&d->cond); mutexDestroy(&d->lock); }
+static void bellWait(Doorbell *d)    { pthread_cond_wait(&d->cond, &d->lock); }
+static void bellSignal(Doorbell *d)  { pthread_cond_signal(&d->cond); }
+static void threadYield(void)        { sched_yield(); }
+#endif
+
+/* Persister：背景寫入執行緒和它的佇列*/
+typedef struct {
+    PersistItem   ring[PERSIST_RING];
+    unsigned long head;    // 下一筆要放進哪一格（只有主執行緒會改）
+    unsigned long tail;    // 下一筆要從哪一格拿（只有寫入執行緒會改）
+    unsigned      rung;    // 門鈴響過幾次（在 bell 的鎖裡面讀寫）
+    Doorbell      bell;
+    ThreadHandle  thread;
+    int           running; // 1 = 寫入執行緒開著（只有主執行緒會讀寫）
+} Persister;
+
+static Persister persist;
+
+/* persistPush：把一筆工作放進佇列（主執行緒用）
+   佇列滿了代表磁碟落後了 PERSIST_RING 筆，只好按門鈴、讓出 CPU，等寫入執行緒空出位置。*/
+static void persistPush(const PersistItem *item) {
+    unsigned long head = persist.head;
+    while (head - atomicLoad(&persist.tail) == PERSIST_RING) {
+        persistFlush();
+        threadYield();
+    }
+    persist.ring[head & (PERSIST_RING - 1)] = *item;
+    atomicStore(&persist.head, head + 1); // 格子填好了才讓 head 往前
+}
+
+/* persistPop：從佇列拿出一筆工作（寫入執行緒用）
+   回傳值：1 = 拿到了，0 = 佇列是空的*/
+static int persistPop(PersistItem *item) {
+    unsigned long tail = persist.tail;
+    if (atomicLoad(&persist.head) == tail) return 0;
+    *item = persist.ring[tail & (PERSIST_RING - 1)];
+    atomicStore(&persist.tail, tail + 1); // 內容拿走了才讓出格子
+    return 1;
+}
+
+/* persistWorker：寫入執行緒的本體
+   -------------------------------------------------------
+   一直從佇列拿工作來做；拿不到就表示這一批寫完了，
+   fsync 一次之後睡到門鈴響（rung 和上次看到的不一樣）為止。*/
+static void *persistWorker(void *arg) {
+    (void)arg;
+    unsigned seen     = 0; // 上次醒來時門鈴響過幾次
+    int      unsynced = 0; // 寫進日誌、還沒 fsync 的紀錄有幾筆
+    PersistItem item;
+
+    for (;;) {
+        if (!persistPop(&item)) {
+            if (unsynced) {
+                syncFile(journal.fp);
+                unsynced = 0;
+            }
+            mutexLock(&persist.bell.lock);
+            while (persist.rung == seen) bellWait(&persist.bell);
+            seen = persist.rung;
+            mutexUnlock(&persist.bell.lock);
+            continue;
+        }
+        if (item.kind == PERSIST_STOP) break;
+
+        if (item.kind == PERSIST_RECORD) {
+            // fwrite 先放進 FILE 的緩衝區，好幾筆合起來才真的呼叫一次 write
+            if (journal.fp) {
+                fwrite(item.text, 1, item.len, journal.fp);
+                metricCount(&metrics.bytesWritten, item.len);
+                if (++unsynced >= JOURNAL_BATCH) {
+                    syncFile(journal.fp);
+                    unsynced = 0;
+                }
+            }
+        } else {
+            // 快照對應的是舊主檔，先刪掉，免得下次啟動讀到過期的內容
+            remove(SNAP_FILE);
+            uint64_t started = metricNow();
+            if (tsvWrite(item.text, item.len)) {
+                if (journal.fp) fclose(journal.fp);
+                journal.fp = journalCreate(item.hash);
+                unsynced   = 0;
+            }
+            metricRecord(METRIC_SAVE, started);
+        }
+        free(item.text);
+    }
+
+    if (unsynced) syncFile(journal.fp);
+    return NULL;
+}
+
+/* persistStart：開啟背景寫入執行緒（選單模式、日誌已經開好之後呼叫）
+   回傳值：1 = 開好了，0 = 沒開（日誌開不起來或開執行緒失敗，之後照舊同步寫入）*/
+int persistStart(void) {
+    if (persist.running) return 1;
+    if (!journal.fp) return 0;
+    // 從這裡開始，還沒寫到磁碟的都交給寫入執行緒
+    fflush(journal.fp);
+    persist.head = persist.tail = 0;
+    persist.rung = 0;
+    bellInit(&persist.bell);
+    if (!threadStart(&persist.thread, persistWorker, NULL)) {
+        bellDestroy(&persist.bell);
+        return 0;
+    }
+    persist.running = 1;
+    return 1;
+}
+
+/* persistStop：讓寫入執行緒把佇列裡剩下的全部寫完，然後結束
+   回來之後 journal.fp 又歸主執行緒管，可以照舊同步寫入（例如離開前的 saveToFile）。*/
+void persistStop(void) {
+    if (!persist.running) return;
+    PersistItem stop = { PERSIST_STOP, NULL, 0, 0 };
+    persistPush(&stop);
+    persistFlush();
+    threadJoin(persist.thread);
+    bellDestroy(&persist.bell);
+    persist.running = 0;
+}
+
+/* persistRunning：背景寫入執行緒是不是開著*/
+int persistRunning(void) {
+    return persist.running;
+}
+
+/* persistAppend：交給寫入執行緒一筆日誌紀錄（text 是 malloc 來的，之後由寫入執行緒 free）*/
+void persistAppend(char *text, size_t len) {
+    PersistItem item = { PERSIST_RECORD, text, len, 0 };
+    persistPush(&item);
+}
+
+/* persistCompact：在記憶體裡排好新主檔，交給寫入執行緒去換掉 english_word.txt
+   記憶體不足的話就先不壓縮，日誌照常接著寫，下一次 journalCommit 會再試一次。*/
+void persistCompact(void) {
+    TextBuf buf = {0};
+    if (!tsvRender(&buf)) {
+        free(buf.data);
+        return;
+    }
+    PersistItem item = { PERSIST_COMPACT, buf.data, buf.len,
+                         fnvHash(FNV_OFFSET, buf.data ? buf.data : "", buf.len) };
+    persistPush(&item);
+    journal.records = 0; // 排在這之後的紀錄都會寫進新日誌
+}
+
+/* persistFlush：按門鈴，叫寫入執行緒把佇列裡的紀錄寫到磁碟*/
+void persistFlush(void) {
+    mutexLock(&persist.bell.lock);
+    persist.rung++;
+    bellSignal(&persist.bell);
+    mutexUnlock(&persist.bell.lock);
+}
+
+
+/* ================================================================
+   儲存後端（文字檔 + 日誌，或 SQLite 資料庫）
+   ================================================================
+
+   為什麼要分出「儲存後端」？
+   → 單字庫在記憶體裡的樣子（library 和各種索引）永遠一樣，
+     不一樣的只有「變更要寫到哪裡」：english_word.txt + 日誌，或是 vocabulary.db。
+   → 改單字的地方（新增、刪除、答錯、複習）只呼叫 storageAdded / storageRemoving /
+     storageError / storageReview / storageCommit，不用知道現在用的是哪一種。
+
+   兩種後端：
+   → 文字檔（預設）：就是原本的日誌 + 主檔，變更交給 journalAppend*、journalCommit。
+   → SQLite（用 --db 檔名 開啟，編譯時要加 -DUSE_SQLITE ... -lsqlite3）：
+     和 Python 版（english_word.py、GUI.py、web.py）用同一個資料庫、同一張 words 資料表，
+     兩邊可以輪流用同一份單字庫，不用再匯入匯出。
+   ================================================================ */
+
+/* textOpen / textClose：文字檔後端的開啟、關閉
+   compact → 1 = 順便把日誌壓縮進主檔（離開程式時）；0 = 只要確定日誌都寫進磁碟*/
+static int textOpen(void) {
+    loadFile();
+    return 1;
+}
+
+static void textClose(int compact) {
+    persistStop(); // 等背景寫入執行緒把還沒寫完的紀錄寫完
+    if (compact) saveToFile();
+}
+
+static const Storage textStorage = {
+    WORD_FILE, textOpen, journalAppendAdd, journalAppendDelete, journalAppendError,
+    journalAppendReview, journalCommit, textClose
+};
+
+static const Storage *storage = &textStorage; // 目前用的儲存後端
+
+#ifdef USE_SQLITE
+/* ---------------- SQLite 後端 ----------------
+
+   資料表和 Python 版一模一樣（words），所以 Python 那邊不用改；
+   複習排程是 C 版才有的，另外放在 word_reviews，Python 版看不到也不影響它。
+
+   為什麼要 prepared statement（預先編譯好的 SQL）？
+   → SQL 每次執行都要先解析、規劃怎麼查，這一步常常比真的寫入還久。
+   → 開資料庫時把會用到的幾句 SQL 各編譯一次，之後每次只要「填值、執行、reset」。
+
+   為什麼一筆變更只寫一列（UPSERT）？
+   → 文字檔版改一個錯誤次數，壓縮時要整個主檔重寫；
+     資料庫只要改那一列：INSERT ... ON CONFLICT(id) DO UPDATE，新增和修改都是同一句。
+   → 錯誤次數用「加上 delta」而不是「改成多少」，Python 版同時在改同一個單字時也不會蓋掉對方。
+
+   WAL 模式：
+   → 寫入時先寫在旁邊的 -wal 檔，讀的人（例如 Python 版）不會被擋住；
+     synchronous=NORMAL 讓每次 COMMIT 不用等 fsync，當機最多只掉最後幾筆，資料庫不會壞。
+   → 變更在 storageCommit 時才 COMMIT：一次測驗、一批新增單字只有一個交易。
+
+   library 的索引（idx）和資料庫的 id 不一樣：rowIds[idx] 記著第 idx 個單字是哪一列。
+   刪除單字時 libraryRemove 會把最後一個單字搬到 idx，rowIds 也要跟著搬。*/
+
+static const char *sqlText[SQL_STMTS] = {
+    "INSERT INTO words (id, folder, english, chinese, error_count) VALUES (?1, ?2, ?3, ?4, ?5) "
+    "ON CONFLICT(id) DO UPDATE SET error_count = error_count + ?6",
+    "INSERT INTO word_reviews (word_id, due, last_review, interval, ease, reps, lapses) "
+    "VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7) ON CONFLICT(word_id) DO UPDATE SET "
+    "due = excluded.due, last_review = excluded.last_review, interval = excluded.interval, "
+    "ease = excluded.ease, reps = excluded.reps, lapses = excluded.lapses",
+    "DELETE FROM words WHERE id = ?1",
+    "DELETE FROM word_reviews WHERE word_id = ?1",
+    "SELECT w.id, w.folder, w.english, w.chinese, w.error_count, "
+    "r.due, r.last_review, r.interval, r.ease, r.reps, r.lapses "
+    "FROM words w LEFT JOIN word_reviews r ON r.word_id = w.id ORDER BY w.id",
+    "BEGIN",
+    "COMMIT",
+};
+
+/* 和 Python 版 create_tables() 一樣的資料表和索引，再加上 word_reviews*/
+static const char *sqlSchema =
+    "PRAGMA journal_mode = WAL;"
+    "PRAGMA synchronous = NORMAL;"
+    "CREATE TABLE IF NOT EXISTS words ("
+    "  id INTEGER PRIMARY KEY AUTOINCREMENT,"
+    "  english TEXT NOT NULL,"
+    "  chinese TEXT NOT NULL DEFAULT '',"
+    "  folder TEXT NOT NULL,"
+    "  part_of_speech TEXT DEFAULT '',"
+    "  error_count INTEGER DEFAULT 0);"
+    "CREATE INDEX IF NOT EXISTS idx_folder ON words(folder);"
+    "CREATE INDEX IF NOT EXISTS idx_english ON words(english);"
+    "CREATE INDEX IF NOT EXISTS idx_error_count ON words(error_count);"
+    "CREATE INDEX IF NOT EXISTS idx_folder_english ON words(folder, english);"
+    "CREATE TABLE IF NOT EXISTS word_reviews ("
+    "  word_id INTEGER PRIMARY KEY,"
+    "  due INTEGER NOT NULL, last_review INTEGER NOT NULL, interval INTEGER NOT NULL,"
+    "  ease INTEGER NOT NULL, reps INTEGER NOT NULL, lapses INTEGER NOT NULL);";
+
+static SqliteStore sqlite;
+
+/* sqliteRun：執行一句預先編譯好的 SQL（參數已經填好），執行完 reset 給下次用
+   回傳值：1 = 成功，0 = 失敗（會印出錯誤訊息）*/
+static int sqliteRun(int which) {
+    sqlite3_stmt *st = sqlite.stmt[which];
+    int rc = sqlite3_step(st);
+    sqlite3_reset(st);
+    sqlite3_clear_bindings(st);
+    if (rc != SQLITE_DONE && rc != SQLITE_ROW) {
+        printf("[Error] 資料庫寫入失敗：%s\n", sqlite3_errmsg(sqlite.db));
+        return 0;
+    }
+    return 1;
+}
+
+/* sqliteBegin：第一筆變更之前開一個交易（之後的都放在同一個交易裡，到 sqliteCommit 才寫入）*/
+static void sqliteBegin(void) {
+    if (!sqlite.inTxn && sqliteRun(SQL_BEGIN)) sqlite.inTxn = 1;
+    sqlite.pending++;
+}
+
+/* sqliteRowSlot：確定 rowIds 放得下第 idx 格
+   回傳值：1 = 放得下，0 = 記憶體不足*/
+static int sqliteRowSlot(int idx) {
+    if (idx < sqlite.rowCap) return 1;
+    int newCap = sqlite.rowCap ? sqlite.rowCap : STORE_INIT_CAP;
+    while (newCap <= idx) newCap *= 2;
+    int64_t *p = realloc(sqlite.rowIds, (size_t)newCap * sizeof(int64_t));
+    if (!p) return 0;
+    sqlite.rowIds = p;
+    sqlite.rowCap = newCap;
+    return 1;
+}
+
+/* sqliteSaveWord：UPSERT 第 idx 個單字（id 是 0 就是新增，errorDelta 是要加上去的錯誤次數）*/
+static int sqliteSaveWord(int idx, int64_t id, int errorDelta) {
+    sqlite3_stmt *st = sqlite.stmt[SQL_SAVE_WORD];
+    if (id) sqlite3_bind_int64(st, 1, id);
+    else    sqlite3_bind_null(st, 1);
+    sqlite3_bind_text(st, 2, wordFolder(idx),  -1, SQLITE_STATIC);
+    sqlite3_bind_text(st, 3, wordEnglish(idx), -1, SQLITE_STATIC);
+    sqlite3_bind_text(st, 4, wordChinese(idx), -1, SQLITE_STATIC);
+    sqlite3_bind_int(st, 5, library.words[idx].errorCount);
+    sqlite3_bind_int(st, 6, errorDelta);
+    return sqliteRun(SQL_SAVE_WORD);
+}
+
+static void sqliteAdded(int idx) {
+    sqliteBegin();
+    if (!sqliteRowSlot(idx)) {
+        printf("[Error] 記憶體不足，「%s」沒有存進資料庫。\n", wordEnglish(idx));
+        return;
+    }
+    sqlite.rowIds[idx] = sqliteSaveWord(idx, 0, 0) ? sqlite3_last_insert_rowid(sqlite.db) : 0;
+}
+
+static void sqliteRemoving(int idx) {
+    sqliteBegin();
+    int64_t id = sqlite.rowIds[idx];
+    sqlite3_bind_int64(sqlite.stmt[SQL_DELETE_REVIEW], 1, id);
+    sqliteRun(SQL_DELETE_REVIEW);
+    sqlite3_bind_int64(sqlite.stmt[SQL_DELETE_WORD], 1, id);
+    sqliteRun(SQL_DELETE_WORD);
+    sqlite.rowIds[idx] = sqlite.rowIds[library.count - 1]; // 和 libraryRemove 一樣：最後一個搬過來
+}
+
+static void sqliteErrorChanged(int idx, int delta) {
+    sqliteBegin();
+    sqliteSaveWord(idx, sqlite.rowIds[idx], delta);
+}
+
+static void sqliteReviewChanged(int idx) {
+    const Review *rv = &library.words[idx].review;
+    sqlite3_stmt *st = sqlite.stmt[SQL_SAVE_REVIEW];
+    sqliteBegin();
+    sqlite3_bind_int64(st, 1, sqlite.rowIds[idx]);
+    sqlite3_bind_int64(st, 2, rv->due);
+    sqlite3_bind_int64(st, 3, rv->lastReview);
+    sqlite3_bind_int(st, 4, rv->interval);
+    sqlite3_bind_int(st, 5, rv->ease);
+    sqlite3_bind_int(st, 6, rv->reps);
+    sqlite3_bind_int(st, 7, rv->lapses);
+    sqliteRun(SQL_SAVE_REVIEW);
+}
+
+/* sqliteCommit：把目前的交易寫進資料庫（force = 0 時攢滿 JOURNAL_BATCH 筆才寫）*/
+static void sqliteCommit(int force) {
+    if (!sqlite.inTxn || (!force && sqlite.pending < JOURNAL_BATCH)) return;
+    uint64_t started = metricNow();
+    sqliteRun(SQL_COMMIT);
+    sqlite.inTxn   = 0;
+    sqlite.pending = 0;
+    metricRecord(METRIC_SAVE, started);
+}
+
+/* sqliteOpen：開資料庫（沒有的話就建立），把所有單字讀進 library
+   -------------------------------------------------------
+   一次 SELECT 讀出全部單字（連同複習排程），照 id 順序加進 library；
+   之後的查詢、出題都用記憶體裡的索引，不用再問資料庫。*/
+static int sqliteOpen(void) {
+    uint64_t started = metricNow();
+    char *err = NULL;
+    if (sqlite3_open(sqlite.path, &sqlite.db) != SQLITE_OK ||
+        sqlite3_exec(sqlite.db, sqlSchema, NULL, NULL, &err) != SQLITE_OK) {
+        printf("[Error] 無法開啟資料庫 %s：%s\n", sqlite.path, err ? err : sqlite3_errmsg(sqlite.db));
+        sqlite3_free(err);
+        sqlite3_close(sqlite.db);
+        sqlite.db = NULL;
+        return 0;
+    }
+    sqlite3_busy_timeout(sqlite.db, 5000); // Python 版正在寫的時候，最多等 5 秒
+    for (int i = 0; i < SQL_STMTS; i++) {
+        if (sqlite3_prepare_v2(sqlite.db, sqlText[i], -1, &sqlite.stmt[i], NULL) != SQLITE_OK) {
+            printf("[Error] 資料庫格式不對：%s\n", sqlite3_errmsg(sqlite.db));
+            storage->close(0);
+            return 0;
+        }
+    }
+
+    sqlite3_stmt *st = sqlite.stmt[SQL_LOAD];
+    int skipped = 0;
+    while (sqlite3_step(st) == SQLITE_ROW) {
+        const char *folder = (const char *)sqlite3_column_text(st, 1);
+        const char *en     = (const char *)sqlite3_column_text(st, 2);
+        const char *cn     = (const char *)sqlite3_column_text(st, 3);
+        int f = (folder && en && cn && en[0] && utf8Valid(folder, strlen(folder)) &&
+                 utf8Valid(en, strlen(en)) && utf8Valid(cn, strlen(cn))) ? folderIntern(folder) : -1;
+        int idx = f >= 0 ? libraryAdd(f, en, cn, sqlite3_column_int(st, 4)) : -1;
+        if (idx < 0 || !sqliteRowSlot(idx)) {
+            if (idx >= 0) libraryRemove(idx);
+            skipped++;
+            continue;
+        }
+        sqlite.rowIds[idx] = sqlite3_column_int64(st, 0);
+        if (sqlite3_column_type(st, 5) != SQLITE_NULL) {
+            Review rv = { (uint32_t)sqlite3_column_int64(st, 5), (uint32_t)sqlite3_column_int64(st, 6),
+                          (uint16_t)sqlite3_column_int(st, 7), (uint16_t)sqlite3_column_int(st, 8),
+                          (uint16_t)sqlite3_column_int(st, 9), (uint16_t)sqlite3_column_int(st, 10) };
+            librarySetReview(idx, &rv);
+        }
+    }
+    sqlite3_reset(st);
+    metricRecord(METRIC_LOAD, started);
+
+    if (skipped) printf("[Warning] 資料庫裡有 %d 個單字讀不進來（欄位是空的、不是 UTF-8 或記憶體不足），已略過。\n", skipped);
+    printf("讀取完成：%d 個資料夾，%d 個單字（%s）。\n", folders.count, library.count, sqlite.path);
+    return 1;
+}
+
+/* sqliteClose：寫完最後一個交易、關資料庫
+   compact → 1 = 順便把 WAL 檔併回資料庫（離開程式時）*/
+static void sqliteClose(int compact) {
+    if (!sqlite.db) return;
+    sqliteCommit(1);
+    for (int i = 0; i < SQL_STMTS; i++) sqlite3_finalize(sqlite.stmt[i]);
+    memset(sqlite.stmt, 0, sizeof(sqlite.stmt));
+    if (compact) sqlite3_wal_checkpoint_v2(sqlite.db, NULL, SQLITE_CHECKPOINT_TRUNCATE, NULL, NULL);
+    sqlite3_close(sqlite.db);
+    sqlite.db = NULL;
+    free(sqlite.rowIds);
+    sqlite.rowIds = NULL;
+    sqlite.rowCap = 0;
+}
+
+static const Storage sqliteStorage = {
+    "SQLite", sqliteOpen, sqliteAdded, sqliteRemoving, sqliteErrorChanged,
+    sqliteReviewChanged, sqliteCommit, sqliteClose
+};
+#endif
+
+/* storageUseDatabase：改用 SQLite 資料庫 path 當儲存後端（要在 storageOpen 之前呼叫）
+   回傳值：1 = 成功，0 = 這個版本編譯時沒有加 SQLite*/
+int storageUseDatabase(const char *path) {
+#ifdef USE_SQLITE
+    sqlite.path = path;
+    storage     = &sqliteStorage;
+    return 1;
+#else
+    (void)path;
+    return 0;
+#endif
+}
+
+/* storageIsText：目前是不是用文字檔（快照匯入匯出、整個主檔重寫只有文字檔才有）*/
+int storageIsText(void) {
+    return storage == &textStorage;
+}
+
+/* 下面這幾個就是「改單字的地方」呼叫的函數，直接交給目前的後端*/
+/* 新增、刪除、錯誤次數也順便記進變更紀錄（見下一段）*/
+int  storageOpen(void)                 { changeStart(); return storage->open(); }
+void storageAdded(int idx)             { storage->added(idx); changeRecord('A', idx); }
+void storageRemoving(int idx)          { changeRecord('D', idx); storage->removing(idx); }
+void storageError(int idx, int delta)  { storage->errorChanged(idx, delta); changeRecord('E', idx); }
+void storageReview(int idx)            { storage->reviewChanged(idx); }
+void storageCommit(int force)          { storage->commit(force); }
+void storageClose(int compact)         { storage->close(compact); }
+
+
+/* ================================================================
+   變更紀錄（讓其他前端只拿「上次之後」的變更）
+   ================================================================
+
+   為什麼需要？
+   → web.py、GUI.py 各有一份資料表，C 版有自己的文字檔；
+     要讓整間教室的裝置都看到老師剛新增的單字，以前只能整份匯出、整份重新讀。
+   → 這裡替每一筆變更（新增、刪除、錯誤次數改變）依序編一個號碼，
+     前端記住「我看到第幾號了」，下次只問「第 N 號之後有什麼」，
+     通常只有幾行、幾 KB，不用把整個單字庫重傳一次。
+
+   游標（cursor）：代號:號碼，例如 5f1c0a9e3b2d4c61:1234
+   → 代號（epoch）是每次開啟單字庫時決定的。變更紀錄只放在記憶體裡，
+     程式重開就從 0 號重新算，拿著上次游標的前端看到代號不一樣，就知道要重新下載全部。
+   → 為什麼不把號碼也存進檔案？日誌裡的刪除、答錯是用索引記的，壓縮之後更早的變更也不在了，
+     重開之後本來就排不出「第 N 號之後」的完整內容；
+     與其給一份可能漏東西的變更，不如明白告訴前端「請重新下載」。
+   → 只留最近 CHANGE_KEEP 筆，太舊的游標（那幾筆早就被蓋掉了）一樣要重新下載全部。
+
+   每一筆變更一行，用內容（資料夾、英文、中文）指出是哪個單字：
+     C [Tab] 號碼 [Tab] A|D|E [Tab] 資料夾 [Tab] 英文 [Tab] 中文 [Tab] 錯誤次數
+   → A = 新增、D = 刪除、E = 錯誤次數變成這個數字（記結果不記「加幾」，
+     同一行套用兩次也不會算錯）。
+   → 為什麼不用索引？刪除會把最後一個單字搬到空格，索引會變，Python 版的 id 又是另一套，
+     只有內容是大家都認得的。
+   → 複習排程只有 C 版有（Python 版的資料表沒有這幾欄），所以不編號。
+
+   重新下載全部時，每個單字一行：
+     F [Tab] 資料夾 [Tab] 英文 [Tab] 中文 [Tab] 錯誤次數
+
+   只有 storageAdded / storageRemoving / storageError 會記變更；
+   啟動時重播日誌不算，那時候還沒有人拿到這次的游標。
+   伺服器模式裡記變更的人一定拿著寫入鎖、讀變更的人坐在讀取席位上，兩邊不會同時碰到 changes。
+   ================================================================ */
+
+/* changeStart：開始一份新的變更紀錄（開啟單字庫時呼叫）
+   代號是現在的時間混進開機後的奈秒數，同一秒內重開程式也不會拿到同一個代號。*/
+void changeStart(void) {
+    changes.epoch  = ((uint64_t)time(NULL) << 32) ^ metricNow();
+    changes.seq    = 0;
+    changes.oldest = 1;
+}
+
+/* changeRecord：替一筆變更編號、記下來
+   參數：
+     op  → 'A' = 新增、'D' = 刪除（要在真正刪除之前呼叫）、'E' = 錯誤次數變了
+     idx → 哪一個單字*/
+void changeRecord(char op, int idx) {
+    static const char format[] = "C\t%llu\t%c\t%s\t%s\t%s\t%d\n";
+    uint64_t n = ++changes.seq;
+    if (!changes.lines) changes.lines = calloc(CHANGE_KEEP, sizeof(char *));
+
+    // 和 journalWrite 一樣先量長度，再 malloc 剛好的大小
+    int   len  = snprintf(NULL, 0, format, (unsigned long long)n, op,
+                          wordFolder(idx), wordEnglish(idx), wordChinese(idx),
+                          library.words[idx].errorCount);
+    char *line = (changes.lines && len >= 0) ? malloc((size_t)len + 1) : NULL;
+    if (!line) {
+        // 記不下來：把之前的都當作已經蓋掉，拿著舊游標的人會重新下載全部，不會漏掉這一筆
+        changes.oldest = n + 1;
+        return;
+    }
+    snprintf(line, (size_t)len + 1, format, (unsigned long long)n, op,
+             wordFolder(idx), wordEnglish(idx), wordChinese(idx),
+             library.words[idx].errorCount);
+
+    char **slot = &changes.lines[n % CHANGE_KEEP];
+    free(*slot); // 第 n - CHANGE_KEEP 號，已經太舊了
+    *slot = line;
+    if (n - changes.oldest >= CHANGE_KEEP) changes.oldest = n - CHANGE_KEEP + 1;
+}
+
+/* changesSince：把游標之後的變更排進 out（伺服器的 CHANGES 指令用）
+   -------------------------------------------------------
+   參數：
+     cursor → 前端上次拿到的游標；空的、別次執行的、太舊的都會改成排出全部單字
+     reset  → 回傳時設成 1 = 排的是全部單字（F 行），0 = 只有變更（C 行）
+
+   回傳值：排了幾行（排完之後的游標就是 changes.epoch:changes.seq）*/
+int changesSince(const char *cursor, TextBuf *out, int *reset) {
+    unsigned long long epoch = 0, since = 0;
+    int usable = sscanf(cursor, "%llx:%llu", &epoch, &since) == 2 && epoch == changes.epoch &&
+                 since + 1 >= changes.oldest && since <= changes.seq;
+    *reset = !usable;
+
+    int rows = 0;
+    if (usable) {
+        for (uint64_t n = since + 1; n <= changes.seq; n++, rows++) {
+            const char *line = changes.lines[n % CHANGE_KEEP];
+            textAppend(out, line, strlen(line));
+        }
+        return rows;
+    }
+    for (int i = 0; i < library.count; i++, rows++) {
+        char errStr[16];
+        snprintf(errStr, sizeof(errStr), "%d\n", library.words[i].errorCount);
+        const char *fields[4] = { wordFolder(i), wordEnglish(i), wordChinese(i), errStr };
+        textAppend(out, "F", 1);
+        for (int f = 0; f < 4; f++) {
+            textAppend(out, "\t", 1);
+            textAppend(out, fields[f], strlen(fields[f]));
+        }
+    }
+    return rows;
+}
+
+/* changesFree：放掉變更紀錄*/
+void changesFree(void) {
+    if (changes.lines) {
+        for (int i = 0; i < CHANGE_KEEP; i++) free(changes.lines[i]);
+    }
+    free(changes.lines);
+    changes.lines  = NULL;
+    changes.seq    = 0;
+    changes.oldest = 1;
+}
+
+
+/* ================================================================
+   效能統計（每種操作花多久、寫了多少資料）
+   ================================================================
+
+   為什麼要內建？
+   → 「最近好像變慢了」要有數字才知道是哪裡慢：載入、儲存、查詢、對答案各花多久，
+     寫了幾次磁碟、索引長到多大。統計資訊選單和伺服器的 METRICS 指令都看得到。
+
+   延遲分布（histogram）：
+   → 不記每一次的時間（太佔記憶體），只記「落在哪個範圍」：
+     第 b 格是 2^b ~ 2^(b+1) 奈秒，每格一個計數器，METRIC_BUCKETS 格可以到一分鐘以上。
+   → 這樣就算得出大約的中位數（p50）、p99：從小的格子開始累加，加到一半 / 99% 的那一格就是。
+
+   為什麼計數器要用 atomic？
+   → 伺服器模式好幾個連線同時在查詢、對答案，都會加同一個計數器；
+     一般的 ++ 是「讀、加、寫」三步，兩個執行緒同時做會少算。
+   → 只是計數，不需要和其他資料排順序，用最便宜的 relaxed 就好。
+   ================================================================ */
+
+/* metricAdd / metricGet：64 位元計數器的 atomic 加、讀*/
+#if defined(_MSC_VER)
+#define metricAdd(p, v) InterlockedExchangeAdd64((volatile LONG64 *)(p), (LONG64)(v))
+#define metricGet(p)    ((uint64_t)InterlockedCompareExchange64((volatile LONG64 *)(p), 0, 0))
+#else
+#define metricAdd(p, v) __atomic_fetch_add((p), (uint64_t)(v), __ATOMIC_RELAXED)
+#define metricGet(p)    __atomic_load_n((p), __ATOMIC_RELAXED)
+#endif
+
+static const char *metricNames[METRIC_OPS]  = { "load", "save", "search", "answer" };
+static const char *metricLabels[METRIC_OPS] = { "載入單字庫", "儲存主檔", "查詢", "對答案" };
+
+/* metricNow：現在的時間（奈秒），只拿來算經過了多久*/
+uint64_t metricNow(void) {
+#ifdef _WIN32
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER now;
+    if (freq.QuadPart == 0) QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    return (uint64_t)((double)now.QuadPart * 1e9 / (double)freq.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+/* metricRecord：記下一次 op 操作花的時間（從 started = metricNow() 算到現在）*/
+void metricRecord(int op, uint64_t started) {
+    uint64_t ns = metricNow() - started;
+    int b = 0;
+    while (b < METRIC_BUCKETS - 1 && (ns >> (b + 1)) != 0) b++; // b = log2(ns)，太久的都放最後一格
+    LatencyHist *h = &metrics.latency[op];
+    metricAdd(&h->buckets[b], 1);
+    metricAdd(&h->count, 1);
+    metricAdd(&h->totalNs, ns);
+}
+
+/* metricCount：加一個計數器（寫了幾個 byte、存了幾次檔...）*/
+void metricCount(uint64_t *counter, uint64_t n) {
+    metricAdd(counter, n);
+}
+
+/* metricQuantile：延遲分布裡第 q（0~1）的位置大約是幾奈秒（用那一格的中間值）*/
+static double metricQuantile(const LatencyHist *h, double q) {
+    uint64_t count = metricGet(&h->count);
+    if (count == 0) return 0;
+    uint64_t want = (uint64_t)(q * (double)count + 0.5), seen = 0;
+    if (want == 0) want = 1;
+    for (int b = 0; b < METRIC_BUCKETS; b++) {
+        seen += metricGet(&h->buckets[b]);
+        if (seen >= want) return (double)((uint64_t)1 << b) * 1.5;
+    }
+    return (double)((uint64_t)1 << (METRIC_BUCKETS - 1));
+}
+
+/* metricDuration：把奈秒排成好讀的單位（ns / µs / ms / s）*/
+static const char *metricDuration(double ns, char *buf, size_t size) {
+    if (ns < 1e3)      snprintf(buf, size, "%.0f ns", ns);
+    else if (ns < 1e6) snprintf(buf, size, "%.1f µs", ns / 1e3);
+    else if (ns < 1e9) snprintf(buf, size, "%.1f ms", ns / 1e6);
+    else               snprintf(buf, size, "%.2f s", ns / 1e9);
+    return buf;
+}
+
+/* metricIndexSizes：目前各個索引有多大（給兩種輸出共用）
+   參數：
+     names  → 回傳每一項的名字（英文，METRICS 用）
+     labels → 回傳每一項的中文說明（統計資訊用）
+     values → 回傳每一項的大小
+   回傳值：幾項*/
+static int metricIndexSizes(const char *names[], const char *labels[], uint64_t values[]) {
+    int n = 0;
+#define METRIC_INDEX(name, label, value) (names[n] = (name), labels[n] = (label), values[n++] = (uint64_t)(value))
+    METRIC_INDEX("words",             "單字",                 library.count);
+    METRIC_INDEX("string_bytes",      "字串池（bytes）",       library.strings.used);
+    METRIC_INDEX("folders",           "資料夾",               folders.count);
+    METRIC_INDEX("english_slots",     "英文索引（格）",         englishIndex.slots ? englishIndex.mask + 1 : 0);
+    METRIC_INDEX("folder_word_slots", "資料夾 + 英文索引（格）",
+                 folderEnglishIndex.slots ? folderEnglishIndex.mask + 1 : 0);
+    METRIC_INDEX("grams",             "搜尋片段（種）",         textIndex.count);
+    METRIC_INDEX("gram_postings",     "搜尋清單（格）",         textIndex.poolUsed);
+    METRIC_INDEX("bk_nodes",          "拼字建議樹（節點）",     headwords.count);
+    METRIC_INDEX("error_rank",        "錯題排行（單字）",       errorRank.count);
+    METRIC_INDEX("due_queue",         "複習佇列（單字）",       dueQueue.count);
+#undef METRIC_INDEX
+    return n;
+}
+
+/* metricsShow：在統計資訊裡顯示效能統計（用 outPrintf，呼叫者負責 outFlush）*/
+void metricsShow(void) {
+    char avg[24], p50[24], p99[24];
+    outPrintf("\n效能統計（這次執行）：\n");
+    outPrintf("  %-14s %8s  %10s  %10s  %10s\n", "操作", "次數", "平均", "p50", "p99");
+    for (int op = 0; op < METRIC_OPS; op++) {
+        const LatencyHist *h = &metrics.latency[op];
+        uint64_t count = metricGet(&h->count);
+        if (count == 0) {
+            outPrintf("  %-14s %8s\n", metricLabels[op], "0");
+            continue;
+        }
+        outPrintf("  %-14s %8llu  %10s  %10s  %10s\n", metricLabels[op], (unsigned long long)count,
+                  metricDuration((double)metricGet(&h->totalNs) / (double)count, avg, sizeof(avg)),
+                  metricDuration(metricQuantile(h, 0.5), p50, sizeof(p50)),
+                  metricDuration(metricQuantile(h, 0.99), p99, sizeof(p99)));
+    }
+    outPrintf("  寫入磁碟 %llu bytes，主檔重寫 %llu 次，fsync %llu 次，日誌 %llu 筆\n",
+              (unsigned long long)metricGet(&metrics.bytesWritten),
+              (unsigned long long)metricGet(&metrics.saves),
+              (unsigned long long)metricGet(&metrics.fsyncs),
+              (unsigned long long)metricGet(&metrics.journalRecords));
+
+    const char *names[METRIC_MAX_INDEXES], *labels[METRIC_MAX_INDEXES];
+    uint64_t values[METRIC_MAX_INDEXES];
+    int n = metricIndexSizes(names, labels, values);
+    outPrintf("\n索引大小：\n");
+    for (int i = 0; i < n; i++) outPrintf("  %-24s %llu\n", labels[i], (unsigned long long)values[i]);
+}
+
+/* metricsExport：把效能統計排成 Prometheus 的文字格式（伺服器的 METRICS 指令用）
+   -------------------------------------------------------
+   一行一個數字，例如
+     en_word_latency_seconds_bucket{op="search",le="2.048e-06"} 15
+     en_word_bytes_written_total 123456
+   監控程式定時來問一次，前後相減就知道這段時間做了多少事、有沒有變慢。
+   呼叫者要確定這段時間沒有人在改單字庫（要讀索引大小）。*/
+void metricsExport(TextBuf *out) {
+    char line[160];
+    int  len;
+#define METRIC_LINE(...) (len = snprintf(line, sizeof(line), __VA_ARGS__), textAppend(out, line, (size_t)len))
+    METRIC_LINE("# TYPE en_word_latency_seconds histogram\n");
+    for (int op = 0; op < METRIC_OPS; op++) {
+        const LatencyHist *h = &metrics.latency[op];
+        uint64_t seen = 0;
+        for (int b = 0; b < METRIC_BUCKETS - 1; b++) {
+            seen += metricGet(&h->buckets[b]);
+            METRIC_LINE("en_word_latency_seconds_bucket{op=\"%s\",le=\"%.9g\"} %llu\n", metricNames[op],
+                        (double)((uint64_t)1 << (b + 1)) / 1e9, (unsigned long long)seen);
+        }
+        METRIC_LINE("en_word_latency_seconds_bucket{op=\"%s\",le=\"+Inf\"} %llu\n", metricNames[op],
+                    (unsigned long long)metricGet(&h->count));
+        METRIC_LINE("en_word_latency_seconds_sum{op=\"%s\"} %.9g\n", metricNames[op],
+                    (double)metricGet(&h->totalNs) / 1e9);
+        METRIC_LINE("en_word_latency_seconds_count{op=\"%s\"} %llu\n", metricNames[op],
+                    (unsigned long long)metricGet(&h->count));
+    }
+    METRIC_LINE("# TYPE en_word_bytes_written_total counter\nen_word_bytes_written_total %llu\n",
+                (unsigned long long)metricGet(&metrics.bytesWritten));
+    METRIC_LINE("# TYPE en_word_saves_total counter\nen_word_saves_total %llu\n",
+                (unsigned long long)metricGet(&metrics.saves));
+    METRIC_LINE("# TYPE en_word_fsyncs_total counter\nen_word_fsyncs_total %llu\n",
+                (unsigned long long)metricGet(&metrics.fsyncs));
+    METRIC_LINE("# TYPE en_word_journal_records_total counter\nen_word_journal_records_total %llu\n",
+                (unsigned long long)metricGet(&metrics.journalRecords));
+
+    const char *names[METRIC_MAX_INDEXES], *labels[METRIC_MAX_INDEXES];
+    uint64_t values[METRIC_MAX_INDEXES];
+    int n = metricIndexSizes(names, labels, values);
+    METRIC_LINE("# TYPE en_word_index_size gauge\n");
+    for (int i = 0; i < n; i++) {
+        METRIC_LINE("en_word_index_size{index=\"%s\"} %llu\n", names[i], (unsigned long long)values[i]);
+    }
+#undef METRIC_LINE
+}
+
+
+/* ================================================================
+   洗牌（Fisher-Yates 演算法）
+   ================================================================
+
+   目的：把存放單字索引的陣列隨機打亂，讓測驗題目順序不固定。
+
+   Fisher-Yates 演算法步驟（以 4 個元素為例）：
+   → i=3：從 0~3 隨機選一個位置 j，把 arr[3] 和 arr[j] 交換
+   → i=2：從 0~2 隨機選一個位置 j，把 arr[2] 和 arr[j] 交換
+   → i=1：從 0~1 隨機選一個位置 j，把 arr[1] 和 arr[j] 交換
+   → 完成！每種排列出現的機率完全相同。
+   （前提是 j 真的是平均分布，所以用 rngBelow，不用會偏向小數字的 rand() % (i + 1)。）
+
+   參數：
+     arr → 要打亂的整數陣列（存放 library 的索引，例如 [0,1,2,3,...]）
+     n   → 陣列長度*/
+void shuffle(int arr[], int n) {
+    for (int i = n - 1; i > 0; i--) {
+        int j    = (int)rngBelow((uint64_t)i + 1); // 從 0 到 i 之間隨機選一個位置
+        // 交換 arr[i] 和 arr[j]（需要一個暫存變數，就像交換兩杯飲料需要第三個杯子）
+        int temp = arr[i];
+        arr[i]   = arr[j];
+        arr[j]   = temp;
+    }
+}
+
+
+/* ================================================================
+   畫面輸出（先排進緩衝區，再一次 fwrite）
+   ================================================================
+
+   為什麼列清單不直接 printf？
+   → 終端機上的 stdout 是「行緩衝」：每印一行就呼叫一次 write，
+     隔著 SSH 列出幾萬個單字，時間幾乎都花在這幾萬次系統呼叫上。
+   → outPrintf 把每一行直接排進 screen 緩衝區（同一塊記憶體一直重複用），
+     攢到 OUT_FLUSH_AT 才 fwrite 一次，速度就只受記憶體複製的速度限制。
+
+   規則：用 outPrintf 的函數，在等使用者輸入、或是改回 printf 之前一定要先呼叫 outFlush，
+   不然提示文字還在緩衝區裡，畫面上的順序也會亂掉。
+
+   分頁（pageList）：
+   → 互動模式下（鍵盤輸入、畫面輸出都是終端機）一次只排「看得到的那一頁」，
+     看下一頁時才排下一頁，十萬筆的清單也不用一次全部排好。
+   → 輸出被導到檔案或管線（例如 ./En_word > list.txt）時就不分頁，整份清單一次寫出去。
+   ================================================================ */
+
+#ifdef _WIN32
+#define isTerminal(fp) _isatty(_fileno(fp))
+#else
+#define isTerminal(fp) isatty(fileno(fp))
+#endif
+
+static TextBuf screen; // 還沒送到 stdout 的畫面輸出
+
+/* outFlush：把緩衝區裡的畫面輸出一次寫出去*/
+void outFlush(void) {
+    if (screen.len > 0) fwrite(screen.data, 1, screen.len, stdout);
+    screen.len    = 0;
+    screen.failed = 0;
+    fflush(stdout);
+}
+
+/* outPrintf：像 printf 一樣，只是先排進緩衝區
+   -------------------------------------------------------
+   vsnprintf 直接排在緩衝區的尾巴，放不下才加大緩衝區、再排一次，
+   大部分的行都只排一次，不用先排進暫存陣列再複製。
+   記憶體不足的話就先把緩衝區寫出去，這一行改用 vprintf 直接印。*/
+void outPrintf(const char *fmt, ...) {
+    va_list ap;
+    size_t room = screen.cap - screen.len;
+    va_start(ap, fmt);
+    int len = vsnprintf(screen.data ? screen.data + screen.len : NULL, room, fmt, ap);
+    va_end(ap);
+    if (len < 0) return;
+
+    if ((size_t)len >= room) {
+        size_t newCap = screen.cap ? screen.cap : OUT_FLUSH_AT * 2;
+        while (newCap < screen.len + (size_t)len + 1) newCap *= 2;
+        char *p = realloc(screen.data, newCap);
+        if (!p) {
+            outFlush();
+            va_start(ap, fmt);
+            vprintf(fmt, ap);
+            va_end(ap);
+            return;
+        }
+        screen.data = p;
+        screen.cap  = newCap;
+        va_start(ap, fmt);
+        vsnprintf(screen.data + screen.len, screen.cap - screen.len, fmt, ap);
+        va_end(ap);
+    }
+    screen.len += (size_t)len;
+    if (screen.len >= OUT_FLUSH_AT) {
+        fwrite(screen.data, 1, screen.len, stdout);
+        screen.len = 0;
+    }
+}
+
+/* pageList：一頁一頁顯示一份很長的清單
+   -------------------------------------------------------
+   清單的每一行怎麼排由呼叫者決定（render），pageList 只決定「要排哪幾行」。
+
+   參數：
+     total  → 清單總共幾行
+     render → 排出第 first 行開始的 count 行（用 outPrintf）
+     ctx    → 傳給 render 的資料*/
+void pageList(int total, ListRender render, void *ctx) {
+    if (total <= LIST_PAGE || !isTerminal(stdin) || !isTerminal(stdout)) {
+        if (total > 0) render(0, total, ctx); // 不用分頁：整份清單排好、一次寫出去
+        outFlush();
+        return;
+    }
+
+    int pages = (total + LIST_PAGE - 1) / LIST_PAGE;
+    int page  = 0;
+    while (page < pages) {
+        int first = page * LIST_PAGE;
+        render(first, total - first < LIST_PAGE ? total - first : LIST_PAGE, ctx);
+        if (page == pages - 1) break;
+
+        char more[16] = "";
+        outPrintf("（第 %d / %d 頁：Enter 下一頁，b 上一頁，輸入數字跳到那一頁，q 結束列表）",
+                  page + 1, pages);
+        outFlush();
+        inputLine(more, sizeof(more));
+        if (more[0] == 'q' || more[0] == 'Q') break;
+        if (more[0] == 'b' || more[0] == 'B') {
+            if (page > 0) page--;
+        } else if (more[0] >= '0' && more[0] <= '9') {
+            int to = atoi(more);
+            if (to >= 1 && to <= pages) page = to - 1;
+        } else {
+            page++;
+        }
+    }
+    outFlush();
+}
+
+
+/* ================================================================
+   資料夾選擇選單
+   ================================================================ */
+
+/* chooseFolder：顯示資料夾列表，讓使用者選要操作哪個範圍
+   -------------------------------------------------------
+   資料夾數量沒有上限了，所以「全部單字」「返回主選單」的選項號碼
+   平常是 99、100，資料夾多到 99 個以上時就往後排，才不會和資料夾撞號。
+
+   回傳值：
+     1 ~ folders.count → 使用者選了某個資料夾（對應資料夾編號+1）
+     0                 → 使用者選了「全部單字」
+     -1                → 使用者選擇離開，或目前完全沒有單字*/
+int chooseFolder(void) {
+    // 連單字都沒有，就沒什麼好選的
+    if (library.count == 0) {
+        printf("[Notice] 目前沒有任何單字，請先新增。\n");
+        return -1;
+    }
+
+    int optAll  = folders.count < 99 ? 99 : folders.count + 1;
+    int optBack = optAll + 1;
+    int option;
+    while (1) { // 無限迴圈，直到使用者輸入有效選項才 return 離開
+        outPrintf("\n===== 選擇範圍 =====\n");
+        for (int i = 0; i < folders.count; i++) {
+            outPrintf("  %d. %s\n", i + 1, folderName(i));
+        }
+        outPrintf("%3d. 全部單字\n", optAll);
+        outPrintf("%3d. 返回主選單\n", optBack);
+        outPrintf("請選擇: ");
+        outFlush(); // 等使用者輸入之前要先把選單送出去
+
+        if (scanf("%d", &option) != 1) {
+            // 使用者輸入了非數字（例如打了「abc」），scanf 回傳 0 表示讀取失敗
+            clearInputBuffer(); // 清掉錯誤的輸入，不然下次還是會讀到它
+            printf("[Error] 請輸入數字。\n");
+            continue; // 回到迴圈開頭重新顯示選單
+        }
+        clearInputBuffer(); // 清掉數字後面殘留的換行符
+
+        if (option == optBack) return -1; // 使用者要返回
+        if (option == optAll)  return 0;  // 全部單字
+        if (option >= 1 && option <= folders.count) return option; // 某個資料夾
+
+        printf("[Error] 沒有這個選項，請重新輸入。\n");
+    }
+}
+
+
+/* ================================================================
+   單字卡學習
+   ================================================================
+
+   單字卡和「單字一覽」都照字母順序，範圍可以只看某一段（例如 a-c，或只打 c 看 c 開頭的），
+   實際的排序和範圍查詢交給字母順序索引（sortedRange），這裡只負責顯示。
+
+   看單字卡時隨時可以輸入 q 先離開，cardResume 會記住看到哪個字，
+   下次選到包含那個字的範圍時可以從它後面接著看。
+
+   預先排好的單字卡（CardDeck）：
+   → 開始時就把「要看哪些字、照什麼順序」一次決定好（cardOpen），之後不用再找下一張是誰。
+   → 後面幾張的內容先從單字庫複製到環狀的 CARD_PREFETCH 格裡（cardPrefetch），
+     翻卡（cardNext）只是從環裡拿下一格，完全不碰單字庫。
+   → 什麼時候排？選單模式在印完英文、等使用者按 Enter 的時候；
+     伺服器模式是回應送出去之後、等下一個指令之前（這時才佔讀取席位）。
+     翻卡的那一下永遠不用等查詢，也不會被別人新增單字擋住。
+   → 以後卡片要附音檔、例句的話，也是在 cardFill 裡一起準備好，翻卡時一樣直接拿。
+   → cardNext 給出去的那一張要一直能用到下一次 cardNext，所以最多只先排 CARD_PREFETCH - 1 張。
+   → 記的是單字的索引：伺服器模式不能刪除單字，選單模式看卡的中途也不會刪，索引不會變。*/
+
+static SortCursor cardResume = {0}; // 單字卡上次看到哪個字（valid = 0 表示上次看完了）
+
+/* cardFill：把第 idx 個單字複製進卡片 c（c 是第 pos 張）
+   回傳值：1 = 成功，0 = 記憶體不足（c 原本的內容不變）*/
+static int cardFill(Card *c, int pos, int idx) {
+    const char *parts[3] = { wordEnglish(idx), wordChinese(idx), wordFolder(idx) };
+    size_t lens[3], need = 0;
+    for (int k = 0; k < 3; k++) need += (lens[k] = strlen(parts[k])) + 1;
+    if (need > c->cap) {
+        char *p = realloc(c->text, need);
+        if (!p) return 0;
+        c->text = p;
+        c->cap  = need;
+    }
+    char *at = c->text;
+    const char **dst[3] = { &c->en, &c->cn, &c->folder };
+    for (int k = 0; k < 3; k++) {
+        memcpy(at, parts[k], lens[k] + 1);
+        *dst[k] = at;
+        at += lens[k] + 1;
+    }
+    c->pos    = pos;
+    c->idx    = idx;
+    c->errors = library.words[idx].errorCount;
+    return 1;
+}
+
+/* cardOpen：開始一次單字卡學習：把要看的單字照順序複製一份，先排好前面幾張
+   d 之前用過的話，環裡的卡片記憶體會直接拿來重複用。
+
+   參數：
+     ids, count → 要看的單字（照順序）
+     start      → 從第幾張開始（接著上次看的時候不是 0）
+
+   回傳值：1 = 成功，0 = 記憶體不足*/
+int cardOpen(CardDeck *d, const int *ids, int count, int start) {
+    int *order = malloc((size_t)(count ? count : 1) * sizeof(int));
+    if (!order) return 0;
+    memcpy(order, ids, (size_t)count * sizeof(int));
+    free(d->order);
+    d->order  = order;
+    d->count  = count;
+    d->next   = start;
+    d->filled = start;
+    return cardPrefetch(d);
+}
+
+/* cardPending：還有沒有卡片可以先排（伺服器模式決定要不要佔讀取席位）*/
+int cardPending(const CardDeck *d) {
+    return d->filled < d->count && d->filled < d->next + CARD_PREFETCH - 1;
+}
+
+/* cardPrefetch：把後面還沒排的卡片排好（最多排到 CARD_PREFETCH - 1 張之後）
+   回傳值：1 = 至少有下一張可以翻了（或已經全部翻完），0 = 記憶體不足、一張都排不出來*/
+int cardPrefetch(CardDeck *d) {
+    while (cardPending(d)) {
+        if (!cardFill(&d->ring[d->filled % CARD_PREFETCH], d->filled, d->order[d->filled])) break;
+        d->filled++;
+    }
+    return d->filled > d->next || d->next == d->count;
+}
+
+/* cardNext：翻下一張（只從已經排好的卡片拿，不碰單字庫）
+   回傳值：下一張；全部翻完了、或是還沒排好（記憶體不足）回傳 NULL*/
+const Card *cardNext(CardDeck *d) {
+    if (d->next >= d->filled) return NULL;
+    return &d->ring[d->next++ % CARD_PREFETCH];
+}
+
+/* cardClose：放掉 d 用的記憶體*/
+void cardClose(CardDeck *d) {
+    for (int k = 0; k < CARD_PREFETCH; k++) free(d->ring[k].text);
+    free(d->order);
+    memset(d, 0, sizeof(*d));
+}
+
+/* rangeKeys：把使用者打的範圍（a-c、c 或空的）換成 sortedRange 要的 from、to
+   from、to 至少要有 LINE_BUF 個 byte；range 會被改掉。*/
+void rangeKeys(char *range, char *from, char *to) {
+    char *dash = strchr(range, '-');
+    if (dash && dash != range) {
+        *dash = '\0';
+        normalizeText(from, range);
+        normalizeText(to, dash + 1);
+    } else {
+        normalizeText(from, range);
+        strcpy(to, from);
+    }
+}
+
+/* showSingleCard：顯示一張單字卡
+   -------------------------------------------------------
+   先秀英文，等使用者按 Enter 之後才顯示中文，
+   這樣可以讓使用者先想一下答案再對照。
+   等使用者的那段時間順便把後面幾張排好（cardPrefetch），下一張就不用等。
+
+   參數：
+     deck → 這次的單字卡
+     c    → 要顯示的那一張（cardNext 給的）
+
+   回傳值：1 = 繼續下一張，0 = 使用者輸入 q（或輸入結束）要離開*/
+int showSingleCard(CardDeck *deck, const Card *c) {
+    char reply[16] = "";
+    outPrintf("----------------------------\n");
+    outPrintf("英文: %s\n", c->en);
+    outPrintf("（按 Enter 查看中文，輸入 q 結束）");
+    outFlush(); // 一張卡只寫一次，不是一行寫一次
+    cardPrefetch(deck); // 排不出來也沒關係，showCards 翻下一張時會再試一次
+    if (!fgets(reply, sizeof(reply), stdin)) return 0; // 輸入結束（例如從檔案讀完了）
+    if (!strchr(reply, '\n')) clearInputBuffer();       // 打太長了，剩下的丟掉
+    if (reply[0] == 'q' || reply[0] == 'Q') return 0;
+    outPrintf("中文: %s\n", c->cn);
+    return 1;
+}
+
+/* showCards：照字母順序一張一張顯示排好的索引裡的一段
+   -------------------------------------------------------
+   參數：
+     order → 排好的索引（sortedRange 給的）
+     first → 從索引的第幾個開始
+     count → 這一段總共幾個
+     start → 從這一段的第幾張開始（接著上次看的時候不是 0）*/
+void showCards(const SortedIndex *order, int first, int count, int start) {
+    CardDeck deck = {0};
+    if (!cardOpen(&deck, order->list.ids + first, count, start)) {
+        cardClose(&deck);
+        printf("[Error] 記憶體不足，無法準備單字卡。\n");
+        return;
+    }
+    outPrintf("\n共 %d 個單字，按 Enter 逐張翻閱...\n", count);
+    for (;;) {
+        const Card *c = cardNext(&deck);
+        if (!c && cardPrefetch(&deck)) c = cardNext(&deck); // 上次沒排好的話現在補
+        if (!c) break;
+        outPrintf("\n[第 %d / %d 張]\n", c->pos + 1, count);
+        if (!showSingleCard(&deck, c)) {
+            // 還沒翻到中文就離開了：這張不算看過，下次從這張開始
+            if (c->pos > 0) sortedCursorSave(&cardResume, deck.order[c->pos - 1]);
+            outPrintf("\n先看到這裡，下次可以接著看。\n");
+            outFlush();
+            cardClose(&deck);
+            return;
+        }
+        sortedCursorSave(&cardResume, c->idx);
+    }
+    if (deck.next < count) {
+        outPrintf("\n[Error] 記憶體不足，只能先看到這裡。\n");
+    } else {
+        cardResume.valid = 0;
+        outPrintf("\n===== 學習完畢，共 %d 個單字！=====\n", count);
+    }
+    outFlush();
+    cardClose(&deck);
+}
+
+/* renderSortedRows：排出這一段的第 first 行開始的 count 行（直接用索引的位置，不用從頭數）*/
+static void renderSortedRows(int first, int count, void *ctx) {
+    const SortedView *v = ctx;
+    for (int i = first; i < first + count; i++) {
+        int idx = v->order->list.ids[v->first + i];
+        outPrintf("%-6d  %-22s  %-22s  %s\n",
+                  i + 1, wordEnglish(idx), wordChinese(idx), wordFolder(idx));
+    }
+}
+
+/* showWordList：照字母順序列出排好的索引裡的一段（一頁 LIST_PAGE 個，第幾頁都一樣快）*/
+void showWordList(const SortedIndex *order, int first, int count) {
+    SortedView view = { order, first };
+    outPrintf("\n%-6s  %-22s  %-22s  %s\n", "編號", "英文", "中文", "資料夾");
+    outPrintf("---------------------------------------------------------------\n");
+    pageList(count, renderSortedRows, &view);
+    printf("共 %d 個單字。\n", count);
+}
+
+/* showCard：單字卡學習功能的入口
+   -------------------------------------------------------
+   先選資料夾，再選範圍：
+     a-c → 英文從 a 到 c 開頭的字（包含 cat、cup）
+     c   → 只看 c 開頭的字
+     Enter → 全部*/
+void showCard(void) {
+    printf("\n===== 單字卡學習模式 =====\n");
+    int choice = chooseFolder();
+    if (choice == -1) return; // 使用者選擇離開
+    int folderId = choice - 1; // 0 = 全部 → -1
+
+    char range[LINE_BUF] = "", from[LINE_BUF], to[LINE_BUF];
+    printf("要看哪些字？（例如 a-c、c，直接按 Enter 看全部）：");
+    inputLine(range, LINE_BUF);
+    rangeKeys(range, from, to);
+
+    const SortedIndex *order;
+    int first;
+    int count = sortedRange(folderId, from, to, &order, &first);
+    if (count < 0) {
+        printf("[Error] 記憶體不足，無法排序單字。\n");
+        return;
+    }
+    if (count == 0) {
+        printf("這個範圍沒有單字。\n");
+        return;
+    }
+
+    printf("1. 單字卡  2. 單字一覽（照字母排）\n請選擇: ");
+    char mode[16] = "";
+    inputLine(mode, sizeof(mode));
+    if (mode[0] == '2') {
+        showWordList(order, first, count);
+        return;
+    }
+
+    // 上次看到的字在這個範圍裡的話，可以從它後面接著看
+    int start = 0;
+    if (cardResume.valid) {
+        int next = sortedCursorNext(order, &cardResume) - first;
+        if (next > 0 && next < count) {
+            printf("上次看到「%s」，要從下一個接著看嗎？(1=是 / 其他=從頭): ", cardResume.en);
+            inputLine(mode, sizeof(mode));
+            if (mode[0] == '1') start = next;
+        }
+    }
+    showCards(order, first, count, start);
+}
+
+
+/* ================================================================
+   測驗的記憶體池
+   ================================================================
+
+   一次測驗要的東西：題目清單、每題的結果、打的答案、每題想了多久。
+   → 以前題目清單是照「整個單字庫」的大小 malloc，答錯清單又另外 malloc 一份；
+     只考一個 20 題的資料夾也要準備整個單字庫那麼多格。
+   → 現在先算出「這次最多幾題」（候選單字有幾個），sessionBegin 一次配置剛好夠的一塊，
+     所有陣列都從這一塊切出來；答案字串不夠放時再接一塊（BUMP_BLOCK）。
+   → 測驗結束呼叫 sessionEnd，整個記憶體池一次放掉，不用一個一個 free。
+   ================================================================ */
+
+/* bumpGrow：接一塊新的（data 剛好 cap byte）當作目前在用的那一塊
+   回傳值：1 = 成功，0 = 記憶體不足*/
+static int bumpGrow(BumpArena *a, size_t cap) {
+    BumpBlock *b = malloc(sizeof(BumpBlock) + cap);
+    if (!b) return 0;
+    b->next = a->head;
+    b->used = 0;
+    b->cap  = cap;
+    a->head = b;
+    return 1;
+}
+
+/* bumpAlloc：從記憶體池拿 bytes 個 byte（對齊 8 byte，放 int、指標都沒問題）
+   回傳值：拿到的位置；記憶體不足時回傳 NULL。拿到的記憶體不能單獨 free，要整個 bumpFree。*/
+void *bumpAlloc(BumpArena *a, size_t bytes) {
+    bytes = (bytes + 7) & ~(size_t)7;
+    if (!a->head || a->head->cap - a->head->used < bytes) {
+        if (!bumpGrow(a, bytes > BUMP_BLOCK ? bytes : BUMP_BLOCK)) return NULL;
+    }
+    void *p = a->head->data + a->head->used;
+    a->head->used += bytes;
+    return p;
+}
+
+/* bumpStrdup：把字串 s 複製一份到記憶體池
+   回傳值：複製出來的字串；記憶體不足時回傳 NULL*/
+char *bumpStrdup(BumpArena *a, const char *s) {
+    size_t len = strlen(s) + 1;
+    char *p = bumpAlloc(a, len);
+    if (p) memcpy(p, s, len);
+    return p;
+}
+
+/* bumpFree：把整個記憶體池還回去（之後還可以再拿）*/
+void bumpFree(BumpArena *a) {
+    while (a->head) {
+        BumpBlock *next = a->head->next;
+        free(a->head);
+        a->head = next;
+    }
+}
+
+/* sessionBegin：準備一次最多 capacity 題的測驗
+   -------------------------------------------------------
+   題目、結果、答案、時間（想了多久、什麼時候交的）五個陣列加上答案字串的位置，先算好總共要多少，
+   一次 malloc 一塊剛好的（bumpGrow），再從裡面切出來，不會多一格、也不會切得很碎。
+   questions 交給呼叫者填，填完把題數寫進 total。
+
+   回傳值：1 = 成功，0 = 記憶體不足（s 不用 sessionEnd）*/
+int sessionBegin(TestSession *s, int capacity) {
+    memset(s, 0, sizeof(*s));
+    size_t n = (size_t)(capacity > 0 ? capacity : 1);
+    size_t need = ((n * sizeof(int) + 7) & ~(size_t)7)
+                + ((n + 7) & ~(size_t)7)
+                + n * sizeof(const char *)
+                + ((n * sizeof(uint32_t) + 7) & ~(size_t)7) * 2
+                + n * SESSION_ANSWER_AVG;
+    if (!bumpGrow(&s->mem, need)) return 0;
+    s->questions = bumpAlloc(&s->mem, n * sizeof(int));
+    s->results   = bumpAlloc(&s->mem, n);
+    s->answers   = bumpAlloc(&s->mem, n * sizeof(const char *));
+    s->elapsedMs = bumpAlloc(&s->mem, n * sizeof(uint32_t));
+    s->answeredAt = bumpAlloc(&s->mem, n * sizeof(uint32_t));
+    s->capacity  = (int)n;
+    return 1;
+}
+
+/* sessionEnd：測驗結束，整個放掉*/
+void sessionEnd(TestSession *s) {
+    bumpFree(&s->mem);
+    memset(s, 0, sizeof(*s));
+}
+
+
+/* ================================================================
+   測驗功能
+   ================================================================ */
+
+/* collectIndices：收集符合條件的單字，把它們在 library 的索引存進 result[]
+   -------------------------------------------------------
+   為什麼用索引而不是直接複製單字資料？
+   → 因為我們之後要修改 errorCount，如果是複製出來的副本，
+     改了不會影響到原本的 library，所以必須用索引來操作原本的資料。
+
+   參數：
+     folderId → 要篩選哪個資料夾的編號；傳入 -1 代表「全部都要」
+     result   → 由呼叫者提供的陣列（至少 library.count 格），用來存結果
+
+   回傳值：符合條件的單字數量*/
+int collectIndices(int folderId, int result[]) {
+    if (folderId >= 0) {
+        // 某個資料夾：它的單字清單已經排好了，直接複製
+        const IdList *members = folderMembers(folderId);
+        memcpy(result, members->ids, (size_t)members->count * sizeof(int));
+        return members->count;
+    }
+    // folderId == -1 代表不篩選，全部收集
+    for (int i = 0; i < library.count; i++) {
+        result[i] = i; // 把索引 i 存進結果陣列
+    }
+    return library.count;
+}
+
+/* isSynonymAnswer：使用者的答案雖然不是這題的單字，但是不是另一個「中文完全一樣」的單字？
+   -------------------------------------------------------
+   例如題目是「大的」，單字庫裡同時有 big 和 large 兩個字的中文都是「大的」，
+   這時候回答 large 也不應該被算錯。
+   用英文索引直接查使用者打的字，O(1) 就知道它在不在單字庫裡。
+   answer 要先正規化過（normalizeText），中文也是比 key，「蘋果」和「苹果」算一樣。
+
+   回傳值：1 = 是同義字，算對；0 = 不是*/
+int isSynonymAnswer(const char *answer, int wordIdx) {
+    uint32_t hash = keyHash(answer);
+    uint32_t pos  = hash;
+    int idx;
+    while ((idx = hashNext(&englishIndex, hash, &pos)) >= 0) {
+        if (strcmp(wordKeyEn(idx), answer) == 0 &&
+            strcmp(wordKeyCn(idx), wordKeyCn(wordIdx)) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* gradeAnswer：判斷答案對不對（只判斷，不改任何資料）
+   answer 要先正規化過（normalizeText）。拼對、或是中文完全一樣的同義字都算對；
+   差一兩個字母算「差一點」（isNearMiss）。
+
+   回傳值：ANSWER_RIGHT / ANSWER_NEAR / ANSWER_WRONG*/
+int gradeAnswer(const char *answer, int wordIdx) {
+    uint64_t started = metricNow();
+    int result;
+    if (strcmp(answer, wordKeyEn(wordIdx)) == 0 || isSynonymAnswer(answer, wordIdx)) {
+        result = ANSWER_RIGHT;
+    } else {
+        result = isNearMiss(answer, wordKeyEn(wordIdx)) ? ANSWER_NEAR : ANSWER_WRONG;
+    }
+    metricRecord(METRIC_ANSWER, started);
+    return result;
+}
+
+/* askQuestion：出一道題目，讀取使用者的答案，判斷對錯
+   -------------------------------------------------------
+   為什麼 score 要用「指標（*score）」而不是直接傳整數？
+   → C 語言函數的參數是「複製一份」傳進來的，
+     如果直接傳 score 這個整數，在函數裡改它，
+     改的是「複製品」，不會影響呼叫者的 score。
+   → 傳指標（&score）相當於傳「score 的地址」，
+     這樣函數就能直接到那個地址去修改它。
+
+   參數：
+     wordIdx → 這題的單字在 library 的索引
+     qNum    → 目前是第幾題（顯示用）
+     total   → 總共幾題（顯示用）
+     score   → 分數的指標，答對時 *score 加 1
+     answer, cap → 使用者打的答案讀進 *answer（正規化過），暫存區不夠時自動加大（和 readLine 一樣）
+
+   回傳值：ANSWER_RIGHT = 答對，ANSWER_WRONG = 答錯，ANSWER_NEAR = 差一點（打錯字，不算分也不算錯）*/
+int askQuestion(int wordIdx, int qNum, int total, int *score, char **answerBuf, size_t *cap) {
+    printf("\n--- 第 %d / %d 題 ---\n", qNum, total);
+    printf("中文：%s\n", wordChinese(wordIdx));
+    printf("請輸入英文單字：");
+
+    // 整行讀進來：scanf("%s") 遇到空格就停，片語（look up）只會讀到 look
+    inputText(answerBuf, cap);
+    if (!*answerBuf) return ANSWER_WRONG; // 記憶體不足，連一個 byte 都讀不進來
+    char *answer = *answerBuf;
+    trimText(answer);
+    normalizeText(answer, answer); // 轉成 key（小寫、半形），和單字庫存好的 key 比
+    int result = gradeAnswer(answer, wordIdx);
+
+    if (result == ANSWER_RIGHT) {
+        (*score)++;   // *score 代表「解開指標，取得它指向的值」，然後 +1
+        libraryReview(wordIdx, 1); // 答對：下次複習的間隔拉長
+        if (strcmp(answer, wordKeyEn(wordIdx)) == 0) {
+            printf("✓ 答對了！目前得分：%d / %d\n", *score, qNum);
+        } else {
+            printf("✓ 答對了！（標準答案是 %s，「%s」的意思也完全一樣）目前得分：%d / %d\n",
+                   wordEnglish(wordIdx), answer, *score, qNum);
+        }
+        return ANSWER_RIGHT;
+    } else if (result == ANSWER_NEAR) {
+        // 只是打錯字：不加分，但錯誤次數也不加，錯題排行和錯題測驗才不會被打錯字灌水
+        libraryReview(wordIdx, 0); // 拼法還不熟，過幾分鐘再考一次
+        printf("△ 差一點！正確拼法是：%s（你打的是 %s，這次不算錯）\n", wordEnglish(wordIdx), answer);
+        printf("  目前得分：%d / %d\n", *score, qNum);
+        return ANSWER_NEAR;
+    } else {
+        libraryAddError(wordIdx, 1);          // 直接修改 library 裡的資料（順便更新錯題排行）
+        storageError(wordIdx, 1);             // 記進日誌（或資料庫），測驗結束時一起寫入磁碟
+        libraryReview(wordIdx, 0);            // 答錯：過幾分鐘再考一次
+        printf("✗ 答錯了，正確答案是：%s（這題已答錯 %d 次）\n",
+               wordEnglish(wordIdx),
+               library.words[wordIdx].errorCount);
+        // 告訴使用者他打的字是什麼：單字庫裡的另一個字，或最像的那個字
+        int other = findEnglish(answer);
+        const char *like;
+        if (other >= 0) {
+            printf("  （%s 是「%s」的意思）\n", answer, wordChinese(other));
+        } else if ((like = bkNearest(answer, SUGGEST_LIMIT, NULL)) != NULL &&
+                   strcmp(like, wordKeyEn(wordIdx)) != 0) {
+            printf("  （你打的 %s 比較像單字庫裡的 %s）\n", answer, like);
+        }
+        printf("  目前得分：%d / %d\n", *score, qNum);
+        return ANSWER_WRONG;
+    }
+}
+
+/* askChoice：出一道選擇題（看中文，從幾個英文裡選一個）
+   -------------------------------------------------------
+   選項是 distractorPick 事先挑好的干擾選項加上正確答案，打亂順序之後列出來，
+   輸入號碼或直接打那個英文都可以。選擇題沒有「差一點」，選錯就是答錯。
+
+   參數、回傳值都和 askQuestion 一樣（*answer 放的是選的那個英文）。
+   單字庫太小湊不出任何干擾選項時，改成打英文作答。*/
+int askChoice(int wordIdx, int qNum, int total, int *score, char **answer, size_t *cap) {
+    int options[DISTRACT_CHOICES + 1];
+    int n = distractorPick(wordIdx, options);
+    if (n <= 0) return askQuestion(wordIdx, qNum, total, score, answer, cap);
+    options[n++] = wordIdx;
+    shuffle(options, n); // 正確答案不會固定在同一個位置
+
+    printf("\n--- 第 %d / %d 題 ---\n", qNum, total);
+    printf("中文：%s\n", wordChinese(wordIdx));
+    for (int i = 0; i < n; i++) printf("  %d. %s\n", i + 1, wordEnglish(options[i]));
+    printf("請選擇 (1~%d)：", n);
+
+    inputText(answer, cap);
+    if (!*answer) return ANSWER_WRONG; // 記憶體不足
+    char *reply = *answer;
+    trimText(reply);
+    normalizeText(reply, reply);
+
+    int picked = -1;
+    char *end;
+    long k = strtol(reply, &end, 10);
+    if (end != reply && *end == '\0') {
+        if (k >= 1 && k <= n) picked = options[k - 1];
+    } else {
+        for (int i = 0; i < n; i++) {
+            if (strcmp(reply, wordKeyEn(options[i])) == 0) picked = options[i];
+        }
+    }
+    if (picked >= 0) {
+        // 記下選的是哪個字（不是號碼），測驗結束時列出來才看得懂
+        const char *en = wordKeyEn(picked);
+        size_t need = strlen(en) + 1;
+        char *p = need <= *cap ? *answer : realloc(*answer, need);
+        if (p) {
+            if (need > *cap) *cap = need;
+            memcpy(p, en, need);
+            *answer = p;
+        }
+    }
+
+    if (picked == wordIdx) {
+        (*score)++;
+        libraryReview(wordIdx, 1);
+        printf("✓ 答對了！目前得分：%d / %d\n", *score, qNum);
+        return ANSWER_RIGHT;
+    }
+    libraryAddError(wordIdx, 1);
+    storageError(wordIdx, 1);
+    libraryReview(wordIdx, 0);
+    printf("✗ 答錯了，正確答案是：%s（這題已答錯 %d 次）\n",
+           wordEnglish(wordIdx), library.words[wordIdx].errorCount);
+    if (picked >= 0) printf("  （%s 是「%s」的意思）\n", wordEnglish(picked), wordChinese(picked));
+    printf("  目前得分：%d / %d\n", *score, qNum);
+    return ANSWER_WRONG;
+}
+
+/* runTest：執行一次完整的測驗流程，顯示最終結果
+   -------------------------------------------------------
+   為什麼要獨立成一個函數？
+   → takeTest（一般測驗）和 takeErrorTest（錯題測驗）的流程幾乎一樣，
+     把共用的部分抽出來，就不用寫兩遍一樣的程式碼。
+   → 這種概念叫做「避免重複（Don't Repeat Yourself）」。
+
+   參數：
+     s → 這次的測驗（questions 和 total 已經填好、洗牌過）；每題的結果、答案、時間都記在 s 裡*/
+void runTest(TestSession *s) {
+    int score      = 0;
+    int wrongCount = 0;
+    int nearCount  = 0;
+    uint64_t thinkMs = 0;
+    int slowest = 0;
+
+    char  *answer    = NULL; // 每一題的答案都讀進這裡（inputText 會依照長度自動加大）
+    size_t answerCap = 0;
+    for (int i = 0; i < s->total; i++) {
+        uint64_t started = metricNow();
+        int result = s->choices ? askChoice(s->questions[i], i + 1, s->total, &score, &answer, &answerCap)
+                                : askQuestion(s->questions[i], i + 1, s->total, &score, &answer, &answerCap);
+        s->results[i]    = (uint8_t)result;
+        s->elapsedMs[i]  = (uint32_t)((metricNow() - started) / 1000000);
+        s->answeredAt[i] = (uint32_t)time(NULL);
+        s->answers[i]    = bumpStrdup(&s->mem, answer ? answer : ""); // 記憶體不足時是 NULL，結果照樣算
+        wrongCount += s->results[i] == ANSWER_WRONG;
+        nearCount  += s->results[i] == ANSWER_NEAR;
+        thinkMs    += s->elapsedMs[i];
+        if (s->elapsedMs[i] > s->elapsedMs[slowest]) slowest = i;
+    }
+    free(answer);
+    statsSession(score, nearCount, s->total);
+    eventLogSession(s); // 每一題的作答都留下來給 --analyze 用
+
+    // 顯示最終結果
+    printf("\n===== 測驗結束 =====\n");
+    // (double) 是強制型別轉換，讓除法結果是小數而不是整數
+    printf("最終得分：%d / %d（正確率 %.0f%%）\n",
+           score, s->total, (double)score / s->total * 100);
+    printf("作答時間：平均每題 %.1f 秒，想最久的是 %s（%.1f 秒）\n",
+           (double)thinkMs / s->total / 1000, wordEnglish(s->questions[slowest]),
+           s->elapsedMs[slowest] / 1000.0);
+
+    // 答錯、差一點的單字直接從每題的結果找出來，不用另外準備清單
+    if (wrongCount > 0) {
+        printf("\n這次答錯的單字（共 %d 個）：\n", wrongCount);
+        for (int i = 0; i < s->total; i++) {
+            if (s->results[i] != ANSWER_WRONG) continue;
+            printf("  ✗  %-20s %s（你寫的是 %s）\n", wordEnglish(s->questions[i]),
+                   wordChinese(s->questions[i]), s->answers[i] ? s->answers[i] : "?");
+        }
+    }
+    if (nearCount > 0) {
+        printf("\n拼字差一點的單字（共 %d 個，不算錯）：\n", nearCount);
+        for (int i = 0; i < s->total; i++) {
+            if (s->results[i] != ANSWER_NEAR) continue;
+            printf("  △  %-20s %s（你寫的是 %s）\n", wordEnglish(s->questions[i]),
+                   wordChinese(s->questions[i]), s->answers[i] ? s->answers[i] : "?");
+        }
+    }
+    if (wrongCount == 0 && nearCount == 0) {
+        printf("太厲害了！全部答對！\n");
+    }
+
+    storageCommit(1); // 把這次的錯誤次數和複習排程變更寫入磁碟
+}
+
+/* takeTest：一般測驗（可選資料夾，三種出題方式）
+   -------------------------------------------------------
+   1. 今日複習：用複習排程挑出「已經到期」的單字，不夠的話補上新單字，最多 REVIEW_SESSION 題。
+   2. 加權抽題：抽 WEIGHTED_QUIZ 題，錯越多次的單字越容易被抽到（drawWeighted）。
+   3. 整個範圍考一遍：全部洗牌之後依序出題（最早的做法）。
+   每一種都可以選「打英文」或「選擇題」（askChoice）作答。*/
+void takeTest(void) {
+    printf("\n===== 單字測驗模式 =====\n");
+
+    int folderChoice = chooseFolder();
+    if (folderChoice == -1) return;
+
+    // 選了「全部單字」（0）就是 -1，否則取對應資料夾編號
+    int folderId = folderChoice - 1;
+
+    printf("\n  1. 今日複習（到期的單字優先，最多 %d 題）\n", REVIEW_SESSION);
+    printf("  2. 加權抽 %d 題（錯越多次越容易抽到）\n", WEIGHTED_QUIZ);
+    printf("  3. 整個範圍隨機考一遍\n");
+    printf("請選擇: ");
+    int mode;
+    int ok = scanf("%d", &mode) == 1;
+    clearInputBuffer();
+    if (!ok || mode < 1 || mode > 3) {
+        printf("[Error] 沒有這個選項。\n");
+        return;
+    }
+
+    printf("\n作答方式：1. 打英文  2. 選擇題（%d 選 1）\n請選擇: ", DISTRACT_CHOICES + 1);
+    int answerMode = 1;
+    if (scanf("%d", &answerMode) != 1) answerMode = 1; // 沒打數字就當作打英文
+    clearInputBuffer();
+
+    // 先算出這次最多幾題，記憶體池就照這個大小準備
+    int capacity = mode == 1 ? REVIEW_SESSION
+                 : mode == 2 ? WEIGHTED_QUIZ
+                 : folderId >= 0 ? folderMembers(folderId)->count : library.count;
+    TestSession s;
+    if (!sessionBegin(&s, capacity)) {
+        printf("[Error] 記憶體不足，無法開始測驗。\n");
+        return;
+    }
+    s.choices = (answerMode == 2);
+
+    if (mode == 1) {
+        int dueCount = 0;
+        s.total = buildReviewSession(folderId, s.questions, REVIEW_SESSION, &dueCount);
+        if (s.total == 0) {
+            printf("這個範圍的單字都還沒到複習時間，可以改用加權抽題或整個範圍考一遍。\n");
+        } else {
+            printf("\n本次複習：%d 個到期的單字、%d 個新單字\n", dueCount, s.total - dueCount);
+            runTest(&s);
+        }
+    } else if (mode == 2) {
+        s.total = drawWeighted(folderId, WEIGHTED_QUIZ, s.questions);
+        if (s.total < 0) {
+            printf("[Error] 記憶體不足，無法開始測驗。\n");
+        } else if (s.total == 0) {
+            printf("這個範圍裡沒有任何單字可以測驗。\n");
+        } else {
+            runTest(&s);
+        }
+    } else {
+        s.total = collectIndices(folderId, s.questions);
+        if (s.total == 0) {
+            printf("這個範圍裡沒有任何單字可以測驗。\n");
+        } else {
+            shuffle(s.questions, s.total); // 洗牌：打亂出題順序
+            runTest(&s);
+        }
+    }
+    sessionEnd(&s);
+}
+
+/* takeErrorTest：錯題加強測驗（只針對有答錯過的單字）*/
+void takeErrorTest(void) {
+    // 錯題排行裡就是所有錯誤次數 > 0 的單字，有幾個就準備幾題，不用再掃一遍單字庫
+    TestSession s;
+    if (!sessionBegin(&s, heapCount(&errorRank))) {
+        printf("[Error] 記憶體不足，無法開始測驗。\n");
+        return;
+    }
+    s.total = heapCollect(&errorRank, s.questions);
+
+    if (s.total == 0) {
+        printf("目前沒有任何錯誤紀錄，繼續加油！\n");
+    } else {
+        printf("\n===== 錯題加強測驗（共 %d 題）=====\n", s.total);
+        shuffle(s.questions, s.total); // 打亂順序，避免記住題目位置
+        runTest(&s);
+    }
+    sessionEnd(&s);
+}
+
+
+/* ================================================================
+   查詢功能
+   ================================================================ */
+
+/* renderSearchRows：排出查詢結果的第 first 行開始的 count 行（ctx 是 IdList）*/
+static void renderSearchRows(int first, int count, void *ctx) {
+    const IdList *hits = ctx;
+    for (int k = first; k < first + count; k++) {
+        int i = hits->ids[k];
+        outPrintf("  %d. [%s]  %-20s ／ %s  （已錯 %d 次）\n",
+                  k + 1,
+                  wordFolder(i),
+                  wordEnglish(i),
+                  wordChinese(i),
+                  library.words[i].errorCount);
+    }
+}
+
+/* search：讓使用者輸入關鍵字，同時搜尋英文和中文欄位
+   -------------------------------------------------------
+   關鍵字最後加一個 *（例如 app*）就只找「開頭是」app 的單字，
+   適合邊打字邊查。實際的搜尋交給片段索引（gramSearch），
+   不用每次都把整個單字庫 strstr 一遍。
+
+   回傳值：1 = 繼續查詢，0 = 使用者輸入 end 要離開
+
+   為什麼回傳 int？
+   → 在 mainMenu 裡是用 while(search()) 呼叫的，
+     回傳 1 就繼續查，回傳 0 就停止。這是一種讓迴圈能「從函數裡控制」的技巧。*/
+int search(void) {
+    char  *keyword = NULL;    // 原始輸入（顯示用），多長都可以，用完要 free
+    size_t cap     = 0;
+    char   buf[CN_LEN];       // 正規化之後的關鍵字（小寫、半形、繁轉簡）短的放這裡
+
+    printf("\n請輸入要查詢的英文或中文（結尾加 * 只找開頭，輸入 end 結束查詢）：");
+    if (inputText(&keyword, &cap) < 0 || strcmp(keyword, "end") == 0) {
+        printf("結束查詢。\n");
+        free(keyword);
+        return 0; // 告訴呼叫者停止 while 迴圈（輸入結束了也一樣）
+    }
+    trimText(keyword);
+    if (strlen(keyword) == 0) { // 什麼都沒輸入，繼續
+        free(keyword);
+        return 1;
+    }
+
+    // 結尾的 * 代表「前綴查詢」，把它拿掉之後才是真正的關鍵字
+    size_t len    = strlen(keyword);
+    int    prefix = (len > 1 && keyword[len - 1] == '*');
+    if (prefix) keyword[len - 1] = '\0';
+
+    // 單字庫的 key 在新增單字時就算好了，這裡只要轉關鍵字這一個
+    char *key = normalizeKey(keyword, buf, sizeof(buf));
+    if (!key) {
+        printf("[Error] 記憶體不足，無法查詢。\n");
+        free(keyword);
+        return 1;
+    }
+
+    IdList hits = {0};
+    int foundCount = gramSearch(&textIndex, &library, key, prefix, &hits);
+    pageList(foundCount, renderSearchRows, &hits);
+    free(hits.ids);
+
+    if (foundCount == 0) {
+        printf("找不到包含「%s」的單字。\n", keyword);
+        const char *like = bkNearest(key, SUGGEST_LIMIT, NULL);
+        if (like) printf("你是不是要找：%s\n", like);
+    } else {
+        printf("共找到 %d 筆。\n", foundCount);
+    }
+
+    if (key != buf) free(key);
+    free(keyword);
+    return 1; // 查詢結束，繼續等下一次輸入
+}
+
+
+/* ================================================================
+   錯題本
+   ================================================================ */
+
+/* renderErrorRows：排出錯題排行第 first+1 名開始的 count 名*/
+static void renderErrorRows(int first, int count, void *ctx) {
+    (void)ctx;
+    int  page[LIST_PAGE];
+    int *ids = count <= LIST_PAGE ? page : malloc((size_t)count * sizeof(int));
+    if (!ids) return;
+    int n = heapTop(&errorRank, first, count, ids, NULL, NULL);
+    for (int i = 0; i < n; i++) {
+        int idx = ids[i];
+        outPrintf("%-5d  %-22s  %-22s  %d 次\n",
+                  first + i + 1,
+                  wordEnglish(idx),
+                  wordChinese(idx),
+                  library.words[idx].errorCount);
+    }
+    if (ids != page) free(ids);
+}
+
+/* showErrorList：顯示所有有答錯紀錄的單字，按錯誤次數從多到少排列
+   -------------------------------------------------------
+   舊版每次都把有錯的單字收集起來再用選擇排序（O(n²)），
+   錯題一多就要等很久。現在錯題排行（errorRank）隨時都是排好的，
+   每一頁只要用 heapTop 取出那 LIST_PAGE 個，不用排序整份清單。*/
+void showErrorList(void) {
+    int errorTotal = heapCount(&errorRank);
+    if (errorTotal == 0) {
+        printf("\n太棒了！目前完全沒有錯誤紀錄！繼續保持！\n");
+        return;
+    }
+
+    // 顯示排行，一頁 LIST_PAGE 個（不是終端機的話一次全部列出來）
+    outPrintf("\n===== 錯題本（共 %d 個單字）=====\n", errorTotal);
+    outPrintf("%-5s  %-22s  %-22s  %s\n", "名次", "英文", "中文", "錯誤次數");
+    outPrintf("-----------------------------------------------\n");
+    pageList(errorTotal, renderErrorRows, NULL);
+
+    // 詢問是否要立刻針對這些錯題測驗
+    printf("\n要針對這些錯題進行加強測驗嗎？(1=是 / 其他=否): ");
+    int yn;
+    if (scanf("%d", &yn) == 1 && yn == 1) {
+        clearInputBuffer();
+        takeErrorTest();
+    } else {
+        clearInputBuffer();
+    }
+}
+
+
+/* ================================================================
+   刪除單字
+   ================================================================ */
+
+/* deleteWord：讓使用者輸入單字名稱，從 library 中刪除
+   -------------------------------------------------------
+   刪除的方法（以最後元素覆蓋，實際做法在 libraryRemove / storeRemove）：
+   → 找到要刪的單字後，把 library 最後一格的資料複製過來蓋掉它，
+     再把 library.count 減 1，這格就等於「消失」了。
+
+   這個方法的優缺點：
+   ✓ 優點：速度快，O(1)，不需要移動其他元素
+   ✗ 缺點：單字的儲存順序會改變（但這個程式不依賴順序，所以沒關係）*/
+void deleteWord(void) {
+    if (library.count == 0) {
+        printf("目前沒有任何單字可以刪除。\n");
+        return;
+    }
+
+    clearInputBuffer(); // 清掉主選單 scanf 留下的換行
+    char  *target = NULL; // 片語多長都可以（inputText 自動加大），用完要 free
+    size_t cap    = 0;
+    printf("\n請輸入要刪除的英文單字（輸入 end 取消）：");
+
+    if (inputText(&target, &cap) < 0 || strcmp(target, "end") == 0) {
+        printf("已取消刪除。\n");
+        free(target);
+        return;
+    }
+    toLowerEN(target);
+
+    // 用英文索引直接找到這個單字，不用從頭掃 library
+    int i = findEnglish(target);
+    if (i < 0) {
+        printf("找不到「%s」這個單字。\n", target);
+        free(target);
+        return;
+    }
+
+    printf("\n找到：\n");
+    printf("  英文：%s\n  中文：%s\n  資料夾：%s\n",
+           wordEnglish(i), wordChinese(i), wordFolder(i));
+    printf("確定要刪除嗎？(1=確定 / 其他=取消): ");
+
+    int yn;
+    scanf("%d", &yn);
+    clearInputBuffer();
+
+    if (yn != 1) {
+        printf("已取消。\n");
+        free(target);
+        return;
+    }
+
+    // 先記進日誌（要趁單字還在的時候記），再用最後一個元素覆蓋，縮短陣列
+    storageRemoving(i);
+    libraryRemove(i);
+    storageCommit(1);
+    printf("[Success] 已成功刪除「%s」。\n", target);
+    free(target);
+}
+
+
+/* ================================================================
+   新增單字
+   ================================================================ */
+
+/* AddWord：讓使用者一次新增多個單字，輸入 end 才結束
+   -------------------------------------------------------
+   輸入格式：英文單字 [Tab鍵] 中文意思
+   例如：apple    蘋果
+
+   一行多長都可以（inputText 會自動加大暫存區），片語、很長的中文解釋都不會被截斷；
+   不是 UTF-8 的輸入（例如終端機設成 Big5）會被擋下來，不會存進單字庫變成亂碼。*/
+void AddWord(void) {
+    clearInputBuffer(); // 清掉主選單 scanf 留下的換行
+
+    printf("===== 新增單字 =====\n");
+    printf("（新增的單字會自動存檔）\n\n");
+
+    char  *folder = NULL, *raw = NULL; // inputText 依照輸入的長度自動加大，最後要 free
+    size_t folderCap = 0, rawCap = 0;
+
+    // 第一步：選擇要存入哪個資料夾
+    while (1) {
+        printf("請輸入資料夾名稱（英文，例如 ch1 / unit2）：");
+        long len = inputText(&folder, &folderCap);
+        if (len < 0) { // 輸入結束了
+            free(folder);
+            return;
+        }
+        toLowerEN(folder); // 轉小寫
+        if (len > 0 && utf8Valid(folder, (size_t)len)) break;
+        printf("[Error] 資料夾名稱不能空白，請重新輸入。\n");
+    }
+    int folderId = folderIntern(folder); // 確保這個資料夾有被記錄起來
+    if (folderId < 0) {
+        free(folder);
+        return;
+    }
+
+    printf("\n輸入格式：英文 [Tab鍵] 中文，例如：apple\t蘋果\n");
+    printf("輸入 end 結束新增。\n\n");
+
+    // 第二步：重複接收單字，直到輸入 end 為止（單字庫會自動長大，不會滿）
+    while (1) {
+        printf("> ");
+        long len = inputText(&raw, &rawCap);
+
+        if (len < 0 || strcmp(raw, "end") == 0) {
+            storageCommit(1); // 把還沒寫入磁碟的最後一批寫進去
+            printf("新增結束。\n");
+            break;
+        }
+        toLowerEN(raw); // 把英文轉小寫（中文不受影響）
+        if (!utf8Valid(raw, (size_t)len)) {
+            printf("[Error] 輸入的文字不是 UTF-8 編碼（終端機可能設成 Big5 了），請重新輸入。\n");
+            continue;
+        }
+
+        // strtok 會直接修改傳入的字串（把 Tab 換成 '\0'），raw 之後就不是完整的一行了
+        char *en = strtok(raw, "\t"); // 切出英文部分
+        char *ch = strtok(NULL, "\t"); // 切出中文部分
+
+        // 檢查格式是否正確（兩個部分都要有）
+        if (!en || !ch || strlen(en) == 0 || strlen(ch) == 0) {
+            printf("[Error] 格式錯誤，記得用 Tab 鍵分隔英文和中文。\n");
+            continue; // 跳回迴圈開頭，讓使用者重新輸入
+        }
+
+        // 重複檢查：同一個資料夾裡，英文和中文都完全一樣就算重複
+        // （用（資料夾, 英文）索引直接查，不用從頭掃一遍）
+        if (findInFolder(folderId, en, ch) >= 0) {
+            printf("[Warning] 這個單字在「%s」已經存在了，跳過。\n", folder);
+            continue;
+        }
+
+        // 以前是組成「資料夾\t英文\t中文」再交給 parseLine，要先準備一個夠大的陣列；
+        // 欄位已經切好了，直接交給 libraryAdd（parseLine 最後也是呼叫它）
+        int idx = libraryAdd(folderId, en, ch, 0);
+        if (idx < 0) continue;
+
+        printf("[Success] 已新增：%s ／ %s（資料夾：%s）\n",
+               wordEnglish(idx),
+               wordChinese(idx),
+               folder);
+        storageAdded(idx);  // 只在日誌後面追加一行（或資料庫多一列），不用重寫整個檔案
+        storageCommit(0);   // 每攢滿一批就寫入磁碟，避免中途出錯遺失太多資料
+    }
+    free(folder);
+    free(raw);
+}
+
+
+/* ================================================================
+   統計資訊
+   ================================================================ */
+
+/* statsBucket：錯誤次數 errors 落在分布的第幾格
+   0 次（或更少）是第 0 格，之後每格的範圍加倍：1、2~3、4~7……，最後一格放不下的都算進去。*/
+static int statsBucket(int errors) {
+    int b = 0;
+    while (errors > 0 && b < STATS_BUCKETS - 1) {
+        errors >>= 1;
+        b++;
+    }
+    return b;
+}
+
+/* statsApply：把一個錯誤次數是 errors、在資料夾 folderId 的單字算進（sign = 1）或扣出（sign = -1）統計
+   回傳值：1 = 成功，0 = 資料夾的統計陣列長不大了（呼叫者要放棄 ready）*/
+static int statsApply(int folderId, int errors, int sign) {
+    if (folderId >= stats.folderCap) {
+        // 新的資料夾：陣列跟著加倍（新的格子都是 0）
+        int newCap = stats.folderCap ? stats.folderCap : 16;
+        while (newCap <= folderId) newCap *= 2;
+        FolderStat *p = realloc(stats.perFolder, (size_t)newCap * sizeof(FolderStat));
+        if (!p) return 0;
+        memset(p + stats.folderCap, 0, (size_t)(newCap - stats.folderCap) * sizeof(FolderStat));
+        stats.perFolder = p;
+        stats.folderCap = newCap;
+    }
+    FolderStat *sets[2] = { &stats.total, &stats.perFolder[folderId] };
+    for (int k = 0; k < 2; k++) {
+        sets[k]->words      += sign;
+        sets[k]->errorWords += sign * (errors > 0);
+        sets[k]->errors     += sign * (errors > 0 ? errors : 0);
+    }
+    stats.histogram[statsBucket(errors)] += sign;
+    return 1;
+}
+
+/* statsBuild：從頭掃一遍單字庫，把統計算好
+   只有第一次看統計（或記憶體不足放棄過）才會用到，之後都靠 statsAdd / statsForget / statsError 更新。
+
+   回傳值：1 = 成功，0 = 記憶體不足*/
+int statsBuild(void) {
+    memset(&stats.total, 0, sizeof(stats.total));
+    memset(stats.histogram, 0, sizeof(stats.histogram));
+    if (stats.perFolder) memset(stats.perFolder, 0, (size_t)stats.folderCap * sizeof(FolderStat));
+    for (int i = 0; i < library.count; i++) {
+        if (!statsApply(library.words[i].folderId, library.words[i].errorCount, 1)) return stats.ready = 0;
+    }
+    return stats.ready = 1;
+}
+
+/* statsAdd / statsForget：第 idx 個單字剛新增／要刪除了（statsForget 要在 storeRemove 之前呼叫）*/
+void statsAdd(int idx) {
+    if (stats.ready && !statsApply(library.words[idx].folderId, library.words[idx].errorCount, 1)) {
+        stats.ready = 0;
+    }
+}
+
+void statsForget(int idx) {
+    // 扣掉一定成功：這個資料夾的格子在加進來的時候就有了
+    if (stats.ready) statsApply(library.words[idx].folderId, library.words[idx].errorCount, -1);
+}
+
+/* statsError：第 idx 個單字的錯誤次數剛從 before 改成現在的值*/
+void statsError(int idx, int before) {
+    if (!stats.ready) return;
+    statsApply(library.words[idx].folderId, before, -1);
+    statsApply(library.words[idx].folderId, library.words[idx].errorCount, 1);
+}
+
+/* statsSession：記下一次測驗的成績（runTest 結束時呼叫）*/
+void statsSession(int right, int near, int total) {
+    if (total <= 0) return;
+    stats.recent[stats.sessions % STATS_RECENT] = (uint16_t)((long)right * 10000 / total);
+    stats.sessions++;
+    stats.asked += total;
+    stats.right += right;
+    stats.near  += near;
+}
+
+/* statsFree：放掉統計（測驗成績不動，只是單字庫的統計下次要重算）*/
+void statsFree(void) {
+    free(stats.perFolder);
+    stats.perFolder = NULL;
+    stats.folderCap = 0;
+    stats.ready     = 0;
+}
+
+/* showStats：顯示目前單字庫的整體數據
+   -------------------------------------------------------
+   以前每看一次就把所有單字掃一遍（算錯誤次數），各資料夾的單字數還要先建好資料夾清單；
+   現在 stats 在新增、刪除、答錯的時候就順便改好了，這裡只是印出來，
+   單字庫再大都一樣快（要掃的只有第一次看的那一遍）。*/
+void showStats(void) {
+    if (!stats.ready && !statsBuild()) {
+        outPrintf("[Error] 記憶體不足，無法計算統計資訊。\n");
+        outFlush();
+        return;
+    }
+    outPrintf("\n===== 統計資訊 =====\n");
+    outPrintf("資料夾數量  : %d 個\n", folders.count);
+    outPrintf("單字總量    : %d 個\n", stats.total.words);
+    outPrintf("有錯誤紀錄  : %d 個單字\n", stats.total.errorWords);
+    outPrintf("累計總錯誤  : %lld 次\n",  (long long)stats.total.errors);
+
+    // 顯示每個資料夾有幾個單字（讓使用者知道各章節的進度）
+    if (folders.count > 0) {
+        outPrintf("\n各資料夾單字數：\n");
+        for (int f = 0; f < folders.count; f++) {
+            FolderStat none = {0};
+            const FolderStat *fs = f < stats.folderCap ? &stats.perFolder[f] : &none;
+            outPrintf("  %-20s %d 個（答錯過 %d 個，共 %lld 次）\n",
+                      folderName(f), fs->words, fs->errorWords, (long long)fs->errors);
+        }
+    }
+
+    // 錯誤次數的分布：每一格有幾個單字
+    if (stats.total.words > 0) {
+        outPrintf("\n錯誤次數分布：\n");
+        for (int b = 0; b < STATS_BUCKETS; b++) {
+            int  lo = b ? 1 << (b - 1) : 0;
+            int  hi = (1 << b) - 1;
+            char range[32];
+            if (b == STATS_BUCKETS - 1) snprintf(range, sizeof(range), "%d ~", lo);
+            else if (lo == hi)          snprintf(range, sizeof(range), "%d", lo);
+            else                        snprintf(range, sizeof(range), "%d ~ %d", lo, hi);
+            outPrintf("  %-10s 次：%d 個\n", range, stats.histogram[b]);
+        }
+    }
+
+    // 這次執行做過的測驗
+    if (stats.sessions > 0) {
+        outPrintf("\n這次做了 %d 次測驗，共 %ld 題，答對 %ld 題（正確率 %.0f%%），差一點 %ld 題\n",
+                  stats.sessions, stats.asked, stats.right,
+                  (double)stats.right / stats.asked * 100, stats.near);
+        int shown = stats.sessions < STATS_RECENT ? stats.sessions : STATS_RECENT;
+        outPrintf("最近 %d 次的正確率（舊到新）：", shown);
+        for (int k = stats.sessions - shown; k < stats.sessions; k++) {
+            outPrintf(" %.0f%%", stats.recent[k % STATS_RECENT] / 100.0);
+        }
+        outPrintf("\n");
+    }
+    metricsShow();
+    outFlush();
+}
+
+
+/* ================================================================
+   作答紀錄（english_word.events）和 --analyze
+   ================================================================
+
+   為什麼要把每一題都記下來？
+   → 單字裡的 errorCount 只有「總共錯幾次」，看不出這個字是「一直錯」
+     還是「以前常錯、現在會了」，也看不出想了多久、都打成什麼。
+   → 每次測驗結束就把每一題的作答（哪個字、什麼時候、想了多久、對錯、打了什麼）
+     接在 english_word.events 後面，累積幾個月就有幾百萬筆，
+     再用 --analyze 一次算出每個單字的「難度曲線」：第 1 次、第 2 次、第 3~4 次……考的答對率。
+
+   為什麼是二進位、而且「一欄一欄」放？
+   → 一筆作答大約 19 byte 加上打的字，寫成文字的話要好幾倍大，讀的時候還要一行一行解析。
+   → 一次測驗寫成一塊，塊裡先放所有題目的單字、再放所有題目的時間……（欄式，columnar）：
+       [EventBlock] [單字 key × n] [交出時間 × n] [想了幾毫秒 × n] [答案長度 × n] [結果 × n] [答案字串]
+     分析時 mapFile 之後直接拿指標用，不用複製、不用解析；
+     每個執行緒只要掃「單字」那一欄就知道哪些題目是自己的。
+   → 每一塊都補到 8 的倍數，所以每一欄都剛好對齊，可以直接當 uint64_t / uint32_t 陣列讀。
+
+   單字為什麼記 key、不記索引？
+   → 單機模式刪除單字時，最後一個單字會搬到被刪的位置，索引就變了。
+   → key 是「資料夾 + 英文（正規化過）」的 64 位元雜湊，刪掉別的字也不會變；
+     分析時再用目前的單字庫對回索引，對不到的（已經被刪掉）算在「已刪除」裡。
+
+   寫到一半當機怎麼辦？
+   → 只往後加、不改前面，所以壞掉的只會是最後一塊。
+   → 每次執行第一次要寫之前，先檢查一遍（eventScan）：最後不完整的那一塊直接截掉；
+     檔頭看不懂（不是這個版本寫的）就改名成 english_word.events.old 再重新開始，不會蓋掉。
+   → 作答紀錄只是「參考用」，所以追加的時候不 fsync（不像日誌），不拖慢測驗。
+   ================================================================ */
+
+/* eventState：這次執行作答紀錄檔的狀態（0 = 還沒檢查過，1 = 可以寫，-1 = 不能寫，這次執行都不寫了）*/
+static int eventState = 0;
+
+/* eventWordKey：第 idx 個單字在作答紀錄裡的 key（資料夾 + 英文的 64 位元雜湊）*/
+uint64_t eventWordKey(int idx) {
+    const char *folder = wordFolder(idx);
+    uint64_t h = fnvHash(FNV_OFFSET, folder, strlen(folder) + 1); // 連 '\0' 一起算，"ab"+"c" 和 "a"+"bc" 才不會一樣
+    const char *en = wordKeyEn(idx);
+    return fnvHash(h, en, strlen(en));
+}
+
+/* eventColumns：找出一塊作答紀錄裡每一欄的位置（block 要已經用 eventScan 檢查過）*/
+static void eventColumns(const char *block, EventCols *c) {
+    uint32_t n = ((const EventBlock *)block)->count;
+    const char *p = block + sizeof(EventBlock);
+    c->word    = (const uint64_t *)p;  p += (size_t)n * sizeof(uint64_t);
+    c->at      = (const uint32_t *)p;  p += (size_t)n * sizeof(uint32_t);
+    c->latency = (const uint32_t *)p;  p += (size_t)n * sizeof(uint32_t);
+    c->len     = (const uint16_t *)p;  p += (size_t)n * sizeof(uint16_t);
+    c->result  = (const uint8_t *)p;   p += n;
+    c->answers = p;
+}
+
+/* eventScan：檢查作答紀錄檔，找出每一塊從哪裡開始
+   -------------------------------------------------------
+   一塊要滿足這些條件才算完整：記號對、大小是 8 的倍數、整塊都在檔案裡、
+   放得下 count 題的各欄、所有答案加起來的長度也放得下。
+   遇到第一個不完整的塊就停下來（後面的都不算，因為不知道下一塊從哪裡開始）。
+
+   參數：
+     blocks → 不是 NULL 的話，*blocks 放每一塊的開頭位置（要由呼叫者 free）
+     count  → 幾塊
+     events → 所有塊加起來幾題
+     end    → 最後一個完整的塊結束在第幾個 byte
+
+   回傳值：1 = 檔頭正確，0 = 檔頭不對（不是作答紀錄或不是這個版本）；
+           記憶體不足（blocks 配置失敗）回傳 -1*/
+static int eventScan(const MappedFile *m, size_t **blocks, int *count, long *events, size_t *end) {
+    const EventHeader *h = (const EventHeader *)m->data;
+    *count  = 0;
+    *events = 0;
+    *end    = 0;
+    if (blocks) *blocks = NULL;
+    if (m->size < sizeof(EventHeader) || memcmp(h->magic, EVENT_MAGIC, sizeof(EVENT_MAGIC)) != 0 ||
+        h->version != EVENT_VERSION || h->endian != SNAP_ENDIAN) return 0;
+
+    int cap = 0;
+    size_t off = sizeof(EventHeader);
+    while (m->size - off >= sizeof(EventBlock)) {
+        const EventBlock *b = (const EventBlock *)(m->data + off);
+        if (b->tag != EVENT_TAG || b->bytes % 8 != 0 || b->bytes < sizeof(EventBlock) ||
+            b->bytes > m->size - off ||
+            (uint64_t)b->count * EVENT_ROW > b->bytes - sizeof(EventBlock)) break;
+        EventCols c;
+        eventColumns(m->data + off, &c);
+        uint64_t answers = 0;
+        for (uint32_t i = 0; i < b->count; i++) answers += c.len[i];
+        if (sizeof(EventBlock) + (uint64_t)b->count * EVENT_ROW + answers > b->bytes) break;
+
+        if (blocks) {
+            if (*count == cap) {
+                int newCap = cap ? cap * 2 : 256;
+                size_t *p = realloc(*blocks, (size_t)newCap * sizeof(size_t));
+                if (!p) {
+                    free(*blocks);
+                    *blocks = NULL;
+                    return -1;
+                }
+                *blocks = p;
+                cap = newCap;
+            }
+            (*blocks)[*count] = off;
+        }
+        (*count)++;
+        *events += b->count;
+        off += b->bytes;
+    }
+    *end = off;
+    return 1;
+}
+
+/* eventReady：第一次要寫作答紀錄之前，確認檔案可以接著寫（沒有就建一個，壞掉的尾巴截掉）
+   回傳值：1 = 可以寫，0 = 不能寫*/
+static int eventReady(void) {
+    if (eventState) return eventState > 0;
+    eventState = -1;
+
+    EventHeader fresh;
+    memset(&fresh, 0, sizeof(fresh));
+    memcpy(fresh.magic, EVENT_MAGIC, sizeof(EVENT_MAGIC));
+    fresh.version = EVENT_VERSION;
+    fresh.endian  = SNAP_ENDIAN;
+
+    MappedFile m = {0};
+    if (!mapFile(EVENT_FILE, &m)) {
+        // mapFile 遇到空檔案也會失敗；打得開卻對應不了的話就不要動它
+        FILE *fp = fopen(EVENT_FILE, "rb");
+        int   empty = !fp || fgetc(fp) == EOF;
+        if (fp) fclose(fp);
+        if (!empty || !replaceFile(EVENT_FILE, EVENT_FILE_TMP, (const char *)&fresh, sizeof(fresh))) return 0;
+        eventState = 1;
+        return 1;
+    }
+
+    int    blocks;
+    long   events;
+    size_t end;
+    int    ok = eventScan(&m, NULL, &blocks, &events, &end);
+    if (!ok) {
+        // 不是這個版本寫的：留著給使用者自己處理，重新開一個
+        unmapFile(&m);
+        remove(EVENT_FILE_OLD);
+        if (rename(EVENT_FILE, EVENT_FILE_OLD) != 0) return 0;
+        printf("[Warning] 作答紀錄的格式看不懂，已改名成 %s，重新開始記錄。\n", EVENT_FILE_OLD);
+        if (!replaceFile(EVENT_FILE, EVENT_FILE_TMP, (const char *)&fresh, sizeof(fresh))) return 0;
+    } else if (end < m.size) {
+        // 上次寫到一半就結束了：只留下完整的部分
+        printf("[Warning] 作答紀錄最後 %llu bytes 不完整（可能是上次寫到一半當機），已截掉。\n",
+               (unsigned long long)(m.size - end));
+        ok = replaceFile(EVENT_FILE, EVENT_FILE_TMP, m.data, end);
+        unmapFile(&m);
+        if (!ok) return 0;
+    } else {
+        unmapFile(&m);
+    }
+    eventState = 1;
+    return 1;
+}
+
+/* eventLogSession：把這次測驗每一題的作答接在作答紀錄後面（runTest 結束時呼叫）
+   -------------------------------------------------------
+   寫不進去（沒有權限、記憶體不足）只會少一次紀錄，測驗結果和錯誤次數都不受影響。*/
+void eventLogSession(const TestSession *s) {
+    uint32_t n = (uint32_t)s->total;
+    if (n == 0 || !eventReady()) return;
+
+    // 答案太長就只留前面 65535 個 byte（長度欄只有 16 位元）
+    uint64_t answers = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        size_t len = s->answers[i] ? strlen(s->answers[i]) : 0;
+        answers += len > UINT16_MAX ? UINT16_MAX : len;
+    }
+    uint64_t bytes = (sizeof(EventBlock) + (uint64_t)n * EVENT_ROW + answers + 7) & ~(uint64_t)7;
+    char *block = bytes <= UINT32_MAX ? calloc(1, (size_t)bytes) : NULL; // calloc：最後補齊的部分一定是 0
+    if (!block) return;
+
+    EventBlock *b = (EventBlock *)block;
+    b->tag   = EVENT_TAG;
+    b->bytes = (uint32_t)bytes;
+    b->count = n;
+    b->mode  = (uint32_t)s->choices;
+    EventCols c;
+    eventColumns(block, &c); // 各欄的位置只在 eventColumns 算，讀寫才不會對不上
+    char *typed = (char *)c.answers;
+    for (uint32_t i = 0; i < n; i++) {
+        size_t len = s->answers[i] ? strlen(s->answers[i]) : 0;
+        if (len > UINT16_MAX) len = UINT16_MAX;
+        ((uint64_t *)c.word)[i]    = eventWordKey(s->questions[i]);
+        ((uint32_t *)c.at)[i]      = s->answeredAt[i];
+        ((uint32_t *)c.latency)[i] = s->elapsedMs[i];
+        ((uint16_t *)c.len)[i]     = (uint16_t)len;
+        ((uint8_t *)c.result)[i]   = s->results[i];
+        if (len) memcpy(typed, s->answers[i], len);
+        typed += len;
+    }
+
+    FILE *fp = fopen(EVENT_FILE, "ab");
+    int   ok = fp && fwrite(block, 1, (size_t)bytes, fp) == (size_t)bytes;
+    if (fp && fclose(fp) != 0) ok = 0;
+    free(block);
+    if (ok) {
+        metricCount(&metrics.bytesWritten, (size_t)bytes);
+    } else {
+        printf("[Warning] 無法寫入作答紀錄 %s，這次執行不再記錄。\n", EVENT_FILE);
+        eventState = -1; // 寫了一半的尾巴下次執行會截掉
+    }
+}
+
+/* eventBucket：第 k 次（從 0 算）考這個字，算在難度曲線的第幾段*/
+static int eventBucket(uint32_t k) {
+    int b = 0;
+    while (k && b < EVENT_CURVE - 1) {
+        k >>= 1;
+        b++;
+    }
+    return b;
+}
+
+/* eventLookup：key 對應到目前單字庫的第幾個單字；已經被刪掉的回傳 -1*/
+static int eventLookup(const uint64_t *keys, const HashIndex *lookup, uint64_t key) {
+    uint32_t hash = (uint32_t)(key ^ (key >> 32));
+    uint32_t pos  = hash;
+    int idx;
+    while ((idx = hashNext(lookup, hash, &pos)) >= 0) {
+        if (keys[idx] == key) return idx;
+    }
+    return -1;
+}
+
+/* eventWorker：一個執行緒的分析工作
+   -------------------------------------------------------
+   怎麼分工？
+   → 照單字分：key 分到自己的單字（(key >> 40) % shards == shard）才處理，
+     同一個單字的所有作答一定在同一個執行緒，照檔案順序（也就是時間順序）累加，
+     「第幾次考」才算得對，而且完全不用鎖。
+   → 每個執行緒都要掃過全部的「單字」和「答案長度」兩欄（要知道自己那題的答案從哪裡開始），
+     但這兩欄是連續的陣列，掃起來很快；真正花時間的查表和累加只做自己那一份。
+   → slot 是大家共用的陣列，但每個單字只屬於一個執行緒，不會有兩個執行緒寫到同一格。*/
+static void *eventWorker(void *arg) {
+    EventShard *w = arg;
+    for (int b = 0; b < w->blockCount && !w->failed; b++) {
+        const EventBlock *blk = (const EventBlock *)(w->data + w->blocks[b]);
+        EventCols c;
+        eventColumns((const char *)blk, &c);
+        const char *typed = c.answers;
+        for (uint32_t i = 0; i < blk->count; i++) {
+            const char *answer = typed;
+            typed += c.len[i];
+            uint64_t key = c.word[i];
+            if ((int)((key >> 40) % (uint64_t)w->shards) != w->shard) continue;
+            w->events++;
+
+            int idx = eventLookup(w->keys, w->lookup, key);
+            if (idx < 0) {
+                w->orphans++;
+                continue;
+            }
+            if (w->slot[idx] < 0) {
+                if (w->count == w->capacity) {
+                    int newCap = w->capacity ? w->capacity * 2 : 1024;
+                    WordTrend *p = realloc(w->trends, (size_t)newCap * sizeof(WordTrend));
+                    if (!p) {
+                        w->failed = 1;
+                        break;
+                    }
+                    w->trends   = p;
+                    w->capacity = newCap;
+                }
+                memset(&w->trends[w->count], 0, sizeof(WordTrend));
+                w->slot[idx] = w->count++;
+            }
+
+            WordTrend *t = &w->trends[w->slot[idx]];
+            int bucket = eventBucket(t->attempts);
+            t->attempts++;
+            t->tried[bucket]++;
+            t->latencyMs += c.latency[i];
+            if (c.at[i] > t->lastAt) t->lastAt = c.at[i];
+            if (c.result[i] == ANSWER_RIGHT) {
+                t->right++;
+                t->passed[bucket]++;
+            } else if (c.result[i] == ANSWER_NEAR) {
+                t->near++;
+            } else {
+                t->lastWrong    = answer;
+                t->lastWrongLen = c.len[i];
+            }
+        }
+    }
+    return NULL;
+}
+
+/* eventDifficulty：一個單字有多難（0 ~ 1，越大越難）
+   答錯算 1、差一點算一半，再加上「先假設對一次、錯一次」，只考過一兩次的字才不會直接變成 0 或 1。*/
+static double eventDifficulty(const WordTrend *t) {
+    uint32_t wrong = t->attempts - t->right - t->near;
+    return (wrong + 0.5 * t->near + 1.0) / (t->attempts + 2.0);
+}
+
+/* eventAnalyze：分析整個作答紀錄，每個單字一行寫進 outPath（--analyze）
+   -------------------------------------------------------
+   結果檔（Tab 分隔，# 開頭是說明）：
+     W [Tab] 資料夾 [Tab] 英文 [Tab] 考了幾次 [Tab] 答對 [Tab] 差一點 [Tab] 答錯 [Tab] 平均毫秒
+       [Tab] 難度 [Tab] 難度曲線 [Tab] 最後一次作答（Unix 秒）[Tab] 最後一次答錯打的字
+   → 難度曲線是 6 段「答對/考了幾次」，用空白隔開：第 1 次、第 2 次、3~4、5~8、9~16、17 次以後。
+   → 只列出考過的單字，照單字庫的順序。畫面上另外印出整體的曲線和最難的幾個字。
+
+   回傳值：0 = 成功；讀不到作答紀錄或寫不出結果檔回傳 -1*/
+int eventAnalyze(const char *outPath) {
+    // 中文一個字佔兩格寬，printf 的 %-12s 對不齊，所以直接補好空白
+    static const char *labels[EVENT_CURVE] = { "第 1 次     ", "第 2 次     ", "第 3~4 次   ",
+                                               "第 5~8 次   ", "第 9~16 次  ", "第 17 次以後" };
+    uint64_t began = metricNow();
+    MappedFile m = {0};
+    if (!mapFile(EVENT_FILE, &m)) {
+        printf("[Error] 還沒有作答紀錄（%s），先做幾次測驗再來分析。\n", EVENT_FILE);
+        return -1;
+    }
+    size_t *blocks;
+    int     blockCount;
+    long    events;
+    size_t  end;
+    int     scanned = eventScan(&m, &blocks, &blockCount, &events, &end);
+    if (scanned == 0) printf("[Error] %s 不是這個版本的作答紀錄。\n", EVENT_FILE);
+
+    // 單字 key → 目前的索引（同一個資料夾裡英文一樣的字算同一個）
+    int       words = library.count;
+    uint64_t *keys  = malloc((size_t)(words ? words : 1) * sizeof(uint64_t));
+    int32_t  *slot  = malloc((size_t)(words ? words : 1) * sizeof(int32_t));
+    HashIndex lookup;
+    memset(&lookup, 0, sizeof(lookup));
+    for (int i = 0; keys && slot && i < words; i++) {
+        keys[i] = eventWordKey(i);
+        slot[i] = -1;
+        hashInsert(&lookup, (uint32_t)(keys[i] ^ (keys[i] >> 32)), i);
+    }
+    int   memory = scanned >= 0 && keys && slot && lookup.live == words;
+    FILE *out    = scanned > 0 && memory ? fopen(outPath, "w") : NULL;
+    if (!out) {
+        if (!memory)          printf("[Error] 記憶體不足，無法分析作答紀錄。\n");
+        else if (scanned > 0) printf("[Error] 無法開啟 %s。\n", outPath);
+        free(blocks);
+        free(keys);
+        free(slot);
+        hashFree(&lookup);
+        unmapFile(&m);
+        return -1;
+    }
+    if (end < m.size) printf("[Warning] 作答紀錄最後 %llu bytes 不完整，沒有分析。\n",
+                             (unsigned long long)(m.size - end));
+
+    // 決定要開幾個執行緒：核心數，但每個執行緒至少要分到 EVENT_MIN_SHARD 筆
+    int threads = cpuCount();
+    if (threads > IMPORT_MAX_THREADS) threads = IMPORT_MAX_THREADS;
+    if (threads > events / EVENT_MIN_SHARD) threads = (int)(events / EVENT_MIN_SHARD);
+    if (threads < 1) threads = 1;
+
+    EventShard shards[IMPORT_MAX_THREADS];
+    memset(shards, 0, sizeof(shards));
+    for (int i = 0; i < threads; i++) {
+        shards[i].data       = m.data;
+        shards[i].blocks     = blocks;
+        shards[i].blockCount = blockCount;
+        shards[i].keys       = keys;
+        shards[i].lookup     = &lookup;
+        shards[i].slot       = slot;
+        shards[i].shard      = i;
+        shards[i].shards     = threads;
+    }
+    // 跟 bulkImport 一樣：第一份由主執行緒自己做，開不了執行緒的也自己做
+    ThreadHandle handles[IMPORT_MAX_THREADS];
+    int started[IMPORT_MAX_THREADS] = {0};
+    for (int i = 1; i < threads; i++) {
+        started[i] = threadStart(&handles[i], eventWorker, &shards[i]);
+    }
+    eventWorker(&shards[0]);
+    for (int i = 1; i < threads; i++) {
+        if (started[i]) threadJoin(handles[i]);
+        else            eventWorker(&shards[i]);
+    }
+
+    // 合併：照單字庫的順序寫出來，順便累加整體曲線、挑出最難的字
+    long     orphans = 0;
+    int      failed  = 0;
+    uint64_t tried[EVENT_CURVE] = {0}, passed[EVENT_CURVE] = {0};
+    int      hardest[EVENT_HARDEST];
+    int      hardCount = 0;
+    for (int i = 0; i < threads; i++) {
+        orphans += shards[i].orphans;
+        failed  |= shards[i].failed;
+    }
+    fprintf(out, "#analyze\t%ld\n", events);
+    for (int idx = 0; idx < words; idx++) {
+        if (slot[idx] < 0) continue;
+        const EventShard *w = &shards[(keys[idx] >> 40) % (uint64_t)threads];
+        const WordTrend  *t = &w->trends[slot[idx]];
+        fprintf(out, "W\t%s\t%s\t%u\t%u\t%u\t%u\t%u\t%.3f\t", wordFolder(idx), wordEnglish(idx),
+                t->attempts, t->right, t->near, t->attempts - t->right - t->near,
+                (unsigned)(t->latencyMs / t->attempts), eventDifficulty(t));
+        for (int b = 0; b < EVENT_CURVE; b++) {
+            fprintf(out, b ? " %u/%u" : "%u/%u", t->passed[b], t->tried[b]);
+            tried[b]  += t->tried[b];
+            passed[b] += t->passed[b];
+        }
+        fprintf(out, "\t%u\t", t->lastAt);
+        for (uint32_t k = 0; k < t->lastWrongLen; k++) {
+            char ch = t->lastWrong[k];
+            fputc(ch == '\t' || ch == '\n' || ch == '\r' ? ' ' : ch, out); // 不要弄亂欄位
+        }
+        fputc('\n', out);
+
+        // 最難的字：插入排序，只留前 EVENT_HARDEST 個
+        if (t->attempts < EVENT_MIN_TRIES) continue;
+        int k = hardCount < EVENT_HARDEST ? hardCount++ : EVENT_HARDEST;
+        while (k > 0) {
+            const WordTrend *prev = &shards[(keys[hardest[k - 1]] >> 40) % (uint64_t)threads]
+                                         .trends[slot[hardest[k - 1]]];
+            if (eventDifficulty(prev) >= eventDifficulty(t)) break;
+            if (k < EVENT_HARDEST) hardest[k] = hardest[k - 1];
+            k--;
+        }
+        if (k < EVENT_HARDEST) hardest[k] = idx;
+    }
+    int ok = !ferror(out);
+    if (fclose(out) != 0) ok = 0;
+
+    printf("已分析 %ld 筆作答（%d 次測驗，%d 個執行緒，%.1f ms），結果寫在 %s\n", events, blockCount,
+           threads, (metricNow() - began) / 1e6, outPath);
+    if (orphans) printf("  其中 %ld 筆的單字已經從單字庫刪掉了，沒有列出來。\n", orphans);
+    if (failed)  printf("[Error] 記憶體不足，有部分單字沒有分析完。\n");
+    if (!ok)     printf("[Error] 寫入 %s 時發生錯誤。\n", outPath);
+    printf("\n學習曲線（所有單字，第幾次考的答對率）：\n");
+    for (int b = 0; b < EVENT_CURVE; b++) {
+        if (!tried[b]) continue;
+        printf("  %s  %5.1f%%（%llu 筆）\n", labels[b], 100.0 * passed[b] / tried[b],
+               (unsigned long long)tried[b]);
+    }
+    if (hardCount) printf("\n最難的單字（考過 %d 次以上）：\n", EVENT_MIN_TRIES);
+    for (int i = 0; i < hardCount; i++) {
+        const WordTrend *t = &shards[(keys[hardest[i]] >> 40) % (uint64_t)threads].trends[slot[hardest[i]]];
+        printf("  %2d. %s（%s）難度 %.2f，答對 %u / %u\n", i + 1, wordEnglish(hardest[i]),
+               wordFolder(hardest[i]), eventDifficulty(t), t->right, t->attempts);
+    }
+
+    for (int i = 0; i < threads; i++) free(shards[i].trends);
+    free(blocks);
+    free(keys);
+    free(slot);
+    hashFree(&lookup);
+    unmapFile(&m);
+    return ok ? 0 : -1;
+}
+
+
+/* ================================================================
+   批次批改（--grade 答案檔 結果檔）
+   ================================================================
+
+   為什麼要有批次模式？
+   → 一般測驗一題一題用 printf / scanf 問，要改幾千份交上來的考卷、或是做壓力測試都不可能。
+   → 批次模式一次讀完整個答案檔（也可以是管線 pipe），全部改完再一口氣寫出結果。
+
+   答案檔（文字檔，一行一題，空白行隔開不同份考卷，# 開頭是註解）：
+     資料夾 [Tab] 題目的英文 [Tab] 學生的答案
+   例如（資料夾和英文不分大小寫，Animals 和 animals 是同一個資料夾）：
+     animals    cat    cat
+     Animals    dog    dgo
+   結果檔（一樣是一行一筆、Tab 分隔，方便其他程式讀）：
+     Q [Tab] 考卷編號 [Tab] 題號 [Tab] RIGHT/NEAR/WRONG/UNKNOWN [Tab] 標準答案
+     S [Tab] 考卷編號 [Tab] 答對 [Tab] 差一點 [Tab] 答錯 [Tab] 找不到的題目 [Tab] 總題數
+   → UNKNOWN 是單字庫裡找不到這個題目（資料夾或英文打錯、或是單字已經被刪掉），不算分也不算錯。
+   → 答案檔是 - 的話就讀標準輸入。結果檔一定要是檔案，因為標準輸出還要印讀檔、批改完成的訊息。
+
+   為什麼錯誤次數最後才一起改？
+   → 一題一題呼叫 libraryAddError 的話，同一個單字在幾千份考卷裡被答錯，
+     錯題排行就要調整幾千次、日誌也要寫幾千行。
+   → 先在 delta[idx] 累加，全部改完再每個單字改一次、每個單字寫一行日誌，
+     最後只 storageCommit 一次（只等一次磁碟），不用整個單字檔重寫（saveToFile）。
+   ================================================================ */
+
+/* gradeWrite：把一份考卷的小計寫進結果檔*/
+static void gradeWrite(FILE *out, int quiz, const int tally[4]) {
+    fprintf(out, "S\t%d\t%d\t%d\t%d\t%d\t%d\n", quiz,
+            tally[ANSWER_RIGHT], tally[ANSWER_NEAR], tally[ANSWER_WRONG], tally[3],
+            tally[0] + tally[1] + tally[2] + tally[3]);
+}
+
+/* gradeBatch：批改整個答案檔
+   -------------------------------------------------------
+   參數：
+     inPath  → 答案檔（- = 標準輸入）
+     outPath → 結果檔
+
+   回傳值：改了幾份考卷；檔案打不開或記憶體不足回傳 -1（錯誤次數不會改）*/
+int gradeBatch(const char *inPath, const char *outPath) {
+    static const char *names[] = { "WRONG", "RIGHT", "NEAR" }; // 照 ANSWER_* 的數值排
+    FILE *in  = strcmp(inPath, "-") == 0 ? stdin : fopen(inPath, "r");
+    FILE *out = in ? fopen(outPath, "w") : NULL;
+    int32_t *delta = calloc((size_t)(library.count ? library.count : 1), sizeof(int32_t));
+    if (!in || !out || !delta) {
+        printf("[Error] 無法開啟 %s。\n", !in ? inPath : !out ? outPath : "（記憶體不足）");
+        if (in && in != stdin) fclose(in);
+        if (out) fclose(out);
+        free(delta);
+        return -1;
+    }
+    setvbuf(out, NULL, _IOFBF, 1 << 16); // 結果一行很短，攢滿 64KB 才真的寫一次
+
+    char  *line = NULL;
+    size_t cap  = 0;
+    int    quizzes = 0, question = 0;
+    int    tally[4] = {0};   // [ANSWER_WRONG] [ANSWER_RIGHT] [ANSWER_NEAR] [3] = 找不到的題目
+    while (readLine(in, &line, &cap) >= 0) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '#') continue;
+        if (line[0] == '\0') {
+            // 空白行：一份考卷結束了（連續好幾行空白只算一次）
+            if (question > 0) gradeWrite(out, ++quizzes, tally);
+            question = 0;
+            memset(tally, 0, sizeof(tally));
+            continue;
+        }
+
+        char *en     = strchr(line, '\t');
+        char *answer = en ? strchr(en + 1, '\t') : NULL;
+        int   idx    = -1;
+        if (answer) {
+            *en++     = '\0';
+            *answer++ = '\0';
+            toLowerEN(line); // 和 AddWord 一樣，資料夾名稱一律小寫（Animals 就是 animals）
+            int f = folderFind(line);
+            if (f >= 0) idx = findInFolder(f, en, NULL);
+        }
+        question++;
+        if (idx < 0) {
+            tally[3]++;
+            fprintf(out, "Q\t%d\t%d\tUNKNOWN\t\n", quizzes + 1, question);
+            continue;
+        }
+
+        normalizeText(answer, answer); // 轉成 key，和單字庫存好的 key 比
+        int result = gradeAnswer(answer, idx);
+        if (result == ANSWER_WRONG) delta[idx]++;
+        tally[result]++;
+        fprintf(out, "Q\t%d\t%d\t%s\t%s\n", quizzes + 1, question, names[result], wordEnglish(idx));
+    }
+    if (question > 0) gradeWrite(out, ++quizzes, tally); // 最後一份考卷後面可能沒有空白行
+    free(line);
+    if (in != stdin) fclose(in);
+    int written = !ferror(out);
+    if (fclose(out) != 0) written = 0;
+
+    // 一次套用所有錯誤次數（一個單字一行日誌），然後只寫一次磁碟
+    int  changed = 0;
+    long wrong   = 0;
+    for (int i = 0; i < library.count; i++) {
+        if (delta[i] == 0) continue;
+        libraryAddError(i, delta[i]);
+        storageError(i, delta[i]);
+        wrong += delta[i];
+        changed++;
+    }
+    free(delta);
+    storageCommit(1);
+
+    printf("已批改 %d 份考卷，%ld 題答錯（%d 個單字的錯誤次數已更新）。\n", quizzes, wrong, changed);
+    if (!written) printf("[Error] 寫入 %s 時發生錯誤，結果可能不完整。\n", outPath);
+    return quizzes;
+}
+
+
+/* ================================================================
+   學習進度表（每個使用者各自的錯誤次數）
+   ================================================================
+
+   為什麼要和單字庫分開？
+   → Word 裡的 errorCount 是「單字」和「某一個人的進度」綁在一起，
+     要服務很多人就得每人複製一整份單字庫。
+   → 進度表只記「誰、哪個單字、錯幾次」，單字庫只存一份；
+     每個人只佔「自己碰過的單字」那幾格，沒碰過的單字一個 byte 都不用。
+   → 單機的選單模式還是用 Word 裡的 errorCount（english_word.txt 的格式不變），
+     伺服器模式的每個使用者則用這裡的進度表。
+
+   每個人的進度有兩種存法，會自動切換：
+   → 稀疏（sparse）：只有碰過的單字，(單字, 次數) 照單字排好，用二分搜尋找；
+     一格 8 bytes，適合只做過幾十題的人。
+   → 密集（dense）：第 idx 格就是第 idx 個單字，O(1) 直接找；每個單字 4 bytes。
+   → 稀疏的格數多到比密集還佔空間（8 × 碰過的數量 ≥ 4 × 單字總數）時就換成密集。
+
+   進度檔 english_word.progress（文字檔，和單字檔分開存）：
+     #progress
+     W [Tab] 資料夾 [Tab] 英文                          ← 第 n 個 W 行就是單字編號 n
+     U [Tab] 名字 [Tab] 編號:次數 編號:次數 ...           ← 一個人一行
+   → 單字用「資料夾 + 英文」記，不用 library 的索引：單機模式刪除單字時索引會變，
+     讀檔時用 findInFolder 重新對回目前的索引；找不到的（已經被刪掉）就略過。
+   → 同一個單字不管幾個人錯過，W 行都只有一行，每個人每個單字只多幾個 byte。
+   ================================================================ */
+
+/* ProgressTable：所有使用者的進度*/
+typedef struct {
+    UserProgress **users;
+    int            count;
+    int            capacity;
+    Mutex          lock;      // 保護 users 名單、每個人的 online 和 saved
+    Mutex          saveLock;  // 同一時間只有一個人在寫進度檔
+} ProgressTable;
+
+static ProgressTable progress;
+
+/* progressNew：新增一個名字是 name 的使用者（呼叫者要拿著 progress.lock）
+   回傳值：新的使用者；記憶體不足時回傳 NULL*/
+static UserProgress *progressNew(const char *name) {
+    if (progress.count == progress.capacity) {
+        int newCap = progress.capacity ? progress.capacity * 2 : 16;
+        UserProgress **p = realloc(progress.users, (size_t)newCap * sizeof(UserProgress *));
+        if (!p) return NULL;
+        progress.users    = p;
+        progress.capacity = newCap;
+    }
+    UserProgress *u = calloc(1, sizeof(UserProgress));
+    if (!u) return NULL;
+    snprintf(u->name, sizeof(u->name), "%s", name);
+    progress.users[progress.count++] = u;
+    return u;
+}
+
+/* progressFind：找名字是 name 的使用者（呼叫者要拿著 progress.lock）
+   參數：
+     create → 1 = 找不到就新增一個
+   回傳值：使用者；找不到（或記憶體不足）回傳 NULL*/
+UserProgress *progressFind(const char *name, int create) {
+    for (int i = 0; i < progress.count; i++) {
+        if (strcmp(progress.users[i]->name, name) == 0) return progress.users[i];
+    }
+    return create ? progressNew(name) : NULL;
+}
+
+/* progressSlot：稀疏存法裡，單字 idx 應該在第幾格（二分搜尋）*/
+static int progressSlot(const UserProgress *u, int idx) {
+    int lo = 0, hi = u->count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if ((int)u->entries[mid].word < idx) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+/* progressDensify：從稀疏換成密集存法
+   回傳值：1 = 成功，0 = 記憶體不足（維持稀疏，資料不會少）*/
+static int progressDensify(UserProgress *u, int words) {
+    int32_t *dense = calloc((size_t)words, sizeof(int32_t));
+    if (!dense) return 0;
+    for (int i = 0; i < u->count; i++) dense[u->entries[i].word] = u->entries[i].count;
+    free(u->entries);
+    u->entries  = NULL;
+    u->entryCap = 0;
+    u->dense    = dense;
+    u->denseCap = words;
+    return 1;
+}
+
+/* progressGet：使用者 u 第 idx 個單字錯了幾次*/
+int progressGet(const UserProgress *u, int idx) {
+    if (u->dense) return idx < u->denseCap ? u->dense[idx] : 0;
+    int k = progressSlot(u, idx);
+    return (k < u->count && (int)u->entries[k].word == idx) ? u->entries[k].count : 0;
+}
+
+/* progressAdd：使用者 u 第 idx 個單字的錯誤次數加上 delta
+   -------------------------------------------------------
+   同一個使用者的進度只有一個執行緒會改（伺服器模式一個名字只能有一個連線），所以不用鎖。
+
+   參數：
+     words → 目前單字庫有幾個單字（決定要不要換成密集存法、密集陣列要多大）
+
+   回傳值：加完之後的次數；記憶體不足時回傳 -1（進度沒有改）*/
+int progressAdd(UserProgress *u, int idx, int delta, int words) {
+    if (!u->dense && (size_t)(u->count + 1) * sizeof(ProgressEntry) >= (size_t)words * sizeof(int32_t)) {
+        progressDensify(u, words > idx ? words : idx + 1); // 失敗就繼續用稀疏
+    }
+    if (u->dense) {
+        if (idx >= u->denseCap) {
+            // 單字庫變大了：密集陣列也跟著加倍
+            int newCap = u->denseCap * 2 > idx ? u->denseCap * 2 : idx + 1;
+            int32_t *p = realloc(u->dense, (size_t)newCap * sizeof(int32_t));
+            if (!p) return -1;
+            memset(p + u->denseCap, 0, (size_t)(newCap - u->denseCap) * sizeof(int32_t));
+            u->dense    = p;
+            u->denseCap = newCap;
+        }
+        int before = u->dense[idx];
+        u->dense[idx] += delta;
+        u->count += (before == 0 && u->dense[idx] != 0) - (before != 0 && u->dense[idx] == 0);
+        return u->dense[idx];
+    }
 
-    int indices[WORD_MAX];
-    int total = collectIndices(folder, indices);
-    if (total == 0) {
-        printf("這個範圍裡沒有任何單字可以測驗。\n");
-        return;
+    int k = progressSlot(u, idx);
+    if (k < u->count && (int)u->entries[k].word == idx) return u->entries[k].count += delta;
+    if (u->count == u->entryCap) {
+        int newCap = u->entryCap ? u->entryCap * 2 : 8;
+        ProgressEntry *p = realloc(u->entries, (size_t)newCap * sizeof(ProgressEntry));
+        if (!p) return -1;
+        u->entries  = p;
+        u->entryCap = newCap;
     }
+    // 照單字順序插進去：後面的往後挪一格
+    memmove(u->entries + k + 1, u->entries + k, (size_t)(u->count - k) * sizeof(ProgressEntry));
+    u->entries[k].word  = (uint32_t)idx;
+    u->entries[k].count = delta;
+    u->count++;
+    return delta;
+}
 
-    shuffle(indices, total); // 洗牌：打亂出題順序
-    runTest(indices, total);
+/* progressCollect：把使用者 u 碰過的單字（次數不是 0 的）照單字順序放進 *out
+   回傳值：幾個；記憶體不足時回傳 -1。*out 要由呼叫者 free。*/
+int progressCollect(const UserProgress *u, ProgressEntry **out) {
+    *out = malloc((size_t)(u->count ? u->count : 1) * sizeof(ProgressEntry));
+    if (!*out) return -1;
+    int n = 0;
+    if (u->dense) {
+        for (int i = 0; i < u->denseCap && n < u->count; i++) {
+            if (u->dense[i] == 0) continue;
+            (*out)[n].word  = (uint32_t)i;
+            (*out)[n].count = u->dense[i];
+            n++;
+        }
+    } else {
+        for (int i = 0; i < u->count; i++) {
+            if (u->entries[i].count != 0) (*out)[n++] = u->entries[i];
+        }
+    }
+    return n;
 }
 
-/* takeErrorTest：錯題加強測驗（只針對有答錯過的單字）*/
-void takeErrorTest(void) {
-    int errorIndices[WORD_MAX];
-    int errorTotal = 0;
+/* progressSnapshot：把 u 目前的進度複製一份到 u->saved，給 progressRender 寫檔用
+   -------------------------------------------------------
+   為什麼寫檔不直接讀 u 的進度？
+   → 寫檔的可能是別人的連線，這時 u 可能正在答題、正在改自己的進度。
+   → 由 u 自己的連線先複製一份（拿著 progress.lock 換上去），寫檔的人只讀 saved，就不會打架。
+
+   回傳值：1 = 成功，0 = 記憶體不足（saved 維持上一次的）*/
+int progressSnapshot(UserProgress *u) {
+    ProgressEntry *copy;
+    int n = progressCollect(u, &copy);
+    if (n < 0) return 0;
+    mutexLock(&progress.lock);
+    free(u->saved);
+    u->saved      = copy;
+    u->savedCount = n;
+    mutexUnlock(&progress.lock);
+    return 1;
+}
 
-    // 找出所有錯誤次數 > 0 的單字
-    for (int i = 0; i < wordCount; i++) {
-        if (library[i].errorCount > 0) {
-            errorIndices[errorTotal] = i;
-            errorTotal++;
+/* progressRender：把所有人的 saved 排成進度檔的內容（呼叫者要拿著 progress.lock，
+   而且這段時間不能有人新增單字，因為要讀單字的資料夾和英文）
+   回傳值：1 = 成功，0 = 記憶體不足*/
+int progressRender(TextBuf *out) {
+    // ref[idx]：第 idx 個單字在檔案裡的編號（-1 = 還沒寫過 W 行）
+    int *ref = malloc((size_t)(library.count ? library.count : 1) * sizeof(int));
+    if (!ref) return 0;
+    for (int i = 0; i < library.count; i++) ref[i] = -1;
+
+    char line[LINE_BUF * 2];
+    int  refs = 0;
+    textAppend(out, "#progress\n", 10);
+    for (int i = 0; i < progress.count; i++) {
+        const UserProgress *u = progress.users[i];
+        for (int k = 0; k < u->savedCount; k++) {
+            int idx = (int)u->saved[k].word;
+            if (idx >= library.count || ref[idx] >= 0) continue;
+            ref[idx] = refs++;
+            int len = snprintf(line, sizeof(line), "W\t%s\t%s\n", wordFolder(idx), wordEnglish(idx));
+            textAppend(out, line, (size_t)len);
         }
     }
+    for (int i = 0; i < progress.count; i++) {
+        const UserProgress *u = progress.users[i];
+        if (u->savedCount == 0) continue;
+        textAppend(out, "U\t", 2);
+        textAppend(out, u->name, strlen(u->name));
+        textAppend(out, "\t", 1);
+        for (int k = 0; k < u->savedCount; k++) {
+            int idx = (int)u->saved[k].word;
+            if (idx >= library.count) continue;
+            int len = snprintf(line, sizeof(line), k ? " %d:%d" : "%d:%d", ref[idx], (int)u->saved[k].count);
+            textAppend(out, line, (size_t)len);
+        }
+        textAppend(out, "\n", 1);
+    }
+    free(ref);
+    return !out->failed;
+}
 
-    if (errorTotal == 0) {
-        printf("目前沒有任何錯誤紀錄，繼續加油！\n");
-        return;
+/* progressLoad：啟動伺服器時讀進度檔（沒有這個檔案就是還沒有人的進度）*/
+void progressLoad(void) {
+    FILE *fp = fopen(PROGRESS_FILE, "r");
+    if (!fp) return;
+
+    char  *line = NULL;
+    size_t cap  = 0;
+    IdList refs = {0};   // refs.ids[n]：檔案裡第 n 個單字在目前 library 的索引（-1 = 被刪掉了）
+    int    skipped = 0;
+    while (readLine(fp, &line, &cap) >= 0) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '#' || line[0] == '\0') continue;
+        char *name = line + 2;
+        char *rest = line[1] == '\t' ? strchr(name, '\t') : NULL;
+        if (!rest) { skipped++; continue; }
+        *rest++ = '\0';
+
+        if (line[0] == 'W') {
+            int f = folderFind(name);
+            idListPush(&refs, f >= 0 ? findInFolder(f, rest, NULL) : -1);
+        } else if (line[0] == 'U' && name[0] && strlen(name) < USER_NAME_LEN) {
+            UserProgress *u = progressFind(name, 1);
+            if (!u) break; // 記憶體不足，能讀多少算多少
+            char *p = rest;
+            while (*p) {
+                char *end;
+                long r = strtol(p, &end, 10);
+                if (end == p || *end != ':') { skipped++; break; }
+                long c = strtol(end + 1, &p, 10);
+                if (c != 0 && r >= 0 && r < refs.count && refs.ids[r] >= 0) {
+                    progressAdd(u, refs.ids[r], (int)c, library.count);
+                }
+                while (*p == ' ') p++;
+            }
+        } else {
+            skipped++;
+        }
     }
+    fclose(fp);
+    free(line);
+    free(refs.ids);
 
-    printf("\n===== 錯題加強測驗（共 %d 題）=====\n", errorTotal);
-    shuffle(errorIndices, errorTotal); // 打亂順序，避免記住題目位置
-    runTest(errorIndices, errorTotal);
+    for (int i = 0; i < progress.count; i++) progressSnapshot(progress.users[i]);
+    if (skipped) printf("[Warning] 進度檔有 %d 行看不懂，已略過。\n", skipped);
 }
 
+/* progressFree：釋放所有人的進度*/
+void progressFree(void) {
+    for (int i = 0; i < progress.count; i++) {
+        free(progress.users[i]->dense);
+        free(progress.users[i]->entries);
+        free(progress.users[i]->saved);
+        free(progress.users[i]);
+    }
+    free(progress.users);
+    progress.users    = NULL;
+    progress.count    = 0;
+    progress.capacity = 0;
+}
 
 /* ================================================================
-   查詢功能
+   伺服器模式（--serve 連接埠）
+   ================================================================
+
+   為什麼需要伺服器模式？
+   → 教室裡每個學生各開一個程式、各自複製一份單字檔，老師新增單字還要一台一台更新。
+   → 伺服器模式只開一個程式、載入一份共用的單字庫，學生用 telnet / nc 之類的工具連進來，
+     每個連線一個執行緒，一行一個指令：
+
+       USER 名字              → 先登入（同一個名字同時只能有一個連線）
+       FIND 英文              → 查英文單字
+       SEARCH 關鍵字          → 查英文或中文含有關鍵字的單字（結尾加 * 只找開頭）
+       ASK [資料夾]           → 出一題：回傳題號和中文
+       ANSWER 題號 英文       → 交答案，答錯會記在自己的錯題紀錄
+       ERRORS                 → 自己答錯最多的單字（每行最後多一欄答錯次數）
+       ADD 資料夾 英文 中文    → 新增單字（三個欄位之間用 Tab 分隔）
+       CARDS [資料夾] [Tab 範圍] → 開始看單字卡（照字母順序，範圍和選單一樣是 a-c、c），回傳張數
+       CARD                   → 翻下一張：C [Tab] 第幾張 [Tab] 總張數 [Tab] 資料夾 [Tab] 英文 [Tab] 中文 [Tab] 錯誤次數
+       STATS                  → 單字庫的統計（總數、各資料夾、錯誤次數分布）
+       CHANGES [游標]          → 游標之後的單字變更（給其他前端同步用，見「變更紀錄」那一段）
+       METRICS                → 效能統計（Prometheus 文字格式，不用登入，給監控程式用）
+       QUIT                   → 離線
+
+     每個回應的最後一行是「OK ...」或「ERR ...」，前面可能有好幾行結果，例如
+       W [Tab] 題號 [Tab] 資料夾 [Tab] 英文 [Tab] 中文
+     伺服器的主控台輸入 quit 就會讓所有人離線、存檔、結束。
+
+   讀多寫少：讀取席位（reader slot）
+   → 查詢、出題、對答案都只「讀」單字庫，只有新增單字才「寫」，而且少很多。
+   → 讀的時候不能有人在寫：libraryAdd 可能 realloc 單字陣列、字串池、雜湊表，
+     讀到一半整塊記憶體被搬走就會當掉。
+   → 最簡單的做法是一把讀寫鎖，但每次讀都要改鎖裡面同一個計數器，
+     好幾個核心搶同一條 cache line，讀的人越多反而越慢。
+   → 這裡改成每個連線一個「讀取席位」，各自佔一整條 cache line：
+     讀之前把自己的席位設成 1、看一眼有沒有人要寫；讀完設回 0。
+     讀的人只寫自己的席位，完全不和別人搶。
+   → 要寫的人先拿寫入鎖、舉手（writerWaiting = 1），等所有席位都變回 0 才開始改，改完放下手。
+     舉手之後才來的讀者看到有人要寫，就先讓開、排隊等寫入鎖。
+   → 為什麼不用 RCU（每次寫都做一份新的單字庫，舊的等沒人在讀了才丟）？
+     單字庫是在原地修改的（realloc、雜湊表擴建），要 RCU 得把整個單字庫改成不可變的版本，
+     每新增一個字就要複製好幾 MB；新增本來就很少，讓讀者等一下划算得多。
+
+   每個人的錯題紀錄（學習進度表，見上一段）：
+   → 共用單字庫裡的 errorCount 是單機版使用者自己的，伺服器模式不動它。
+   → 同一個名字同時只能有一個連線，所以一個人的進度只有一個執行緒會改，答錯時不需要任何鎖；
+     只有登入、登出、存進度檔時要拿 progress.lock。
+   → 每答錯 PROGRESS_SAVE_EVERY 題、或是離線時，就把進度寫進 english_word.progress。
+   → 伺服器模式不能刪除單字：刪除會把最後一個單字搬到空格，大家進度裡的索引就對不上了。
    ================================================================ */
 
-/* search：讓使用者輸入關鍵字，同時搜尋英文和中文欄位
-   -------------------------------------------------------
-   回傳值：1 = 繼續查詢，0 = 使用者輸入 end 要離開
+#ifdef _WIN32
+typedef SOCKET SocketHandle;
+#define SOCKET_NONE INVALID_SOCKET
+#define SOCK_SHUT   SD_BOTH
+#define sockClose   closesocket
+#else
+typedef int SocketHandle;
+#define SOCKET_NONE (-1)
+#define SOCK_SHUT   SHUT_RDWR
+#define sockClose   close
+#endif
+
+/* ReaderSlot：讀取席位（一個佔一整條 cache line，讀的人不會互相拖慢）*/
+typedef struct {
+    int  active;                        // 1 = 這個連線正在讀單字庫（atomic）
+    char pad[CACHE_LINE - sizeof(int)];
+} ReaderSlot;
 
-   為什麼回傳 int？
-   → 在 mainMenu 裡是用 while(search()) 呼叫的，
-     回傳 1 就繼續查，回傳 0 就停止。這是一種讓迴圈能「從函數裡控制」的技巧。*/
-int search(void) {
-    char keyword[CN_LEN];     // 原始輸入，保留中文不轉換
-    char keyLower[CN_LEN];    // 英文搜尋用的小寫版本
+/* Session：一個連線*/
+typedef struct {
+    SocketHandle sock;
+    ThreadHandle thread;
+    int          used;   // 1 = 這一格有連線（只有接受連線的執行緒會讀寫）
+    int          done;   // 1 = 連線已經結束，可以收拾了（atomic）
+    int          slot;   // 自己在 sessions[] 和 readers[] 的位置
+    UserProgress *user;  // 登入的使用者（還沒登入是 NULL）
+    CardDeck     cards;  // CARDS 開始的單字卡（預先排好的卡片在送出回應之後才排）
+    Rng          rng;    // 出題用的亂數（每個連線各一個，不用搶全域的 rng）
+    char         in[LINE_BUF * 2]; // 收到、還沒處理的資料
+    int          inLen;
+    TextBuf      out;    // 這次要回的內容（整段排好再 send 一次）
+} Session;
+
+/* Server：伺服器模式的所有狀態*/
+typedef struct {
+    ReaderSlot   readers[SERVER_MAX_SESSIONS];
+    Session      sessions[SERVER_MAX_SESSIONS];
+    int          writerWaiting; // 1 = 有人要修改單字庫（atomic）
+    Mutex        writerLock;    // 同一時間只能有一個人修改單字庫
+    SocketHandle listener;
+    int          stopping;      // 1 = 主控台輸入了 quit（atomic）
+} Server;
 
-    printf("\n請輸入要查詢的英文或中文（輸入 end 結束查詢）：");
-    inputLine(keyword, CN_LEN);
+static Server server;
 
-    if (strlen(keyword) == 0) return 1; // 什麼都沒輸入，繼續
-    if (strcmp(keyword, "end") == 0) {
-        printf("結束查詢。\n");
-        return 0; // 告訴呼叫者停止 while 迴圈
+/* serverWarmUp：先把「第一次用到才建」的資料結構建好
+   -------------------------------------------------------
+   folderMembers、bkNearest、統計資訊、字母順序索引第一次用到時會順便建資料，這其實是「寫」，
+   好幾個讀者同時建就會打架。所以開始服務之前、以及每次修改完單字庫之後，
+   都先在沒有讀者的時候建好。
+   錯題排行和複習佇列也一起建：METRICS 直接讀它們的大小，沒建的話永遠是 0。*/
+static void serverWarmUp(void) {
+    if (!folders.membersReady) folderBuildMembers();
+    if (!headwords.ready) bkBuild(&headwords);
+    if (!stats.ready) statsBuild();
+    if (!alphaOrder.ready) sortedBuild(&alphaOrder);
+    if (!folderAlphaOrder.ready) sortedBuild(&folderAlphaOrder);
+    if (!errorRank.ready) heapBuild(&errorRank);
+    if (!dueQueue.ready) heapBuild(&dueQueue);
+    if (!newQueue.ready) heapBuild(&newQueue);
+}
+
+/* readBegin / readEnd：讀單字庫之前、之後呼叫
+   -------------------------------------------------------
+   先坐上席位（active = 1）再看有沒有人舉手，順序不能反過來：
+   寫的人是先舉手再看席位，兩邊都用 atomicStoreFull / atomicLoadFull，
+   就不可能「讀者以為沒人要寫、寫的人也以為沒人在讀」。*/
+static void readBegin(Session *s) {
+    ReaderSlot *r = &server.readers[s->slot];
+    for (;;) {
+        atomicStoreFull(&r->active, 1);
+        if (!atomicLoadFull(&server.writerWaiting)) return;
+        // 有人要寫：先離開席位讓它寫，拿一下寫入鎖就是排隊等它寫完
+        atomicStore(&r->active, 0);
+        mutexLock(&server.writerLock);
+        mutexUnlock(&server.writerLock);
     }
+}
+
+static void readEnd(Session *s) {
+    atomicStore(&server.readers[s->slot].active, 0);
+}
 
-    // 製作小寫版本，讓英文搜尋不分大小寫
-    strcpy(keyLower, keyword);
-    toLowerEN(keyLower);
+/* writeBegin / writeEnd：修改單字庫之前、之後呼叫（等所有讀者都離開才開始）*/
+static void writeBegin(void) {
+    mutexLock(&server.writerLock);
+    atomicStoreFull(&server.writerWaiting, 1);
+    for (int i = 0; i < SERVER_MAX_SESSIONS; i++) {
+        while (atomicLoadFull(&server.readers[i].active)) threadYield();
+    }
+}
 
-    int foundCount = 0;
-    for (int i = 0; i < wordCount; i++) {
-        // strstr(a, b) → 在 a 裡面找 b，找到回傳非 NULL，找不到回傳 NULL
-        int matchEN = (strstr(library[i].english, keyLower) != NULL);
-        int matchCN = (strstr(library[i].chinese, keyword)  != NULL);
+static void writeEnd(void) {
+    serverWarmUp(); // 記憶體不足時 libraryAdd 可能讓某些結構要重建，趁還沒有讀者時建好
+    atomicStore(&server.writerWaiting, 0);
+    mutexUnlock(&server.writerLock);
+}
 
-        if (matchEN || matchCN) {
-            foundCount++;
-            printf("  %d. [%s]  %-20s ／ %s  （已錯 %d 次）\n",
-                   foundCount,
-                   library[i].folder,
-                   library[i].english,
-                   library[i].chinese,
-                   library[i].errorCount);
+/* reply：像 printf 一樣，把一行回應接在 s->out 後面（最後一起送出）
+   大部分的回應放得進 line；很長的中文解釋放不下時另外 malloc 剛好的大小，
+   不能截斷：結尾的換行被截掉的話，對方會把下一行當成這一行的一部分。*/
+static void reply(Session *s, const char *fmt, ...) {
+    char    line[LINE_BUF * 3];
+    va_list ap, again;
+    va_start(ap, fmt);
+    va_copy(again, ap); // vsnprintf 用過的 ap 不能再用一次
+    int len = vsnprintf(line, sizeof(line), fmt, ap);
+    va_end(ap);
+    if (len >= (int)sizeof(line)) {
+        char *big = malloc((size_t)len + 1);
+        if (big) {
+            vsnprintf(big, (size_t)len + 1, fmt, again);
+            textAppend(&s->out, big, (size_t)len);
+            free(big);
+        } else {
+            s->out.failed = 1; // 記憶體不足：sessionFlush 會當成斷線，不會送出半行
         }
+    } else if (len >= 0) {
+        textAppend(&s->out, line, (size_t)len);
     }
+    va_end(again);
+}
 
-    if (foundCount == 0)
-        printf("找不到包含「%s」的單字。\n", keyword);
-    else
-        printf("共找到 %d 筆。\n", foundCount);
+/* replyWord：回應一行單字資料：W [Tab] 題號 [Tab] 資料夾 [Tab] 英文 [Tab] 中文*/
+static void replyWord(Session *s, int idx) {
+    reply(s, "W\t%d\t%s\t%s\t%s\n", idx, wordFolder(idx), wordEnglish(idx), wordChinese(idx));
+}
 
-    return 1; // 查詢結束，繼續等下一次輸入
+/* sessionFlush：把排好的回應一次送出去
+   回傳值：1 = 成功，0 = 對方已經斷線*/
+static int sessionFlush(Session *s) {
+    int    ok   = !s->out.failed;
+    size_t sent = 0;
+    while (ok && sent < s->out.len) {
+        int n = (int)send(s->sock, s->out.data + sent, (int)(s->out.len - sent), 0);
+        if (n <= 0) ok = 0;
+        else sent += (size_t)n;
+    }
+    s->out.len    = 0;
+    s->out.failed = 0;
+    return ok;
 }
 
+/* sessionReadLine：從連線讀一整行（不含換行）
+   -------------------------------------------------------
+   和 inputText 一樣，暫存區不夠就自動加大，很長的中文解釋也能整行收到。
+   一行最多 SERVER_LINE_MAX 個 byte：超過（或記憶體不足）就一直讀到換行、整行丟掉，
+   不能把後半段當成下一個指令執行。
 
-/* ================================================================
-   錯題本
-   ================================================================ */
+   參數：
+     line, cap → 放這一行的暫存區（第一次可以傳指向 NULL 的指標，用完要 free）
+
+   回傳值：這一行的長度；這一行被丟掉時回傳 -2；對方斷線時回傳 -1*/
+static long sessionReadLine(Session *s, char **line, size_t *cap) {
+    size_t len  = 0;
+    int    drop = 0;
+    for (;;) {
+        char  *nl = memchr(s->in, '\n', (size_t)s->inLen);
+        size_t n  = nl ? (size_t)(nl - s->in) : (size_t)s->inLen;
+        if (!drop && len + n > SERVER_LINE_MAX) drop = 1;
+        if (!drop && len + n >= *cap) {
+            size_t newCap = *cap ? *cap : LINE_BUF;
+            while (newCap <= len + n) newCap *= 2;
+            char *p = realloc(*line, newCap);
+            if (p) { *line = p; *cap = newCap; }
+            else drop = 1;
+        }
+        if (!drop) {
+            memcpy(*line + len, s->in, n);
+            len += n;
+        }
+        int used = nl ? (int)n + 1 : (int)n;
+        memmove(s->in, s->in + used, (size_t)(s->inLen - used));
+        s->inLen -= used;
+        if (nl) {
+            if (drop) return -2;
+            (*line)[len] = '\0';
+            (*line)[strcspn(*line, "\r")] = '\0'; // telnet 傳來的是 \r\n
+            return (long)strlen(*line);
+        }
+        int got = (int)recv(s->sock, s->in + s->inLen, (int)sizeof(s->in) - s->inLen, 0);
+        if (got <= 0) return -1;
+        s->inLen += got;
+    }
+}
 
-/* showErrorList：顯示所有有答錯紀錄的單字，按錯誤次數從多到少排列
+/* serverSaveProgress：把自己的進度複製一份，再把所有人的進度寫進進度檔
    -------------------------------------------------------
-   排序方式：選擇排序（Selection Sort）
-   → 每輪從「還沒排好的部分」找出錯誤次數最多的，
-     把它放到最前面，然後繼續處理剩下的。
-   → 第一輪：找全部裡最多的 → 放到第 0 位
-   → 第二輪：找剩下的最多的 → 放到第 1 位
-   → 以此類推...
-
-   為什麼用索引陣列而不是直接排序 library[]？
-   → 直接排序 library[] 會改變單字的儲存順序，影響其他功能。
-   → 用一個獨立的索引陣列來排序，library[] 本身不動，
-     只是「觀看的順序」不同。*/
-void showErrorList(void) {
-    int errorIdx[WORD_MAX]; // 存放「有答錯的單字」在 library[] 裡的索引
-    int errorTotal = 0;
+   寫檔時拿 saveLock，同一時間只有一個連線在寫；其他人答題、查詢都不受影響，
+   只有排檔案內容的那一下子要拿 progress.lock（擋住別人登入、登出）。
 
-    // 收集所有有錯誤紀錄的單字索引
-    for (int i = 0; i < wordCount; i++) {
-        if (library[i].errorCount > 0) {
-            errorIdx[errorTotal] = i;
-            errorTotal++;
-        }
+   參數：
+     s → 自己的連線（伺服器結束時沒有連線了，傳 NULL）*/
+static void serverSaveProgress(Session *s) {
+    if (s && s->user) {
+        progressSnapshot(s->user);
+        s->user->unsaved = 0;
     }
+    mutexLock(&progress.saveLock);
+    TextBuf buf = {0};
+    if (s) readBegin(s); // 要讀單字的資料夾和英文
+    mutexLock(&progress.lock);
+    int ok = progressRender(&buf);
+    mutexUnlock(&progress.lock);
+    if (s) readEnd(s);
+    if (ok) replaceFile(PROGRESS_FILE, PROGRESS_FILE_TMP, buf.data, buf.len);
+    free(buf.data);
+    mutexUnlock(&progress.saveLock);
+}
 
-    if (errorTotal == 0) {
-        printf("\n太棒了！目前完全沒有錯誤紀錄！繼續保持！\n");
+/* serverLogin：USER 名字*/
+static void serverLogin(Session *s, const char *name) {
+    size_t len = strlen(name);
+    if (s->user) { reply(s, "ERR 已經用 %s 登入了\n", s->user->name); return; }
+    if (len == 0 || len >= USER_NAME_LEN || strchr(name, '\t')) {
+        reply(s, "ERR 名字要是 1~%d 個 byte，不能有 Tab\n", USER_NAME_LEN - 1);
         return;
     }
 
-    // 選擇排序：讓錯最多的排在前面
-    for (int i = 0; i < errorTotal - 1; i++) {
-        int maxPos = i; // 先假設「目前這個位置」的錯誤次數是最多的
-        for (int j = i + 1; j < errorTotal; j++) {
-            if (library[errorIdx[j]].errorCount > library[errorIdx[maxPos]].errorCount) {
-                maxPos = j; // 找到更多的，更新「最多」的位置
-            }
-        }
-        if (maxPos != i) {
-            // 把「錯最多的」和「目前位置」交換
-            int tmp        = errorIdx[i];
-            errorIdx[i]    = errorIdx[maxPos];
-            errorIdx[maxPos] = tmp;
-        }
+    mutexLock(&progress.lock);
+    UserProgress *u = progressFind(name, 1);
+    int busy = u && u->online;
+    if (u && !busy) u->online = 1;
+    mutexUnlock(&progress.lock);
+
+    if (!u)        reply(s, "ERR 記憶體不足\n");
+    else if (busy) reply(s, "ERR %s 已經在別的連線登入了\n", name);
+    else {
+        s->user = u;
+        reply(s, "OK 歡迎，%s\n", name);
     }
+}
 
-    // 顯示排序後的錯題清單
-    printf("\n===== 錯題本（共 %d 個單字）=====\n", errorTotal);
-    printf("%-5s  %-22s  %-22s  %s\n", "名次", "英文", "中文", "錯誤次數");
-    printf("-----------------------------------------------\n");
-    for (int i = 0; i < errorTotal; i++) {
-        int idx = errorIdx[i];
-        printf("%-5d  %-22s  %-22s  %d 次\n",
-               i + 1,
-               library[idx].english,
-               library[idx].chinese,
-               library[idx].errorCount);
+/* serverFind：FIND 英文（同一個英文在好幾個資料夾的話全部列出來）*/
+static void serverFind(Session *s, char *word) {
+    normalizeText(word, word); // 正規化不會變長，直接改在原來的字串上（一行多長都可以）
+    const char *key = word;
+    int found = 0;
+    readBegin(s);
+    uint32_t hash = keyHash(key);
+    uint32_t pos  = hash;
+    int idx;
+    while ((idx = hashNext(&englishIndex, hash, &pos)) >= 0 && found < SERVER_MAX_RESULTS) {
+        if (strcmp(wordKeyEn(idx), key) == 0) {
+            replyWord(s, idx);
+            found++;
+        }
     }
+    readEnd(s);
+    if (found) reply(s, "OK %d\n", found);
+    else       reply(s, "ERR 找不到 %s\n", word);
+}
 
-    // 詢問是否要立刻針對這些錯題測驗
-    printf("\n要針對這些錯題進行加強測驗嗎？(1=是 / 其他=否): ");
-    int yn;
-    if (scanf("%d", &yn) == 1 && yn == 1) {
-        clearInputBuffer();
-        takeErrorTest();
-    } else {
-        clearInputBuffer();
+/* serverSearch：SEARCH 關鍵字（和選單的 search 一樣，結尾加 * 只找開頭）*/
+static void serverSearch(Session *s, char *keyword) {
+    size_t len    = strlen(keyword);
+    int    prefix = (len > 1 && keyword[len - 1] == '*');
+    if (prefix) keyword[len - 1] = '\0';
+    if (keyword[0] == '\0') { reply(s, "ERR 請輸入關鍵字\n"); return; }
+    normalizeText(keyword, keyword); // 和 FIND 一樣直接改在原來的字串上
+    const char *key = keyword;
+
+    IdList hits = {0};
+    const char *like = NULL;
+    readBegin(s);
+    int found = gramSearch(&textIndex, &library, key, prefix, &hits);
+    for (int k = 0; k < found && k < SERVER_MAX_RESULTS; k++) replyWord(s, hits.ids[k]);
+    if (found == 0 && headwords.ready) {
+        like = bkNearest(key, SUGGEST_LIMIT, NULL);
+        if (like) reply(s, "S\t%s\n", like); // 你是不是要找（要在 readEnd 之前印，字串屬於 BK-tree）
     }
+    readEnd(s);
+    free(hits.ids);
+    reply(s, "OK %d\n", found);
 }
 
+/* serverAsk：ASK [資料夾]，從資料夾（沒指定就是全部）隨機出一題*/
+static void serverAsk(Session *s, char *folder) {
+    toLowerEN(folder);
+    readBegin(s);
+    int fid = folder[0] ? folderFind(folder) : -1;
+    const IdList *m = fid >= 0 ? folderMembers(fid) : NULL;
+    int n = folder[0] ? (m ? m->count : 0) : library.count;
+    if (n > 0) {
+        int k   = (int)rngRange(&s->rng, (uint64_t)n);
+        int idx = m ? m->ids[k] : k;
+        reply(s, "Q\t%d\t%s\n", idx, wordChinese(idx));
+    }
+    readEnd(s);
+    if (n > 0) reply(s, "OK\n");
+    else       reply(s, "ERR %s沒有單字\n", folder[0] ? "這個資料夾" : "單字庫");
+}
 
-/* ================================================================
-   刪除單字
-   ================================================================ */
+/* serverAnswer：ANSWER 題號 英文*/
+static void serverAnswer(Session *s, char *arg) {
+    char *answer = NULL;
+    long  idx    = strtol(arg, &answer, 10);
+    if (answer == arg || *answer != ' ') { reply(s, "ERR 格式是 ANSWER 題號 英文\n"); return; }
+    answer++;
+    normalizeText(answer, answer);
+
+    readBegin(s);
+    int ok = idx >= 0 && idx < library.count;
+    int result = ok ? gradeAnswer(answer, (int)idx) : ANSWER_WRONG;
+    if (!ok) {
+        reply(s, "ERR 沒有第 %ld 題\n", idx);
+    } else if (result == ANSWER_RIGHT) {
+        reply(s, "OK RIGHT\t%s\n", wordEnglish((int)idx));
+    } else if (result == ANSWER_NEAR) {
+        reply(s, "OK NEAR\t%s\n", wordEnglish((int)idx));
+    } else {
+        // 只改自己的進度，不用等任何人
+        int count = progressAdd(s->user, (int)idx, 1, library.count);
+        reply(s, "OK WRONG\t%s\t%d\n", wordEnglish((int)idx), count > 0 ? count : 0);
+    }
+    readEnd(s);
+    if (ok && result == ANSWER_WRONG && ++s->user->unsaved >= PROGRESS_SAVE_EVERY) {
+        serverSaveProgress(s);
+    }
+}
 
-/* deleteWord：讓使用者輸入單字名稱，從 library[] 中刪除
-   -------------------------------------------------------
-   刪除的方法（以最後元素覆蓋）：
-   → 找到要刪的單字後，把 library[] 最後一格的資料複製過來蓋掉它，
-     再把 wordCount 減 1，這格就等於「消失」了。
+/* ErrorHit：ERRORS 排序用的（錯誤次數, 單字索引）*/
+typedef struct {
+    int count;
+    int idx;
+} ErrorHit;
+
+static int cmpErrorHit(const void *a, const void *b) {
+    const ErrorHit *x = a, *y = b;
+    if (x->count != y->count) return y->count - x->count; // 錯越多越前面
+    return (x->idx > y->idx) - (x->idx < y->idx);         // 一樣多就照單字順序
+}
 
-   這個方法的優缺點：
-   ✓ 優點：速度快，O(1)，不需要移動其他元素
-   ✗ 缺點：單字的儲存順序會改變（但這個程式不依賴順序，所以沒關係）*/
-void deleteWord(void) {
-    if (wordCount == 0) {
-        printf("目前沒有任何單字可以刪除。\n");
+/* serverErrors：ERRORS，列出自己答錯最多的單字*/
+static void serverErrors(Session *s) {
+    ProgressEntry *mine;
+    int total = progressCollect(s->user, &mine);
+    ErrorHit *hits = total >= 0 ? malloc((size_t)(total ? total : 1) * sizeof(ErrorHit)) : NULL;
+    if (!hits) {
+        if (total >= 0) free(mine);
+        reply(s, "ERR 記憶體不足\n");
         return;
     }
 
-    clearInputBuffer(); // 清掉主選單 scanf 留下的換行
-    char target[EN_LEN];
-    printf("\n請輸入要刪除的英文單字（輸入 end 取消）：");
-    inputLineEN(target, EN_LEN);
+    readBegin(s);
+    int n = 0;
+    for (int i = 0; i < total; i++) {
+        if (mine[i].count > 0 && (int)mine[i].word < library.count) {
+            hits[n].count = mine[i].count;
+            hits[n].idx   = (int)mine[i].word;
+            n++;
+        }
+    }
+    free(mine);
+    qsort(hits, (size_t)n, sizeof(ErrorHit), cmpErrorHit);
+    for (int k = 0; k < n && k < SERVER_MAX_RESULTS; k++) {
+        reply(s, "W\t%d\t%s\t%s\t%s\t%d\n", hits[k].idx, wordFolder(hits[k].idx),
+              wordEnglish(hits[k].idx), wordChinese(hits[k].idx), hits[k].count);
+    }
+    readEnd(s);
+    free(hits);
+    reply(s, "OK %d\n", n);
+}
 
-    if (strcmp(target, "end") == 0) {
-        printf("已取消刪除。\n");
+/* serverAdd：ADD 資料夾 [Tab] 英文 [Tab] 中文（唯一會修改單字庫的指令）*/
+static void serverAdd(Session *s, char *arg) {
+    toLowerEN(arg); // 和 AddWord 一樣，資料夾和英文一律小寫
+    // 不能用 strtok：它把切到哪裡記在函式庫裡，好幾個連線同時切就會打架
+    char *folder = arg;
+    char *en     = strchr(folder, '\t');
+    char *cn     = en ? strchr(en + 1, '\t') : NULL;
+    if (en) *en++ = '\0';
+    if (cn) *cn++ = '\0';
+    if (!en || !cn || !folder[0] || !en[0] || !cn[0] || strchr(cn, '\t')) { reply(s, "ERR 格式是 ADD 資料夾 [Tab] 英文 [Tab] 中文\n"); return; }
+    // 和讀檔一樣只收 UTF-8：Big5 之類的字先收下、寫進日誌，下次讀檔時就會被整行略過
+    if (!utf8Valid(folder, strlen(folder)) || !utf8Valid(en, strlen(en)) || !utf8Valid(cn, strlen(cn))) {
+        reply(s, "ERR 資料夾、英文、中文都要是 UTF-8\n");
         return;
     }
 
-    // 在 library[] 裡找這個單字
-    for (int i = 0; i < wordCount; i++) {
-        if (strcmp(library[i].english, target) == 0) {
-            printf("\n找到：\n");
-            printf("  英文：%s\n  中文：%s\n  資料夾：%s\n",
-                   library[i].english, library[i].chinese, library[i].folder);
-            printf("確定要刪除嗎？(1=確定 / 其他=取消): ");
+    writeBegin();
+    int fid = folderIntern(folder);
+    int idx = -1, dup = 0;
+    if (fid >= 0) {
+        dup = findInFolder(fid, en, cn) >= 0;
+        if (!dup) idx = libraryAdd(fid, en, cn, 0);
+        if (idx >= 0) {
+            storageAdded(idx);
+            storageCommit(1); // 文字檔：交給背景寫入執行緒，不用等磁碟
+        }
+    }
+    writeEnd();
+
+    if (dup)          reply(s, "ERR 這個單字在 %s 已經存在了\n", folder);
+    else if (idx < 0) reply(s, "ERR 記憶體不足\n");
+    else              reply(s, "OK %d\n", idx);
+}
 
-            int yn;
-            scanf("%d", &yn);
-            clearInputBuffer();
+/* serverCards：CARDS [資料夾] [Tab 範圍]，開始一次單字卡學習，先排好前面幾張*/
+static void serverCards(Session *s, char *arg) {
+    char *range = strchr(arg, '\t');
+    if (range) *range++ = '\0';
+    else       range = arg + strlen(arg);
+    if (strlen(range) >= LINE_BUF) { reply(s, "ERR 範圍太長了\n"); return; }
+    char from[LINE_BUF], to[LINE_BUF];
+    rangeKeys(range, from, to);
+    toLowerEN(arg);
+
+    readBegin(s);
+    int fid   = arg[0] ? folderFind(arg) : -1;
+    int count = 0, ok = 1;
+    if (arg[0] && fid < 0) {
+        count = 0; // 沒有這個資料夾
+    } else if (!(fid >= 0 ? folderAlphaOrder.ready : alphaOrder.ready)) {
+        ok = 0;    // 字母順序索引沒建好（記憶體不足過）：建索引是「寫」，不能在讀取席位上建
+    } else {
+        const SortedIndex *order;
+        int first;
+        count = sortedRange(fid, from, to, &order, &first);
+        ok    = count >= 0 && cardOpen(&s->cards, order->list.ids + first, count, 0);
+    }
+    readEnd(s);
+    if (!ok)             reply(s, "ERR 記憶體不足\n");
+    else if (count == 0) reply(s, "ERR 這個範圍沒有單字\n");
+    else                 reply(s, "OK %d\n", count);
+}
 
-            if (yn != 1) {
-                printf("已取消。\n");
-                return;
-            }
+/* serverCard：CARD，翻下一張（已經預先排好了，不用佔讀取席位）*/
+static void serverCard(Session *s) {
+    CardDeck *d = &s->cards;
+    if (!d->order) { reply(s, "ERR 請先用 CARDS 開始\n"); return; }
+    const Card *c = cardNext(d);
+    if (!c && d->next < d->count) {
+        // 上次沒排好（記憶體不足）：只好現在查
+        readBegin(s);
+        cardPrefetch(d);
+        readEnd(s);
+        c = cardNext(d);
+    }
+    if (!c) {
+        reply(s, d->next < d->count ? "ERR 記憶體不足\n" : "OK END\n");
+        return;
+    }
+    reply(s, "C\t%d\t%d\t%s\t%s\t%s\t%d\n", c->pos + 1, d->count, c->folder, c->en, c->cn, c->errors);
+    reply(s, "OK\n");
+}
 
-            // 用最後一個元素覆蓋，縮短陣列
-            library[i] = library[wordCount - 1];
-            wordCount--;
-            saveToFile();
-            printf("[Success] 已成功刪除「%s」。\n", target);
-            return;
+/* serverStats：STATS，回傳單字庫的統計（隨時維護好的，不用掃單字庫）
+     T [Tab] 單字數 [Tab] 答錯過的單字數 [Tab] 錯誤次數總和
+     F [Tab] 資料夾 [Tab] 單字數 [Tab] 答錯過的單字數 [Tab] 錯誤次數總和   ← 一個資料夾一行
+     H [Tab] 錯誤次數（這一格的下限）[Tab] 單字數                         ← 一格一行*/
+static void serverStats(Session *s) {
+    readBegin(s);
+    int ok = stats.ready; // 記憶體不足放棄過的話，要等下一次修改單字庫（writeEnd）才會重建
+    if (ok) {
+        reply(s, "T\t%d\t%d\t%lld\n", stats.total.words, stats.total.errorWords,
+              (long long)stats.total.errors);
+        for (int f = 0; f < folders.count; f++) {
+            FolderStat none = {0};
+            const FolderStat *fs = f < stats.folderCap ? &stats.perFolder[f] : &none;
+            reply(s, "F\t%s\t%d\t%d\t%lld\n", folderName(f), fs->words, fs->errorWords,
+                  (long long)fs->errors);
+        }
+        for (int b = 0; b < STATS_BUCKETS; b++) {
+            reply(s, "H\t%d\t%d\n", b ? 1 << (b - 1) : 0, stats.histogram[b]);
         }
     }
-
-    printf("找不到「%s」這個單字。\n", target);
+    readEnd(s);
+    if (ok) reply(s, "OK\n");
+    else    reply(s, "ERR 記憶體不足\n");
 }
 
+/* serverChanges：CHANGES [游標]，只回傳游標之後的變更，最後一行是新的游標
+   游標不能用（沒給、程式重開過、太舊）的話改成回傳全部單字，OK 後面多一個 RESET。*/
+static void serverChanges(Session *s, const char *cursor) {
+    int reset;
+    readBegin(s);
+    int rows = changesSince(cursor, &s->out, &reset);
+    unsigned long long epoch = changes.epoch, seq = changes.seq;
+    readEnd(s);
+    reply(s, "OK %s%016llx:%llu %d\n", reset ? "RESET " : "", epoch, seq, rows);
+}
 
-/* ================================================================
-   新增單字
-   ================================================================ */
+/* serverMetrics：METRICS，回傳效能統計（讀索引大小，所以要佔讀取席位）*/
+static void serverMetrics(Session *s) {
+    readBegin(s);
+    metricsExport(&s->out);
+    readEnd(s);
+    reply(s, "OK\n");
+}
 
-/* AddWord：讓使用者一次新增多個單字，輸入 end 才結束
-   -------------------------------------------------------
-   輸入格式：英文單字 [Tab鍵] 中文意思
-   例如：apple    蘋果*/
-void AddWord(void) {
-    if (isFull()) return;
-    clearInputBuffer(); // 清掉主選單 scanf 留下的換行
+/* serverHandle：處理一行指令
+   回傳值：1 = 繼續，0 = 使用者要離線*/
+static int serverHandle(Session *s, char *line) {
+    char *arg = strchr(line, ' ');
+    if (arg) *arg++ = '\0';
+    else     arg = line + strlen(line);
+    toLowerEN(line); // 指令不分大小寫
 
-    printf("===== 新增單字 =====\n");
-    printf("（每次新增都會自動存檔）\n\n");
+    if (strcmp(line, "quit") == 0) {
+        reply(s, "OK 掰掰！\n");
+        return 0;
+    }
+    if (line[0] == '\0') return 1;
+    if (strcmp(line, "user") == 0)    { serverLogin(s, arg); return 1; }
+    if (strcmp(line, "metrics") == 0) { serverMetrics(s); return 1; }
+    if (!s->user) { reply(s, "ERR 請先用 USER 名字 登入\n"); return 1; }
+
+    if      (strcmp(line, "find") == 0)   serverFind(s, arg);
+    else if (strcmp(line, "search") == 0) serverSearch(s, arg);
+    else if (strcmp(line, "ask") == 0)    serverAsk(s, arg);
+    else if (strcmp(line, "answer") == 0) serverAnswer(s, arg);
+    else if (strcmp(line, "errors") == 0) serverErrors(s);
+    else if (strcmp(line, "add") == 0)    serverAdd(s, arg);
+    else if (strcmp(line, "cards") == 0)  serverCards(s, arg);
+    else if (strcmp(line, "card") == 0)   serverCard(s);
+    else if (strcmp(line, "stats") == 0)  serverStats(s);
+    else if (strcmp(line, "changes") == 0) serverChanges(s, arg);
+    else reply(s, "ERR 不認識的指令：%s\n", line);
+    return 1;
+}
 
-    // 第一步：選擇要存入哪個資料夾
-    char folder[EN_LEN];
-    while (1) {
-        printf("請輸入資料夾名稱（英文，例如 ch1 / unit2）：");
-        inputLineEN(folder, EN_LEN); // 讀入並轉小寫
-        if (strlen(folder) > 0) break;
-        printf("[Error] 資料夾名稱不能空白，請重新輸入。\n");
+/* sessionMain：一個連線的執行緒*/
+static void *sessionMain(void *arg) {
+    Session *s    = arg;
+    char    *line = NULL;
+    size_t   cap  = 0;
+    long     len;
+    readBegin(s);
+    reply(s, "OK 英文單字背誦系統（%d 個單字），請先輸入 USER 名字\n", library.count);
+    readEnd(s);
+    int alive = sessionFlush(s);
+    while (alive && (len = sessionReadLine(s, &line, &cap)) != -1) {
+        if (len == -2) reply(s, "ERR 一行最多 %d 個 byte，這一行整行沒有執行\n", SERVER_LINE_MAX);
+        else alive = serverHandle(s, line);
+        alive = sessionFlush(s) && alive;
+        if (alive && cardPending(&s->cards)) {
+            // 回應已經送出去了，對方在看這張卡的時候把後面幾張排好
+            readBegin(s);
+            cardPrefetch(&s->cards);
+            readEnd(s);
+        }
     }
-    updateFolderList(folder); // 確保這個資料夾有被記錄起來
+    free(line);
 
-    printf("\n輸入格式：英文 [Tab鍵] 中文，例如：apple\t蘋果\n");
-    printf("輸入 end 結束新增。\n\n");
+    if (s->user) {
+        serverSaveProgress(s); // 離線前存一次，下次登入（或伺服器重開）進度還在
+        mutexLock(&progress.lock);
+        s->user->online = 0;
+        mutexUnlock(&progress.lock);
+    }
+    shutdown(s->sock, SOCK_SHUT); // 讓對方知道連線結束了（socket 由收拾的人關）
+    atomicStore(&s->done, 1);
+    return NULL;
+}
 
-    // 第二步：重複接收單字，直到輸入 end 或單字庫滿為止
-    while (!isFull()) {
-        printf("> ");
-        char raw[LINE_BUF];
-        inputLineEN(raw, LINE_BUF); // 讀入並把英文轉小寫（中文不受影響）
+/* sessionReap：收拾已經結束（或是 wait = 1 時不管有沒有結束）的連線*/
+static void sessionReap(Session *s, int wait) {
+    if (!s->used || (!wait && !atomicLoad(&s->done))) return;
+    threadJoin(s->thread);
+    sockClose(s->sock);
+    free(s->out.data);
+    cardClose(&s->cards);
+    s->used = 0;
+}
 
-        if (strcmp(raw, "end") == 0) {
-            printf("新增結束。\n");
+/* serverAccept：接受連線的執行緒，每來一個連線就找一格空的 Session、開一個執行緒*/
+static void *serverAccept(void *arg) {
+    (void)arg;
+    for (;;) {
+        SocketHandle c = accept(server.listener, NULL, NULL);
+        if (atomicLoad(&server.stopping)) {
+            if (c != SOCKET_NONE) sockClose(c);
             break;
         }
+        if (c == SOCKET_NONE) { threadYield(); continue; }
 
-        /* 為什麼要先複製到 copy 再用 strtok 切割？
-           → strtok 會直接修改傳入的字串（把 Tab 換成 '\0'）。
-           → 如果直接切割 raw，之後就沒辦法用 raw 的內容來組合 wholeLine 了。
-           → 用複本 copy 來切割，raw 保持原樣可以繼續使用。*/
-        char copy[LINE_BUF];
-        strcpy(copy, raw);
-        char *en = strtok(copy, "\t"); // 切出英文部分
-        char *ch = strtok(NULL, "\t"); // 切出中文部分
-
-        // 檢查格式是否正確（兩個部分都要有）
-        if (!en || !ch || strlen(en) == 0 || strlen(ch) == 0) {
-            printf("[Error] 格式錯誤，記得用 Tab 鍵分隔英文和中文。\n");
-            continue; // 跳回迴圈開頭，讓使用者重新輸入
-        }
-
-        // 重複檢查：同一個資料夾裡，英文和中文都完全一樣就算重複
-        int duplicate = 0;
-        for (int i = 0; i < wordCount; i++) {
-            if (strcmp(library[i].folder,  folder) == 0 &&
-                strcmp(library[i].english, en)     == 0 &&
-                strcmp(library[i].chinese, ch)     == 0) {
-                duplicate = 1;
-                break; // 找到就不用繼續找了
-            }
+        Session *s = NULL;
+        for (int i = 0; i < SERVER_MAX_SESSIONS && !s; i++) {
+            sessionReap(&server.sessions[i], 0);
+            if (!server.sessions[i].used) s = &server.sessions[i];
         }
-        if (duplicate) {
-            printf("[Warning] 這個單字在「%s」已經存在了，跳過。\n", folder);
+        if (!s) {
+            const char *full = "ERR 人數已滿，請稍後再試\n";
+            send(c, full, (int)strlen(full), 0);
+            sockClose(c);
             continue;
         }
 
-        /* 為什麼要組合成 wholeLine 再傳給 parseLine？
-           → parseLine 負責解析「資料夾\t英文\t中文」這種格式，
-             並把它寫入 library[]。
-           → 我們直接重用這個函數，不用再寫一遍存入的邏輯。*/
-        char wholeLine[LINE_BUF];
-        sprintf(wholeLine, "%s\t%s\t%s", folder, en, ch);
-        parseLine(wholeLine);
+        int slot = (int)(s - server.sessions);
+        memset(s, 0, sizeof(*s));
+        s->sock = c;
+        s->slot = slot;
+        rngInit(&s->rng, rngNext()); // 全域的 rng 只有這個執行緒在用
+        s->used = 1;
+        if (!threadStart(&s->thread, sessionMain, s)) {
+            sockClose(c);
+            s->used = 0;
+        }
+    }
+    return NULL;
+}
 
-        printf("[Success] 已新增：%s ／ %s（資料夾：%s）\n",
-               library[wordCount - 1].english,
-               library[wordCount - 1].chinese,
-               folder);
-        saveToFile(); // 每新增一個就存一次，避免中途出錯遺失資料
+/* serverListen：在 port 上開始等待連線
+   回傳值：等待連線的 socket；失敗時回傳 SOCKET_NONE*/
+static SocketHandle serverListen(int port) {
+    SocketHandle s = socket(AF_INET, SOCK_STREAM, 0);
+    if (s == SOCKET_NONE) return SOCKET_NONE;
+    int yes = 1; // 伺服器剛關掉馬上重開時，連接埠還可以再用
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (const char *)&yes, sizeof(yes));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons((unsigned short)port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(s, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(s, 16) != 0) {
+        sockClose(s);
+        return SOCKET_NONE;
+    }
+    return s;
+}
+
+/* serverWake：自己連自己一下，把卡在 accept 裡的執行緒叫醒（它醒來會看到 stopping）*/
+static void serverWake(int port) {
+    SocketHandle s = socket(AF_INET, SOCK_STREAM, 0);
+    if (s == SOCKET_NONE) return;
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons((unsigned short)port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    connect(s, (struct sockaddr *)&addr, sizeof(addr));
+    sockClose(s);
+}
+
+/* serverRun：伺服器模式的主程式
+   -------------------------------------------------------
+   主執行緒只負責主控台（等 quit），接受連線交給 serverAccept 執行緒，
+   每個連線再各自一個執行緒。結束時的順序：
+     不再接受新連線 → 把所有連線斷掉、等它們的執行緒結束 → 背景寫入清空 → 存檔
+
+   回傳值：給 main 回傳的結束代碼（0 = 正常結束）*/
+int serverRun(int port) {
+#ifdef _WIN32
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+        printf("[Error] 無法啟動網路功能。\n");
+        return 1;
+    }
+#else
+    signal(SIGPIPE, SIG_IGN); // 對斷線的連線 send 時只回傳錯誤，不要讓整個程式結束
+#endif
+    if (!storageOpen()) return 1;
+    mutexInit(&progress.lock);
+    mutexInit(&progress.saveLock);
+    progressLoad();
+    persistStart();
+    serverWarmUp();
+
+    server.listener = serverListen(port);
+    if (server.listener == SOCKET_NONE) {
+        printf("[Error] 無法使用連接埠 %d（可能已經有別的程式在用）。\n", port);
+        storageClose(0);
+        progressFree();
+        libraryFree();
+        return 1;
+    }
+    mutexInit(&server.writerLock);
+    printf("伺服器已啟動：連接埠 %d，%d 個單字。輸入 quit 結束。\n", port, library.count);
+
+    ThreadHandle acceptor;
+    if (!threadStart(&acceptor, serverAccept, NULL)) {
+        printf("[Error] 無法開啟執行緒。\n");
+        sockClose(server.listener);
+        storageClose(0);
+        progressFree();
+        libraryFree();
+        return 1;
+    }
+
+    char cmd[EN_LEN];
+    while (fgets(cmd, sizeof(cmd), stdin)) {
+        cmd[strcspn(cmd, "\r\n")] = '\0';
+        if (strcmp(cmd, "quit") == 0) break;
+        if (cmd[0]) printf("輸入 quit 結束伺服器。\n");
+    }
+
+    atomicStore(&server.stopping, 1);
+    serverWake(port);
+    threadJoin(acceptor);
+    sockClose(server.listener);
+    for (int i = 0; i < SERVER_MAX_SESSIONS; i++) {
+        // shutdown 會讓卡在 recv 的連線執行緒馬上收到「斷線」，自己結束
+        if (server.sessions[i].used) shutdown(server.sessions[i].sock, SOCK_SHUT);
+        sessionReap(&server.sessions[i], 1);
     }
+    serverSaveProgress(NULL); // 大家都離線時已經各自存過了，這裡只是保險
+    progressFree();
+    mutexDestroy(&server.writerLock);
+#ifdef _WIN32
+    WSACleanup();
+#endif
+
+    storageClose(1); // 等還沒寫完的紀錄寫完，再把日誌壓縮進主檔
+    libraryFree();
+    printf("伺服器已結束。\n");
+    return 0;
 }
 
 
 /* ================================================================
-   統計資訊
+   嵌入用的函式庫介面（enw*，給 Python 等其他程式直接呼叫）
+   ================================================================
+
+   為什麼需要？
+   → 所有功能都只能從 mainMenu 的 scanf 選單進去，Python 版（web.py、GUI.py）要查詢、批改，
+     只能自己用 SQL 再寫一遍，每個請求都要重新查資料庫。
+   → 編成共用函式庫之後，Python 用 ctypes 載入（english_word_lib.py），
+     單字庫只讀一次、常駐在記憶體裡，查詢和批改直接用 C 這邊的索引（片段索引、BK-tree、打錯字判斷）。
+
+   編譯（不會有 main，只留 enw* 這幾個函數給別人呼叫）：
+     gcc -O2 -shared -fPIC -fvisibility=hidden -DEN_WORD_LIBRARY -DUSE_SQLITE En_word.c -o libenword.so -pthread -lsqlite3
+   -fvisibility=hidden 讓其他不是 static 的函數（loadFile、libraryAdd...）都不匯出，
+   只有標了 ENW_API 的 enw* 看得到，不會和載入它的程式裡同名的函數撞在一起。
+     Windows：gcc -O2 -shared -DEN_WORD_LIBRARY -DUSE_SQLITE En_word.c -o enword.dll -lsqlite3 -lws2_32
+
+   怎麼用？
+     EnWord *h = enwOpen("vocabulary.db");   // NULL = 用目前資料夾的 english_word.txt
+     enwAdd(h, "ch1", "apple", "蘋果");
+     const char *hits = enwSearch(h, "app*", 20);
+     int result = enwGrade(h, idx, "aple");   // ANSWER_NEAR
+     enwClose(h);                             // 收尾：把日誌壓縮進主檔
+   → 回傳的文字都是「一行一筆、Tab 分隔」，和伺服器模式的格式一樣：
+       W [Tab] 索引 [Tab] 資料夾 [Tab] 英文 [Tab] 中文 [Tab] 錯誤次數   ← 單字
+       Q [Tab] 索引 [Tab] 資料夾 [Tab] 中文                           ← 題目（enwQuiz）
+     字串屬於代號，下一次呼叫 enw* 就會被蓋掉，要留著的話請自己複製（Python 那邊會馬上轉成 str）。
+   → 索引和選單模式一樣：刪除單字時最後一個單字會搬到被刪的位置，所以刪除之後要重新查。
+
+   為什麼還是只能同時開一個？
+   → 單字庫、索引、日誌都是全域變數，整個程式只有一份；
+     要真的一個代號一份，得把所有函數都改成多傳一個參數，等於重寫整個程式。
+   → 所以先把「對外的介面」做成代號的樣子：呼叫的人不碰任何全域變數，
+     之後核心改成一個代號一份時，介面不用改。現在同時開第二個會直接失敗（回傳 NULL）。
+   → 同一個代號一次只能有一個執行緒在用（Python 那邊用一把鎖包起來）。
    ================================================================ */
 
-/* showStats：顯示目前單字庫的整體數據*/
-void showStats(void) {
-    printf("\n===== 統計資訊 =====\n");
-    printf("資料夾數量  : %d 個\n", folderCount);
-    printf("單字總量    : %d 個\n", wordCount);
+/* enwText：回傳 h->out 目前的內容（當作 C 字串）；記憶體不足回傳 NULL*/
+static const char *enwText(EnWord *h) {
+    textAppend(&h->out, "", 1); // 結尾的 '\0'
+    return h->out.failed ? NULL : h->out.data;
+}
 
-    // 計算有答錯過的單字數和總錯誤次數
-    int hasErrorCount = 0;
-    int totalErrors   = 0;
-    for (int i = 0; i < wordCount; i++) {
-        if (library[i].errorCount > 0) {
-            hasErrorCount++;
-            totalErrors += library[i].errorCount;
+/* enwLine：把第 idx 個單字排成一行 W 接在 h->out 後面*/
+static void enwLine(EnWord *h, int idx) {
+    char line[LINE_BUF * 3];
+    int  len = snprintf(line, sizeof(line), "W\t%d\t%s\t%s\t%s\t%d\n", idx, wordFolder(idx),
+                        wordEnglish(idx), wordChinese(idx), library.words[idx].errorCount);
+    if (len >= (int)sizeof(line)) {
+        // 很長的片語：改成一段一段接
+        textAppend(&h->out, line, (size_t)snprintf(line, sizeof(line), "W\t%d\t", idx));
+        const char *field[3] = { wordFolder(idx), wordEnglish(idx), wordChinese(idx) };
+        for (int f = 0; f < 3; f++) {
+            textAppend(&h->out, field[f], strlen(field[f]));
+            textAppend(&h->out, "\t", 1);
         }
+        len = snprintf(line, sizeof(line), "%d\n", library.words[idx].errorCount);
     }
-    printf("有錯誤紀錄  : %d 個單字\n", hasErrorCount);
-    printf("累計總錯誤  : %d 次\n",     totalErrors);
+    textAppend(&h->out, line, (size_t)len);
+}
 
-    // 顯示每個資料夾有幾個單字（讓使用者知道各章節的進度）
-    if (folderCount > 0) {
-        printf("\n各資料夾單字數：\n");
-        for (int f = 0; f < folderCount; f++) {
-            int count = 0;
-            for (int i = 0; i < wordCount; i++) {
-                if (strcmp(library[i].folder, folderList[f]) == 0) count++;
-            }
-            printf("  %-20s %d 個\n", folderList[f], count);
+/* enwOpen：打開單字庫，傳回代號
+   -------------------------------------------------------
+   參數：
+     dbPath → SQLite 資料庫檔（和 Python 版共用，編譯時要加 -DUSE_SQLITE）；
+              NULL 或空字串 = 用目前資料夾的 english_word.txt
+
+   回傳值：代號；已經有一個開著、資料庫功能沒有編進來、或讀不到單字庫時回傳 NULL*/
+ENW_API EnWord *enwOpen(const char *dbPath) {
+    if (enwOpened) return NULL;
+    EnWord *h = calloc(1, sizeof(EnWord));
+    if (!h) return NULL;
+    if (dbPath && dbPath[0]) {
+        h->dbPath = malloc(strlen(dbPath) + 1);
+        if (!h->dbPath || !storageUseDatabase(strcpy(h->dbPath, dbPath))) {
+            free(h->dbPath);
+            free(h);
+            return NULL;
+        }
+    } else {
+        storage = &textStorage; // 上一個代號可能用過資料庫
+    }
+    rngSeed((uint64_t)time(NULL) ^ metricNow()); // 和 main 一樣，每次出題順序才不同
+    if (!storageOpen()) {
+        libraryFree();
+        free(h->dbPath);
+        free(h);
+        return NULL;
+    }
+    enwOpened = h;
+    return h;
+}
+
+/* enwClose：關閉代號（把還沒寫的變更寫完、日誌壓縮進主檔），之後 h 不能再用*/
+ENW_API void enwClose(EnWord *h) {
+    if (!h || h != enwOpened) return;
+    storageClose(1);
+    libraryFree();
+    free(h->out.data);
+    free(h->dbPath);
+    free(h);
+    enwOpened = NULL;
+}
+
+/* enwCount：單字庫目前有幾個單字*/
+ENW_API int enwCount(EnWord *h) {
+    return h == enwOpened ? library.count : 0;
+}
+
+/* enwWord：第 idx 個單字（一行 W）；沒有這個單字回傳 NULL*/
+ENW_API const char *enwWord(EnWord *h, int idx) {
+    if (h != enwOpened || idx < 0 || idx >= library.count) return NULL;
+    h->out.len = 0;
+    h->out.failed = 0;
+    enwLine(h, idx);
+    return enwText(h);
+}
+
+/* enwAdd：新增一個單字（和選單的 AddWord 一樣，資料夾和英文一律小寫）
+   回傳值：新單字的索引；-2 = 同一個資料夾已經有一模一樣的字；
+           -1 = 格式不對（空白、有 Tab 或換行、不是 UTF-8）或記憶體不足*/
+ENW_API int enwAdd(EnWord *h, const char *folder, const char *en, const char *cn) {
+    if (h != enwOpened || !folder || !en || !cn) return -1;
+    const char *field[3] = { folder, en, cn };
+    char *copy[3] = { NULL, NULL, NULL };
+    int   ok = 1;
+    for (int f = 0; f < 3; f++) {
+        size_t len = strlen(field[f]);
+        copy[f] = malloc(len + 1);
+        ok = ok && copy[f] && len > 0 && !strpbrk(field[f], "\t\r\n") && utf8Valid(field[f], len);
+        if (copy[f]) toLowerEN(strcpy(copy[f], field[f]));
+    }
+
+    int idx = -1;
+    int fid = ok ? folderIntern(copy[0]) : -1;
+    if (fid >= 0 && findInFolder(fid, copy[1], copy[2]) >= 0) {
+        idx = -2;
+    } else if (fid >= 0 && (idx = libraryAdd(fid, copy[1], copy[2], 0)) >= 0) {
+        storageAdded(idx);
+        storageCommit(0); // 攢滿一批才寫；enwSave / enwClose 會把最後一批寫完
+    }
+    for (int f = 0; f < 3; f++) free(copy[f]);
+    return idx;
+}
+
+/* enwDelete：刪除第 idx 個單字（最後一個單字會搬到 idx 的位置）
+   回傳值：1 = 刪掉了，0 = 沒有這個單字*/
+ENW_API int enwDelete(EnWord *h, int idx) {
+    if (h != enwOpened || idx < 0 || idx >= library.count) return 0;
+    storageRemoving(idx); // 要趁單字還在的時候記
+    libraryRemove(idx);
+    storageCommit(1);
+    return 1;
+}
+
+/* enwSearch：搜尋英文或中文裡有 keyword 的單字（和選單的 search 一樣，結尾加 * 只找開頭）
+   -------------------------------------------------------
+   參數：
+     limit → 最多列出幾個（0 以下 = 全部）
+
+   回傳值：找到的單字，一個一行 W；一個都沒找到的話，
+           如果有拼法很像的字會回傳一行「S [Tab] 那個字」（你是不是要找）；記憶體不足回傳 NULL*/
+ENW_API const char *enwSearch(EnWord *h, const char *keyword, int limit) {
+    if (h != enwOpened || !keyword) return NULL;
+    size_t len = strlen(keyword);
+    char  *key = malloc(len + 1);
+    if (!key) return NULL;
+    memcpy(key, keyword, len + 1);
+    int prefix = (len > 1 && key[len - 1] == '*');
+    if (prefix) key[len - 1] = '\0';
+    trimText(key);
+    normalizeText(key, key);
+
+    h->out.len = 0;
+    h->out.failed = 0;
+    IdList hits = {0};
+    int found = key[0] ? gramSearch(&textIndex, &library, key, prefix, &hits) : 0;
+    for (int k = 0; k < found && (limit <= 0 || k < limit); k++) enwLine(h, hits.ids[k]);
+    if (found == 0 && key[0]) {
+        const char *like = bkNearest(key, SUGGEST_LIMIT, NULL);
+        if (like) {
+            textAppend(&h->out, "S\t", 2);
+            textAppend(&h->out, like, strlen(like));
+            textAppend(&h->out, "\n", 1);
         }
     }
+    free(hits.ids);
+    free(key);
+    return enwText(h);
+}
+
+/* enwQuiz：出一份考卷（和選單的「開始測驗」一樣三種出法）
+   -------------------------------------------------------
+   參數：
+     folder → 資料夾名稱；NULL 或空字串 = 全部單字
+     mode   → 1 = 今日複習（到期的優先），2 = 加權抽題（錯越多越容易抽到），3 = 整個範圍洗牌
+     count  → 最多幾題（0 以下 = 每種出法的預設題數；整個範圍就是全部）
+
+   回傳值：題目，一題一行 Q（照出題順序）；沒有題目是空字串；
+           mode 不對、沒有這個資料夾或記憶體不足回傳 NULL。
+   作答之後用 enwGrade 一題一題改。*/
+ENW_API const char *enwQuiz(EnWord *h, const char *folder, int mode, int count) {
+    if (h != enwOpened || mode < 1 || mode > 3) return NULL;
+    int folderId = -1;
+    if (folder && folder[0]) {
+        char *name = malloc(strlen(folder) + 1);
+        if (!name) return NULL;
+        toLowerEN(strcpy(name, folder));
+        folderId = folderFind(name);
+        free(name);
+        if (folderId < 0) return NULL;
+    }
+
+    int range = folderId >= 0 ? folderMembers(folderId)->count : library.count;
+    int max   = count > 0 ? count : mode == 1 ? REVIEW_SESSION : mode == 2 ? WEIGHTED_QUIZ : range;
+    int *ids  = malloc((size_t)((mode == 3 ? range : max) + 1) * sizeof(int));
+    if (!ids) return NULL;
+    int total, due;
+    if (mode == 1)      total = buildReviewSession(folderId, ids, max, &due);
+    else if (mode == 2) total = drawWeighted(folderId, max, ids);
+    else {
+        total = collectIndices(folderId, ids);
+        shuffle(ids, total);
+        if (total > max) total = max;
+    }
+
+    h->out.len = 0;
+    h->out.failed = total < 0; // drawWeighted 記憶體不足
+    char line[LINE_BUF * 2];
+    for (int i = 0; i < total; i++) {
+        const char *cn = wordChinese(ids[i]);
+        int len = snprintf(line, sizeof(line), "Q\t%d\t%s\t", ids[i], wordFolder(ids[i]));
+        textAppend(&h->out, line, (size_t)(len < (int)sizeof(line) ? len : (int)sizeof(line) - 1));
+        textAppend(&h->out, cn, strlen(cn));
+        textAppend(&h->out, "\n", 1);
+    }
+    free(ids);
+    return enwText(h);
+}
+
+/* enwGrade：批改一題（和選單的測驗一樣，答錯會加錯誤次數、也會更新複習排程）
+   -------------------------------------------------------
+   參數：
+     idx    → 題目（enwQuiz 的 Q 行第二欄）
+     answer → 打的英文（大小寫、全形半形、前後空白都不要緊）
+
+   回傳值：ANSWER_RIGHT（1）/ ANSWER_NEAR（2，打錯字，不算錯）/ ANSWER_WRONG（0）；
+           沒有這一題或記憶體不足回傳 -1*/
+ENW_API int enwGrade(EnWord *h, int idx, const char *answer) {
+    if (h != enwOpened || idx < 0 || idx >= library.count || !answer) return -1;
+    char *typed = malloc(strlen(answer) + 1);
+    if (!typed) return -1;
+    strcpy(typed, answer);
+    trimText(typed);
+    normalizeText(typed, typed);
+    int result = gradeAnswer(typed, idx);
+    free(typed);
+
+    if (result == ANSWER_WRONG) {
+        libraryAddError(idx, 1);
+        storageError(idx, 1);
+    }
+    libraryReview(idx, result == ANSWER_RIGHT);
+    storageCommit(0);
+    return result;
+}
+
+/* enwSave：把還沒寫進磁碟的變更全部寫進去（不用等到 enwClose）
+   回傳值：1 = 成功，0 = 代號不對*/
+ENW_API int enwSave(EnWord *h) {
+    if (h != enwOpened) return 0;
+    storageCommit(1);
+    return 1;
 }
 
 
@@ -935,7 +9573,7 @@ int mainMenu(void) {
             break;
         case 7: deleteWord();     break;
         case 8:
-            saveToFile();
+            storageClose(1); // 等還沒寫完的紀錄寫完，離開前把日誌壓縮進主檔
             printf("掰掰！記得定期複習喔！\n");
             break;
         default:
@@ -945,17 +9583,144 @@ int mainMenu(void) {
     return choice;
 }
 
+#ifndef EN_WORD_LIBRARY // 編成共用函式庫（-DEN_WORD_LIBRARY）時沒有 main，只留 enw* 給別的程式呼叫
 /* main：程式的起點，C 語言程式一定從這裡開始執行
    -------------------------------------------------------
-   srand(time(NULL)) 的作用：
-   → rand() 產生的數字序列其實是固定的「偽隨機」，
-     每次執行都一樣（好比說固定是 4, 1, 3, 2...）。
+   rngSeed(time(NULL)) 的作用：
+   → 亂數產生器產生的數字序列其實是固定的「偽隨機」，
+     同一個種子每次都一樣（好比說固定是 4, 1, 3, 2...）。
    → 用 time(NULL) 取得目前時間（秒數），當作「起始點（種子）」，
-     這樣每次執行的起始點不同，洗牌結果也就不同了。
-   → (unsigned) 是型別轉換，讓負的時間值也能正常使用。*/
-int main(void) {
-    srand((unsigned)time(NULL)); // 設定隨機種子，讓每次洗牌結果不同
-    loadFile();                  // 讀取之前儲存的單字資料
+     這樣每次執行的起始點不同，洗牌和抽題的結果也就不同了。
+
+   命令列參數（不加參數就是一般的選單模式）：
+     --export-snapshot 檔名 → 把目前的單字庫（含日誌裡的變更）匯出成快照檔
+     --import-snapshot 檔名 → 從快照檔匯入，覆蓋 english_word.txt
+     --import-tsv 檔名      → 把另一個 TSV 單字表（格式和 english_word.txt 一樣）
+                              加進目前的單字庫，同資料夾裡重複的單字會跳過
+     --export-dict 檔名     → 把目前的單字庫匯出成壓縮字典（唯讀的參考字典，很省空間）
+     --import-dict 檔名     → 從壓縮字典匯入，覆蓋 english_word.txt（沒有複習排程）
+     --lookup 檔名          → 參考字典模式：直接在壓縮字典裡查，不讀 english_word.txt
+     --typo 數字            → 一般的選單模式，但測驗時最多容忍幾個打錯的字母
+                              （預設 TYPO_LIMIT，0 = 一定要拼對才算）
+     --serve 連接埠         → 伺服器模式：好幾個學生同時連進來共用同一份單字庫
+     --grade 答案檔 結果檔  → 批次批改：一次改完整個答案檔，結果寫成 Tab 分隔的文字檔
+                              （答案檔是 - 就從標準輸入讀，可以接管線）
+     --analyze 結果檔       → 分析作答紀錄（english_word.events）：每個單字的難度曲線寫成 Tab 分隔的文字檔
+     --db 資料庫檔          → 寫在最前面：單字改存在 SQLite 資料庫（和 Python 版共用），
+                              後面可以再接 --typo、--serve、--grade、--analyze（編譯時要加 -DUSE_SQLITE）*/
+int main(int argc, char **argv) {
+    rngSeed((uint64_t)time(NULL)); // 設定隨機種子，讓每次洗牌、抽題結果不同
+
+    if (argc >= 3 && strcmp(argv[1], "--db") == 0) {
+        if (!storageUseDatabase(argv[2])) {
+            printf("[Error] 這個版本沒有 SQLite 功能，請用 -DUSE_SQLITE ... -lsqlite3 重新編譯。\n");
+            return 1;
+        }
+        // 後面的參數照常處理，就當作 --db 檔名 不存在
+        argv[2] = argv[0];
+        argv += 2;
+        argc -= 2;
+    }
+
+    if (!storageIsText() && argc > 1 && strcmp(argv[1], "--typo") != 0 &&
+        strcmp(argv[1], "--serve") != 0 && strcmp(argv[1], "--grade") != 0 &&
+        strcmp(argv[1], "--analyze") != 0) {
+        printf("[Error] 快照、壓縮字典和 TSV 匯入匯出只能用在 english_word.txt，不能和 --db 一起用。\n");
+        return 1;
+    }
+    if (argc == 3 && strcmp(argv[1], "--export-snapshot") == 0) {
+        loadFile();
+        // 匯出的快照不對應任何 english_word.txt，指紋和大小都填 0
+        int ok = snapshotSave(argv[2], 0, 0, 0);
+        printf(ok ? "已匯出快照：%s\n" : "[Error] 無法寫入快照：%s\n", argv[2]);
+        libraryFree();
+        return ok ? 0 : 1;
+    }
+    if (argc == 3 && strcmp(argv[1], "--import-snapshot") == 0) {
+        uint64_t hash;
+        if (!snapshotLoad(argv[2], 0, &hash)) {
+            printf("[Error] 無法讀取快照：%s\n", argv[2]);
+            return 1;
+        }
+        int ok = saveToFile(); // 寫回文字檔，同時清空日誌、更新 english_word.snap
+        printf(ok ? "已匯入 %d 個單字。\n" : "[Error] 無法寫入 english_word.txt（%d 個單字未匯入）\n",
+               library.count);
+        libraryFree();
+        return ok ? 0 : 1;
+    }
+    if (argc == 3 && strcmp(argv[1], "--import-tsv") == 0) {
+        int added = 0;
+        loadFile();
+        if (!bulkImport(argv[2], 1, NULL, &added)) {
+            printf("[Error] 無法開啟檔案：%s\n", argv[2]);
+            libraryFree();
+            return 1;
+        }
+        int ok = saveToFile();
+        printf(ok ? "已匯入 %d 個單字。\n" : "[Error] 無法寫入 english_word.txt（%d 個單字未匯入）\n",
+               added);
+        libraryFree();
+        return ok ? 0 : 1;
+    }
+    if (argc == 3 && strcmp(argv[1], "--export-dict") == 0) {
+        loadFile();
+        int kept = dictSave(argv[2]);
+        printf(kept >= 0 ? "已匯出壓縮字典：%s（%d 個單字）\n" : "[Error] 無法寫入壓縮字典：%s\n",
+               argv[2], kept);
+        libraryFree();
+        return kept >= 0 ? 0 : 1;
+    }
+    if (argc == 3 && strcmp(argv[1], "--import-dict") == 0) {
+        int added = dictImport(argv[2]);
+        if (added < 0) {
+            printf("[Error] 無法讀取壓縮字典：%s\n", argv[2]);
+            return 1;
+        }
+        int ok = saveToFile();
+        printf(ok ? "已匯入 %d 個單字。\n" : "[Error] 無法寫入 english_word.txt（%d 個單字未匯入）\n",
+               added);
+        libraryFree();
+        return ok ? 0 : 1;
+    }
+    if (argc == 3 && strcmp(argv[1], "--lookup") == 0) {
+        return dictLookup(argv[2]);
+    }
+    if (argc == 4 && strcmp(argv[1], "--grade") == 0) {
+        if (!storageOpen()) return 1; // 不開背景寫入執行緒：最後只寫一次，直接寫比較快
+        int quizzes = gradeBatch(argv[2], argv[3]);
+        storageClose(0);
+        libraryFree();
+        return quizzes >= 0 ? 0 : 1;
+    }
+    if (argc == 3 && strcmp(argv[1], "--analyze") == 0) {
+        if (!storageOpen()) return 1; // 要用目前的單字庫把紀錄裡的單字對回來
+        int ok = eventAnalyze(argv[2]) == 0;
+        storageClose(0);
+        libraryFree();
+        return ok ? 0 : 1;
+    }
+    if (argc == 3 && strcmp(argv[1], "--serve") == 0) {
+        int port = atoi(argv[2]);
+        if (port <= 0 || port > 65535) {
+            printf("[Error] 連接埠要是 1~65535 的數字。\n");
+            return 1;
+        }
+        return serverRun(port);
+    }
+    if (argc == 3 && strcmp(argv[1], "--typo") == 0 && argv[2][0] >= '0' && argv[2][0] <= '9') {
+        typoLimit = atoi(argv[2]);
+    } else if (argc > 1) {
+        printf("用法：%s [--export-snapshot 檔名 | --import-snapshot 檔名 | --import-tsv 檔名 |\n"
+               "          --export-dict 檔名 | --import-dict 檔名 | --lookup 檔名 |\n"
+               "          --typo 數字 | --serve 連接埠 | --grade 答案檔 結果檔 | --analyze 結果檔]\n"
+               "      %s --db 資料庫檔 [--typo 數字 | --serve 連接埠 | --grade 答案檔 結果檔 |\n"
+               "                       --analyze 結果檔]\n",
+               argv[0], argv[0]);
+        return 1;
+    }
+
+    if (!storageOpen()) return 1; // 讀取之前儲存的單字資料
+    persistStart();               // 之後的寫檔都交給背景執行緒，選單不用等磁碟
 
     int choice;
     do {
@@ -976,5 +9741,7 @@ int main(void) {
         choice = mainMenu();
     } while (choice != 8); // 選 8 才離開迴圈，結束程式
 
+    libraryFree(); // 釋放單字庫和索引的記憶體
     return 0; // main 回傳 0 代表「程式正常結束」
-}
\ No newline at end of file
+}
+#endif
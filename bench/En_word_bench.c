@@ -0,0 +1,419 @@
+/* ================================================================
+   英文單字背誦系統 · 效能測試（benchmark）
+   ================================================================
+
+   為什麼要有這個檔案？
+   → 「改完變快了」要有數字才算數：每一個效能相關的修改，都要先量、改完再量一次。
+   → 這裡會產生 1 千到 1 百萬個單字的假單字庫（英文 + UTF-8 中文），
+     量 loadFile、parseLine、查詢、collectIndices、錯題排行、shuffle、作答紀錄、saveToFile
+     每一次操作平均花幾奈秒（ns/op）、呼叫幾次 malloc（allocs/op）。
+
+   編譯（在專案最上層的資料夾）：
+     gcc -std=c99 -O2 -pthread bench/En_word_bench.c -o en_word_bench
+   執行：
+     ./en_word_bench                 → 量 1000、10000、100000、1000000 個單字
+     ./en_word_bench 5000 50000      → 只量指定的大小
+   假單字庫會寫在目前資料夾的 en_word_bench_data/ 裡（量完不會刪，可以拿來手動測試）。
+
+   怎麼量 allocs/op？
+   → 先把 <stdlib.h> 引進來，再用 #define 把 malloc / calloc / realloc 換成會計數的版本，
+     最後才 #include "../En_word.c"：En_word.c 裡的每一次配置記憶體都會經過計數器。
+   → main 改名成 enWordMain，printf 也換掉（En_word.c 的訊息不印，只留 [Error] / [Warning]），
+     這樣就能直接呼叫 En_word.c 裡的函數，不用另外拆出函式庫。
+   ================================================================ */
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+
+static long benchAllocs; // 到目前為止 malloc / calloc / realloc 被呼叫了幾次
+
+static void *benchMalloc(size_t n)          { benchAllocs++; return malloc(n); }
+static void *benchCalloc(size_t n, size_t m) { benchAllocs++; return calloc(n, m); }
+static void *benchRealloc(void *p, size_t n) { benchAllocs++; return realloc(p, n); }
+
+/* benchPrintf：En_word.c 的 printf 只留下錯誤和警告，其他的一般訊息不印*/
+static int benchPrintf(const char *fmt, ...) {
+    if (strncmp(fmt, "[Error]", 7) != 0 && strncmp(fmt, "[Warning]", 9) != 0) return 0;
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vprintf(fmt, ap);
+    va_end(ap);
+    return n;
+}
+
+#define malloc(n)     benchMalloc(n)
+#define calloc(n, m)  benchCalloc(n, m)
+#define realloc(p, n) benchRealloc(p, n)
+#define printf(...)   benchPrintf(__VA_ARGS__)
+#define main          enWordMain
+#include "../En_word.c"
+#undef main
+#undef printf
+
+#ifdef _WIN32
+#include <direct.h>  // _mkdir / _chdir
+#define benchMkdir(path) _mkdir(path)
+#define benchChdir(path) _chdir(path)
+#else
+#define benchMkdir(path) mkdir(path, 0755)
+#define benchChdir(path) chdir(path)
+#endif
+
+#define BENCH_DIR      "en_word_bench_data" // 假單字庫放在這個資料夾
+#define BENCH_QUERIES  2000  // 每種查詢做幾次
+#define BENCH_MIN_SEC  0.2   // 小的操作至少重複量這麼久，數字才穩定
+#define BENCH_EVENTS   2000000 // 作答紀錄要產生幾筆作答來分析
+#define BENCH_SESSION  50      // 產生作答紀錄時，一次測驗幾題
+
+/* benchNow：現在的時間（秒），只拿來算經過了多久*/
+static double benchNow(void) {
+#ifdef _WIN32
+    LARGE_INTEGER freq, now;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    return (double)now.QuadPart / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#endif
+}
+
+static double benchStartTime;
+static long   benchStartAllocs;
+
+/* benchBegin / benchEnd：量一段程式；benchEnd 印出 ns/op 和 allocs/op
+   參數：
+     ops → 這段程式總共做了幾次操作（例如載入 1000 個單字就是 1000 次）*/
+static void benchBegin(void) {
+    benchStartAllocs = benchAllocs;
+    benchStartTime   = benchNow();
+}
+
+static void benchEnd(const char *name, int words, long ops) {
+    double sec    = benchNow() - benchStartTime;
+    long   allocs = benchAllocs - benchStartAllocs;
+    if (ops <= 0) ops = 1;
+    printf("%-26s %8d  %12.1f ns/op  %10.3f allocs/op  %10ld ops  %9.3f ms\n",
+           name, words, sec * 1e9 / (double)ops, (double)allocs / (double)ops, ops, sec * 1e3);
+}
+
+/* benchUtf8：把一個 Unicode 字元寫成 UTF-8（這裡只會用到 3 bytes 的中文字）*/
+static int benchUtf8(char *out, uint32_t cp) {
+    out[0] = (char)(0xE0 | (cp >> 12));
+    out[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    out[2] = (char)(0x80 | (cp & 0x3F));
+    return 3;
+}
+
+/* benchWord：產生第 i 個假單字的英文和中文
+   英文是 3~8 個亂數字母，後面接 i 的 26 進位（保證每個單字都不一樣）；
+   中文是 2~4 個常用字範圍（U+4E00 ~ U+9FA5）裡的亂數中文字。*/
+static void benchWord(int i, char *en, char *cn) {
+    int n = 3 + (int)rngBelow(6), len = 0;
+    for (int k = 0; k < n; k++) en[len++] = (char)('a' + rngBelow(26));
+    unsigned v = (unsigned)i;
+    do {
+        en[len++] = (char)('a' + v % 26);
+        v /= 26;
+    } while (v);
+    en[len] = '\0';
+
+    int chars = 2 + (int)rngBelow(3);
+    len = 0;
+    for (int k = 0; k < chars; k++) len += benchUtf8(cn + len, 0x4E00 + (uint32_t)rngBelow(0x9FA5 - 0x4E00));
+    cn[len] = '\0';
+}
+
+/* benchGenerate：寫出有 words 個單字的 english_word.txt（和真的單字檔格式一樣）
+   大約三成的單字有錯誤紀錄，錯題排行才有東西可以排。*/
+static int benchGenerate(int words) {
+    remove(SNAP_FILE);
+    remove(JOURNAL_FILE);
+    FILE *fp = fopen(WORD_FILE, "w");
+    if (!fp) return 0;
+    int folderCount = words / 200 + 1;
+    if (folderCount > 1000) folderCount = 1000;
+    char en[64], cn[64];
+    for (int i = 0; i < words; i++) {
+        benchWord(i, en, cn);
+        int errors = rngBelow(10) < 3 ? 1 + (int)rngBelow(9) : 0;
+        fprintf(fp, "Unit%03d\t%s\t%s\t%d\n", (int)rngBelow((uint64_t)folderCount), en, cn, errors);
+    }
+    fclose(fp);
+    return 1;
+}
+
+/* benchReset：把 loadFile 留下的東西全部清掉，下一次 loadFile 才是從頭開始*/
+static void benchReset(void) {
+    libraryFree();
+    if (journal.fp) fclose(journal.fp);
+    journal.fp = NULL;
+}
+
+/* benchLoadAndParse：量 loadFile（讀文字檔、讀快照）和 parseLine*/
+static void benchLoadAndParse(int words) {
+    remove(SNAP_FILE);
+    benchBegin();
+    loadFile(); // 沒有快照：解析文字檔，順便寫出快照
+    benchEnd("loadFile (tsv)", words, words);
+    benchReset();
+
+    benchBegin();
+    loadFile(); // 有快照：直接 mmap，不用解析
+    benchEnd("loadFile (snapshot)", words, words);
+    benchReset();
+
+    // parseLine 會改到傳進去的字串，所以先把整個檔案讀進來，每一行各放一份
+    FILE *fp = fopen(WORD_FILE, "r");
+    if (!fp) return;
+    char  *line = NULL;
+    size_t cap  = 0;
+    long   len;
+    TextBuf text = {0};
+    size_t *starts = malloc((size_t)words * sizeof(size_t));
+    int lines = 0;
+    while (starts && lines < words && (len = readLine(fp, &line, &cap)) >= 0) {
+        starts[lines++] = text.len;
+        textAppend(&text, line, (size_t)len + 1);
+    }
+    fclose(fp);
+    free(line);
+    if (starts && !text.failed) {
+        benchBegin();
+        for (int i = 0; i < lines; i++) parseLine(text.data + starts[i]);
+        benchEnd("parseLine", words, lines);
+    }
+    free(starts);
+    free(text.data);
+    benchReset();
+}
+
+/* benchSearch：量查詢（找得到、找不到、前綴查詢、打錯字時的建議）*/
+static void benchSearch(int words) {
+    char (*keys)[16] = malloc((size_t)BENCH_QUERIES * sizeof(*keys));
+    char (*typos)[64] = malloc((size_t)BENCH_QUERIES * sizeof(*typos));
+    if (!keys || !typos) { free(keys); free(typos); return; }
+
+    // 找得到的：某個單字英文的一段；找不到的：數字（單字只有字母，一定找不到）
+    for (int q = 0; q < BENCH_QUERIES; q++) {
+        int idx = (int)rngBelow((uint64_t)library.count);
+        const char *en = wordKeyEn(idx);
+        size_t len = strlen(en), start = rngBelow(len > 3 ? len - 3 : 1);
+        snprintf(keys[q], sizeof(keys[q]), "%.3s", en + start);
+        snprintf(typos[q], sizeof(typos[q]), "%s", en);
+        typos[q][rngBelow(strlen(typos[q]))] = 'z'; // 改掉一個字母，當成打錯字
+    }
+
+    IdList hits = {0};
+    // 先查一次暖身，讓 hits 先配好空間（片段索引在 libraryAdd 時就建好了）；
+    // 下面計時的只有查詢本身：挑最短的片段清單、逐一確認候選、排序去掉重複
+    gramSearch(&textIndex, &library, keys[0], 0, &hits);
+
+    long found = 0;
+    benchBegin();
+    for (int q = 0; q < BENCH_QUERIES; q++) {
+        hits.count = 0;
+        found += gramSearch(&textIndex, &library, keys[q], 0, &hits);
+    }
+    benchEnd("search (hit)", words, BENCH_QUERIES);
+
+    benchBegin();
+    for (int q = 0; q < BENCH_QUERIES; q++) {
+        char miss[16];
+        snprintf(miss, sizeof(miss), "%d", 1000 + q);
+        hits.count = 0;
+        found += gramSearch(&textIndex, &library, miss, 0, &hits);
+    }
+    benchEnd("search (miss)", words, BENCH_QUERIES);
+
+    benchBegin();
+    for (int q = 0; q < BENCH_QUERIES; q++) {
+        hits.count = 0;
+        found += gramSearch(&textIndex, &library, keys[q], 1, &hits);
+    }
+    benchEnd("search (prefix)", words, BENCH_QUERIES);
+    free(hits.ids);
+
+    bkNearest(typos[0], SUGGEST_LIMIT, NULL); // 第一次才建 BK-tree
+    benchBegin();
+    for (int q = 0; q < BENCH_QUERIES; q++) {
+        if (bkNearest(typos[q], SUGGEST_LIMIT, NULL)) found++;
+    }
+    benchEnd("search (did you mean)", words, BENCH_QUERIES);
+
+    if (found < 0) printf("%ld\n", found); // 不讓編譯器把查詢當成沒用的程式碼拿掉
+    free(keys);
+    free(typos);
+}
+
+/* benchSelect：量出題前的準備（collectIndices、shuffle）、錯題排行、字母順序的分頁、選擇題和統計資訊*/
+static void benchSelect(int words) {
+    int *ids = malloc((size_t)(library.count ? library.count : 1) * sizeof(int));
+    if (!ids) return;
+
+    long reps = 0;
+    double until = benchNow() + BENCH_MIN_SEC;
+    benchBegin();
+    while (benchNow() < until) { collectIndices(-1, ids); reps++; }
+    benchEnd("collectIndices (all)", words, reps * library.count);
+
+    int folder = folders.count / 2;
+    folderMembers(folder); // 第一次才建資料夾的單字清單
+    reps = 0;
+    until = benchNow() + BENCH_MIN_SEC;
+    long picked = 0;
+    benchBegin();
+    while (benchNow() < until) { picked += collectIndices(folder, ids); reps++; }
+    benchEnd("collectIndices (folder)", words, picked);
+
+    collectIndices(-1, ids);
+    reps = 0;
+    until = benchNow() + BENCH_MIN_SEC;
+    benchBegin();
+    while (benchNow() < until) { shuffle(ids, library.count); reps++; }
+    benchEnd("shuffle", words, reps * library.count);
+
+    // 錯題排行：重建整個 heap、取第一頁（showErrorList 一頁）、取出整份排行
+    errorRank.ready = 0;
+    benchBegin();
+    int ranked = heapCount(&errorRank);
+    benchEnd("error rank (build)", words, words);
+
+    int page[LIST_PAGE];
+    reps = 0;
+    until = benchNow() + BENCH_MIN_SEC;
+    benchBegin();
+    while (benchNow() < until) { heapTop(&errorRank, 0, LIST_PAGE, page, NULL, NULL); reps++; }
+    benchEnd("error rank (first page)", words, reps);
+
+    benchBegin();
+    int got = heapTop(&errorRank, 0, ranked, ids, NULL, NULL);
+    benchEnd("error rank (full list)", words, got);
+    free(ids);
+
+    // 字母順序：第一次才整個排序，之後每次「範圍查詢 + 取出第 500 頁」都只要二分搜尋
+    const SortedIndex *order;
+    int first;
+    sortedFree(&alphaOrder);
+    benchBegin();
+    sortedRange(-1, "", "", &order, &first);
+    benchEnd("sorted view (build)", words, words);
+
+    long seen = 0;
+    reps = 0;
+    until = benchNow() + BENCH_MIN_SEC;
+    benchBegin();
+    while (benchNow() < until) {
+        int n = sortedRange(-1, "b", "m", &order, &first);
+        int at = 499 * LIST_PAGE < n ? 499 * LIST_PAGE : 0;
+        for (int i = at; i < at + LIST_PAGE && i < n; i++) seen += order->list.ids[first + i];
+        reps++;
+    }
+    benchEnd("sorted view (page 500)", words, reps);
+
+    // 選擇題：第一題要先建好另外兩份字母順序索引，之後每題只是查事先挑好的干擾選項
+    int options[DISTRACT_CHOICES];
+    benchBegin();
+    seen += distractorPick(0, options);
+    benchEnd("distractors (first pick)", words, 1);
+
+    reps = 0;
+    until = benchNow() + BENCH_MIN_SEC;
+    benchBegin();
+    while (benchNow() < until) {
+        seen += distractorPick((int)rngBelow((uint64_t)library.count), options);
+        reps++;
+    }
+    benchEnd("distractors (per question)", words, reps);
+
+    // 統計資訊：第一次看要整個掃一遍，之後每答錯一題只改幾個計數器
+    statsFree();
+    benchBegin();
+    statsBuild();
+    benchEnd("stats (build)", words, words);
+
+    reps = 0;
+    until = benchNow() + BENCH_MIN_SEC;
+    benchBegin();
+    while (benchNow() < until) {
+        int idx = (int)rngBelow((uint64_t)library.count);
+        statsError(idx, library.words[idx].errorCount); // 扣掉再加回同一個次數：計數器不變，要做的事一樣多
+        reps++;
+    }
+    benchEnd("stats (per answer)", words, reps);
+    seen += stats.total.errorWords;
+    if (seen < 0) printf("%ld\n", seen); // 不讓編譯器把查詢當成沒用的程式碼拿掉
+}
+
+/* benchEvents：量寫作答紀錄（每次測驗結束寫一塊）和 --analyze 分析幾百萬筆作答*/
+static void benchEvents(int words) {
+    remove(EVENT_FILE); // 每種大小都從空的紀錄開始，不然會越疊越多
+    eventState = 0;
+
+    TestSession s;
+    if (!sessionBegin(&s, BENCH_SESSION)) return;
+    s.total = BENCH_SESSION;
+    benchBegin();
+    for (long done = 0; done < BENCH_EVENTS; done += BENCH_SESSION) {
+        for (int i = 0; i < BENCH_SESSION; i++) {
+            // 一部分的字常常考，難度曲線後面幾段才有資料
+            int idx = (int)rngBelow((uint64_t)(i % 2 ? library.count : (library.count + 9) / 10));
+            s.questions[i]  = idx;
+            s.results[i]    = (uint8_t)rngBelow(3);
+            s.answers[i]    = s.results[i] == ANSWER_RIGHT ? wordKeyEn(idx) : "wrong";
+            s.elapsedMs[i]  = (uint32_t)rngBelow(8000);
+            s.answeredAt[i] = (uint32_t)(done / BENCH_SESSION);
+        }
+        eventLogSession(&s);
+    }
+    benchEnd("events (log per answer)", words, BENCH_EVENTS);
+    sessionEnd(&s);
+
+    benchBegin();
+    eventAnalyze("en_word_bench.analyze");
+    benchEnd("events (analyze)", words, BENCH_EVENTS);
+}
+
+/* benchSave：量 saveToFile（排好整份主檔、寫到磁碟、寫快照）*/
+static void benchSave(int words) {
+    benchBegin();
+    saveToFile();
+    benchEnd("saveToFile", words, words);
+}
+
+int main(int argc, char **argv) {
+    static const int defaults[] = { 1000, 10000, 100000, 1000000 };
+    int sizes = argc > 1 ? argc - 1 : (int)(sizeof(defaults) / sizeof(defaults[0]));
+
+    benchMkdir(BENCH_DIR); // 已經有這個資料夾也沒關係
+    if (benchChdir(BENCH_DIR) != 0) {
+        fprintf(stderr, "無法進入 %s 資料夾。\n", BENCH_DIR);
+        return 1;
+    }
+    rngSeed(1); // 固定種子：每次產生的假單字庫都一樣，結果才能互相比較
+
+    printf("%-26s %8s  %18s  %20s  %14s  %12s\n", "operation", "words", "ns/op", "allocs/op", "ops", "total");
+    for (int s = 0; s < sizes; s++) {
+        int words = argc > 1 ? atoi(argv[s + 1]) : defaults[s];
+        if (words <= 0) continue;
+        if (!benchGenerate(words)) {
+            fprintf(stderr, "無法寫入 %s。\n", WORD_FILE);
+            return 1;
+        }
+        benchLoadAndParse(words);
+        loadFile();
+        benchSearch(words);
+        benchSelect(words);
+        benchEvents(words);
+        benchSave(words);
+        benchReset();
+        printf("\n");
+    }
+    return 0;
+}
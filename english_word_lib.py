@@ -0,0 +1,214 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+英文單字背誦系統 - C 核心的 Python 介面（ctypes）
+
+為什麼需要？
+web.py、GUI.py 每個請求都要重新下 SQL 查詢；改用這個模組的話，
+單字庫只讀一次、常駐在記憶體裡，查詢、出題、批改都直接用 C 版的索引和打錯字判斷。
+
+先把 En_word.c 編成共用函式庫（和這個檔案放在同一個資料夾）：
+    gcc -O2 -shared -fPIC -fvisibility=hidden -DEN_WORD_LIBRARY -DUSE_SQLITE En_word.c -o libenword.so -pthread -lsqlite3
+    （Windows 編成 enword.dll，要再加 -lws2_32）
+
+用法：
+    from english_word_lib import NativeVocabulary
+    with NativeVocabulary("vocabulary.db") as vocab:
+        words, suggestion = vocab.search("app*")
+        result = vocab.grade(words[0]["index"], "aple")   # 'near'
+"""
+
+import ctypes  # Python 內建的模組，可以直接呼叫 C 寫的函式庫
+import os
+import sys
+import threading  # C 那邊同一個代號一次只能有一個執行緒在用，所以要一把鎖
+from typing import Dict, List, Optional, Tuple
+
+# 批改結果：和 En_word.c 的 ANSWER_* 數值一樣
+RESULTS = {0: 'wrong', 1: 'right', 2: 'near'}
+
+# 出題方式：和 enwQuiz 的 mode 一樣
+QUIZ_REVIEW = 1    # 今日複習（到期的單字優先）
+QUIZ_WEIGHTED = 2  # 加權抽題（錯越多次越容易抽到）
+QUIZ_ALL = 3       # 整個範圍洗牌
+
+
+def _default_library_path() -> str:
+    """找共用函式庫：先看環境變數 EN_WORD_LIB，再找這個檔案旁邊的 libenword.so / enword.dll"""
+    path = os.environ.get('EN_WORD_LIB')
+    if path:
+        return path
+    name = 'enword.dll' if sys.platform == 'win32' else 'libenword.so'
+    return os.path.join(os.path.dirname(os.path.abspath(__file__)), name)
+
+
+def _load(path: str) -> ctypes.CDLL:
+    """載入函式庫，並告訴 ctypes 每個函數的參數和回傳值型別（沒寫的話指標會被當成 int 截斷）"""
+    lib = ctypes.CDLL(path)
+    handle = ctypes.c_void_p
+    text = ctypes.c_char_p
+    signatures = {
+        'enwOpen':   (handle, [text]),
+        'enwClose':  (None, [handle]),
+        'enwCount':  (ctypes.c_int, [handle]),
+        'enwWord':   (text, [handle, ctypes.c_int]),
+        'enwAdd':    (ctypes.c_int, [handle, text, text, text]),
+        'enwDelete': (ctypes.c_int, [handle, ctypes.c_int]),
+        'enwSearch': (text, [handle, text, ctypes.c_int]),
+        'enwQuiz':   (text, [handle, text, ctypes.c_int, ctypes.c_int]),
+        'enwGrade':  (ctypes.c_int, [handle, ctypes.c_int, text]),
+        'enwSave':   (ctypes.c_int, [handle]),
+    }
+    for name, (restype, argtypes) in signatures.items():
+        func = getattr(lib, name)
+        func.restype = restype
+        func.argtypes = argtypes
+    return lib
+
+
+def _encode(value: Optional[str]) -> Optional[bytes]:
+    """Python 字串 → C 字串（UTF-8）；None 就傳 NULL"""
+    return value.encode('utf-8') if value is not None else None
+
+
+def _rows(raw: Optional[bytes]) -> List[List[str]]:
+    """把 C 回傳的「一行一筆、Tab 分隔」的文字切成一個一個欄位"""
+    if not raw:
+        return []
+    return [line.split('\t') for line in raw.decode('utf-8').split('\n') if line]
+
+
+def _word(fields: List[str]) -> Dict:
+    """W [Tab] 索引 [Tab] 資料夾 [Tab] 英文 [Tab] 中文 [Tab] 錯誤次數 → dict"""
+    return {
+        'index': int(fields[1]),
+        'folder': fields[2],
+        'english': fields[3],
+        'chinese': fields[4],
+        'error_count': int(fields[5]),
+    }
+
+
+class NativeVocabulary:
+    """
+    C 核心的單字庫（同一個程式裡同時只能開一個）
+
+    index 是 C 那邊的單字索引（不是資料庫的 id）：
+    刪除單字時最後一個單字會搬到被刪的位置，所以刪除之後要重新查。
+    """
+
+    def __init__(self, db_path: Optional[str] = None, lib_path: Optional[str] = None):
+        """
+        參數說明：
+        db_path: SQLite 資料庫（和 web.py、GUI.py 共用的 vocabulary.db）；
+                 None = 用目前資料夾的 english_word.txt
+        lib_path: 共用函式庫的位置（預設找這個檔案旁邊的 libenword.so）
+        """
+        self._lib = _load(lib_path or _default_library_path())
+        self._lock = threading.Lock()
+        self._handle = self._lib.enwOpen(_encode(db_path))
+        if not self._handle:
+            raise RuntimeError('無法開啟單字庫（已經開了一個、編譯時沒有加 -DUSE_SQLITE，或讀不到檔案）')
+
+    def close(self) -> None:
+        """關閉單字庫（把還沒寫的變更寫完）"""
+        with self._lock:
+            if self._handle:
+                self._lib.enwClose(self._handle)
+                self._handle = None
+
+    def __enter__(self) -> 'NativeVocabulary':
+        return self
+
+    def __exit__(self, *exc) -> None:
+        self.close()
+
+    def _call(self, name: str, *args):
+        """呼叫 C 的函數（拿著鎖；回傳的字串在下一次呼叫前就要轉好，所以在鎖裡面轉）"""
+        with self._lock:
+            if not self._handle:
+                raise RuntimeError('單字庫已經關閉了')
+            return getattr(self._lib, name)(self._handle, *args)
+
+    def count(self) -> int:
+        """單字庫有幾個單字"""
+        return self._call('enwCount')
+
+    def word(self, index: int) -> Optional[Dict]:
+        """第 index 個單字；沒有的話回傳 None"""
+        rows = _rows(self._call('enwWord', index))
+        return _word(rows[0]) if rows else None
+
+    def add(self, folder: str, english: str, chinese: str) -> Optional[int]:
+        """
+        新增單字（資料夾和英文會轉成小寫）
+
+        回傳值：新單字的 index；同一個資料夾已經有一模一樣的字就回傳 None
+        格式不對（空白、有 Tab 或換行）會丟出 ValueError
+        """
+        index = self._call('enwAdd', _encode(folder), _encode(english), _encode(chinese))
+        if index == -2:
+            return None
+        if index < 0:
+            raise ValueError('資料夾、英文、中文都不能空白，也不能有 Tab 或換行')
+        return index
+
+    def delete(self, index: int) -> bool:
+        """刪除第 index 個單字，回傳有沒有刪掉"""
+        return self._call('enwDelete', index) == 1
+
+    def search(self, keyword: str, limit: int = 0) -> Tuple[List[Dict], Optional[str]]:
+        """
+        搜尋英文或中文裡有 keyword 的單字（結尾加 * 只找開頭）
+
+        回傳值：(符合的單字, 你是不是要找的字)；
+        第二個只有在一個都沒找到、而且有拼法很像的字時才不是 None
+        """
+        words, suggestion = [], None
+        for fields in _rows(self._call('enwSearch', _encode(keyword), limit)):
+            if fields[0] == 'W':
+                words.append(_word(fields))
+            elif fields[0] == 'S':
+                suggestion = fields[1]
+        return words, suggestion
+
+    def quiz(self, folder: Optional[str] = None, mode: int = QUIZ_ALL, count: int = 0) -> List[Dict]:
+        """
+        出一份考卷：每一題是 {'index', 'folder', 'chinese'}，作答後用 grade 批改
+
+        參數說明：
+        folder: 資料夾名稱（None = 全部單字）
+        mode: QUIZ_REVIEW / QUIZ_WEIGHTED / QUIZ_ALL
+        count: 最多幾題（0 = 預設題數；QUIZ_ALL 就是整個範圍）
+        """
+        raw = self._call('enwQuiz', _encode(folder), mode, count)
+        if raw is None:
+            raise ValueError('沒有這個資料夾或出題方式')
+        return [{'index': int(f[1]), 'folder': f[2], 'chinese': f[3]} for f in _rows(raw)]
+
+    def grade(self, index: int, answer: str) -> str:
+        """
+        批改一題：回傳 'right' / 'near'（打錯字，不算錯）/ 'wrong'
+        答錯會加錯誤次數，也會更新複習排程（和 C 版的測驗一樣）
+        """
+        result = self._call('enwGrade', index, _encode(answer))
+        if result < 0:
+            raise IndexError(f'沒有第 {index} 題')
+        return RESULTS[result]
+
+    def save(self) -> None:
+        """把還沒寫進磁碟的變更寫進去"""
+        self._call('enwSave')
+
+
+if __name__ == '__main__':
+    # 簡單的試用：python3 english_word_lib.py vocabulary.db 關鍵字
+    if len(sys.argv) != 3:
+        print(f'用法：{sys.argv[0]} 資料庫檔 關鍵字')
+        sys.exit(1)
+    with NativeVocabulary(sys.argv[1]) as vocab:
+        found, like = vocab.search(sys.argv[2], 20)
+        for w in found:
+            print(f"{w['english']}\t{w['chinese']}\t（{w['folder']}，錯 {w['error_count']} 次）")
+        if not found:
+            print(f'找不到，你是不是要找：{like}' if like else '找不到。')